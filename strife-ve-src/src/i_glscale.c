@@ -65,6 +65,7 @@
 #include <stdlib.h>
 
 #include "i_video.h"
+#include "i_scale.h"
 #include "m_argv.h"
 
 // [SVE] svillarreal
@@ -89,12 +90,20 @@ static int window_w, window_h;
 
 // The texture that "receives" the original 320x200 screen contents:
 static GLuint unscaled_texture;
-static unsigned int *unscaled_data = NULL;
+static uint32_t *unscaled_data = NULL;
 
 // The scaled framebuffer
 static rbfbo_t scaled_framebuffer;
 static int scaled_w, scaled_h;
 
+// [SVE] A frame bigger than 320x200, from a software view drawn at a
+// higher resolution (see I_SetViewLayer). It has pixels enough of its
+// own, so it goes straight to the window with linear filtering.
+static GLuint native_texture;
+static uint32_t *native_data = NULL;
+static int native_w, native_h;
+static int native_tex_w, native_tex_h;
+
 #ifdef SVE_PLAT_SWITCH
 GL_Context ctx;
 #endif
@@ -246,43 +255,46 @@ static boolean SetupFramebuffer(void)
     return scaled_framebuffer.bLoaded;
 }
 
+// [SVE] the 8 to 32 bit lookup is done by i_scale.c's row kernels;
+// the colors are laid out in memory as GL_RGBA expects
+static void SetPalette32(SDL_Color *palette)
+{
+    uint32_t colors[256];
+    byte *c;
+    int i;
+
+    for (i = 0; i < 256; ++i)
+    {
+        c = (byte *) &colors[i];
+        c[0] = palette[i].r;
+        c[1] = palette[i].g;
+        c[2] = palette[i].b;
+        c[3] = 0xff;
+    }
+
+    I_SetScalePalette32(colors);
+}
+
 // Import screen data from the given pointer and palette and update
 // the unscaled_texture texture.
 static void SetInputData(byte *screen, SDL_Color *palette)
 {
-    SDL_Color *c;
-    byte *s;
+    int pitch;
+
+    SetPalette32(palette);
 
     // TODO: Maybe support GL_RGB as well as GL_RGBA?
     if(glscale_pipeline == GLSCALE_PIPELINE_FBO)
     {
-        unsigned int i;
-        s = (byte *) unscaled_data;
-        for (i = 0; i < SCREENWIDTH * SCREENHEIGHT; ++i)
-        {
-            c = &palette[screen[i]];
-            *s++ = c->r;
-            *s++ = c->g;
-            *s++ = c->b;
-            *s++ = 0xff;
-        }
+        pitch = SCREENWIDTH * 4;
     }
     else
     {
-        int x, y;
-        for(y = 0; y < SCREENHEIGHT; y++)
-        {
-            s = (byte *)(unscaled_data + y * 512);
-            for(x = 0; x < SCREENWIDTH; x++)
-            {
-                c = &palette[screen[y * SCREENWIDTH + x]];
-                *s++ = c->r;
-                *s++ = c->g;
-                *s++ = c->b;
-                *s++ = 0xff;
-            }
-        }
+        pitch = 512 * 4;
     }
+
+    I_InitScale(screen, (byte *) unscaled_data, pitch);
+    I_Scale32(0, 0, SCREENWIDTH, SCREENHEIGHT, 1, unscaled_data, pitch);
         
     dglBindTexture(GL_TEXTURE_2D, unscaled_texture);
     if(glscale_pipeline == GLSCALE_PIPELINE_FBO)
@@ -297,6 +309,52 @@ static void SetInputData(byte *screen, SDL_Color *palette)
     }
 }
 
+// [SVE] Import a frame of any size into native_texture, making the
+// texture over if the size has changed.
+static void SetNativeInputData(byte *screen, int w, int h, SDL_Color *palette)
+{
+    SetPalette32(palette);
+
+    if (w != native_w || h != native_h)
+    {
+        native_w = w;
+        native_h = h;
+
+        if (glscale_pipeline == GLSCALE_PIPELINE_FBO)
+        {
+            native_tex_w = w;
+            native_tex_h = h;
+        }
+        else
+        {
+            native_tex_w = RB_RoundPowerOfTwo(w);
+            native_tex_h = RB_RoundPowerOfTwo(h);
+        }
+
+        free(native_data);
+        native_data = malloc(w * h * sizeof(uint32_t));
+
+        if (native_texture == 0)
+        {
+            dglGenTextures(1, &native_texture);
+        }
+
+        dglBindTexture(GL_TEXTURE_2D, native_texture);
+        dglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        dglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        dglTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        dglTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        dglTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, native_tex_w, native_tex_h, 0,
+                      GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+
+    I_Convert32(screen, w, h, native_data, w * 4);
+
+    dglBindTexture(GL_TEXTURE_2D, native_texture);
+    dglTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h,
+                     GL_RGBA, GL_UNSIGNED_BYTE, native_data);
+}
+
 // Draw fake scanlines.
 static void DrawScanlines(void)
 {
@@ -401,6 +459,37 @@ static void DrawScreen(void)
     }
 }
 
+// [SVE] Render native_texture to the screen.
+static void DrawNativeScreen(void)
+{
+    GLfloat w, h;
+    float smax = (float) native_w / native_tex_w;
+    float tmax = (float) native_h / native_tex_h;
+
+    dglClear(GL_COLOR_BUFFER_BIT);
+
+    dglMatrixMode(GL_PROJECTION);
+    dglLoadIdentity();
+    dglMatrixMode(GL_MODELVIEW);
+    dglLoadIdentity();
+
+    dglViewport(0, 0, screen_w, screen_h);
+
+    w = (float) window_w / screen_w;
+    h = (float) window_h / screen_h;
+
+    dglBindTexture(GL_TEXTURE_2D, native_texture);
+
+    dglBegin(GL_QUADS);
+    dglTexCoord2f(0,    0   ); dglVertex2f(-w,  h);
+    dglTexCoord2f(smax, 0   ); dglVertex2f( w,  h);
+    dglTexCoord2f(smax, tmax); dglVertex2f( w, -h);
+    dglTexCoord2f(0,    tmax); dglVertex2f(-w, -h);
+    dglEnd();
+
+    RB_UnbindTexture();
+}
+
 boolean I_GL_InitScale(int w, int h)
 {
     if(CheckExtensions())
@@ -442,3 +531,15 @@ void I_GL_UpdateScreen(byte *screendata, SDL_Color *palette)
     DrawScreen();
 }
 
+// [SVE] Show a frame bigger than 320x200 over the same window.
+void I_GL_UpdateNativeScreen(byte *screendata, int w, int h,
+                             SDL_Color *palette)
+{
+    // disable culling
+    RB_SetState(GLSTATE_CULL, false);
+    RB_SetCull(GLCULL_BACK);
+
+    SetNativeInputData(screendata, w, h, palette);
+    DrawNativeScreen();
+}
+
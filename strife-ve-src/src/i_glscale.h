@@ -26,6 +26,8 @@
 
 boolean I_GL_InitScale(int w, int h);
 void I_GL_UpdateScreen(byte *screendata, SDL_Color *palette);
+void I_GL_UpdateNativeScreen(byte *screendata, int w, int h,
+                             SDL_Color *palette);
 
 extern int gl_max_scale;
 
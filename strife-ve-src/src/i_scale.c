@@ -22,10 +22,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "SDL_cpuinfo.h"
+
 #include "doomtype.h"
 
+#include "i_timer.h"
 #include "i_video.h"
 #include "m_argv.h"
+#include "m_misc.h"
 #include "z_zone.h"
 
 #if defined(_MSC_VER) && !defined(__cplusplus)
@@ -55,6 +59,363 @@ static byte *stretch_tables[2] = { NULL, NULL };
 
 static byte *half_stretch_table = NULL;
 
+//
+// [SVE] Row kernels.
+//
+// The integer scales write every row of the source out N times, so
+// each row is built once and the copies below it are memcpy'd. The
+// row itself is built with SSE2 or AVX2 when the CPU has them, with
+// a plain C loop as the fallback. The same kernels also do the 8 to
+// 32 bit palette lookup for I_Scale32, which scales straight into a
+// 32 bit surface or locked texture without an indexed copy between.
+//
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCALE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(SCALE_SSE2)
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define SCALE_AVX2
+#define SCALE_AVX2_FUNC __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && _MSC_VER >= 1700
+#define SCALE_AVX2
+#define SCALE_AVX2_FUNC
+#include <immintrin.h>
+#endif
+#endif
+
+#define MAX_INTEGER_SCALE 5
+
+enum
+{
+    SCALE_KERNEL_C,
+    SCALE_KERNEL_SSE2,
+    SCALE_KERNEL_AVX2,
+    NUM_SCALE_KERNELS
+};
+
+static const char *scale_kernel_names[NUM_SCALE_KERNELS] =
+{
+    "C", "SSE2", "AVX2"
+};
+
+// Best kernel the CPU supports, and the one in use.
+
+static int best_scale_kernel = -1;
+static int scale_kernel = SCALE_KERNEL_C;
+
+// 32 bit colors for I_Scale32, indexed by palette entry.
+
+static uint32_t scale_colors[256];
+
+#ifdef SCALE_AVX2
+
+// Shuffle masks: output element i of chunk k comes from source element
+// (k * chunk + i) / scale. Padded by a chunk so that two neighbouring
+// byte chunks can always be loaded as one 256 bit mask.
+
+static byte scale_shuffle8[MAX_INTEGER_SCALE + 1][MAX_INTEGER_SCALE + 1][16];
+static int32_t scale_permute32[MAX_INTEGER_SCALE + 1][MAX_INTEGER_SCALE][8];
+
+#endif
+
+static void ScaleRow8_C(byte *dest, const byte *src, int w, int scale)
+{
+    int x, i;
+    byte c;
+
+    for (x=0; x<w; ++x)
+    {
+        c = src[x];
+
+        for (i=0; i<scale; ++i)
+        {
+            *dest++ = c;
+        }
+    }
+}
+
+static void ScaleRow32_C(uint32_t *dest, const byte *src, int w, int scale)
+{
+    int x, i;
+    uint32_t c;
+
+    for (x=0; x<w; ++x)
+    {
+        c = scale_colors[src[x]];
+
+        for (i=0; i<scale; ++i)
+        {
+            *dest++ = c;
+        }
+    }
+}
+
+#ifdef SCALE_SSE2
+
+// SSE2 has no byte shuffle, so only 2x and 4x are done by unpacking;
+// 3x and 5x fall through to C.
+
+static void ScaleRow8_SSE2(byte *dest, const byte *src, int w, int scale)
+{
+    __m128i p, lo, hi;
+    int x = 0;
+
+    if (scale == 2)
+    {
+        for (; x + 16 <= w; x += 16)
+        {
+            p = _mm_loadu_si128((const __m128i *) (src + x));
+            _mm_storeu_si128((__m128i *) dest, _mm_unpacklo_epi8(p, p));
+            _mm_storeu_si128((__m128i *) (dest + 16), _mm_unpackhi_epi8(p, p));
+            dest += 32;
+        }
+    }
+    else if (scale == 4)
+    {
+        for (; x + 16 <= w; x += 16)
+        {
+            p = _mm_loadu_si128((const __m128i *) (src + x));
+            lo = _mm_unpacklo_epi8(p, p);
+            hi = _mm_unpackhi_epi8(p, p);
+            _mm_storeu_si128((__m128i *) dest, _mm_unpacklo_epi16(lo, lo));
+            _mm_storeu_si128((__m128i *) (dest + 16), _mm_unpackhi_epi16(lo, lo));
+            _mm_storeu_si128((__m128i *) (dest + 32), _mm_unpacklo_epi16(hi, hi));
+            _mm_storeu_si128((__m128i *) (dest + 48), _mm_unpackhi_epi16(hi, hi));
+            dest += 64;
+        }
+    }
+
+    ScaleRow8_C(dest, src + x, w - x, scale);
+}
+
+// No gather either: four colors are looked up and then spread out
+// with fixed shuffles.
+
+static void ScaleRow32_SSE2(uint32_t *dest, const byte *src, int w, int scale)
+{
+    __m128i c;
+    __m128i *d;
+    int x = 0;
+
+    for (; x + 4 <= w; x += 4)
+    {
+        c = _mm_set_epi32(scale_colors[src[x + 3]], scale_colors[src[x + 2]],
+                          scale_colors[src[x + 1]], scale_colors[src[x]]);
+        d = (__m128i *) dest;
+
+        switch (scale)
+        {
+            case 1:
+                _mm_storeu_si128(d, c);
+                break;
+
+            case 2:
+                _mm_storeu_si128(d, _mm_unpacklo_epi32(c, c));
+                _mm_storeu_si128(d + 1, _mm_unpackhi_epi32(c, c));
+                break;
+
+            case 3:
+                _mm_storeu_si128(d, _mm_shuffle_epi32(c, _MM_SHUFFLE(1, 0, 0, 0)));
+                _mm_storeu_si128(d + 1, _mm_shuffle_epi32(c, _MM_SHUFFLE(2, 2, 1, 1)));
+                _mm_storeu_si128(d + 2, _mm_shuffle_epi32(c, _MM_SHUFFLE(3, 3, 3, 2)));
+                break;
+
+            case 4:
+                _mm_storeu_si128(d, _mm_shuffle_epi32(c, _MM_SHUFFLE(0, 0, 0, 0)));
+                _mm_storeu_si128(d + 1, _mm_shuffle_epi32(c, _MM_SHUFFLE(1, 1, 1, 1)));
+                _mm_storeu_si128(d + 2, _mm_shuffle_epi32(c, _MM_SHUFFLE(2, 2, 2, 2)));
+                _mm_storeu_si128(d + 3, _mm_shuffle_epi32(c, _MM_SHUFFLE(3, 3, 3, 3)));
+                break;
+
+            case 5:
+                _mm_storeu_si128(d, _mm_shuffle_epi32(c, _MM_SHUFFLE(0, 0, 0, 0)));
+                _mm_storeu_si128(d + 1, _mm_shuffle_epi32(c, _MM_SHUFFLE(1, 1, 1, 0)));
+                _mm_storeu_si128(d + 2, _mm_shuffle_epi32(c, _MM_SHUFFLE(2, 2, 1, 1)));
+                _mm_storeu_si128(d + 3, _mm_shuffle_epi32(c, _MM_SHUFFLE(3, 2, 2, 2)));
+                _mm_storeu_si128(d + 4, _mm_shuffle_epi32(c, _MM_SHUFFLE(3, 3, 3, 3)));
+                break;
+        }
+
+        dest += 4 * scale;
+    }
+
+    ScaleRow32_C(dest, src + x, w - x, scale);
+}
+
+#endif
+
+#ifdef SCALE_AVX2
+
+// Any scale: 16 source pixels are broadcast to both lanes and each
+// pair of 16 byte output chunks is one byte shuffle.
+
+static SCALE_AVX2_FUNC void ScaleRow8_AVX2(byte *dest, const byte *src, int w, int scale)
+{
+    __m256i p, mask;
+    int x = 0;
+    int k;
+
+    for (; x + 16 <= w; x += 16)
+    {
+        p = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) (src + x)));
+
+        for (k=0; k<scale; k += 2)
+        {
+            mask = _mm256_loadu_si256((const __m256i *) scale_shuffle8[scale][k]);
+
+            if (k + 1 < scale)
+            {
+                _mm256_storeu_si256((__m256i *) dest, _mm256_shuffle_epi8(p, mask));
+                dest += 32;
+            }
+            else
+            {
+                _mm_storeu_si128((__m128i *) dest,
+                    _mm256_castsi256_si128(_mm256_shuffle_epi8(p, mask)));
+                dest += 16;
+            }
+        }
+    }
+
+    _mm256_zeroupper();
+
+    ScaleRow8_C(dest, src + x, w - x, scale);
+}
+
+// Eight colors are gathered at once and each 8 pixel output chunk is
+// one cross-lane permute.
+
+static SCALE_AVX2_FUNC void ScaleRow32_AVX2(uint32_t *dest, const byte *src, int w, int scale)
+{
+    __m256i idx, c, perm;
+    int x = 0;
+    int k;
+
+    for (; x + 8 <= w; x += 8)
+    {
+        idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (src + x)));
+        c = _mm256_i32gather_epi32((const int *) scale_colors, idx, 4);
+
+        for (k=0; k<scale; ++k)
+        {
+            perm = _mm256_loadu_si256((const __m256i *) scale_permute32[scale][k]);
+            _mm256_storeu_si256((__m256i *) dest, _mm256_permutevar8x32_epi32(c, perm));
+            dest += 8;
+        }
+    }
+
+    _mm256_zeroupper();
+
+    ScaleRow32_C(dest, src + x, w - x, scale);
+}
+
+#endif
+
+static void ScaleRow8(byte *dest, const byte *src, int w, int scale)
+{
+    switch (scale_kernel)
+    {
+#ifdef SCALE_AVX2
+        case SCALE_KERNEL_AVX2:
+            ScaleRow8_AVX2(dest, src, w, scale);
+            break;
+#endif
+#ifdef SCALE_SSE2
+        case SCALE_KERNEL_SSE2:
+            ScaleRow8_SSE2(dest, src, w, scale);
+            break;
+#endif
+        default:
+            ScaleRow8_C(dest, src, w, scale);
+            break;
+    }
+}
+
+static void ScaleRow32(uint32_t *dest, const byte *src, int w, int scale)
+{
+    switch (scale_kernel)
+    {
+#ifdef SCALE_AVX2
+        case SCALE_KERNEL_AVX2:
+            ScaleRow32_AVX2(dest, src, w, scale);
+            break;
+#endif
+#ifdef SCALE_SSE2
+        case SCALE_KERNEL_SSE2:
+            ScaleRow32_SSE2(dest, src, w, scale);
+            break;
+#endif
+        default:
+            ScaleRow32_C(dest, src, w, scale);
+            break;
+    }
+}
+
+// Pick the best kernel the CPU can run, unless told not to.
+
+static void I_InitScaleKernels(void)
+{
+    if (best_scale_kernel >= 0)
+    {
+        return;
+    }
+
+    best_scale_kernel = SCALE_KERNEL_C;
+
+#ifdef SCALE_AVX2
+    {
+        int scale, k, i;
+
+        for (scale=1; scale<=MAX_INTEGER_SCALE; ++scale)
+        {
+            for (k=0; k<=MAX_INTEGER_SCALE; ++k)
+            {
+                for (i=0; i<16; ++i)
+                {
+                    scale_shuffle8[scale][k][i] = MIN((k * 16 + i) / scale, 15);
+                }
+            }
+
+            for (k=0; k<MAX_INTEGER_SCALE; ++k)
+            {
+                for (i=0; i<8; ++i)
+                {
+                    scale_permute32[scale][k][i] = MIN((k * 8 + i) / scale, 7);
+                }
+            }
+        }
+    }
+#endif
+
+    //!
+    // @category video
+    //
+    // Don't use SSE2 or AVX2 to scale up the screen in software mode.
+    //
+
+    if (M_CheckParm("-noscalesimd") == 0)
+    {
+#ifdef SCALE_SSE2
+        if (SDL_HasSSE2())
+        {
+            best_scale_kernel = SCALE_KERNEL_SSE2;
+        }
+#endif
+#ifdef SCALE_AVX2
+        if (SDL_HasAVX2())
+        {
+            best_scale_kernel = SCALE_KERNEL_AVX2;
+        }
+#endif
+    }
+
+    scale_kernel = best_scale_kernel;
+}
+
 // Called to set the source and destination buffers before doing the
 // scale.
 
@@ -63,6 +424,8 @@ void I_InitScale(byte *_src_buffer, byte *_dest_buffer, int _dest_pitch)
     src_buffer = _src_buffer;
     dest_buffer = _dest_buffer;
     dest_pitch = _dest_pitch;
+
+    I_InitScaleKernels();
 }
 
 //
@@ -100,40 +463,40 @@ screen_mode_t mode_scale_1x = {
     false,
 };
 
-// 2x scale (640x400)
+// Integer scale: build each row once and copy it down scale - 1 times.
 
-static boolean I_Scale2x(int x1, int y1, int x2, int y2)
+static boolean I_ScaleMultiple(int x1, int y1, int x2, int y2, int scale)
 {
-    byte *bufp, *screenp, *screenp2;
-    int x, y;
-    int multi_pitch;
+    byte *bufp, *screenp;
+    int y, i;
+    int w = x2 - x1;
 
-    multi_pitch = dest_pitch * 2;
     bufp = src_buffer + y1 * SCREENWIDTH + x1;
-    screenp = (byte *) dest_buffer + (y1 * dest_pitch + x1) * 2;
-    screenp2 = screenp + dest_pitch;
+    screenp = (byte *) dest_buffer + (y1 * dest_pitch + x1) * scale;
 
     for (y=y1; y<y2; ++y)
     {
-        byte *sp, *sp2, *bp;
-        sp = screenp;
-        sp2 = screenp2;
-        bp = bufp;
+        ScaleRow8(screenp, bufp, w, scale);
 
-        for (x=x1; x<x2; ++x)
+        for (i=1; i<scale; ++i)
         {
-            *sp++ = *bp;  *sp++ = *bp;
-            *sp2++ = *bp; *sp2++ = *bp;
-            ++bp;
+            memcpy(screenp + i * dest_pitch, screenp, w * scale);
         }
-        screenp += multi_pitch;
-        screenp2 += multi_pitch;
+
+        screenp += dest_pitch * scale;
         bufp += SCREENWIDTH;
     }
 
     return true;
 }
 
+// 2x scale (640x400)
+
+static boolean I_Scale2x(int x1, int y1, int x2, int y2)
+{
+    return I_ScaleMultiple(x1, y1, x2, y2, 2);
+}
+
 screen_mode_t mode_scale_2x = {
     SCREENWIDTH * 2, SCREENHEIGHT * 2,
     NULL,
@@ -145,38 +508,7 @@ screen_mode_t mode_scale_2x = {
 
 static boolean I_Scale3x(int x1, int y1, int x2, int y2)
 {
-    byte *bufp, *screenp, *screenp2, *screenp3;
-    int x, y;
-    int multi_pitch;
-
-    multi_pitch = dest_pitch * 3;
-    bufp = src_buffer + y1 * SCREENWIDTH + x1;
-    screenp = (byte *) dest_buffer + (y1 * dest_pitch + x1) * 3;
-    screenp2 = screenp + dest_pitch;
-    screenp3 = screenp + dest_pitch * 2;
-
-    for (y=y1; y<y2; ++y)
-    {
-        byte *sp, *sp2, *sp3, *bp;
-        sp = screenp;
-        sp2 = screenp2;
-        sp3 = screenp3;
-        bp = bufp;
-
-        for (x=x1; x<x2; ++x)
-        {
-            *sp++ = *bp;  *sp++ = *bp;  *sp++ = *bp;
-            *sp2++ = *bp; *sp2++ = *bp; *sp2++ = *bp;
-            *sp3++ = *bp; *sp3++ = *bp; *sp3++ = *bp;
-            ++bp;
-        }
-        screenp += multi_pitch;
-        screenp2 += multi_pitch;
-        screenp3 += multi_pitch;
-        bufp += SCREENWIDTH;
-    }
-
-    return true;
+    return I_ScaleMultiple(x1, y1, x2, y2, 3);
 }
 
 screen_mode_t mode_scale_3x = {
@@ -190,42 +522,7 @@ screen_mode_t mode_scale_3x = {
 
 static boolean I_Scale4x(int x1, int y1, int x2, int y2)
 {
-    byte *bufp, *screenp, *screenp2, *screenp3, *screenp4;
-    int x, y;
-    int multi_pitch;
-
-    multi_pitch = dest_pitch * 4;
-    bufp = src_buffer + y1 * SCREENWIDTH + x1;
-    screenp = (byte *) dest_buffer + (y1 * dest_pitch + x1) * 4;
-    screenp2 = screenp + dest_pitch;
-    screenp3 = screenp + dest_pitch * 2;
-    screenp4 = screenp + dest_pitch * 3;
-
-    for (y=y1; y<y2; ++y)
-    {
-        byte *sp, *sp2, *sp3, *sp4, *bp;
-        sp = screenp;
-        sp2 = screenp2;
-        sp3 = screenp3;
-        sp4 = screenp4;
-        bp = bufp;
-
-        for (x=x1; x<x2; ++x)
-        {
-            *sp++ = *bp;  *sp++ = *bp;  *sp++ = *bp;  *sp++ = *bp;
-            *sp2++ = *bp; *sp2++ = *bp; *sp2++ = *bp; *sp2++ = *bp;
-            *sp3++ = *bp; *sp3++ = *bp; *sp3++ = *bp; *sp3++ = *bp;
-            *sp4++ = *bp; *sp4++ = *bp; *sp4++ = *bp; *sp4++ = *bp;
-            ++bp;
-        }
-        screenp += multi_pitch;
-        screenp2 += multi_pitch;
-        screenp3 += multi_pitch;
-        screenp4 += multi_pitch;
-        bufp += SCREENWIDTH;
-    }
-
-    return true;
+    return I_ScaleMultiple(x1, y1, x2, y2, 4);
 }
 
 screen_mode_t mode_scale_4x = {
@@ -239,46 +536,7 @@ screen_mode_t mode_scale_4x = {
 
 static boolean I_Scale5x(int x1, int y1, int x2, int y2)
 {
-    byte *bufp, *screenp, *screenp2, *screenp3, *screenp4, *screenp5;
-    int x, y;
-    int multi_pitch;
-
-    multi_pitch = dest_pitch * 5;
-    bufp = src_buffer + y1 * SCREENWIDTH + x1;
-    screenp = (byte *) dest_buffer + (y1 * dest_pitch + x1) * 5;
-    screenp2 = screenp + dest_pitch;
-    screenp3 = screenp + dest_pitch * 2;
-    screenp4 = screenp + dest_pitch * 3;
-    screenp5 = screenp + dest_pitch * 4;
-
-    for (y=y1; y<y2; ++y)
-    {
-        byte *sp, *sp2, *sp3, *sp4, *sp5, *bp;
-        sp = screenp;
-        sp2 = screenp2;
-        sp3 = screenp3;
-        sp4 = screenp4;
-        sp5 = screenp5;
-        bp = bufp;
-
-        for (x=x1; x<x2; ++x)
-        {
-            *sp++ = *bp;  *sp++ = *bp;  *sp++ = *bp;  *sp++ = *bp;  *sp++ = *bp;
-            *sp2++ = *bp; *sp2++ = *bp; *sp2++ = *bp; *sp2++ = *bp; *sp2++ = *bp;
-            *sp3++ = *bp; *sp3++ = *bp; *sp3++ = *bp; *sp3++ = *bp; *sp3++ = *bp;
-            *sp4++ = *bp; *sp4++ = *bp; *sp4++ = *bp; *sp4++ = *bp; *sp4++ = *bp;
-            *sp5++ = *bp; *sp5++ = *bp; *sp5++ = *bp; *sp5++ = *bp; *sp5++ = *bp;
-            ++bp;
-        }
-        screenp += multi_pitch;
-        screenp2 += multi_pitch;
-        screenp3 += multi_pitch;
-        screenp4 += multi_pitch;
-        screenp5 += multi_pitch;
-        bufp += SCREENWIDTH;
-    }
-
-    return true;
+    return I_ScaleMultiple(x1, y1, x2, y2, 5);
 }
 
 screen_mode_t mode_scale_5x = {
@@ -506,15 +764,7 @@ screen_mode_t mode_stretch_1x = {
 
 static inline void WriteLine2x(byte *dest, byte *src)
 {
-    int x;
-
-    for (x=0; x<SCREENWIDTH; ++x)
-    {
-        dest[0] = *src;
-        dest[1] = *src;
-        dest += 2;
-        ++src;
-    }
+    ScaleRow8(dest, src, SCREENWIDTH, 2);
 }
 
 static inline void WriteBlendedLine2x(byte *dest, byte *src1, byte *src2, 
@@ -619,16 +869,7 @@ screen_mode_t mode_stretch_2x = {
 
 static inline void WriteLine3x(byte *dest, byte *src)
 {
-    int x;
-
-    for (x=0; x<SCREENWIDTH; ++x)
-    {
-        dest[0] = *src;
-        dest[1] = *src;
-        dest[2] = *src;
-        dest += 3;
-        ++src;
-    }
+    ScaleRow8(dest, src, SCREENWIDTH, 3);
 }
 
 static inline void WriteBlendedLine3x(byte *dest, byte *src1, byte *src2, 
@@ -758,17 +999,7 @@ screen_mode_t mode_stretch_3x = {
 
 static inline void WriteLine4x(byte *dest, byte *src)
 {
-    int x;
-
-    for (x=0; x<SCREENWIDTH; ++x)
-    {
-        dest[0] = *src;
-        dest[1] = *src;
-        dest[2] = *src;
-        dest[3] = *src;
-        dest += 4;
-        ++src;
-    }
+    ScaleRow8(dest, src, SCREENWIDTH, 4);
 }
 
 static inline void WriteBlendedLine4x(byte *dest, byte *src1, byte *src2, 
@@ -923,18 +1154,7 @@ screen_mode_t mode_stretch_4x = {
 
 static inline void WriteLine5x(byte *dest, byte *src)
 {
-    int x;
-
-    for (x=0; x<SCREENWIDTH; ++x)
-    {
-        dest[0] = *src;
-        dest[1] = *src;
-        dest[2] = *src;
-        dest[3] = *src;
-        dest[4] = *src;
-        dest += 5;
-        ++src;
-    }
+    ScaleRow8(dest, src, SCREENWIDTH, 5);
 }
 
 // 5x stretch (1600x1200)
@@ -1450,3 +1670,239 @@ screen_mode_t mode_squash_5x = {
 };
 
 
+
+//
+// [SVE] 8 to 32 bit scale-up.
+//
+// Scales the source buffer given to I_InitScale by a whole number,
+// looking each pixel up in the colors from I_SetScalePalette32 as it
+// goes. The destination is 32 bit, eg. the GL scaler's input texture,
+// and its pitch is in bytes.
+//
+
+void I_SetScalePalette32(const uint32_t *colors)
+{
+    memcpy(scale_colors, colors, sizeof(scale_colors));
+}
+
+boolean I_Scale32(int x1, int y1, int x2, int y2, int scale,
+                  uint32_t *dest, int pitch)
+{
+    byte *bufp, *screenp;
+    int y, i;
+    int w = x2 - x1;
+
+    if (scale < 1 || scale > MAX_INTEGER_SCALE)
+    {
+        return false;
+    }
+
+    I_InitScaleKernels();
+
+    bufp = src_buffer + y1 * SCREENWIDTH + x1;
+    screenp = (byte *) dest + y1 * scale * pitch + x1 * scale * 4;
+
+    for (y=y1; y<y2; ++y)
+    {
+        ScaleRow32((uint32_t *) screenp, bufp, w, scale);
+
+        for (i=1; i<scale; ++i)
+        {
+            memcpy(screenp + i * pitch, screenp, w * scale * 4);
+        }
+
+        screenp += pitch * scale;
+        bufp += SCREENWIDTH;
+    }
+
+    return true;
+}
+
+// The same lookup for a buffer of any size, eg. a software view drawn
+// bigger than the screen; src is tightly packed.
+
+void I_Convert32(const byte *src, int width, int height,
+                 uint32_t *dest, int pitch)
+{
+    byte *screenp = (byte *) dest;
+    int y;
+
+    I_InitScaleKernels();
+
+    for (y=0; y<height; ++y)
+    {
+        ScaleRow32((uint32_t *) screenp, src, width, 1);
+
+        screenp += pitch;
+        src += width;
+    }
+}
+
+//
+// [SVE] Benchmark.
+//
+// Times every scaler with each kernel the CPU can run, and checks
+// that the SIMD kernels give the same picture as the C ones.
+//
+
+#define SCALEBENCH_FRAMES 100
+
+typedef struct
+{
+    const char *name;
+    screen_mode_t *mode;
+} scalebench_t;
+
+static scalebench_t scalebench_modes[] =
+{
+    { "scale 1x",   &mode_scale_1x },
+    { "scale 2x",   &mode_scale_2x },
+    { "scale 3x",   &mode_scale_3x },
+    { "scale 4x",   &mode_scale_4x },
+    { "scale 5x",   &mode_scale_5x },
+    { "stretch 1x", &mode_stretch_1x },
+    { "stretch 2x", &mode_stretch_2x },
+    { "stretch 3x", &mode_stretch_3x },
+    { "stretch 4x", &mode_stretch_4x },
+    { "stretch 5x", &mode_stretch_5x },
+    { "squash 1x",  &mode_squash_1x },
+    { "squash 2x",  &mode_squash_2x },
+    { "squash 3x",  &mode_squash_3x },
+    { "squash 4x",  &mode_squash_4x },
+    { "squash 5x",  &mode_squash_5x },
+};
+
+static void PrintBenchResult(const char *name, int w, int h,
+                             uint64_t *times, boolean mismatch)
+{
+    int k;
+
+    printf("  %-10s %4ix%-4i", name, w, h);
+
+    for (k=0; k<=best_scale_kernel; ++k)
+    {
+        printf("  %s %8.1f us", scale_kernel_names[k],
+               (double) times[k] / SCALEBENCH_FRAMES);
+    }
+
+    printf("%s\n", mismatch ? "  MISMATCH" : "");
+}
+
+void I_ScaleBenchmark(byte *palette)
+{
+    byte *saved_src_buffer = src_buffer;
+    byte *saved_dest_buffer = dest_buffer;
+    int saved_dest_pitch = dest_pitch;
+    uint32_t saved_colors[256];
+    uint64_t times[NUM_SCALE_KERNELS];
+    uint64_t start;
+    unsigned int seed = 1;
+    byte *src, *dest, *reference;
+    boolean mismatch;
+    size_t size;
+    int i, k, f;
+
+    I_InitScaleKernels();
+
+    // Biggest output is 5x at 32 bits, or 5x stretched at 8.
+
+    size = SCREENWIDTH * 5 * SCREENHEIGHT_4_3 * 5 * 4;
+    src = Z_Malloc(SCREENWIDTH * SCREENHEIGHT, PU_STATIC, NULL);
+    dest = Z_Malloc(size, PU_STATIC, NULL);
+    reference = Z_Malloc(size, PU_STATIC, NULL);
+
+    for (i=0; i<SCREENWIDTH * SCREENHEIGHT; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        src[i] = (seed >> 16) & 0xff;
+    }
+
+    memcpy(saved_colors, scale_colors, sizeof(scale_colors));
+
+    for (i=0; i<256; ++i)
+    {
+        scale_colors[i] = 0xff000000 | (palette[i * 3] << 16)
+                        | (palette[i * 3 + 1] << 8) | palette[i * 3 + 2];
+    }
+
+    printf("I_ScaleBenchmark: %i frames each, using %s\n",
+           SCALEBENCH_FRAMES, scale_kernel_names[best_scale_kernel]);
+
+    for (i=0; i<(int) arrlen(scalebench_modes); ++i)
+    {
+        screen_mode_t *mode = scalebench_modes[i].mode;
+
+        if (mode->InitMode != NULL)
+        {
+            mode->InitMode(palette);
+        }
+
+        mismatch = false;
+
+        for (k=0; k<=best_scale_kernel; ++k)
+        {
+            scale_kernel = k;
+            I_InitScale(src, k == SCALE_KERNEL_C ? reference : dest, mode->width);
+
+            start = I_GetTimeUS();
+
+            for (f=0; f<SCALEBENCH_FRAMES; ++f)
+            {
+                mode->DrawScreen(0, 0, SCREENWIDTH, SCREENHEIGHT);
+            }
+
+            times[k] = I_GetTimeUS() - start;
+
+            if (k != SCALE_KERNEL_C
+             && memcmp(dest, reference, mode->width * mode->height) != 0)
+            {
+                mismatch = true;
+            }
+        }
+
+        PrintBenchResult(scalebench_modes[i].name,
+                         mode->width, mode->height, times, mismatch);
+    }
+
+    for (i=1; i<=MAX_INTEGER_SCALE; ++i)
+    {
+        char name[16];
+
+        mismatch = false;
+
+        for (k=0; k<=best_scale_kernel; ++k)
+        {
+            uint32_t *buf = (uint32_t *) (k == SCALE_KERNEL_C ? reference : dest);
+
+            scale_kernel = k;
+            src_buffer = src;
+
+            start = I_GetTimeUS();
+
+            for (f=0; f<SCALEBENCH_FRAMES; ++f)
+            {
+                I_Scale32(0, 0, SCREENWIDTH, SCREENHEIGHT, i,
+                          buf, SCREENWIDTH * i * 4);
+            }
+
+            times[k] = I_GetTimeUS() - start;
+
+            if (k != SCALE_KERNEL_C
+             && memcmp(dest, reference, SCREENWIDTH * SCREENHEIGHT * i * i * 4) != 0)
+            {
+                mismatch = true;
+            }
+        }
+
+        M_snprintf(name, sizeof(name), "32bit %ix", i);
+        PrintBenchResult(name, SCREENWIDTH * i, SCREENHEIGHT * i, times, mismatch);
+    }
+
+    memcpy(scale_colors, saved_colors, sizeof(scale_colors));
+    scale_kernel = best_scale_kernel;
+    I_InitScale(saved_src_buffer, saved_dest_buffer, saved_dest_pitch);
+
+    Z_Free(reference);
+    Z_Free(dest);
+    Z_Free(src);
+}
@@ -25,6 +25,16 @@
 void I_InitScale(byte *_src_buffer, byte *_dest_buffer, int _dest_pitch);
 void I_ResetScaleTables(byte *palette);
 
+// [SVE] 8 to 32 bit scale-up straight into a 32 bit destination
+
+void I_SetScalePalette32(const uint32_t *colors);
+boolean I_Scale32(int x1, int y1, int x2, int y2, int scale,
+                  uint32_t *dest, int pitch);
+void I_Convert32(const byte *src, int width, int height,
+                 uint32_t *dest, int pitch);
+
+void I_ScaleBenchmark(byte *palette);
+
 // Scaled modes (direct multiples of 320x200)
 
 extern screen_mode_t mode_scale_1x;
@@ -0,0 +1,198 @@
+//
+// Copyright(C) 2014 Night Dive Studios, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Worker thread pool.
+//
+//      Jobs are handed out through an atomic counter, so the only thing
+//      callers can rely on is that every job ran once before I_RunJobs
+//      returns. Anything that has to come out in a fixed order must be
+//      written per job and put together afterwards by the caller.
+//
+
+#include "SDL.h"
+
+#include "i_system.h"
+#include "i_thread.h"
+
+static SDL_Thread   *workers[MAX_WORKER_THREADS];
+static int          numworkers = 0;
+
+static SDL_sem      *startsem;
+static SDL_sem      *donesem;
+static SDL_atomic_t nextjob;
+
+static jobfunc_t    jobfunc;
+static void         *jobdata;
+static int          numjobs;
+static boolean      quitworkers;
+
+//
+// I_DoJobs
+//
+// Keep grabbing jobs until there are none left
+//
+
+static void I_DoJobs(void)
+{
+    int job;
+
+    while((job = SDL_AtomicAdd(&nextjob, 1)) < numjobs)
+    {
+        jobfunc(job, jobdata);
+    }
+}
+
+//
+// I_WorkerThread
+//
+
+static int I_WorkerThread(void *unused)
+{
+    while(1)
+    {
+        SDL_SemWait(startsem);
+
+        if(quitworkers)
+        {
+            break;
+        }
+
+        I_DoJobs();
+        SDL_SemPost(donesem);
+    }
+
+    return 0;
+}
+
+//
+// I_ShutdownWorkerThreads
+//
+
+static void I_ShutdownWorkerThreads(void)
+{
+    int i;
+
+    quitworkers = true;
+
+    for(i = 0; i < numworkers; i++)
+    {
+        SDL_SemPost(startsem);
+    }
+
+    for(i = 0; i < numworkers; i++)
+    {
+        SDL_WaitThread(workers[i], NULL);
+    }
+
+    numworkers = 0;
+}
+
+//
+// I_StartWorkerThreads
+//
+
+int I_StartWorkerThreads(int count)
+{
+    int cpus = SDL_GetCPUCount();
+
+    // leave one core to the thread calling I_RunJobs
+    if(count > cpus - 1)
+    {
+        count = cpus - 1;
+    }
+
+    if(count > MAX_WORKER_THREADS)
+    {
+        count = MAX_WORKER_THREADS;
+    }
+
+    if(count <= numworkers)
+    {
+        return numworkers;
+    }
+
+    if(!startsem)
+    {
+        startsem = SDL_CreateSemaphore(0);
+        donesem = SDL_CreateSemaphore(0);
+
+        if(!startsem || !donesem)
+        {
+            I_Error("I_StartWorkerThreads: %s", SDL_GetError());
+        }
+
+        I_AtExit(I_ShutdownWorkerThreads, true);
+    }
+
+    while(numworkers < count)
+    {
+        workers[numworkers] = SDL_CreateThread(I_WorkerThread, "I_WorkerThread", NULL);
+
+        if(!workers[numworkers])
+        {
+            fprintf(stderr, "I_StartWorkerThreads: %s\n", SDL_GetError());
+            break;
+        }
+
+        numworkers++;
+    }
+
+    return numworkers;
+}
+
+//
+// I_GetNumWorkerThreads
+//
+
+int I_GetNumWorkerThreads(void)
+{
+    return numworkers;
+}
+
+//
+// I_RunJobs
+//
+
+void I_RunJobs(jobfunc_t func, void *data, int count)
+{
+    int i;
+
+    if(numworkers == 0 || count <= 1)
+    {
+        for(i = 0; i < count; i++)
+        {
+            func(i, data);
+        }
+
+        return;
+    }
+
+    jobfunc = func;
+    jobdata = data;
+    numjobs = count;
+    SDL_AtomicSet(&nextjob, 0);
+
+    for(i = 0; i < numworkers; i++)
+    {
+        SDL_SemPost(startsem);
+    }
+
+    // help out while waiting
+    I_DoJobs();
+
+    for(i = 0; i < numworkers; i++)
+    {
+        SDL_SemWait(donesem);
+    }
+}
@@ -0,0 +1,37 @@
+//
+// Copyright(C) 2014 Night Dive Studios, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Worker thread pool
+//
+
+#ifndef __I_THREAD__
+#define __I_THREAD__
+
+#include "doomtype.h"
+
+#define MAX_WORKER_THREADS  16
+
+typedef void (*jobfunc_t)(int job, void *data);
+
+// Make sure at least this many worker threads are running; returns
+// how many there actually are (never more than the machine has cores)
+int I_StartWorkerThreads(int count);
+
+int I_GetNumWorkerThreads(void);
+
+// Runs func for every job number in [0, numjobs) spread across the
+// worker threads and the calling thread. Returns once all are done.
+void I_RunJobs(jobfunc_t func, void *data, int numjobs);
+
+#endif
@@ -21,6 +21,7 @@
 #ifndef __I_TIMER__
 #define __I_TIMER__
 
+#include "doomtype.h"
 #include "m_fixed.h"
 
 #define TICRATE 35
@@ -32,6 +33,14 @@ int I_GetTime (void);
 // returns current time in ms
 int I_GetTimeMS (void);
 
+// returns a high resolution time stamp in microseconds
+uint64_t I_GetTimeUS(void);
+
+// [SVE] raw high resolution counter and its ticks per second, for
+// timing intervals too short to be counted in microseconds
+uint64_t I_GetPerfCounter(void);
+uint64_t I_GetPerfFrequency(void);
+
 // Pause for a specified number of ms
 void I_Sleep(int ms);
 
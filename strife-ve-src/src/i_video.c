@@ -1161,6 +1161,102 @@ void I_EndRead(void)
                SCREENWIDTH, SCREENHEIGHT);
 }
 
+// [SVE] A software view drawn bigger than the screen (see I_SetViewLayer)
+// and what its 320x200 copy looked like when it was handed over.
+
+static byte *viewlayer = NULL;
+static int viewlayer_w, viewlayer_h;
+static int viewlayer_x1, viewlayer_y1, viewlayer_x2, viewlayer_y2;
+static byte viewlayer_copy[SCREENWIDTH * SCREENHEIGHT];
+
+// The full size frame put together from the view and I_VideoBuffer.
+static byte *composed = NULL;
+static int composed_w, composed_h;
+
+void I_SetViewLayer(byte *buffer, int width, int height,
+                    int x, int y, int w, int h)
+{
+    viewlayer = buffer;
+
+    if (buffer == NULL)
+    {
+        return;
+    }
+
+    viewlayer_w = width;
+    viewlayer_h = height;
+
+    // the same rounding R_InitBuffer uses to place the view
+    viewlayer_x1 = (x * width + SCREENWIDTH - 1) / SCREENWIDTH;
+    viewlayer_y1 = (y * height + SCREENHEIGHT - 1) / SCREENHEIGHT;
+    viewlayer_x2 = ((x + w) * width + SCREENWIDTH - 1) / SCREENWIDTH;
+    viewlayer_y2 = ((y + h) * height + SCREENHEIGHT - 1) / SCREENHEIGHT;
+
+    memcpy(viewlayer_copy, I_VideoBuffer, SCREENWIDTH * SCREENHEIGHT);
+}
+
+// Blow I_VideoBuffer up to the size of the view layer, taking the view's
+// own pixels wherever its 320x200 copy is still showing. Anything drawn
+// since (the status bar, messages, menus) stays as blocky as it always was.
+
+static byte *ComposeViewLayer(void)
+{
+    static int xmap[MAXRENDERWIDTH];
+    byte *src, *copy, *layer, *dest;
+    int x, y, lx;
+
+    if (composed == NULL
+     || composed_w != viewlayer_w || composed_h != viewlayer_h)
+    {
+        if (composed != NULL)
+        {
+            Z_Free(composed);
+        }
+
+        composed_w = viewlayer_w;
+        composed_h = viewlayer_h;
+        composed = Z_Malloc(composed_w * composed_h, PU_STATIC, NULL);
+    }
+
+    for (x = 0; x < composed_w; ++x)
+    {
+        xmap[x] = (x * SCREENWIDTH) / composed_w;
+    }
+
+    for (y = 0; y < composed_h; ++y)
+    {
+        src = I_VideoBuffer + ((y * SCREENHEIGHT) / composed_h) * SCREENWIDTH;
+        copy = viewlayer_copy + (src - I_VideoBuffer);
+        layer = viewlayer + y * composed_w;
+        dest = composed + y * composed_w;
+
+        if (y < viewlayer_y1 || y >= viewlayer_y2)
+        {
+            for (x = 0; x < composed_w; ++x)
+            {
+                dest[x] = src[xmap[x]];
+            }
+            continue;
+        }
+
+        for (x = 0; x < composed_w; ++x)
+        {
+            lx = xmap[x];
+
+            if (x >= viewlayer_x1 && x < viewlayer_x2 && src[lx] == copy[lx])
+            {
+                dest[x] = layer[x];
+            }
+            else
+            {
+                dest[x] = src[lx];
+            }
+        }
+    }
+
+    return composed;
+}
+
 // [SVE] svillarreal - from gl scale branch
 // Ending of I_FinishUpdate() when in software scaling mode.
 
@@ -1275,7 +1371,15 @@ void I_FinishUpdate (void)
 
         if(!use3drenderer)
         {
-            I_GL_UpdateScreen(I_VideoBuffer, palette);
+            if(viewlayer != NULL)
+            {
+                I_GL_UpdateNativeScreen(ComposeViewLayer(),
+                                        composed_w, composed_h, palette);
+            }
+            else
+            {
+                I_GL_UpdateScreen(I_VideoBuffer, palette);
+            }
         }
         else
         {
@@ -1300,6 +1404,9 @@ void I_FinishUpdate (void)
     {
         FinishUpdateSoftware();
     }
+
+    // [SVE] the view is drawn again for every frame that shows it
+    viewlayer = NULL;
 }
 
 
@@ -2331,6 +2438,17 @@ void I_InitGraphics(void)
     doompal = W_CacheLumpName(DEH_String("PLAYPAL"), PU_CACHE);
     I_SetPalette(doompal);
 
+    //!
+    // @category video
+    //
+    // Time each of the software scalers and print the results.
+    //
+
+    if (M_CheckParm("-scalebench"))
+    {
+        I_ScaleBenchmark(doompal);
+    }
+
     if (!using_opengl)
     {
         SDL_SetPaletteColors(screenbuffer->format->palette, palette, 0, 256);
@@ -36,6 +36,12 @@
 
 #define SCREENHEIGHT_4_3 240
 
+// [SVE] Largest size the software renderer can draw the 3D view at,
+// counted for the whole screen (see render_width in r_draw.c).
+
+#define MAXRENDERWIDTH  2560
+#define MAXRENDERHEIGHT 1600
+
 #define MAX_MOUSE_BUTTONS 8
 
 typedef struct
@@ -110,6 +116,13 @@ void I_GetPaletteColor(byte *rgb, int index);
 void I_UpdateNoBlit (void);
 void I_FinishUpdate (void);
 
+// [SVE] Hands over the 3D view drawn at width x height, covering the
+// whole screen at that size, after a 320x200 copy of the w x h window
+// at x, y has been put in I_VideoBuffer. The next I_FinishUpdate shows
+// it wherever nothing has been drawn over the copy since. NULL drops it.
+void I_SetViewLayer(byte *buffer, int width, int height,
+                    int x, int y, int w, int h);
+
 void I_ReadScreen (byte* scr);
 
 void I_BeginRead (void);
@@ -799,6 +799,34 @@ static default_t extra_defaults_list[] =
 
     CONFIG_VARIABLE_INT(d_fpslimit),
 
+    //!
+    // @game strife [SVE]
+    //
+    // Number of worker threads the software renderer draws walls and
+    // flats with. If zero, they are drawn on the main thread.
+    //
+
+    CONFIG_VARIABLE_INT(render_threads),
+
+    //!
+    // @game strife [SVE]
+    //
+    // Size to draw the 3D view at with the software renderer, counted
+    // for the whole screen as if it were this big, eg. 1440x1080 to
+    // fill the 4:3 part of a 1080p display. If either is zero, the view
+    // is drawn at 320x200 like the rest of the screen.
+    //
+
+    CONFIG_VARIABLE_INT(render_width),
+
+    //!
+    // @game strife [SVE]
+    //
+    // See render_width.
+    //
+
+    CONFIG_VARIABLE_INT(render_height),
+
     //!
     // @game strife [SVE]
     //
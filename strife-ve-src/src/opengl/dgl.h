@@ -6362,6 +6362,295 @@ has_GL_EXT_texture_array = GL_CheckExtension("GL_EXT_texture_array");
 #define GL_EXT_texture_array_Init() has_GL_EXT_texture_array = true;
 #endif // __IPHONEOS__
 
+//
+// GL_ARB_timer_query
+//
+extern boolean has_GL_ARB_timer_query;
+
+// [AM] Now available in SDL2.
+// #if !defined(__IPHONEOS__) && !defined(SVE_PLAT_SWITCH)
+// typedef void (APIENTRYP PFNGLQUERYCOUNTERPROC) (GLuint id, GLenum target);
+// typedef void (APIENTRYP PFNGLGETQUERYOBJECTUI64VPROC) (GLuint id, GLenum pname, GLuint64* params);
+// #endif // __IPHONEOS__
+
+#ifndef __IPHONEOS__
+extern PFNGLQUERYCOUNTERPROC _glQueryCounter;
+extern PFNGLGETQUERYOBJECTUI64VPROC _glGetQueryObjectui64v;
+#endif // __IPHONEOS__
+
+#ifndef __IPHONEOS__
+#define GL_ARB_timer_query_Define() \
+boolean has_GL_ARB_timer_query = false; \
+PFNGLQUERYCOUNTERPROC _glQueryCounter = NULL; \
+PFNGLGETQUERYOBJECTUI64VPROC _glGetQueryObjectui64v = NULL
+#else
+#define GL_ARB_timer_query_Define() boolean has_GL_ARB_timer_query = false;
+#endif // __IPHONEOS__
+
+#ifndef __IPHONEOS__
+#define GL_ARB_timer_query_Init() \
+has_GL_ARB_timer_query = GL_CheckExtension("GL_ARB_timer_query"); \
+_glQueryCounter = (PFNGLQUERYCOUNTERPROC)GL_RegisterProc("glQueryCounter"); \
+_glGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VPROC)GL_RegisterProc("glGetQueryObjectui64v")
+#else
+#define GL_ARB_timer_query_Init() has_GL_ARB_timer_query = false;
+#endif // __IPHONEOS__
+
+#ifndef USE_DEBUG_GLFUNCS
+
+#define dglQueryCounter(id, target) _glQueryCounter(id, target)
+#define dglGetQueryObjectui64v(id, pname, params) _glGetQueryObjectui64v(id, pname, params)
+
+#else
+
+static __inline void glQueryCounter_DEBUG (GLuint id, GLenum target, const char* file, int line)
+{
+#ifdef LOG_GLFUNC_CALLS
+    fprintf(stderr, "file = %s, line = %i, glQueryCounter(id=%i, target=0x%x)\n", file, line, id, target);
+#endif
+    _glQueryCounter(id, target);
+    GL_LogError("glQueryCounter", file, line);
+}
+
+static __inline void glGetQueryObjectui64v_DEBUG (GLuint id, GLenum pname, GLuint64* params, const char* file, int line)
+{
+#ifdef LOG_GLFUNC_CALLS
+    fprintf(stderr, "file = %s, line = %i, glGetQueryObjectui64v(id=%i, pname=0x%x, params=%p)\n", file, line, id, pname, params);
+#endif
+    _glGetQueryObjectui64v(id, pname, params);
+    GL_LogError("glGetQueryObjectui64v", file, line);
+}
+
+
+#define dglQueryCounter(id, target) glQueryCounter_DEBUG(id, target, __FILE__, __LINE__)
+#define dglGetQueryObjectui64v(id, pname, params) glGetQueryObjectui64v_DEBUG(id, pname, params, __FILE__, __LINE__)
+
+#endif // USE_DEBUG_GLFUNCS
+
+//
+// GL_ARB_vertex_shader
+//
+extern boolean has_GL_ARB_vertex_shader;
+
+#ifndef __IPHONEOS__
+extern PFNGLVERTEXATTRIBPOINTERARBPROC _glVertexAttribPointerARB;
+extern PFNGLENABLEVERTEXATTRIBARRAYARBPROC _glEnableVertexAttribArrayARB;
+extern PFNGLDISABLEVERTEXATTRIBARRAYARBPROC _glDisableVertexAttribArrayARB;
+extern PFNGLGETATTRIBLOCATIONARBPROC _glGetAttribLocationARB;
+#endif // __IPHONEOS__
+
+#ifndef __IPHONEOS__
+#define GL_ARB_vertex_shader_Define() \
+boolean has_GL_ARB_vertex_shader = false; \
+PFNGLVERTEXATTRIBPOINTERARBPROC _glVertexAttribPointerARB = NULL; \
+PFNGLENABLEVERTEXATTRIBARRAYARBPROC _glEnableVertexAttribArrayARB = NULL; \
+PFNGLDISABLEVERTEXATTRIBARRAYARBPROC _glDisableVertexAttribArrayARB = NULL; \
+PFNGLGETATTRIBLOCATIONARBPROC _glGetAttribLocationARB = NULL
+#else
+#define GL_ARB_vertex_shader_Define() boolean has_GL_ARB_vertex_shader = false;
+#endif // __IPHONEOS__
+
+#ifndef __IPHONEOS__
+#define GL_ARB_vertex_shader_Init() \
+has_GL_ARB_vertex_shader = GL_CheckExtension("GL_ARB_vertex_shader"); \
+_glVertexAttribPointerARB = (PFNGLVERTEXATTRIBPOINTERARBPROC)GL_RegisterProc("glVertexAttribPointerARB"); \
+_glEnableVertexAttribArrayARB = (PFNGLENABLEVERTEXATTRIBARRAYARBPROC)GL_RegisterProc("glEnableVertexAttribArrayARB"); \
+_glDisableVertexAttribArrayARB = (PFNGLDISABLEVERTEXATTRIBARRAYARBPROC)GL_RegisterProc("glDisableVertexAttribArrayARB"); \
+_glGetAttribLocationARB = (PFNGLGETATTRIBLOCATIONARBPROC)GL_RegisterProc("glGetAttribLocationARB")
+#else
+#define GL_ARB_vertex_shader_Init() has_GL_ARB_vertex_shader = false;
+#endif // __IPHONEOS__
+
+#ifndef USE_DEBUG_GLFUNCS
+
+#define dglVertexAttribPointerARB(index, size, type, normalized, stride, pointer) _glVertexAttribPointerARB(index, size, type, normalized, stride, pointer)
+#define dglEnableVertexAttribArrayARB(index) _glEnableVertexAttribArrayARB(index)
+#define dglDisableVertexAttribArrayARB(index) _glDisableVertexAttribArrayARB(index)
+#define dglGetAttribLocationARB(programObj, name) _glGetAttribLocationARB(programObj, name)
+
+#else
+
+static __inline void glVertexAttribPointerARB_DEBUG (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid* pointer, const char* file, int line)
+{
+#ifdef LOG_GLFUNC_CALLS
+    fprintf(stderr, "file = %s, line = %i, glVertexAttribPointerARB(index=%i, size=%i, type=0x%x, normalized=%i, stride=0x%x, pointer=%p)\n", file, line, index, size, type, normalized, stride, pointer);
+#endif
+    _glVertexAttribPointerARB(index, size, type, normalized, stride, pointer);
+    GL_LogError("glVertexAttribPointerARB", file, line);
+}
+
+static __inline void glEnableVertexAttribArrayARB_DEBUG (GLuint index, const char* file, int line)
+{
+#ifdef LOG_GLFUNC_CALLS
+    fprintf(stderr, "file = %s, line = %i, glEnableVertexAttribArrayARB(index=%i)\n", file, line, index);
+#endif
+    _glEnableVertexAttribArrayARB(index);
+    GL_LogError("glEnableVertexAttribArrayARB", file, line);
+}
+
+static __inline void glDisableVertexAttribArrayARB_DEBUG (GLuint index, const char* file, int line)
+{
+#ifdef LOG_GLFUNC_CALLS
+    fprintf(stderr, "file = %s, line = %i, glDisableVertexAttribArrayARB(index=%i)\n", file, line, index);
+#endif
+    _glDisableVertexAttribArrayARB(index);
+    GL_LogError("glDisableVertexAttribArrayARB", file, line);
+}
+
+static __inline GLint glGetAttribLocationARB_DEBUG (GLhandleARB programObj, const GLcharARB* name, const char* file, int line)
+{
+    GLint result;
+#ifdef LOG_GLFUNC_CALLS
+    fprintf(stderr, "file = %s, line = %i, glGetAttribLocationARB(programObj=%i, name=%p)\n", file, line, programObj, name);
+#endif
+    result = _glGetAttribLocationARB(programObj, name);
+    GL_LogError("glGetAttribLocationARB", file, line);
+    return result;
+}
+
+
+#define dglVertexAttribPointerARB(index, size, type, normalized, stride, pointer) glVertexAttribPointerARB_DEBUG(index, size, type, normalized, stride, pointer, __FILE__, __LINE__)
+#define dglEnableVertexAttribArrayARB(index) glEnableVertexAttribArrayARB_DEBUG(index, __FILE__, __LINE__)
+#define dglDisableVertexAttribArrayARB(index) glDisableVertexAttribArrayARB_DEBUG(index, __FILE__, __LINE__)
+#define dglGetAttribLocationARB(programObj, name) glGetAttribLocationARB_DEBUG(programObj, name, __FILE__, __LINE__)
+
+#endif // USE_DEBUG_GLFUNCS
+
+//
+// GL_ARB_instanced_arrays
+//
+extern boolean has_GL_ARB_instanced_arrays;
+
+#ifndef __IPHONEOS__
+extern PFNGLVERTEXATTRIBDIVISORARBPROC _glVertexAttribDivisorARB;
+#endif // __IPHONEOS__
+
+#ifndef __IPHONEOS__
+#define GL_ARB_instanced_arrays_Define() \
+boolean has_GL_ARB_instanced_arrays = false; \
+PFNGLVERTEXATTRIBDIVISORARBPROC _glVertexAttribDivisorARB = NULL
+#else
+#define GL_ARB_instanced_arrays_Define() boolean has_GL_ARB_instanced_arrays = false;
+#endif // __IPHONEOS__
+
+#ifndef __IPHONEOS__
+#define GL_ARB_instanced_arrays_Init() \
+has_GL_ARB_instanced_arrays = GL_CheckExtension("GL_ARB_instanced_arrays"); \
+_glVertexAttribDivisorARB = (PFNGLVERTEXATTRIBDIVISORARBPROC)GL_RegisterProc("glVertexAttribDivisorARB")
+#else
+#define GL_ARB_instanced_arrays_Init() has_GL_ARB_instanced_arrays = false;
+#endif // __IPHONEOS__
+
+#ifndef USE_DEBUG_GLFUNCS
+
+#define dglVertexAttribDivisorARB(index, divisor) _glVertexAttribDivisorARB(index, divisor)
+
+#else
+
+static __inline void glVertexAttribDivisorARB_DEBUG (GLuint index, GLuint divisor, const char* file, int line)
+{
+#ifdef LOG_GLFUNC_CALLS
+    fprintf(stderr, "file = %s, line = %i, glVertexAttribDivisorARB(index=%i, divisor=%i)\n", file, line, index, divisor);
+#endif
+    _glVertexAttribDivisorARB(index, divisor);
+    GL_LogError("glVertexAttribDivisorARB", file, line);
+}
+
+
+#define dglVertexAttribDivisorARB(index, divisor) glVertexAttribDivisorARB_DEBUG(index, divisor, __FILE__, __LINE__)
+
+#endif // USE_DEBUG_GLFUNCS
+
+//
+// GL_ARB_draw_instanced
+//
+extern boolean has_GL_ARB_draw_instanced;
+
+#ifndef __IPHONEOS__
+extern PFNGLDRAWARRAYSINSTANCEDARBPROC _glDrawArraysInstancedARB;
+#endif // __IPHONEOS__
+
+#ifndef __IPHONEOS__
+#define GL_ARB_draw_instanced_Define() \
+boolean has_GL_ARB_draw_instanced = false; \
+PFNGLDRAWARRAYSINSTANCEDARBPROC _glDrawArraysInstancedARB = NULL
+#else
+#define GL_ARB_draw_instanced_Define() boolean has_GL_ARB_draw_instanced = false;
+#endif // __IPHONEOS__
+
+#ifndef __IPHONEOS__
+#define GL_ARB_draw_instanced_Init() \
+has_GL_ARB_draw_instanced = GL_CheckExtension("GL_ARB_draw_instanced"); \
+_glDrawArraysInstancedARB = (PFNGLDRAWARRAYSINSTANCEDARBPROC)GL_RegisterProc("glDrawArraysInstancedARB")
+#else
+#define GL_ARB_draw_instanced_Init() has_GL_ARB_draw_instanced = false;
+#endif // __IPHONEOS__
+
+#ifndef USE_DEBUG_GLFUNCS
+
+#define dglDrawArraysInstancedARB(mode, first, count, primcount) _glDrawArraysInstancedARB(mode, first, count, primcount)
+
+#else
+
+static __inline void glDrawArraysInstancedARB_DEBUG (GLenum mode, GLint first, GLsizei count, GLsizei primcount, const char* file, int line)
+{
+#ifdef LOG_GLFUNC_CALLS
+    fprintf(stderr, "file = %s, line = %i, glDrawArraysInstancedARB(mode=0x%x, first=%i, count=0x%x, primcount=0x%x)\n", file, line, mode, first, count, primcount);
+#endif
+    _glDrawArraysInstancedARB(mode, first, count, primcount);
+    GL_LogError("glDrawArraysInstancedARB", file, line);
+}
+
+
+#define dglDrawArraysInstancedARB(mode, first, count, primcount) glDrawArraysInstancedARB_DEBUG(mode, first, count, primcount, __FILE__, __LINE__)
+
+#endif // USE_DEBUG_GLFUNCS
+
+//
+// GL_EXT_texture3D
+//
+extern boolean has_GL_EXT_texture3D;
+
+#ifndef __IPHONEOS__
+extern PFNGLTEXIMAGE3DEXTPROC _glTexImage3DEXT;
+#endif // __IPHONEOS__
+
+#ifndef __IPHONEOS__
+#define GL_EXT_texture3D_Define() \
+boolean has_GL_EXT_texture3D = false; \
+PFNGLTEXIMAGE3DEXTPROC _glTexImage3DEXT = NULL
+#else
+#define GL_EXT_texture3D_Define() boolean has_GL_EXT_texture3D = false;
+#endif // __IPHONEOS__
+
+#ifndef __IPHONEOS__
+#define GL_EXT_texture3D_Init() \
+has_GL_EXT_texture3D = GL_CheckExtension("GL_EXT_texture3D"); \
+_glTexImage3DEXT = (PFNGLTEXIMAGE3DEXTPROC)GL_RegisterProc("glTexImage3DEXT")
+#else
+#define GL_EXT_texture3D_Init() has_GL_EXT_texture3D = false;
+#endif // __IPHONEOS__
+
+#ifndef USE_DEBUG_GLFUNCS
+
+#define dglTexImage3DEXT(target, level, internalformat, width, height, depth, border, format, type, pixels) _glTexImage3DEXT(target, level, internalformat, width, height, depth, border, format, type, pixels)
+
+#else
+
+static __inline void glTexImage3DEXT_DEBUG (GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const GLvoid* pixels, const char* file, int line)
+{
+#ifdef LOG_GLFUNC_CALLS
+    fprintf(stderr, "file = %s, line = %i, glTexImage3DEXT(target=0x%x, level=%i, internalformat=0x%x, width=0x%x, height=0x%x, depth=0x%x, border=%i, format=0x%x, type=0x%x, pixels=%p)\n", file, line, target, level, internalformat, width, height, depth, border, format, type, pixels);
+#endif
+    _glTexImage3DEXT(target, level, internalformat, width, height, depth, border, format, type, pixels);
+    GL_LogError("glTexImage3DEXT", file, line);
+}
+
+
+#define dglTexImage3DEXT(target, level, internalformat, width, height, depth, border, format, type, pixels) glTexImage3DEXT_DEBUG(target, level, internalformat, width, height, depth, border, format, type, pixels, __FILE__, __LINE__)
+
+#endif // USE_DEBUG_GLFUNCS
+
 #ifdef __cplusplus
 }
 #endif
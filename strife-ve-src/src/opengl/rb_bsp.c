@@ -32,6 +32,9 @@
 #include "rb_wallshade.h"
 #include "rb_dynlights.h"
 #include "rb_config.h"
+#include "rb_profile.h"
+#include "rb_vbo.h"
+#include "i_thread.h"
 #include "r_main.h"
 #include "r_defs.h"
 #include "i_system.h"
@@ -40,8 +43,6 @@
 #include "p_local.h"
 #include "doomstat.h"
 
-static int currentssect = 0;
-
 typedef enum
 {
     BS_LOWER    = 0,
@@ -49,6 +50,77 @@ typedef enum
     BS_MIDDLE
 } bspSide_t;
 
+// results of clipping a seg against the angular clipper
+enum
+{
+    BSF_VISIBLE     = BIT(0),
+    BSF_FRONTFACING = BIT(1),
+    BSF_CLIPLINE    = BIT(2)
+};
+
+//
+// everything the draw list emitters write to. the main context
+// targets the real draw lists; each BSP job gets its own so that
+// worker threads never touch shared state.
+//
+typedef struct
+{
+    drawlist_t      *drawlists;
+    int             currentssect;
+    boolean         bWorker;
+
+    // job contexts only
+    drawlist_t      shards[NUMDRAWLISTS];
+    line_t          **mappedlines;
+    int             nummappedlines;
+    int             maxmappedlines;
+    mobj_t          **things;
+    int             numthings;
+    int             maxthings;
+    int             firstvis;
+    int             numvis;
+} bspContext_t;
+
+static bspContext_t bspMainContext = { drawlist };
+
+#define MAX_BSP_JOBS    64
+
+static bspContext_t *bspJobContexts[MAX_BSP_JOBS];
+
+//
+// visible subsectors recorded in traversal order while the
+// occlusion walk is run ahead of the draw list emission
+//
+typedef struct
+{
+    subsector_t     *ssect;
+    int             firstseg;
+    int             numsegs;
+} bspVisSubsector_t;
+
+typedef struct
+{
+    seg_t           *seg;
+    int             flags;
+} bspVisSeg_t;
+
+static bspVisSubsector_t    *bspVisSubsectors;
+static int                  bspNumVisSubsectors;
+static int                  bspMaxVisSubsectors;
+static bspVisSeg_t          *bspVisSegs;
+static int                  bspNumVisSegs;
+static int                  bspMaxVisSegs;
+static boolean              bDeferEmit = false;
+
+//
+// for every node, whether anything below it is in the PVS of the
+// subsector the view is in. lets whole subtrees be skipped before
+// any bbox or clipper work is done on them
+//
+static byte                 *bspNodeVis;
+static int                  bspMaxNodes;
+static byte                 *bspPVSRow;
+
 static boolean (*procsegs[][3])(struct vtxlist_s*, int*) =
 {
     {
@@ -65,6 +137,11 @@ static boolean (*procsegs[][3])(struct vtxlist_s*, int*) =
         RB_GenerateLightmapLowerSeg,
         RB_GenerateLightmapUpperSeg,
         RB_GenerateLightmapMiddleSeg
+    },
+    {
+        VBO_GenerateLowerSeg,
+        VBO_GenerateUpperSeg,
+        VBO_GenerateMiddleSeg
     }
 };
 
@@ -85,11 +162,53 @@ static float RB_SegDistanceToView(seg_t *seg)
                   rbPlayerView.y * seg->linedef->fny) - pd);
 }
 
+//
+// RB_AddDynLightsToDrawlist
+//
+// One list per light touching the subsector, or just one for all of
+// them when the lights are done in a shader. The shader lists carry the
+// light mask in texid so only surfaces lit by the same lights batch
+//
+
+static void RB_AddDynLightsToDrawlist(bspContext_t *ctx, unsigned int marknum,
+                                      boolean (*procfunc)(struct vtxlist_s*, int*),
+                                      int params, int flags)
+{
+    vtxlist_t *list;
+    int i;
+
+    for(i = 0; i < MAX_DYNLIGHTS; ++i)
+    {
+        if(!(marknum & (1 << i)))
+        {
+            continue;
+        }
+
+        list = DL_AddVertexList(&ctx->drawlists[DLT_DYNLIGHT]);
+        list->data = (rbDynLight_t*)RB_GetDynLight(i);
+        list->procfunc = procfunc;
+        list->preprocess = 0;
+        list->postprocess = rbDynamicLightFastBlend ? 0 : RB_DynLightPostProcess;
+        list->flags = flags;
+        list->texid = 0;
+        list->fparams = 0;
+        list->params = params;
+
+        if(RB_DynLightSinglePass())
+        {
+            // the geometry doesn't depend on which light it was built for
+            list->preprocess = RB_PreProcessDynLights;
+            list->texid = marknum;
+            break;
+        }
+    }
+}
+
 //
 // RB_AddSegToDrawlist
 //
 
-static void RB_AddSegToDrawlist(seg_t *seg, int texid, bspSide_t sidetype)
+static void RB_AddSegToDrawlist(bspContext_t *ctx, seg_t *seg, int texid, bspSide_t sidetype)
 {
     vtxlist_t *list;
     drawlisttag_e dltag;
@@ -112,9 +231,9 @@ static void RB_AddSegToDrawlist(seg_t *seg, int texid, bspSide_t sidetype)
     }
 
     // add initial draw list
-    list = DL_AddVertexList(&drawlist[dltag]);
+    list = DL_AddVertexList(&ctx->drawlists[dltag]);
     list->data = (seg_t*)seg;
-    list->procfunc = procsegs[0][sidetype];
+    list->procfunc = procsegs[(dltag == DLT_WALL && VBO_StaticGeometryEnabled()) ? 3 : 0][sidetype];
     list->preprocess = RB_PreProcessSeg;
     list->postprocess = 0;
     list->flags = 0;
@@ -122,6 +241,12 @@ static void RB_AddSegToDrawlist(seg_t *seg, int texid, bspSide_t sidetype)
     list->params = (rbLightmaps && sector->altlightlevel != -1) ? sector->altlightlevel : sector->lightlevel;
     list->texid = texid;
 
+    if(seg->linedef->flags & (ML_TRANSPARENT1|ML_TRANSPARENT2))
+    {
+        // RB_PreProcessSeg blends these differently
+        list->flags |= DLF_TRANSLUCENT;
+    }
+
     if(dltag == DLT_TRANSWALL)
     {
         // set distance for transparent walls
@@ -136,7 +261,7 @@ static void RB_AddSegToDrawlist(seg_t *seg, int texid, bspSide_t sidetype)
     {
         if(RB_GetTextureFlags(RDT_COLUMN, texid, 0) & TDF_BRIGHTMAP)
         {
-            list = DL_AddVertexList(&drawlist[DLT_BRIGHTMASKED]);
+            list = DL_AddVertexList(&ctx->drawlists[DLT_BRIGHTMASKED]);
             list->data = (seg_t*)seg;
             list->procfunc = procsegs[0][sidetype];
             list->preprocess = RB_PreProcessSeg;
@@ -153,7 +278,7 @@ static void RB_AddSegToDrawlist(seg_t *seg, int texid, bspSide_t sidetype)
         // TODO: this may not get explicitly added on the very first frame
         if(RB_GetTextureFlags(RDT_COLUMN, texid, 0) & TDF_BRIGHTMAP)
         {
-            list = DL_AddVertexList(&drawlist[DLT_BRIGHT]);
+            list = DL_AddVertexList(&ctx->drawlists[DLT_BRIGHT]);
             list->data = (seg_t*)seg;
             list->procfunc = procsegs[0][sidetype];
             list->preprocess = RB_PreProcessSeg;
@@ -167,29 +292,11 @@ static void RB_AddSegToDrawlist(seg_t *seg, int texid, bspSide_t sidetype)
         // dynamic light draw lists
         if(rbDynamicLights)
         {
-            int marknum = RB_SubsectorMarked(currentssect);
+            unsigned int marknum = RB_SubsectorMarked(ctx->currentssect);
             
             if(marknum)
             {
-                int i;
-                
-                for(i = 0; i < MAX_DYNLIGHTS; ++i)
-                {
-                    if(!(marknum & (1 << i)))
-                    {
-                        continue;
-                    }
-                    
-                    list = DL_AddVertexList(&drawlist[DLT_DYNLIGHT]);
-                    list->data = (rbDynLight_t*)RB_GetDynLight(i);
-                    list->procfunc = procsegs[1][sidetype];
-                    list->preprocess = 0;
-                    list->postprocess = rbDynamicLightFastBlend ? 0 : RB_DynLightPostProcess;
-                    list->flags = 0;
-                    list->texid = 0;
-                    list->fparams = 0;
-                    list->params = seg - segs;
-                }
+                RB_AddDynLightsToDrawlist(ctx, marknum, procsegs[1][sidetype], seg - segs, 0);
             }
         }
 
@@ -224,7 +331,7 @@ static void RB_AddSegToDrawlist(seg_t *seg, int texid, bspSide_t sidetype)
                 return;
             }
 
-            list = DL_AddVertexList(&drawlist[DLT_LIGHTMAP]);
+            list = DL_AddVertexList(&ctx->drawlists[DLT_LIGHTMAP]);
             list->data = (seg_t*)seg;
             list->procfunc = procsegs[2][sidetype];
             list->preprocess = RB_PreProcessLightmapSeg;
@@ -241,16 +348,16 @@ static void RB_AddSegToDrawlist(seg_t *seg, int texid, bspSide_t sidetype)
 // RB_AddLeafToDrawlist
 //
 
-static void RB_AddLeafToDrawlist(subsector_t *sub, int texid, boolean bCeiling)
+static void RB_AddLeafToDrawlist(bspContext_t *ctx, subsector_t *sub, int texid, boolean bCeiling)
 {
     vtxlist_t *list;
     sector_t *sector = sub->sector;
-    int marknum;
+    unsigned int marknum;
     
     // add initial draw list
-    list = DL_AddVertexList(&drawlist[DLT_FLAT]);
+    list = DL_AddVertexList(&ctx->drawlists[DLT_FLAT]);
     list->data = (subsector_t*)sub;
-    list->procfunc = RB_GenerateSubSectors;
+    list->procfunc = VBO_StaticGeometryEnabled() ? VBO_GenerateSubSectors : RB_GenerateSubSectors;
     list->preprocess = RB_PreProcessSubsector;
     list->postprocess = 0;
     list->params = (rbLightmaps && sector->altlightlevel != -1) ? sector->altlightlevel : sector->lightlevel;
@@ -266,7 +373,7 @@ static void RB_AddLeafToDrawlist(subsector_t *sub, int texid, boolean bCeiling)
     // TODO: this may not get explicitly added on the very first frame
     if(RB_GetTextureFlags(RDT_FLAT, texid, 0) & TDF_BRIGHTMAP)
     {
-        list = DL_AddVertexList(&drawlist[DLT_BRIGHT]);
+        list = DL_AddVertexList(&ctx->drawlists[DLT_BRIGHT]);
         list->data = (subsector_t*)sub;
         list->procfunc = RB_GenerateSubSectors;
         list->preprocess = RB_PreProcessSubsector;
@@ -284,40 +391,19 @@ static void RB_AddLeafToDrawlist(subsector_t *sub, int texid, boolean bCeiling)
     // add dynamic light draw list
     if(rbDynamicLights)
     {
-        marknum = RB_SubsectorMarked(currentssect);
+        marknum = RB_SubsectorMarked(ctx->currentssect);
         
         if(marknum)
         {
-            int i;
-            
-            for(i = 0; i < MAX_DYNLIGHTS; ++i)
-            {
-                if(!(marknum & (1 << i)))
-                {
-                    continue;
-                }
-                
-                list = DL_AddVertexList(&drawlist[DLT_DYNLIGHT]);
-                list->data = (rbDynLight_t*)RB_GetDynLight(i);
-                list->preprocess = 0;
-                list->postprocess = rbDynamicLightFastBlend ? 0 : RB_DynLightPostProcess;
-                list->procfunc = RB_GenerateDynLightFlat;
-                list->texid = 0;
-                list->fparams = 0;
-                list->params = sub - subsectors;
-
-                if(bCeiling)
-                {
-                    list->flags |= DLF_CEILING;
-                }
-            }
+            RB_AddDynLightsToDrawlist(ctx, marknum, RB_GenerateDynLightFlat,
+                                      sub - subsectors, bCeiling ? DLF_CEILING : 0);
         }
     }
 
     // add lightmap drawlist
     if(rbLightmaps && lightmapTextures && sub->lightMapInfo[bCeiling].num != -1)
     {
-        list = DL_AddVertexList(&drawlist[DLT_LIGHTMAP]);
+        list = DL_AddVertexList(&ctx->drawlists[DLT_LIGHTMAP]);
         list->data = (subsector_t*)sub;
         list->procfunc = RB_GenerateLightMapFlat;
         list->preprocess = RB_PreProcessLightMapFlat;
@@ -337,26 +423,12 @@ static void RB_AddLeafToDrawlist(subsector_t *sub, int texid, boolean bCeiling)
 // RB_AddClipLineToDrawlist
 //
 
-static void RB_AddClipLineToDrawlist(seg_t *seg)
+static void RB_AddClipLineToDrawlist(bspContext_t *ctx, seg_t *seg)
 {
     vtxlist_t *list;
-    line_t *line;
+    line_t *line = seg->linedef;
 
-    if(!rbFixSpriteClipping)
-    {
-        return;
-    }
-
-    line = seg->linedef;
-
-    if(line->validcount == validcount)
-    {
-        return;
-    }
-
-    line->validcount = validcount;
-
-    list = DL_AddVertexList(&drawlist[DLT_CLIPLINE]);
+    list = DL_AddVertexList(&ctx->drawlists[DLT_CLIPLINE]);
     list->data = (line_t*)line;
     list->preprocess = RB_PreProcessClipLine;
     list->postprocess = 0;
@@ -385,11 +457,11 @@ static void RB_AddClipLineToDrawlist(seg_t *seg)
 // RB_AddSkyLineToDrawlist
 //
 
-static void RB_AddSkyLineToDrawlist(seg_t *seg, float height)
+static void RB_AddSkyLineToDrawlist(bspContext_t *ctx, seg_t *seg, float height)
 {
     vtxlist_t *list;
 
-    list = DL_AddVertexList(&drawlist[DLT_SKY]);
+    list = DL_AddVertexList(&ctx->drawlists[DLT_SKY]);
     list->data = (seg_t*)seg;
     list->preprocess = RB_PreProcessClipLine;
     list->postprocess = 0;
@@ -401,25 +473,50 @@ static void RB_AddSkyLineToDrawlist(seg_t *seg, float height)
 }
 
 //
-// RB_AddLine
+// RB_LineInView
+//
+
+static boolean RB_LineInView(line_t *linedef)
+{
+    fixed_t z1, z2;
+
+    if(linedef->backsector)
+    {
+        z1 = linedef->frontsector->floorheight < linedef->backsector->floorheight ?
+        linedef->frontsector->floorheight :
+        linedef->backsector->floorheight;
+
+        z2 = linedef->frontsector->ceilingheight > linedef->backsector->ceilingheight ?
+        linedef->frontsector->ceilingheight :
+        linedef->backsector->ceilingheight;
+    }
+    else
+    {
+        z1 = linedef->frontsector->floorheight;
+        z2 = linedef->frontsector->ceilingheight;
+    }
+
+    return RB_CheckBoxInView(&rbPlayerView, linedef->bbox, z1, z2);
+}
+
+//
+// RB_ClipLine
+//
+// Runs the seg through the angular clipper. This depends on the
+// front to back order of the traversal so it always happens on the
+// calling thread. Returns 0 if there is nothing left to emit.
 //
 
-void RB_AddLine(seg_t* seg)
+static int RB_ClipLine(seg_t *seg)
 {
     angle_t     angle1;
     angle_t     angle2;
-    vtx_t       v[4];
     line_t      *linedef;
-    side_t      *sidedef;
-    float       top;
-    float       bottom;
-    float       btop;
-    float       bbottom;
-    boolean     infrustum;
+    int         flags;
 
     if(!seg->linedef)
     {
-        return;
+        return 0;
     }
 
     if(seg->backsector)
@@ -429,7 +526,7 @@ void RB_AddLine(seg_t* seg)
             seg->sidedef->midtexture == 0)
         {
             seg->linedef->flags |= ML_MAPPED;
-            return;
+            return 0;
         }
     }
 
@@ -450,58 +547,27 @@ void RB_AddLine(seg_t* seg)
 
     if(!RB_Clipper_SafeCheckRange(angle2, angle1))
     {
-        return;
+        return 0;
     }
-    
-    linedef = seg->linedef;
 
-    // did we already check this linedef?
-    if(linedef->validclip[0] != validcount)
-    {
-        if(linedef->validclip[1] == validcount)
-        {
-            // this linedef was already clipped
-            infrustum = false;
-        }
-        else
-        {
-            fixed_t z1, z2;
-            
-            if(linedef->backsector)
-            {
-                z1 = linedef->frontsector->floorheight < linedef->backsector->floorheight ?
-                linedef->frontsector->floorheight :
-                linedef->backsector->floorheight;
+    linedef = seg->linedef;
+    flags = BSF_VISIBLE;
 
-                z2 = linedef->frontsector->ceilingheight > linedef->backsector->ceilingheight ?
-                linedef->frontsector->ceilingheight :
-                linedef->backsector->ceilingheight;
-            }
-            else
-            {
-                z1 = linedef->frontsector->floorheight;
-                z2 = linedef->frontsector->ceilingheight;
-            }
-            
-            infrustum = RB_CheckBoxInView(&rbPlayerView, linedef->bbox, z1, z2);
-            
-            // mark it so we don't have to recheck this linedef again
-            linedef->validclip[infrustum ? 0 : 1] = validcount;
-        }
-    }
-    else
+    // only add one clip line per linedef
+    if(rbFixSpriteClipping && linedef->validcount != validcount)
     {
-        infrustum = true;
+        linedef->validcount = validcount;
+        flags |= BSF_CLIPLINE;
     }
 
-    RB_AddClipLineToDrawlist(seg);
-
     // Back side, i.e. backface culling - read: endAngle >= startAngle!
     if(angle2 - angle1 < ANG180)
     {
-        return;
+        return flags;
     }
 
+    flags |= BSF_FRONTFACING;
+
     if(seg->backsector)
     {
         if((seg->backsector->floorheight == seg->backsector->ceilingheight) ||
@@ -517,12 +583,87 @@ void RB_AddLine(seg_t* seg)
         RB_Clipper_SafeAddClipRange(angle2, angle1);
     }
 
+    return flags;
+}
+
+//
+// RB_EmitLine
+//
+// Adds the draw lists for a seg that survived RB_ClipLine
+//
+
+static void RB_EmitLine(bspContext_t *ctx, seg_t *seg, int flags)
+{
+    vtx_t       v[4];
+    line_t      *linedef;
+    side_t      *sidedef;
+    float       top;
+    float       bottom;
+    float       btop;
+    float       bbottom;
+    boolean     infrustum;
+
+    if(flags & BSF_CLIPLINE)
+    {
+        RB_AddClipLineToDrawlist(ctx, seg);
+    }
+
+    if(!(flags & BSF_FRONTFACING))
+    {
+        return;
+    }
+
+    linedef = seg->linedef;
+
+    if(ctx->bWorker)
+    {
+        // the validclip cache is shared, so workers always do the test
+        infrustum = RB_LineInView(linedef);
+    }
+    else if(linedef->validclip[0] == validcount)
+    {
+        infrustum = true;
+    }
+    else if(linedef->validclip[1] == validcount)
+    {
+        // this linedef was already clipped
+        infrustum = false;
+    }
+    else
+    {
+        infrustum = RB_LineInView(linedef);
+
+        // mark it so we don't have to recheck this linedef again
+        linedef->validclip[infrustum ? 0 : 1] = validcount;
+    }
+
     if(!infrustum)
     {
         return;
     }
 
-    linedef->flags |= ML_MAPPED;
+    if(ctx->bWorker)
+    {
+        // flagged by the main thread once the job is done
+        if(ctx->nummappedlines == ctx->maxmappedlines)
+        {
+            ctx->maxmappedlines += 128;
+            ctx->mappedlines = (line_t**)realloc(ctx->mappedlines,
+                                                 ctx->maxmappedlines * sizeof(line_t*));
+
+            if(!ctx->mappedlines)
+            {
+                I_Error("RB_EmitLine: failed to grow mapped line list");
+            }
+        }
+
+        ctx->mappedlines[ctx->nummappedlines++] = linedef;
+    }
+    else
+    {
+        linedef->flags |= ML_MAPPED;
+    }
+
     sidedef = seg->sidedef;
 
     v[0].x = v[2].x = seg->v1->fx;
@@ -551,7 +692,7 @@ void RB_AddLine(seg_t* seg)
             
             if(RB_CheckPointsInView(&rbPlayerView, v, 4))
             {
-                RB_AddSegToDrawlist(seg, sidedef->bottomtexture, BS_LOWER);
+                RB_AddSegToDrawlist(ctx, seg, sidedef->bottomtexture, BS_LOWER);
             }
             bottom = bbottom;
         }
@@ -566,7 +707,7 @@ void RB_AddLine(seg_t* seg)
 
             if(RB_CheckPointsInView(&rbPlayerView, v, 4))
             {
-                RB_AddSegToDrawlist(seg, sidedef->toptexture, BS_UPPER);
+                RB_AddSegToDrawlist(ctx, seg, sidedef->toptexture, BS_UPPER);
             }
             top = btop;
         }
@@ -577,18 +718,18 @@ void RB_AddLine(seg_t* seg)
         {
             if(seg->backsector->ceilingpic == skyflatnum)
             {
-                RB_AddSkyLineToDrawlist(seg, FIXED2FLOAT(seg->backsector->ceilingheight));
+                RB_AddSkyLineToDrawlist(ctx, seg, FIXED2FLOAT(seg->backsector->ceilingheight));
             }
             else if(seg->frontsector->ceilingpic == skyflatnum)
             {
-                RB_AddSkyLineToDrawlist(seg, FIXED2FLOAT(seg->frontsector->ceilingheight));
+                RB_AddSkyLineToDrawlist(ctx, seg, FIXED2FLOAT(seg->frontsector->ceilingheight));
             }
         }
     }
     else if(seg->frontsector->ceilingpic == skyflatnum)
     {
         // do nothing special here. just add it so we can mask it out in the stencil buffer
-        RB_AddSkyLineToDrawlist(seg, FIXED2FLOAT(seg->frontsector->ceilingheight));
+        RB_AddSkyLineToDrawlist(ctx, seg, FIXED2FLOAT(seg->frontsector->ceilingheight));
     }
 
     //
@@ -601,7 +742,7 @@ void RB_AddLine(seg_t* seg)
 
         if(RB_CheckPointsInView(&rbPlayerView, v, 4))
         {
-            RB_AddSegToDrawlist(seg, sidedef->midtexture, BS_MIDDLE);
+            RB_AddSegToDrawlist(ctx, seg, sidedef->midtexture, BS_MIDDLE);
         }
     }
 }
@@ -649,6 +790,131 @@ static boolean RB_CheckBBox(fixed_t *bspcoord)
     return RB_Clipper_SafeCheckRange(angle2 + viewangle, angle1 + viewangle);
 }
 
+//
+// RB_SectorInView
+//
+
+static boolean RB_SectorInView(sector_t *sector)
+{
+    fixed_t bbox[4];
+    fixed_t *blockbox = sector->blockbox;
+
+    bbox[BOXTOP]    = ((blockbox[BOXTOP]    << MAPBLOCKSHIFT) + bmaporgy) + (80*FRACUNIT);
+    bbox[BOXBOTTOM] = ((blockbox[BOXBOTTOM] << MAPBLOCKSHIFT) + bmaporgy) - (80*FRACUNIT);
+    bbox[BOXRIGHT]  = ((blockbox[BOXRIGHT]  << MAPBLOCKSHIFT) + bmaporgx) + (80*FRACUNIT);
+    bbox[BOXLEFT]   = ((blockbox[BOXLEFT]   << MAPBLOCKSHIFT) + bmaporgx) - (80*FRACUNIT);
+
+    return RB_CheckBoxInView(&rbPlayerView, bbox, sector->floorheight, sector->ceilingheight);
+}
+
+//
+// RB_EmitSubsector
+//
+// Adds the flats, sprites and decals of a visible subsector
+//
+
+static void RB_EmitSubsector(bspContext_t *ctx, subsector_t *sub)
+{
+    sector_t *sector = sub->sector;
+
+    if(ctx->bWorker)
+    {
+        if(!RB_SectorInView(sector))
+        {
+            return;
+        }
+    }
+    // did we already check this sector?
+    else if(sector->validclip[0] != validcount)
+    {
+        if(sector->validclip[1] == validcount)
+        {
+            // this sector was already clipped
+            return;
+        }
+
+        if(!RB_SectorInView(sector))
+        {
+            // mark it so we don't have to recheck this sector again
+            sector->validclip[1] = validcount;
+            return;
+        }
+        else
+        {
+            // mark it so we don't have to recheck this sector again
+            sector->validclip[0] = validcount;
+        }
+    }
+
+    if(viewz > sector->floorheight && sector->floorpic != skyflatnum)
+    {
+        RB_AddLeafToDrawlist(ctx, sub, sector->floorpic, false);
+    }
+
+    if(viewz < sector->ceilingheight && sector->ceilingpic != skyflatnum)
+    {
+        RB_AddLeafToDrawlist(ctx, sub, sector->ceilingpic, true);
+    }
+
+    if(ctx->bWorker)
+    {
+        int count;
+
+        // vissprites are added by the main thread once the job is done
+        while((count = RB_FindSprites(sub, ctx->things + ctx->numthings,
+                                      ctx->maxthings - ctx->numthings)) > ctx->maxthings - ctx->numthings)
+        {
+            ctx->maxthings = ctx->numthings + count + 64;
+            ctx->things = (mobj_t**)realloc(ctx->things, ctx->maxthings * sizeof(mobj_t*));
+
+            if(!ctx->things)
+            {
+                I_Error("RB_EmitSubsector: failed to grow sprite list");
+            }
+        }
+
+        ctx->numthings += count;
+    }
+    else
+    {
+        RB_AddSprites(sub);
+    }
+
+    RB_AddDecals(&ctx->drawlists[DLT_DECAL], sub);
+}
+
+//
+// RB_RecordSubsector
+//
+// Clips the segs of a subsector and saves the results so the
+// draw lists can be emitted later by the BSP jobs
+//
+
+static void RB_RecordSubsector(subsector_t *sub)
+{
+    bspVisSubsector_t *vis;
+    leaf_t *leaf;
+    int flags;
+    int i;
+
+    vis = &bspVisSubsectors[bspNumVisSubsectors++];
+    vis->ssect = sub;
+    vis->firstseg = bspNumVisSegs;
+
+    for(i = 0; i < sub->numleafs; i++)
+    {
+        leaf = &leafs[sub->leaf + i];
+        if(leaf->seg != NULL && (flags = RB_ClipLine(leaf->seg)))
+        {
+            bspVisSegs[bspNumVisSegs].seg = leaf->seg;
+            bspVisSegs[bspNumVisSegs].flags = flags;
+            bspNumVisSegs++;
+        }
+    }
+
+    vis->numsegs = bspNumVisSegs - vis->firstseg;
+}
+
 //
 // RB_Subsector
 //
@@ -657,12 +923,9 @@ void RB_Subsector(int num)
 {
     sector_t *sector;
     subsector_t *sub;
-    fixed_t bbox[4];
-    fixed_t *blockbox;
     int i;
+    int flags;
     leaf_t *leaf;
-    
-    currentssect = num;
 
     sub = &subsectors[num];
     sector = sub->sector;
@@ -680,56 +943,76 @@ void RB_Subsector(int num)
     // haleyjd: set sector shade(s) now
     RB_SetSectorShades(sector);
 
+    if(bDeferEmit)
+    {
+        RB_RecordSubsector(sub);
+        return;
+    }
+
+    bspMainContext.currentssect = num;
+
     for(i = 0; i < sub->numleafs; i++)
     {
         leaf = &leafs[sub->leaf + i];
-        if(leaf->seg != NULL)
+        if(leaf->seg != NULL && (flags = RB_ClipLine(leaf->seg)))
         {
-            RB_AddLine(leaf->seg);
+            RB_EmitLine(&bspMainContext, leaf->seg, flags);
         }
     }
 
-    // did we already check this sector?
-    if(sector->validclip[0] != validcount)
+    RB_EmitSubsector(&bspMainContext, sub);
+}
+
+//
+// RB_MarkPVSNode
+//
+
+static boolean RB_MarkPVSNode(int bspnum)
+{
+    boolean bVisible;
+    int num;
+
+    if(bspnum & NF_SUBSECTOR)
     {
-        if(sector->validclip[1] == validcount)
-        {
-            // this sector was already clipped
-            return;
-        }
+        num = (bspnum == -1) ? 0 : (bspnum & ~NF_SUBSECTOR);
+        return (bspPVSRow[num >> 3] & (1 << (num & 7))) != 0;
+    }
 
-        blockbox = sector->blockbox;
+    bVisible = RB_MarkPVSNode(nodes[bspnum].children[0]);
+    bVisible |= RB_MarkPVSNode(nodes[bspnum].children[1]);
 
-        bbox[BOXTOP]    = ((blockbox[BOXTOP]    << MAPBLOCKSHIFT) + bmaporgy) + (80*FRACUNIT);
-        bbox[BOXBOTTOM] = ((blockbox[BOXBOTTOM] << MAPBLOCKSHIFT) + bmaporgy) - (80*FRACUNIT);
-        bbox[BOXRIGHT]  = ((blockbox[BOXRIGHT]  << MAPBLOCKSHIFT) + bmaporgx) + (80*FRACUNIT);
-        bbox[BOXLEFT]   = ((blockbox[BOXLEFT]   << MAPBLOCKSHIFT) + bmaporgx) - (80*FRACUNIT);
+    bspNodeVis[bspnum] = bVisible;
+    return bVisible;
+}
 
-        if(!RB_CheckBoxInView(&rbPlayerView, bbox, sector->floorheight, sector->ceilingheight))
-        {
-            // mark it so we don't have to recheck this sector again
-            sector->validclip[1] = validcount;
-            return;
-        }
-        else
+//
+// RB_MarkPVSNodes
+//
+// One pass over the tree per frame, far less than the walk itself
+//
+
+static void RB_MarkPVSNodes(void)
+{
+    int num;
+
+    if(bspMaxNodes < numnodes)
+    {
+        bspMaxNodes = numnodes;
+        bspNodeVis = (byte*)realloc(bspNodeVis, bspMaxNodes);
+
+        if(!bspNodeVis)
         {
-            // mark it so we don't have to recheck this sector again
-            sector->validclip[0] = validcount;
+            I_Error("RB_MarkPVSNodes: failed to allocate node flags");
         }
     }
 
-    if(viewz > sector->floorheight && sector->floorpic != skyflatnum)
-    {
-        RB_AddLeafToDrawlist(sub, sector->floorpic, false);
-    }
+    num = R_PointInSubsector(viewx, viewy) - subsectors;
+    bspPVSRow = &pvsmatrix[((numsubsectors + 7) / 8) * num];
 
-    if(viewz < sector->ceilingheight && sector->ceilingpic != skyflatnum)
+    if(numnodes > 0)
     {
-        RB_AddLeafToDrawlist(sub, sector->ceilingpic, true);
+        RB_MarkPVSNode(numnodes-1);
     }
-
-    RB_AddSprites(sub);
-    RB_AddDecals(sub);
 }
 
 //
@@ -740,9 +1023,16 @@ void RB_RenderBSPNode(int bspnum)
 {
     node_t  *bsp;
     int     side;
+    int     num;
 
     while(!(bspnum & NF_SUBSECTOR))
     {
+        // nothing down here can be seen from where the view is
+        if(!bspNodeVis[bspnum])
+        {
+            return;
+        }
+
         bsp = &nodes[bspnum];
 
         // Decide which side the view point is on.
@@ -765,10 +1055,191 @@ void RB_RenderBSPNode(int bspnum)
 
     // subsector with contents
     // add all the drawable elements in the subsector
-    if(bspnum == -1)
+    num = (bspnum == -1) ? 0 : (bspnum & ~NF_SUBSECTOR);
+
+    if(!(bspPVSRow[num >> 3] & (1 << (num & 7))))
     {
-        bspnum = 0;
+        return;
+    }
+
+    RB_Subsector(num);
+}
+
+//
+// RB_GetJobContext
+//
+
+static bspContext_t *RB_GetJobContext(int job)
+{
+    bspContext_t *ctx = bspJobContexts[job];
+    int i;
+
+    if(ctx == NULL)
+    {
+        if(!(ctx = (bspContext_t*)calloc(1, sizeof(bspContext_t))))
+        {
+            I_Error("RB_GetJobContext: failed to allocate job context");
+        }
+
+        for(i = 0; i < NUMDRAWLISTS; i++)
+        {
+            DL_InitShard(&ctx->shards[i], i);
+        }
+
+        ctx->drawlists = ctx->shards;
+        ctx->bWorker = true;
+
+        bspJobContexts[job] = ctx;
+    }
+
+    for(i = 0; i < NUMDRAWLISTS; i++)
+    {
+        ctx->shards[i].index = 0;
+    }
+
+    ctx->nummappedlines = 0;
+    ctx->numthings = 0;
+
+    return ctx;
+}
+
+//
+// RB_BSPJob
+//
+
+static void RB_BSPJob(int job, void *data)
+{
+    bspContext_t *ctx = bspJobContexts[job];
+    bspVisSubsector_t *vis;
+    int i;
+    int j;
+
+    for(i = ctx->firstvis; i < ctx->firstvis + ctx->numvis; i++)
+    {
+        vis = &bspVisSubsectors[i];
+        ctx->currentssect = vis->ssect - subsectors;
+
+        for(j = vis->firstseg; j < vis->firstseg + vis->numsegs; j++)
+        {
+            RB_EmitLine(ctx, bspVisSegs[j].seg, bspVisSegs[j].flags);
+        }
+
+        RB_EmitSubsector(ctx, vis->ssect);
+    }
+}
+
+//
+// RB_CheckVisBuffers
+//
+
+static void RB_CheckVisBuffers(void)
+{
+    // every subsector and seg is visited at most once per frame
+    if(bspMaxVisSubsectors < numsubsectors)
+    {
+        bspMaxVisSubsectors = numsubsectors;
+        bspVisSubsectors = (bspVisSubsector_t*)realloc(bspVisSubsectors,
+                                                       bspMaxVisSubsectors * sizeof(bspVisSubsector_t));
+    }
+
+    if(bspMaxVisSegs < numsegs)
+    {
+        bspMaxVisSegs = numsegs;
+        bspVisSegs = (bspVisSeg_t*)realloc(bspVisSegs, bspMaxVisSegs * sizeof(bspVisSeg_t));
+    }
+
+    if(!bspVisSubsectors || !bspVisSegs)
+    {
+        I_Error("RB_CheckVisBuffers: failed to allocate visibility buffers");
+    }
+}
+
+//
+// RB_RenderBSP
+//
+// With gl_bsp_threads set, the occlusion walk is done first and only
+// records what is visible. The draw lists for those subsectors are then
+// built by the worker threads in contiguous chunks and appended back in
+// traversal order, so the result is the same as the single threaded path.
+//
+
+void RB_RenderBSP(void)
+{
+    bspContext_t *ctx;
+    int numjobs;
+    int i;
+    int j;
+
+    RB_MarkPVSNodes();
+
+    if(rbBSPThreads <= 0 || I_StartWorkerThreads(rbBSPThreads) <= 0)
+    {
+        RB_RenderBSPNode(numnodes-1);
+        return;
+    }
+
+    RB_CheckVisBuffers();
+
+    bspNumVisSubsectors = 0;
+    bspNumVisSegs = 0;
+
+    RB_ProfileBegin("Traverse");
+    bDeferEmit = true;
+    RB_RenderBSPNode(numnodes-1);
+    bDeferEmit = false;
+    RB_ProfileEnd();
+
+    if(bspNumVisSubsectors == 0)
+    {
+        return;
+    }
+
+    // a few jobs per thread to even out the load
+    numjobs = (I_GetNumWorkerThreads() + 1) * 4;
+
+    if(numjobs > MAX_BSP_JOBS)
+    {
+        numjobs = MAX_BSP_JOBS;
+    }
+
+    if(numjobs > bspNumVisSubsectors)
+    {
+        numjobs = bspNumVisSubsectors;
+    }
+
+    for(i = 0; i < numjobs; i++)
+    {
+        ctx = RB_GetJobContext(i);
+        ctx->firstvis = i * bspNumVisSubsectors / numjobs;
+        ctx->numvis = (i + 1) * bspNumVisSubsectors / numjobs - ctx->firstvis;
+    }
+
+    RB_ProfileBegin("Emit");
+    I_RunJobs(RB_BSPJob, NULL, numjobs);
+    RB_ProfileEnd();
+
+    RB_ProfileBegin("Merge");
+
+    // merge everything back in job order
+    for(i = 0; i < numjobs; i++)
+    {
+        ctx = bspJobContexts[i];
+
+        for(j = 0; j < NUMDRAWLISTS; j++)
+        {
+            DL_AppendDrawList(&drawlist[j], &ctx->shards[j]);
+        }
+
+        for(j = 0; j < ctx->nummappedlines; j++)
+        {
+            ctx->mappedlines[j]->flags |= ML_MAPPED;
+        }
+
+        for(j = 0; j < ctx->numthings; j++)
+        {
+            RB_AddSprite(ctx->things[j]);
+        }
     }
 
-    RB_Subsector(bspnum & ~NF_SUBSECTOR);
+    RB_ProfileEnd();
 }
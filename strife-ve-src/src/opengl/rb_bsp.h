@@ -17,5 +17,6 @@
 #define __RB_BSP_H__
 
 void RB_RenderBSPNode(int bspnum);
+void RB_RenderBSP(void);
 
 #endif
@@ -16,15 +16,284 @@
 // DESCRIPTION:
 //    World clipper: handles visibility checks
 //
+//    The angles already covered by solid walls are kept as a sorted
+//    array of disjoint ranges in a pool that is reused every frame, so
+//    a check is a binary search rather than a walk down a list. Ranges
+//    that touch are merged as they are added; a check only fails when
+//    a single range covers all of it, the same as the old linked list
+//    clipper, which is kept below for -clipbench.
+//
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "r_local.h"
 #include "tables.h"
 #include "m_fixed.h"
+#include "m_argv.h"
 #include "z_zone.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "rb_clipper.h"
 #include <math.h>
 
+#define CLIPRANGECHUNK  256
+
+typedef struct
+{
+    angle_t start;
+    angle_t end;
+} cliprange_t;
+
+static cliprange_t  *clipranges;
+static int          numclipranges;
+static int          maxclipranges;
+
+static void RB_Clipper_RecordOp(int type, angle_t start, angle_t end, boolean result);
+static void RB_Clipper_RunBenchmark(void);
+
+static boolean      bClipBench = false;
+
+//
+// RB_Clipper_FindStart
+//
+// Index of the last range starting at or before angle, -1 if none
+//
+
+static int RB_Clipper_FindStart(angle_t angle)
+{
+    int lo = 0;
+    int hi = numclipranges - 1;
+    int mid;
+
+    while(lo <= hi)
+    {
+        mid = (lo + hi) >> 1;
+
+        if(clipranges[mid].start <= angle)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+
+    return hi;
+}
+
+//
+// RB_Clipper_FindEnd
+//
+// Index of the first range ending at or after angle, numclipranges if none
+//
+
+static int RB_Clipper_FindEnd(angle_t angle)
+{
+    int lo = 0;
+    int hi = numclipranges - 1;
+    int mid;
+
+    while(lo <= hi)
+    {
+        mid = (lo + hi) >> 1;
+
+        if(clipranges[mid].end >= angle)
+        {
+            hi = mid - 1;
+        }
+        else
+        {
+            lo = mid + 1;
+        }
+    }
+
+    return lo;
+}
+
+//
+// RB_Clipper_IsRangeVisible
+//
+
+static boolean RB_Clipper_IsRangeVisible(angle_t startAngle, angle_t endAngle)
+{
+    int i;
+
+    if(numclipranges == 0)
+    {
+        return true;
+    }
+
+    if(endAngle == 0 && clipranges[0].start == 0)
+    {
+        return false;
+    }
+
+    i = RB_Clipper_FindStart(startAngle);
+
+    // a range that starts right on an empty span doesn't hide it
+    if(i >= 0 && clipranges[i].end >= endAngle && clipranges[i].start < endAngle)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+//
+// RB_Clipper_AddClipRange
+//
+
+static void RB_Clipper_AddClipRange(angle_t start, angle_t end)
+{
+    int first;
+    int last;
+
+    // everything touching the new range gets folded into it
+    first = RB_Clipper_FindEnd(start);
+    last = RB_Clipper_FindStart(end);
+
+    if(first <= last)
+    {
+        if(clipranges[first].start > start)
+        {
+            clipranges[first].start = start;
+        }
+
+        if(clipranges[last].end > end)
+        {
+            end = clipranges[last].end;
+        }
+
+        clipranges[first].end = end;
+
+        if(last > first)
+        {
+            memmove(&clipranges[first + 1], &clipranges[last + 1],
+                    (numclipranges - last - 1) * sizeof(cliprange_t));
+            numclipranges -= (last - first);
+        }
+
+        return;
+    }
+
+    if(numclipranges == maxclipranges)
+    {
+        maxclipranges += CLIPRANGECHUNK;
+        clipranges = (cliprange_t*)realloc(clipranges, maxclipranges * sizeof(cliprange_t));
+
+        if(clipranges == NULL)
+        {
+            I_Error("RB_Clipper_AddClipRange: failed to allocate clip ranges");
+        }
+    }
+
+    memmove(&clipranges[first + 1], &clipranges[first],
+            (numclipranges - first) * sizeof(cliprange_t));
+
+    clipranges[first].start = start;
+    clipranges[first].end = end;
+    numclipranges++;
+}
+
+//
+// RB_Clipper_SafeCheckRange
+//
+
+boolean RB_Clipper_SafeCheckRange(angle_t startAngle, angle_t endAngle)
+{
+    boolean result;
+
+    if(startAngle > endAngle)
+    {
+        result = (RB_Clipper_IsRangeVisible(startAngle, ANG_MAX) ||
+                  RB_Clipper_IsRangeVisible(0, endAngle));
+    }
+    else
+    {
+        result = RB_Clipper_IsRangeVisible(startAngle, endAngle);
+    }
+
+    if(bClipBench)
+    {
+        RB_Clipper_RecordOp(0, startAngle, endAngle, result);
+    }
+
+    return result;
+}
+
+//
+// RB_Clipper_SafeAddClipRange
+//
+
+void RB_Clipper_SafeAddClipRange(angle_t startangle, angle_t endangle)
+{
+    if(bClipBench)
+    {
+        RB_Clipper_RecordOp(1, startangle, endangle, false);
+    }
+
+    if(startangle > endangle)
+    {
+        // The range has to added in two parts.
+        RB_Clipper_AddClipRange(startangle, ANG_MAX);
+        RB_Clipper_AddClipRange(0, endangle);
+    }
+    else
+    {
+        // Add the range as usual.
+        RB_Clipper_AddClipRange(startangle, endangle);
+    }
+}
+
+//
+// RB_Clipper_Clear
+//
+
+void RB_Clipper_Clear(void)
+{
+    if(bClipBench)
+    {
+        RB_Clipper_RunBenchmark();
+    }
+
+    numclipranges = 0;
+}
+
+//
+// RB_Clipper_Init
+//
+
+void RB_Clipper_Init(void)
+{
+    //!
+    // @category video
+    //
+    // Replay each frame's clipper queries against the old linked list
+    // clipper, compare the results and print how long both took.
+    //
+
+    bClipBench = M_CheckParm("-clipbench") > 0;
+
+    if(clipranges == NULL)
+    {
+        maxclipranges = CLIPRANGECHUNK;
+        clipranges = (cliprange_t*)malloc(maxclipranges * sizeof(cliprange_t));
+
+        if(clipranges == NULL)
+        {
+            I_Error("RB_Clipper_Init: failed to allocate clip ranges");
+        }
+    }
+}
+
+//=============================================================================
+//
+// Linked list clipper, for comparison against the above
+//
+//=============================================================================
+
 typedef struct clipnode_s
 {
     struct clipnode_s *prev, *next;
@@ -32,14 +301,15 @@ typedef struct clipnode_s
 } clipnode_t;
 
 
-clipnode_t *freelist    = NULL;
-clipnode_t *clipnodes   = NULL;
-clipnode_t *cliphead    = NULL;
+static clipnode_t *freelist    = NULL;
+static clipnode_t *cliphead    = NULL;
 
 static clipnode_t * RB_Clipnode_NewRange(angle_t start, angle_t end);
-static boolean RB_Clipper_IsRangeVisible(angle_t startAngle, angle_t endAngle);
-static void RB_Clipper_AddClipRange(angle_t start, angle_t end);
-static void RB_Clipper_RemoveRange(clipnode_t * range);
+static boolean RB_ListClipper_SafeCheckRange(angle_t startAngle, angle_t endAngle);
+static void RB_ListClipper_SafeAddClipRange(angle_t startangle, angle_t endangle);
+static boolean RB_ListClipper_IsRangeVisible(angle_t startAngle, angle_t endAngle);
+static void RB_ListClipper_AddClipRange(angle_t start, angle_t end);
+static void RB_ListClipper_RemoveRange(clipnode_t * range);
 static void RB_Clipnode_Free(clipnode_t *node);
 
 static clipnode_t *RB_Clipnode_GetNew(void)
@@ -64,19 +334,19 @@ static clipnode_t * RB_Clipnode_NewRange(angle_t start, angle_t end)
 }
 
 //
-// RB_Clipper_SafeCheckRange
+// RB_ListClipper_SafeCheckRange
 //
 
-boolean RB_Clipper_SafeCheckRange(angle_t startAngle, angle_t endAngle)
+static boolean RB_ListClipper_SafeCheckRange(angle_t startAngle, angle_t endAngle)
 {
     if(startAngle > endAngle)
-        return (RB_Clipper_IsRangeVisible(startAngle, ANG_MAX) ||
-                RB_Clipper_IsRangeVisible(0, endAngle));
+        return (RB_ListClipper_IsRangeVisible(startAngle, ANG_MAX) ||
+                RB_ListClipper_IsRangeVisible(0, endAngle));
 
-    return RB_Clipper_IsRangeVisible(startAngle, endAngle);
+    return RB_ListClipper_IsRangeVisible(startAngle, endAngle);
 }
 
-static boolean RB_Clipper_IsRangeVisible(angle_t startAngle, angle_t endAngle)
+static boolean RB_ListClipper_IsRangeVisible(angle_t startAngle, angle_t endAngle)
 {
     clipnode_t *ci;
     ci = cliphead;
@@ -105,7 +375,7 @@ static void RB_Clipnode_Free(clipnode_t *node)
     freelist = node;
 }
 
-static void RB_Clipper_RemoveRange(clipnode_t *range)
+static void RB_ListClipper_RemoveRange(clipnode_t *range)
 {
     if(range == cliphead)
     {
@@ -127,25 +397,25 @@ static void RB_Clipper_RemoveRange(clipnode_t *range)
 }
 
 //
-// RB_Clipper_SafeAddClipRange
+// RB_ListClipper_SafeAddClipRange
 //
 
-void RB_Clipper_SafeAddClipRange(angle_t startangle, angle_t endangle)
+static void RB_ListClipper_SafeAddClipRange(angle_t startangle, angle_t endangle)
 {
     if(startangle > endangle)
     {
         // The range has to added in two parts.
-        RB_Clipper_AddClipRange(startangle, ANG_MAX);
-        RB_Clipper_AddClipRange(0, endangle);
+        RB_ListClipper_AddClipRange(startangle, ANG_MAX);
+        RB_ListClipper_AddClipRange(0, endangle);
     }
     else
     {
         // Add the range as usual.
-        RB_Clipper_AddClipRange(startangle, endangle);
+        RB_ListClipper_AddClipRange(startangle, endangle);
     }
 }
 
-static void RB_Clipper_AddClipRange(angle_t start, angle_t end)
+static void RB_ListClipper_AddClipRange(angle_t start, angle_t end)
 {
     clipnode_t *node, *temp, *prevNode;
     if(cliphead)
@@ -158,7 +428,7 @@ static void RB_Clipper_AddClipRange(angle_t start, angle_t end)
             {
                 temp = node;
                 node = node->next;
-                RB_Clipper_RemoveRange(temp);
+                RB_ListClipper_RemoveRange(temp);
             }
             else
             {
@@ -187,7 +457,7 @@ static void RB_Clipper_AddClipRange(angle_t start, angle_t end)
                 if(node->next && node->next->start <= end)
                 {
                     node->end = node->next->end;
-                    RB_Clipper_RemoveRange(node->next);
+                    RB_ListClipper_RemoveRange(node->next);
                 }
                 else
                 {
@@ -251,10 +521,10 @@ static void RB_Clipper_AddClipRange(angle_t start, angle_t end)
 }
 
 //
-// RB_Clipper_Clear
+// RB_ListClipper_Clear
 //
 
-void RB_Clipper_Clear(void)
+static void RB_ListClipper_Clear(void)
 {
     clipnode_t *node = cliphead;
     clipnode_t *temp;
@@ -268,3 +538,145 @@ void RB_Clipper_Clear(void)
 
     cliphead = NULL;
 }
+
+//=============================================================================
+//
+// Benchmark
+//
+//=============================================================================
+
+#define CLIPBENCH_PASSES    16
+#define CLIPBENCH_FRAMES    175
+
+typedef struct
+{
+    byte    type;       // 0 = check, 1 = add
+    boolean result;
+    angle_t start;
+    angle_t end;
+} clipop_t;
+
+static clipop_t     *clipops;
+static int          numclipops;
+static int          maxclipops;
+
+static uint64_t     benchListTime;
+static uint64_t     benchPoolTime;
+static int          benchFrames;
+static int          benchOps;
+static int          benchMismatches;
+
+//
+// RB_Clipper_RecordOp
+//
+
+static void RB_Clipper_RecordOp(int type, angle_t start, angle_t end, boolean result)
+{
+    if(numclipops == maxclipops)
+    {
+        maxclipops += 1024;
+        clipops = (clipop_t*)realloc(clipops, maxclipops * sizeof(clipop_t));
+
+        if(clipops == NULL)
+        {
+            I_Error("RB_Clipper_RecordOp: failed to allocate clipper ops");
+        }
+    }
+
+    clipops[numclipops].type = type;
+    clipops[numclipops].result = result;
+    clipops[numclipops].start = start;
+    clipops[numclipops].end = end;
+    numclipops++;
+}
+
+//
+// RB_Clipper_RunBenchmark
+//
+// Replays the frame that was just rendered through both clippers.
+// The recorded results came from the pool clipper, so they are what
+// the list clipper has to match.
+//
+
+static void RB_Clipper_RunBenchmark(void)
+{
+    uint64_t start;
+    clipop_t *op;
+    boolean result;
+    int pass;
+    int i;
+
+    if(numclipops == 0)
+    {
+        return;
+    }
+
+    // don't record the replays themselves
+    bClipBench = false;
+
+    start = I_GetTimeUS();
+
+    for(pass = 0; pass < CLIPBENCH_PASSES; pass++)
+    {
+        RB_ListClipper_Clear();
+
+        for(i = 0, op = clipops; i < numclipops; i++, op++)
+        {
+            if(op->type == 1)
+            {
+                RB_ListClipper_SafeAddClipRange(op->start, op->end);
+            }
+            else
+            {
+                result = RB_ListClipper_SafeCheckRange(op->start, op->end);
+
+                if(pass == 0 && result != op->result)
+                {
+                    benchMismatches++;
+                }
+            }
+        }
+    }
+
+    RB_ListClipper_Clear();
+    benchListTime += I_GetTimeUS() - start;
+
+    start = I_GetTimeUS();
+
+    for(pass = 0; pass < CLIPBENCH_PASSES; pass++)
+    {
+        numclipranges = 0;
+
+        for(i = 0, op = clipops; i < numclipops; i++, op++)
+        {
+            if(op->type == 1)
+            {
+                RB_Clipper_SafeAddClipRange(op->start, op->end);
+            }
+            else
+            {
+                RB_Clipper_SafeCheckRange(op->start, op->end);
+            }
+        }
+    }
+
+    benchPoolTime += I_GetTimeUS() - start;
+
+    bClipBench = true;
+    benchOps += numclipops;
+    numclipops = 0;
+
+    if(++benchFrames < CLIPBENCH_FRAMES)
+    {
+        return;
+    }
+
+    fprintf(stdout, "RB_Clipper: %i frames, %i ops/frame, list %.2f us, pool %.2f us, %i mismatches\n",
+            benchFrames, benchOps / benchFrames,
+            (double)benchListTime / (benchFrames * CLIPBENCH_PASSES),
+            (double)benchPoolTime / (benchFrames * CLIPBENCH_PASSES),
+            benchMismatches);
+
+    benchListTime = benchPoolTime = 0;
+    benchFrames = benchOps = benchMismatches = 0;
+}
@@ -20,5 +20,6 @@
 boolean     RB_Clipper_SafeCheckRange(angle_t startAngle, angle_t endAngle);
 void        RB_Clipper_SafeAddClipRange(angle_t startangle, angle_t endangle);
 void        RB_Clipper_Clear(void);
+void        RB_Clipper_Init(void);
 
 #endif
\ No newline at end of file
@@ -29,6 +29,7 @@ boolean rbLightmaps = true;
 boolean rbLightmapsDefault = true;
 boolean rbDynamicLights = true;
 boolean rbDynamicLightFastBlend = false;
+boolean rbDynamicLightShader = true;
 boolean rbForceSync = false;
 boolean rbCrosshair = false;
 #if defined(SVE_PLAT_SWITCH)
@@ -51,6 +52,26 @@ boolean rbEnableFXAA = true;
 // bloom
 boolean rbEnableBloom = true;
 float   rbBloomThreshold = 0.5f;
+int     rbBloomDownsample = 1;      // bloom is blurred at 1/(2^n) of the screen size
+
+// static geometry
+boolean rbStaticGeometry = true;
+
+// sprite atlas
+boolean rbTextureAtlas = true;
+
+// instanced sprites and decals
+boolean rbInstancing = true;
+
+// background texture decoding
+int     rbTextureDecodeThreads = 1;
+int     rbTextureUploadBudget = 2000;
+
+// threaded bsp traversal
+int     rbBSPThreads = 0;
+
+// build a pvs for maps that don't have one
+boolean rbGeneratePVS = true;
 
 //
 // RB_BindVariables
@@ -67,6 +88,7 @@ void RB_BindVariables(void)
     M_BindVariableWithDefault("gl_lightmaps", &rbLightmaps, &rbLightmapsDefault);
     M_BindVariable("gl_dynamic_lights", &rbDynamicLights);
     M_BindVariable("gl_dynamic_light_fast_blend", &rbDynamicLightFastBlend);
+    M_BindVariable("gl_dynamic_light_shader", &rbDynamicLightShader);
     M_BindVariable("gl_force_sync", &rbForceSync);
     M_BindVariable("gl_show_crosshair", &rbCrosshair);
     M_BindVariable("gl_enable_vsync", &rbVsync);
@@ -79,4 +101,12 @@ void RB_BindVariables(void)
     M_BindVariable("gl_enable_fxaa", &rbEnableFXAA);
     M_BindVariable("gl_enable_bloom", &rbEnableBloom);
     M_BindVariable("gl_bloom_threshold", &rbBloomThreshold);
+    M_BindVariable("gl_bloom_downsample", &rbBloomDownsample);
+    M_BindVariable("gl_static_geometry", &rbStaticGeometry);
+    M_BindVariable("gl_texture_atlas", &rbTextureAtlas);
+    M_BindVariable("gl_instancing", &rbInstancing);
+    M_BindVariable("gl_texture_decode_threads", &rbTextureDecodeThreads);
+    M_BindVariable("gl_texture_upload_budget", &rbTextureUploadBudget);
+    M_BindVariable("gl_bsp_threads", &rbBSPThreads);
+    M_BindVariable("gl_generate_pvs", &rbGeneratePVS);
 }
@@ -27,6 +27,7 @@ extern boolean  rbLightmaps;
 extern boolean  rbLightmapsDefault;
 extern boolean  rbDynamicLights;
 extern boolean  rbDynamicLightFastBlend;
+extern boolean  rbDynamicLightShader;
 extern boolean  rbForceSync;
 extern boolean  rbCrosshair;
 extern boolean  rbVsync;
@@ -39,6 +40,14 @@ extern int      rbMotionBlurSamples;
 extern boolean  rbEnableFXAA;
 extern boolean  rbEnableBloom;
 extern float    rbBloomThreshold;
+extern int      rbBloomDownsample;
+extern boolean  rbStaticGeometry;
+extern boolean  rbTextureAtlas;
+extern boolean  rbInstancing;
+extern int      rbTextureDecodeThreads;
+extern int      rbTextureUploadBudget;
+extern int      rbBSPThreads;
+extern boolean  rbGeneratePVS;
 
 void RB_BindVariables(void);
 
@@ -52,6 +61,7 @@ void RB_BindVariables(void);
     CONFIG_VARIABLE_INT(gl_lightmaps),                  \
     CONFIG_VARIABLE_INT(gl_dynamic_lights),             \
     CONFIG_VARIABLE_INT(gl_dynamic_light_fast_blend),   \
+    CONFIG_VARIABLE_INT(gl_dynamic_light_shader),       \
     CONFIG_VARIABLE_INT(gl_force_sync),                 \
     CONFIG_VARIABLE_INT(gl_show_crosshair),             \
     CONFIG_VARIABLE_INT(gl_enable_vsync),               \
@@ -63,6 +73,14 @@ void RB_BindVariables(void);
     CONFIG_VARIABLE_INT(gl_motion_blur_samples),        \
     CONFIG_VARIABLE_INT(gl_enable_fxaa),                \
     CONFIG_VARIABLE_INT(gl_enable_bloom),               \
-    CONFIG_VARIABLE_FLOAT(gl_bloom_threshold),
+    CONFIG_VARIABLE_FLOAT(gl_bloom_threshold),          \
+    CONFIG_VARIABLE_INT(gl_bloom_downsample),           \
+    CONFIG_VARIABLE_INT(gl_static_geometry),            \
+    CONFIG_VARIABLE_INT(gl_texture_atlas),              \
+    CONFIG_VARIABLE_INT(gl_instancing),                 \
+    CONFIG_VARIABLE_INT(gl_texture_decode_threads),     \
+    CONFIG_VARIABLE_INT(gl_texture_upload_budget),      \
+    CONFIG_VARIABLE_INT(gl_bsp_threads),                \
+    CONFIG_VARIABLE_INT(gl_generate_pvs),
 
 #endif
@@ -29,6 +29,9 @@
 #include "deh_str.h"
 #include "i_swap.h"
 #include "p_local.h"
+#include "i_system.h"
+#include "rb_config.h"
+#include "i_timer.h"
 
 rbTexture_t *lightmapTextures;
 int lightmapCount;
@@ -39,8 +42,19 @@ typedef struct
     rbTexture_t     brightmap;
     rbTexture_t     outline;
     unsigned int    flags;
+    int             atlasNum;       // atlas page + 1, 0 if not packed
+    atlas_t         atlasRect;
+    boolean         bDecoding;      // waiting on a background decoder
+    boolean         bDecodePriority;
 } rbTextureData_t;
 
+typedef struct
+{
+    byte            *data;
+    byte            *brightdata;
+    unsigned int    flags;
+} rbPatchPixels_t;
+
 static rbTextureData_t  *colTextures;
 static rbTextureData_t  *flatTextures;
 static rbTextureData_t  *spriteTextures[8];
@@ -49,6 +63,10 @@ static rbTextureData_t  *patchTextures;
 static int playpallump;
 static boolean bInitialized = false;
 
+static void RB_DeleteSpriteAtlas(void);
+static void RB_InitTextureDecoding(void);
+static rbTexture_t placeholderTexture;
+
 extern SDL_Window *windowscreen;
 
 //
@@ -124,6 +142,7 @@ void RB_InitData(void)
     playpallump = W_GetNumForName(DEH_String("PLAYPAL"));
     bInitialized = true;
 
+    RB_InitTextureDecoding();
     RB_InitDecals();
     RB_HudTextInit();
     RB_InitExtraHudTextures();
@@ -159,6 +178,9 @@ void RB_DeleteDoomData(void)
 {
     int i;
 
+    // nothing may still be on its way in
+    RB_FlushTextureDecodes();
+
     for(i = 0; i < numtextures; ++i)
     {
         RB_DeleteTextureData(&colTextures[texturetranslation[i]]);
@@ -179,6 +201,7 @@ void RB_DeleteDoomData(void)
         }
     }
 
+    RB_DeleteSpriteAtlas();
     RB_DeleteExtraHudTextures();
     RB_DeleteSkyTextures();
 }
@@ -204,86 +227,10 @@ void RB_DeleteData(void)
         }
     }
 
+    RB_DeleteTexture(&placeholderTexture);
     RB_FreeLightmapTextures();
 }
 
-//
-// RB_CreateBrightMap1
-//
-
-void RB_CreateBrightMap1(rbTextureData_t *texdata, byte *data, byte *paldata,
-                         patch_t *patch, const int translation)
-{
-    int w;
-    int h;
-    rbTexture_t *brightmap;
-    rbTexture_t *texture;
-    column_t *column;
-    byte *colData;
-    byte  rgb[256][3];
-    byte  rgbf[32];
-
-    memset(rgbf, 0, sizeof(rgbf));
-
-    brightmap = &texdata->brightmap;
-
-    if(brightmap->texid != 0)
-    {
-        return;
-    }
-
-    texdata->flags |= TDF_BRIGHTMAP;
-
-    texture = &texdata->texture;
-
-    memcpy(brightmap, texture, sizeof(rbTexture_t));
-    brightmap->texid = 0;
-
-    for(w = 0; w < texture->origwidth; ++w)
-    {
-        column = (column_t*)((byte*)patch + LONG(patch->columnofs[w]));
-        while(column->topdelta != 0xff)
-        {
-            colData = (byte*)column + 3;
-
-            for(h = 0; h < column->length; ++h)
-            {
-                int ch;
-                byte p = colData[h];
-                int bytenum = p >> 3;
-                int bitnum  = 1 << (p & 7);
-
-                if(!(rgbf[bytenum] & bitnum))
-                {
-                    RB_GetPaletteRGB(rgb[p], paldata, p, translation);
-                    rgbf[bytenum] |= bitnum;
-                }
-
-                ch = column->topdelta + h;
-
-                if(p < 224)
-                {
-                    data[((texture->width * ch) + w) * 4 + 0] = 0;
-                    data[((texture->width * ch) + w) * 4 + 1] = 0;
-                    data[((texture->width * ch) + w) * 4 + 2] = 0;
-                    data[((texture->width * ch) + w) * 4 + 3] = 0;
-                }
-                else
-                {
-                    data[((texture->width * ch) + w) * 4 + 0] = rgb[p][0];
-                    data[((texture->width * ch) + w) * 4 + 1] = rgb[p][1];
-                    data[((texture->width * ch) + w) * 4 + 2] = rgb[p][2];
-                    data[((texture->width * ch) + w) * 4 + 3] = 0xff;
-                }
-            }
-
-            column = (column_t*)((byte*)column + column->length + 4);
-        }
-    }
-
-    RB_UploadTexture(brightmap, data, TC_REPEAT, TF_NEAREST);
-}
-
 //
 // RB_CreateBrightMap2
 //
@@ -410,39 +357,46 @@ void RB_ReadTextureData(rbTextureData_t *texdata, texture_t *texture, byte *pald
 }
 
 //
-// RB_ReadPatchData
-// Width and height for rbTexture should already be set
+// RB_DecodePatch
+//
+// Converts a patch to RGBA along with its brightmap, if it has one.
+// Doesn't touch the zone or GL, so the background decoders use it too
 //
 
-void RB_ReadPatchData(rbTextureData_t *texdata, byte *paldata, patch_t *patch,
-                      const int translation, const int index, rbDataType_t type)
+static void RB_DecodePatch(rbPatchPixels_t *pixels, patch_t *patch, byte *paldata,
+                           const int width, const int height,
+                           const int origwidth, const int origheight,
+                           const int translation, boolean outline)
 {
     int w;
     int h;
+    int offset;
     byte bMakeBrightmap;
-    rbTexture_t *rbTexture;
     column_t *column;
-    byte *data;
     byte *colData;
     byte rgb[256][3];
     byte rgbf[32];
 
     memset(rgbf, 0, sizeof(rgbf));
 
-    rbTexture = (type == RDT_SPRITEOUTLINE) ? &texdata->outline : &texdata->texture;
+    pixels->data = (byte*)calloc(1, (width * height) * 4);
+    pixels->brightdata = NULL;
+    pixels->flags = 0;
 
-    data = (byte*)malloc((rbTexture->width * rbTexture->height) * 4);
-    memset(data, 0, (rbTexture->width * rbTexture->height) * 4);
+    if(pixels->data == NULL)
+    {
+        I_Error("RB_DecodePatch: failed to allocate %ix%i texture", width, height);
+    }
 
     bMakeBrightmap = 0;
 
-    for(w = 0; w < rbTexture->origwidth; ++w)
+    for(w = 0; w < origwidth; ++w)
     {
         column = (column_t*)((byte*)patch + LONG(patch->columnofs[w]));
 
-        if(column->length != rbTexture->origheight)
+        if(column->length != origheight)
         {
-            texdata->flags |= TDF_MASKED;
+            pixels->flags |= TDF_MASKED;
         }
 
         while(column->topdelta != 0xff)
@@ -451,12 +405,11 @@ void RB_ReadPatchData(rbTextureData_t *texdata, byte *paldata, patch_t *patch,
 
             for(h = 0; h < column->length; ++h)
             {
-                int ch;
                 byte p = colData[h];
                 int bytenum = p >> 3;
                 int bitnum  = 1 << (p & 7);
 
-                if(type == RDT_SPRITEOUTLINE)
+                if(outline)
                 {
                     rgb[p][0] = rgb[p][1] = rgb[p][2] = 0xff;
                 }
@@ -469,28 +422,108 @@ void RB_ReadPatchData(rbTextureData_t *texdata, byte *paldata, patch_t *patch,
                     }
                 }
 
-                ch = column->topdelta + h;
+                offset = ((width * (column->topdelta + h)) + w) * 4;
+
+                pixels->data[offset + 0] = rgb[p][0];
+                pixels->data[offset + 1] = rgb[p][1];
+                pixels->data[offset + 2] = rgb[p][2];
+                pixels->data[offset + 3] = 0xff;
+
+                // only the fullbright end of the untranslated palette
+                // ends up in the brightmap
+                if(!outline && p >= 224)
+                {
+                    if(pixels->brightdata == NULL)
+                    {
+                        pixels->brightdata = (byte*)calloc(1, (width * height) * 4);
+
+                        if(pixels->brightdata == NULL)
+                        {
+                            I_Error("RB_DecodePatch: failed to allocate %ix%i brightmap", width, height);
+                        }
+                    }
 
-                data[((rbTexture->width * ch) + w) * 4 + 0] = rgb[p][0];
-                data[((rbTexture->width * ch) + w) * 4 + 1] = rgb[p][1];
-                data[((rbTexture->width * ch) + w) * 4 + 2] = rgb[p][2];
-                data[((rbTexture->width * ch) + w) * 4 + 3] = 0xff;
+                    pixels->brightdata[offset + 0] = rgb[p][0];
+                    pixels->brightdata[offset + 1] = rgb[p][1];
+                    pixels->brightdata[offset + 2] = rgb[p][2];
+                    pixels->brightdata[offset + 3] = 0xff;
+                }
             }
 
             column = (column_t*)((byte*)column + column->length + 4);
         }
     }
 
+    // whether a brightmap exists is decided on the translated colors
+    if(bMakeBrightmap && pixels->brightdata == NULL)
+    {
+        pixels->brightdata = (byte*)calloc(1, (width * height) * 4);
+    }
+    else if(!bMakeBrightmap && pixels->brightdata != NULL)
+    {
+        free(pixels->brightdata);
+        pixels->brightdata = NULL;
+    }
+
+    if(pixels->brightdata)
+    {
+        pixels->flags |= TDF_BRIGHTMAP;
+    }
+}
+
+//
+// RB_UploadPatchPixels
+//
+
+static void RB_UploadPatchPixels(rbTextureData_t *texdata, rbTexture_t *rbTexture, rbPatchPixels_t *pixels)
+{
+    rbTexture_t *brightmap;
+
+    texdata->flags |= (pixels->flags & TDF_MASKED);
+
     rbTexture->colorMode = TCR_RGBA;
+    RB_UploadTexture(rbTexture, pixels->data, TC_REPEAT, TF_NEAREST);
 
-    RB_UploadTexture(rbTexture, data, TC_REPEAT, TF_NEAREST);
+    brightmap = &texdata->brightmap;
 
-    if(bMakeBrightmap)
+    if(pixels->brightdata && brightmap->texid == 0)
+    {
+        texdata->flags |= TDF_BRIGHTMAP;
+
+        memcpy(brightmap, rbTexture, sizeof(rbTexture_t));
+        brightmap->texid = 0;
+
+        RB_UploadTexture(brightmap, pixels->brightdata, TC_REPEAT, TF_NEAREST);
+    }
+
+    free(pixels->data);
+    pixels->data = NULL;
+
+    if(pixels->brightdata)
     {
-        RB_CreateBrightMap1(texdata, data, paldata, patch, translation);
+        free(pixels->brightdata);
+        pixels->brightdata = NULL;
     }
+}
 
-    free(data);
+//
+// RB_ReadPatchData
+// Width and height for rbTexture should already be set
+//
+
+void RB_ReadPatchData(rbTextureData_t *texdata, byte *paldata, patch_t *patch,
+                      const int translation, const int index, rbDataType_t type)
+{
+    rbTexture_t *rbTexture;
+    rbPatchPixels_t pixels;
+
+    rbTexture = (type == RDT_SPRITEOUTLINE) ? &texdata->outline : &texdata->texture;
+
+    RB_DecodePatch(&pixels, patch, paldata, rbTexture->width, rbTexture->height,
+                   rbTexture->origwidth, rbTexture->origheight,
+                   translation, type == RDT_SPRITEOUTLINE);
+
+    RB_UploadPatchPixels(texdata, rbTexture, &pixels);
 }
 
 //
@@ -521,6 +554,9 @@ rbTextureData_t *RB_CreateColTexture(const int index)
     }
 
     texture = textures[idx];
+
+    // paldata has to survive the patches cached while reading the texture
+    Z_LockCache();
     paldata = (byte*)W_CacheLumpNum(playpallump, PU_CACHE);
 
     rbTexture->origwidth = texture->width;
@@ -544,6 +580,7 @@ rbTextureData_t *RB_CreateColTexture(const int index)
         RB_ReadPatchData(texdata, paldata, patch, 0, index, RDT_COLUMN);
     }
 
+    Z_UnlockCache();
     return texdata;
 }
 
@@ -580,6 +617,7 @@ rbTextureData_t *RB_CreateFlatTexture(const int index)
         return texdata;
     }
 
+    Z_LockCache();
     paldata = (byte*)W_CacheLumpNum(playpallump, PU_CACHE);
     size = lumpinfo[firstflat + idx].size;
 
@@ -653,246 +691,1225 @@ rbTextureData_t *RB_CreateFlatTexture(const int index)
     }
 
     free(data);
+    Z_UnlockCache();
 
     return texdata;
 }
 
+//=============================================================================
 //
-// RB_CreateSpriteTexture
+// Background decoding
 //
+// Sprites that aren't cached yet used to be decoded on the spot, which hitched
+// whenever something new came into view and stalled the level precache. With
+// gl_texture_decode_threads set, the lump is copied and handed to a decoder
+// thread instead and a transparent placeholder is drawn until it's ready.
+// Finished textures wait in a bounded upload queue that
+// RB_ProcessTextureUploads drains on the GL thread each frame, within
+// gl_texture_upload_budget microseconds. Sprites that are being drawn right
+// now skip ahead of ones that are only being precached. Only sprites that
+// must never show the placeholder, like the player's weapon, are decoded
+// on the spot (RB_FinishDecode).
+//
+//=============================================================================
+
+#define DECODE_MAXJOBS      1024
+#define DECODE_MAXTHREADS   4
+#define UPLOAD_MAXQUEUE     64
 
-rbTextureData_t *RB_CreateSpriteTexture(const int index, const int translation, boolean outline)
+typedef struct
 {
     rbTextureData_t *texdata;
-    rbTexture_t     *rbTexture;
-    byte            *paldata;
-    patch_t         *patch;
+    patch_t         *patch;         // private copy of the lump
+    int             translation;
+    rbPatchPixels_t pixels;
+} rbDecodeJob_t;
+
+static rbDecodeJob_t    decodeJobs[DECODE_MAXJOBS];
+static rbDecodeJob_t    *freeJobs[DECODE_MAXJOBS];
+static int              numFreeJobs;
+
+// everything below is guarded by decodeMutex
+static rbDecodeJob_t    *decodeQueue[DECODE_MAXJOBS];
+static int              numDecodeQueue;
+static rbDecodeJob_t    *uploadQueue[UPLOAD_MAXQUEUE];
+static int              numUploadQueue;
+static int              numDecoding;
+static boolean          quitDecoders;
+
+static SDL_mutex        *decodeMutex;
+static SDL_cond         *decodeCond;    // work or upload room available
+static SDL_cond         *uploadCond;    // something finished decoding
+static SDL_Thread       *decodeThreads[DECODE_MAXTHREADS];
+static int              numDecodeThreads = 0;
+
+static byte             decodePalette[768];
+
+typedef enum
+{
+    DP_PRECACHE,        // queue behind everything else
+    DP_VISIBLE,         // on screen; queue first and draw the placeholder
+    DP_IMMEDIATE        // decode and upload before returning
+} decodePriority_t;
 
-    if(index < 0 || !bInitialized)
-    {
-        // blank texture?
-        return NULL;
-    }
+//
+// RB_DecodeThread
+//
 
-    texdata = &spriteTextures[translation][index];
-    rbTexture = outline ? &texdata->outline : &texdata->texture;
+static int RB_DecodeThread(void *unused)
+{
+    rbDecodeJob_t *job;
+    rbTexture_t *rbTexture;
+    int i;
+    int pick;
 
-    if(rbTexture->texid != 0)
+    SDL_LockMutex(decodeMutex);
+
+    while(!quitDecoders)
     {
-        return texdata;
+        // don't let decoded textures pile up faster than they're uploaded
+        if(numDecodeQueue == 0 || numUploadQueue + numDecoding >= UPLOAD_MAXQUEUE)
+        {
+            SDL_CondWait(decodeCond, decodeMutex);
+            continue;
+        }
+
+        // anything that is on screen right now goes first
+        pick = 0;
+
+        for(i = 0; i < numDecodeQueue; ++i)
+        {
+            if(decodeQueue[i]->texdata->bDecodePriority)
+            {
+                pick = i;
+                break;
+            }
+        }
+
+        job = decodeQueue[pick];
+        memmove(&decodeQueue[pick], &decodeQueue[pick+1], (numDecodeQueue - pick - 1) * sizeof(rbDecodeJob_t*));
+        numDecodeQueue--;
+        numDecoding++;
+
+        SDL_UnlockMutex(decodeMutex);
+
+        rbTexture = &job->texdata->texture;
+        RB_DecodePatch(&job->pixels, job->patch, decodePalette,
+                       rbTexture->width, rbTexture->height,
+                       rbTexture->origwidth, rbTexture->origheight,
+                       job->translation, false);
+
+        SDL_LockMutex(decodeMutex);
+
+        numDecoding--;
+        uploadQueue[numUploadQueue++] = job;
+        SDL_CondBroadcast(uploadCond);
     }
 
-    paldata = (byte*)W_CacheLumpNum(playpallump, PU_CACHE);
-    patch = (patch_t*)W_CacheLumpNum(firstspritelump + index, PU_CACHE);
+    SDL_UnlockMutex(decodeMutex);
+    return 0;
+}
 
-    rbTexture->colorMode = TCR_RGBA;
-    rbTexture->origwidth = SHORT(patch->width);
-    rbTexture->origheight = SHORT(patch->height);
+//
+// RB_ShutdownDecodeThreads
+//
 
-    rbTexture->width = RB_RoundPowerOfTwo(rbTexture->origwidth);
-    rbTexture->height = RB_RoundPowerOfTwo(rbTexture->origheight);
+static void RB_ShutdownDecodeThreads(void)
+{
+    int i;
 
-    RB_ReadPatchData(texdata, paldata, patch, translation, index,
-        outline ? RDT_SPRITEOUTLINE : RDT_SPRITE);
-    return texdata;
+    SDL_LockMutex(decodeMutex);
+    quitDecoders = true;
+    SDL_CondBroadcast(decodeCond);
+    SDL_UnlockMutex(decodeMutex);
+
+    for(i = 0; i < numDecodeThreads; ++i)
+    {
+        SDL_WaitThread(decodeThreads[i], NULL);
+    }
+
+    numDecodeThreads = 0;
 }
 
 //
-// RB_CreatePatchTexture
+// RB_StartDecodeThreads
 //
 
-rbTextureData_t *RB_CreatePatchTexture(const int index)
+static void RB_StartDecodeThreads(void)
 {
-    rbTextureData_t *texdata;
-    rbTexture_t     *rbTexture;
-    byte            *paldata;
-    patch_t         *patch;
+    int count = MIN(rbTextureDecodeThreads, DECODE_MAXTHREADS);
+    int i;
 
-    if(index == 0 || !bInitialized)
+    if(numDecodeThreads > 0 || count <= 0)
     {
-        // blank texture?
-        return NULL;
+        return;
     }
 
-    texdata = &patchTextures[index];
-    rbTexture = &texdata->texture;
+    decodeMutex = SDL_CreateMutex();
+    decodeCond = SDL_CreateCond();
+    uploadCond = SDL_CreateCond();
 
-    if(rbTexture->texid != 0)
+    if(!decodeMutex || !decodeCond || !uploadCond)
     {
-        return texdata;
+        fprintf(stderr, "RB_StartDecodeThreads: %s\n", SDL_GetError());
+        return;
     }
 
-    paldata = (byte*)W_CacheLumpNum(playpallump, PU_CACHE);
-    patch = (patch_t*)W_CacheLumpNum(index, PU_CACHE);
+    for(i = 0; i < DECODE_MAXJOBS; ++i)
+    {
+        freeJobs[i] = &decodeJobs[i];
+    }
 
-    rbTexture->colorMode = TCR_RGBA;
-    rbTexture->origwidth = SHORT(patch->width);
-    rbTexture->origheight = SHORT(patch->height);
+    numFreeJobs = DECODE_MAXJOBS;
 
-    rbTexture->width = RB_RoundPowerOfTwo(rbTexture->origwidth);
-    rbTexture->height = RB_RoundPowerOfTwo(rbTexture->origheight);
+    for(i = 0; i < count; ++i)
+    {
+        decodeThreads[numDecodeThreads] = SDL_CreateThread(RB_DecodeThread, "RB_DecodeThread", NULL);
 
-    RB_ReadPatchData(texdata, paldata, patch, 0, index, RDT_PATCH);
-    return texdata;
+        if(!decodeThreads[numDecodeThreads])
+        {
+            fprintf(stderr, "RB_StartDecodeThreads: %s\n", SDL_GetError());
+            break;
+        }
+
+        numDecodeThreads++;
+    }
+
+    if(numDecodeThreads > 0)
+    {
+        I_AtExit(RB_ShutdownDecodeThreads, true);
+    }
 }
 
 //
-// RB_GetTextureFlags
+// RB_QueueDecode
+//
+// Returns false if the texture has to be decoded right away instead
 //
 
-unsigned int RB_GetTextureFlags(const rbDataType_t type, const int index, const int translation)
+static boolean RB_QueueDecode(rbTextureData_t *texdata, patch_t *patch, int lump,
+                              const int translation, boolean bPriority)
 {
-    switch(type)
-    {
-    case RDT_COLUMN:
-        return colTextures[texturetranslation[index]].flags;
+    rbDecodeJob_t *job;
+    int length;
 
-    case RDT_FLAT:
-        return flatTextures[flattranslation[index]].flags;
+    if(numDecodeThreads == 0 || numFreeJobs == 0)
+    {
+        return false;
+    }
 
-    case RDT_SPRITE:
-        return spriteTextures[translation][index].flags;
+    // the zone isn't thread safe, so the decoder gets its own copy
+    length = W_LumpLength(lump);
 
-    case RDT_PATCH:
-        return patchTextures[index].flags;
+    job = freeJobs[--numFreeJobs];
+    job->texdata = texdata;
+    job->translation = translation;
+    job->patch = (patch_t*)malloc(length);
 
-    default:
-        break;
+    if(job->patch == NULL)
+    {
+        freeJobs[numFreeJobs++] = job;
+        return false;
     }
 
-    return 0;
+    memcpy(job->patch, patch, length);
+
+    SDL_LockMutex(decodeMutex);
+
+    texdata->bDecoding = true;
+    texdata->bDecodePriority = bPriority;
+
+    decodeQueue[numDecodeQueue++] = job;
+    SDL_CondSignal(decodeCond);
+
+    SDL_UnlockMutex(decodeMutex);
+
+    return true;
 }
 
 //
-// RB_GetTexture
+// RB_RaiseDecodePriority
 //
 
-rbTexture_t *RB_GetTexture(const rbDataType_t type, const int index, const int translation)
+static void RB_RaiseDecodePriority(rbTextureData_t *texdata)
 {
-    rbTextureData_t *texdata = NULL;
-
-    switch(type)
+    if(texdata->bDecodePriority)
     {
-    case RDT_COLUMN:
-        texdata = RB_CreateColTexture(index);
-        break;
+        return;
+    }
 
-    case RDT_FLAT:
-        texdata = RB_CreateFlatTexture(index);
-        break;
+    SDL_LockMutex(decodeMutex);
+    texdata->bDecodePriority = true;
+    SDL_UnlockMutex(decodeMutex);
+}
 
-    case RDT_SPRITE:
-        texdata = RB_CreateSpriteTexture(index, translation, false);
+//
+// RB_UploadDecodedJob
+//
+
+static void RB_UploadDecodedJob(rbDecodeJob_t *job)
+{
+    rbTextureData_t *texdata = job->texdata;
+
+    RB_UploadPatchPixels(texdata, &texdata->texture, &job->pixels);
+
+    texdata->bDecoding = false;
+    texdata->bDecodePriority = false;
+
+    free(job->patch);
+    job->patch = NULL;
+
+    freeJobs[numFreeJobs++] = job;
+}
+
+//
+// RB_takeJob
+//
+// Removes the job for texdata from a queue, or returns NULL if it isn't
+// there. decodeMutex must be held
+//
+
+static rbDecodeJob_t *RB_takeJob(rbDecodeJob_t **queue, int *count, rbTextureData_t *texdata)
+{
+    rbDecodeJob_t *job;
+    int i;
+
+    for(i = 0; i < *count; ++i)
+    {
+        if(queue[i]->texdata == texdata)
+        {
+            job = queue[i];
+            memmove(&queue[i], &queue[i+1], (*count - i - 1) * sizeof(rbDecodeJob_t*));
+            (*count)--;
+            return job;
+        }
+    }
+
+    return NULL;
+}
+
+//
+// RB_FinishDecode
+//
+// Called when a sprite that is still queued has to be drawn without the
+// placeholder. A job that no decoder has picked up yet is taken back and decoded here; one that
+// is being decoded is waited for. Either way the texture is uploaded
+// before this returns.
+//
+
+static void RB_FinishDecode(rbTextureData_t *texdata)
+{
+    rbDecodeJob_t *job;
+    rbTexture_t *rbTexture;
+
+    SDL_LockMutex(decodeMutex);
+
+    while(1)
+    {
+        if((job = RB_takeJob(decodeQueue, &numDecodeQueue, texdata)) != NULL)
+        {
+            SDL_UnlockMutex(decodeMutex);
+
+            rbTexture = &texdata->texture;
+            RB_DecodePatch(&job->pixels, job->patch, decodePalette,
+                           rbTexture->width, rbTexture->height,
+                           rbTexture->origwidth, rbTexture->origheight,
+                           job->translation, false);
+            break;
+        }
+
+        if((job = RB_takeJob(uploadQueue, &numUploadQueue, texdata)) != NULL)
+        {
+            // room for another decode
+            SDL_CondSignal(decodeCond);
+            SDL_UnlockMutex(decodeMutex);
+            break;
+        }
+
+        // a decoder has it right now
+        SDL_CondWait(uploadCond, decodeMutex);
+    }
+
+    RB_UploadDecodedJob(job);
+    RB_UnbindTexture();
+}
+
+//
+// RB_ProcessTextureUploads
+//
+// Uploads what the decoders have finished. Textures that are on screen
+// always go up; the rest only until the time budget runs out. Pass
+// false to upload everything that's ready.
+//
+
+void RB_ProcessTextureUploads(boolean bBudget)
+{
+    uint64_t start;
+    rbDecodeJob_t *job;
+    boolean uploaded = false;
+    int i;
+    int pick;
+
+    if(numDecodeThreads == 0)
+    {
+        return;
+    }
+
+    start = I_GetTimeUS();
+
+    while(1)
+    {
+        SDL_LockMutex(decodeMutex);
+
+        if(numUploadQueue == 0)
+        {
+            SDL_UnlockMutex(decodeMutex);
+            break;
+        }
+
+        pick = -1;
+
+        for(i = 0; i < numUploadQueue; ++i)
+        {
+            if(uploadQueue[i]->texdata->bDecodePriority)
+            {
+                pick = i;
+                break;
+            }
+        }
+
+        if(pick == -1)
+        {
+            if(bBudget && I_GetTimeUS() - start >= (uint64_t)rbTextureUploadBudget)
+            {
+                SDL_UnlockMutex(decodeMutex);
+                break;
+            }
+
+            pick = 0;
+        }
+
+        job = uploadQueue[pick];
+        memmove(&uploadQueue[pick], &uploadQueue[pick+1], (numUploadQueue - pick - 1) * sizeof(rbDecodeJob_t*));
+        numUploadQueue--;
+
+        // room for another decode
+        SDL_CondSignal(decodeCond);
+        SDL_UnlockMutex(decodeMutex);
+
+        RB_UploadDecodedJob(job);
+        uploaded = true;
+    }
+
+    if(uploaded)
+    {
+        // RB_UploadTexture leaves nothing bound behind rbState's back
+        RB_UnbindTexture();
+    }
+}
+
+//
+// RB_FlushTextureDecodes
+//
+// Waits for every queued decode and uploads the results
+//
+
+void RB_FlushTextureDecodes(void)
+{
+    boolean done;
+
+    if(numDecodeThreads == 0)
+    {
+        return;
+    }
+
+    do
+    {
+        RB_ProcessTextureUploads(false);
+
+        SDL_LockMutex(decodeMutex);
+
+        done = (numDecodeQueue + numDecoding + numUploadQueue) == 0;
+
+        if(!done && numUploadQueue == 0)
+        {
+            SDL_CondWait(uploadCond, decodeMutex);
+        }
+
+        SDL_UnlockMutex(decodeMutex);
+
+    } while(!done);
+}
+
+//
+// RB_InitTextureDecoding
+//
+
+static void RB_InitTextureDecoding(void)
+{
+    static byte blank[4] = { 0, 0, 0, 0 };
+
+    RB_StartDecodeThreads();
+
+    if(numDecodeThreads == 0)
+    {
+        return;
+    }
+
+    // gamma is applied when the palette is read, so this can be kept around
+    memcpy(decodePalette, W_CacheLumpNum(playpallump, PU_CACHE), sizeof(decodePalette));
+
+    if(placeholderTexture.texid == 0)
+    {
+        placeholderTexture.colorMode = TCR_RGBA;
+        placeholderTexture.width = placeholderTexture.origwidth = 1;
+        placeholderTexture.height = placeholderTexture.origheight = 1;
+
+        RB_UploadTexture(&placeholderTexture, blank, TC_REPEAT, TF_NEAREST);
+    }
+}
+
+//
+// RB_CreateSpriteTexture
+//
+
+static rbTextureData_t *RB_CreateSpriteTexture(const int index, const int translation,
+                                               boolean outline, decodePriority_t priority)
+{
+    rbTextureData_t *texdata;
+    rbTexture_t     *rbTexture;
+    byte            *paldata;
+    patch_t         *patch;
+
+    if(index < 0 || !bInitialized)
+    {
+        // blank texture?
+        return NULL;
+    }
+
+    texdata = &spriteTextures[translation][index];
+    rbTexture = outline ? &texdata->outline : &texdata->texture;
+
+    if(rbTexture->texid != 0)
+    {
+        return texdata;
+    }
+
+    if(!outline && texdata->bDecoding)
+    {
+        if(priority == DP_IMMEDIATE)
+        {
+            RB_FinishDecode(texdata);
+        }
+        else if(priority == DP_VISIBLE)
+        {
+            RB_RaiseDecodePriority(texdata);
+        }
+
+        return texdata;
+    }
+
+    Z_LockCache();
+    paldata = (byte*)W_CacheLumpNum(playpallump, PU_CACHE);
+    patch = (patch_t*)W_CacheLumpNum(firstspritelump + index, PU_CACHE);
+
+    rbTexture->colorMode = TCR_RGBA;
+    rbTexture->origwidth = SHORT(patch->width);
+    rbTexture->origheight = SHORT(patch->height);
+
+    rbTexture->width = RB_RoundPowerOfTwo(rbTexture->origwidth);
+    rbTexture->height = RB_RoundPowerOfTwo(rbTexture->origheight);
+
+    if(!outline && priority != DP_IMMEDIATE &&
+        RB_QueueDecode(texdata, patch, firstspritelump + index, translation, priority == DP_VISIBLE))
+    {
+        Z_UnlockCache();
+        return texdata;
+    }
+
+    RB_ReadPatchData(texdata, paldata, patch, translation, index,
+        outline ? RDT_SPRITEOUTLINE : RDT_SPRITE);
+    Z_UnlockCache();
+    return texdata;
+}
+
+//
+// RB_CreatePatchTexture
+//
+
+rbTextureData_t *RB_CreatePatchTexture(const int index)
+{
+    rbTextureData_t *texdata;
+    rbTexture_t     *rbTexture;
+    byte            *paldata;
+    patch_t         *patch;
+
+    if(index == 0 || !bInitialized)
+    {
+        // blank texture?
+        return NULL;
+    }
+
+    texdata = &patchTextures[index];
+    rbTexture = &texdata->texture;
+
+    if(rbTexture->texid != 0)
+    {
+        return texdata;
+    }
+
+    Z_LockCache();
+    paldata = (byte*)W_CacheLumpNum(playpallump, PU_CACHE);
+    patch = (patch_t*)W_CacheLumpNum(index, PU_CACHE);
+
+    rbTexture->colorMode = TCR_RGBA;
+    rbTexture->origwidth = SHORT(patch->width);
+    rbTexture->origheight = SHORT(patch->height);
+
+    rbTexture->width = RB_RoundPowerOfTwo(rbTexture->origwidth);
+    rbTexture->height = RB_RoundPowerOfTwo(rbTexture->origheight);
+
+    RB_ReadPatchData(texdata, paldata, patch, 0, index, RDT_PATCH);
+    Z_UnlockCache();
+    return texdata;
+}
+
+//
+// RB_GetTextureFlags
+//
+
+unsigned int RB_GetTextureFlags(const rbDataType_t type, const int index, const int translation)
+{
+    switch(type)
+    {
+    case RDT_COLUMN:
+        return colTextures[texturetranslation[index]].flags;
+
+    case RDT_FLAT:
+        return flatTextures[flattranslation[index]].flags;
+
+    case RDT_SPRITE:
+        return spriteTextures[translation][index].flags;
+
+    case RDT_PATCH:
+        return patchTextures[index].flags;
+
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+//
+// RB_GetTexture
+//
+
+rbTexture_t *RB_GetTexture(const rbDataType_t type, const int index, const int translation)
+{
+    rbTextureData_t *texdata = NULL;
+
+    switch(type)
+    {
+    case RDT_COLUMN:
+        texdata = RB_CreateColTexture(index);
         break;
 
-    case RDT_PATCH:
-        texdata = RB_CreatePatchTexture(index);
-        break;
+    case RDT_FLAT:
+        texdata = RB_CreateFlatTexture(index);
+        break;
+
+    case RDT_SPRITE:
+        texdata = RB_CreateSpriteTexture(index, translation, false, DP_VISIBLE);
+
+        // still being decoded; draw nothing for now unless the
+        // atlas already has it
+        if(texdata && texdata->bDecoding && RB_GetSpriteAtlasPage(index, translation) == -1)
+        {
+            return &placeholderTexture;
+        }
+        break;
+
+    case RDT_PATCH:
+        texdata = RB_CreatePatchTexture(index);
+        break;
+
+    default:
+        break;
+    }
+
+    if(texdata)
+    {
+        return &texdata->texture;
+    }
+
+    return NULL;
+}
+
+//
+// RB_GetBrightmap
+//
+
+rbTexture_t *RB_GetBrightmap(const rbDataType_t type, const int index, const int translation)
+{
+    switch(type)
+    {
+    case RDT_COLUMN:
+        if(colTextures[texturetranslation[index]].brightmap.texid != 0)
+        {
+            return &colTextures[texturetranslation[index]].brightmap;
+        }
+        break;
+
+    case RDT_FLAT:
+        if(flatTextures[flattranslation[index]].brightmap.texid != 0)
+        {
+            return &flatTextures[flattranslation[index]].brightmap;
+        }
+        break;
+
+    case RDT_SPRITE:
+        if(spriteTextures[translation][index].brightmap.texid != 0)
+        {
+            return &spriteTextures[translation][index].brightmap;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return NULL;
+}
+
+//
+// RB_GetPrioritySpriteTexture
+//
+// Like RB_GetTexture, but never hands back the placeholder. Meant for
+// sprites that pop badly, like the player's weapon
+//
+
+rbTexture_t *RB_GetPrioritySpriteTexture(const int index, const int translation)
+{
+    rbTextureData_t *texdata = RB_CreateSpriteTexture(index, translation, false, DP_IMMEDIATE);
+
+    if(texdata)
+    {
+        return &texdata->texture;
+    }
+
+    return NULL;
+}
+
+//
+// RB_GetSpriteOutlineTexture
+//
+
+rbTexture_t *RB_GetSpriteOutlineTexture(const int index)
+{
+    rbTextureData_t *texdata = RB_CreateSpriteTexture(index, 0, true, DP_IMMEDIATE);
+
+    if(texdata)
+    {
+        return &texdata->outline;
+    }
+
+    return NULL;
+}
+
+//
+// RB_InitLightmapTextures
+//
+
+void RB_InitLightmapTextures(byte *data, int count, int width, int height)
+{
+    int i;
+    byte *textureData;
+
+    lightmapTextures = (rbTexture_t*)Z_Calloc(1, sizeof(rbTexture_t) * count, PU_LEVEL, 0);
+    lightmapCount = count;
+
+    for(i = 0; i < count; ++i)
+    {
+        lightmapTextures[i].colorMode = TCR_RGB;
+        lightmapTextures[i].origwidth = width;
+        lightmapTextures[i].origheight = height;
+        lightmapTextures[i].width = width;
+        lightmapTextures[i].height = height;
+
+        textureData = &data[(width * height * 3) * i];
+        RB_UploadTexture(&lightmapTextures[i], textureData, TC_CLAMP_BORDER, TF_LINEAR);
+    }
+}
+
+//
+// RB_FreeLightmapTextures
+//
+
+void RB_FreeLightmapTextures(void)
+{
+    int i;
+
+    if(lightmapTextures)
+    {
+        for(i = 0; i < lightmapCount; ++i)
+        {
+            RB_DeleteTexture(&lightmapTextures[i]);
+        }
+    }
+}
+
+//=============================================================================
+//
+// Sprite atlas
+//
+// Sprites are drawn sorted by distance, so nearly every sprite used to need
+// its own bind and draw call. At level start the sprites a level uses get
+// packed into a few large pages, with a matching page for brightmaps, so runs
+// of sprites can be drawn together. Translated and outline sprites still use
+// their own textures.
+//
+// Walls and flats stay out of this. Their coordinates aren't confined to one
+// copy of the texture: a wall's u runs from its texture offset over the whole
+// seg length, and flat coordinates come from world x/y, so both rely on
+// GL_REPEAT to tile. An atlas page can only repeat as a whole, and the world
+// is drawn with the fixed function pipeline, which has no way to wrap the
+// coordinates within a sub-rectangle. Animated walls and flats also swap
+// textures every few tics through texturetranslation and flattranslation,
+// which already rebinds them.
+//
+// Flats are all 64x64 and would fit a GL_TEXTURE_2D_ARRAY, where each layer
+// repeats on its own. That was left out too. An array texture can only be
+// sampled from a shader, and flats go through the same fixed function passes
+// as the rest of the world (vertex color shading, fog, brightmaps, dynamic
+// lights), all of which would need a shader of their own. vtx_t also has no
+// room for a layer, so it would have to be baked into the static surfaces,
+// and flattranslation would change it every few tics. The static surfaces
+// are already merged by flat (VBO_SetupLeafKey), so the saving would be one
+// draw call per distinct flat in view.
+//
+//=============================================================================
+
+#define ATLAS_MAXPAGES      8
+#define ATLAS_MAXSIZE       2048
+#define ATLAS_PADDING       2
+
+typedef struct
+{
+    rbTexture_t     texture;
+    rbTexture_t     brightmap;
+    byte            *data;
+    byte            *brightdata;
+    int             shelfx;
+    int             shelfy;
+    int             shelfheight;
+} rbAtlasPage_t;
+
+static rbAtlasPage_t    atlasPages[ATLAS_MAXPAGES];
+static int              numAtlasPages = 0;
+static int              atlasSize = 0;
+
+//
+// RB_DeleteSpriteAtlas
+//
 
-    default:
-        break;
-    }
+static void RB_DeleteSpriteAtlas(void)
+{
+    int i;
 
-    if(texdata)
+    for(i = 0; i < numAtlasPages; ++i)
     {
-        return &texdata->texture;
+        RB_DeleteTexture(&atlasPages[i].texture);
+        RB_DeleteTexture(&atlasPages[i].brightmap);
     }
 
-    return NULL;
+    memset(atlasPages, 0, sizeof(atlasPages));
+    numAtlasPages = 0;
+
+    if(spriteTextures[0] != NULL)
+    {
+        for(i = 0; i < numspritelumps; ++i)
+        {
+            spriteTextures[0][i].atlasNum = 0;
+        }
+    }
 }
 
 //
-// RB_GetBrightmap
+// RB_AtlasAlloc
+//
+// Simple shelf packer. Returns the page number or -1 if everything is full
 //
 
-rbTexture_t *RB_GetBrightmap(const rbDataType_t type, const int index, const int translation)
+static int RB_AtlasAlloc(int width, int height, atlas_t *rect)
 {
-    switch(type)
+    rbAtlasPage_t *page;
+
+    width += ATLAS_PADDING;
+    height += ATLAS_PADDING;
+
+    if(width > atlasSize || height > atlasSize)
     {
-    case RDT_COLUMN:
-        if(colTextures[texturetranslation[index]].brightmap.texid != 0)
+        return -1;
+    }
+
+    while(numAtlasPages <= ATLAS_MAXPAGES)
+    {
+        if(numAtlasPages > 0)
         {
-            return &colTextures[texturetranslation[index]].brightmap;
+            page = &atlasPages[numAtlasPages-1];
+
+            if(page->shelfx + width > atlasSize)
+            {
+                // start a new shelf
+                page->shelfy += page->shelfheight;
+                page->shelfx = 0;
+                page->shelfheight = 0;
+            }
+
+            if(page->shelfy + height <= atlasSize)
+            {
+                rect->x = page->shelfx;
+                rect->y = page->shelfy;
+                rect->w = width - ATLAS_PADDING;
+                rect->h = height - ATLAS_PADDING;
+
+                page->shelfx += width;
+
+                if(height > page->shelfheight)
+                {
+                    page->shelfheight = height;
+                }
+
+                return numAtlasPages-1;
+            }
         }
-        break;
 
-    case RDT_FLAT:
-        if(flatTextures[flattranslation[index]].brightmap.texid != 0)
+        if(numAtlasPages == ATLAS_MAXPAGES)
         {
-            return &flatTextures[flattranslation[index]].brightmap;
+            break;
         }
-        break;
 
-    case RDT_SPRITE:
-        if(spriteTextures[translation][index].brightmap.texid != 0)
+        page = &atlasPages[numAtlasPages++];
+        page->data = (byte*)calloc(1, atlasSize * atlasSize * 4);
+
+        if(page->data == NULL)
         {
-            return &spriteTextures[translation][index].brightmap;
+            numAtlasPages--;
+            break;
         }
-        break;
-
-    default:
-        break;
     }
 
-    return NULL;
+    return -1;
 }
 
 //
-// RB_GetSpriteOutlineTexture
+// RB_AtlasBlitPatch
+//
+// Same conversion as RB_DecodePatch,
+// but written straight into an atlas page
 //
 
-rbTexture_t *RB_GetSpriteOutlineTexture(const int index)
+static void RB_AtlasBlitPatch(rbAtlasPage_t *page, atlas_t *rect, patch_t *patch, byte *paldata)
+{
+    int w;
+    int h;
+    int offset;
+    column_t *column;
+    byte *colData;
+    byte rgb[256][3];
+    byte bright[256];
+    byte rgbf[32];
+
+    memset(rgbf, 0, sizeof(rgbf));
+
+    for(w = 0; w < rect->w; ++w)
+    {
+        column = (column_t*)((byte*)patch + LONG(patch->columnofs[w]));
+
+        while(column->topdelta != 0xff)
+        {
+            colData = (byte*)column + 3;
+
+            for(h = 0; h < column->length; ++h)
+            {
+                byte p = colData[h];
+                int bytenum = p >> 3;
+                int bitnum  = 1 << (p & 7);
+
+                if(!(rgbf[bytenum] & bitnum))
+                {
+                    bright[p] = RB_GetPaletteRGB(rgb[p], paldata, p, 0);
+                    rgbf[bytenum] |= bitnum;
+                }
+
+                offset = ((atlasSize * (rect->y + column->topdelta + h)) + rect->x + w) * 4;
+
+                page->data[offset + 0] = rgb[p][0];
+                page->data[offset + 1] = rgb[p][1];
+                page->data[offset + 2] = rgb[p][2];
+                page->data[offset + 3] = 0xff;
+
+                if(bright[p])
+                {
+                    if(page->brightdata == NULL)
+                    {
+                        page->brightdata = (byte*)calloc(1, atlasSize * atlasSize * 4);
+
+                        if(page->brightdata == NULL)
+                        {
+                            I_Error("RB_AtlasBlitPatch: failed to allocate brightmap page");
+                        }
+                    }
+
+                    page->brightdata[offset + 0] = rgb[p][0];
+                    page->brightdata[offset + 1] = rgb[p][1];
+                    page->brightdata[offset + 2] = rgb[p][2];
+                    page->brightdata[offset + 3] = 0xff;
+                }
+            }
+
+            column = (column_t*)((byte*)column + column->length + 4);
+        }
+    }
+}
+
+//
+// SortAtlasLumps
+//
+
+static int SortAtlasLumps(const void *a, const void *b)
 {
-    rbTextureData_t *texdata = RB_CreateSpriteTexture(index, 0, true);
+    int h1 = spriteTextures[0][*(const int*)a].texture.origheight;
+    int h2 = spriteTextures[0][*(const int*)b].texture.origheight;
 
-    if(texdata)
+    if(h1 != h2)
     {
-        return &texdata->outline;
+        return h2 - h1;
     }
 
-    return NULL;
+    // keep the packing the same from run to run
+    return *(const int*)a - *(const int*)b;
 }
 
 //
-// RB_InitLightmapTextures
+// RB_BuildSpriteAtlas
+//
+// present is indexed by sprite number. The individual textures
+// must already exist or be queued, they are still used for
+// everything but plain untranslated sprites. The atlas reads the
+// lumps itself, so it doesn't wait for the decoders
 //
 
-void RB_InitLightmapTextures(byte *data, int count, int width, int height)
+static void RB_BuildSpriteAtlas(char *present)
 {
-    int i;
-    byte *textureData;
+    int *lumps;
+    byte *used;
+    int numlumps;
+    int i, j, k;
+    byte *paldata;
 
-    lightmapTextures = (rbTexture_t*)Z_Calloc(1, sizeof(rbTexture_t) * count, PU_LEVEL, 0);
-    lightmapCount = count;
+    RB_DeleteSpriteAtlas();
 
-    for(i = 0; i < count; ++i)
+    atlasSize = MIN(RB_GetMaxTextureSize(), ATLAS_MAXSIZE);
+
+    if(!rbTextureAtlas || atlasSize <= 0)
     {
-        lightmapTextures[i].colorMode = TCR_RGB;
-        lightmapTextures[i].origwidth = width;
-        lightmapTextures[i].origheight = height;
-        lightmapTextures[i].width = width;
-        lightmapTextures[i].height = height;
+        return;
+    }
 
-        textureData = &data[(width * height * 3) * i];
-        RB_UploadTexture(&lightmapTextures[i], textureData, TC_CLAMP_BORDER, TF_LINEAR);
+    lumps = (int*)Z_Malloc(sizeof(int) * numspritelumps, PU_STATIC, 0);
+    used = (byte*)Z_Calloc(1, numspritelumps, PU_STATIC, 0);
+    numlumps = 0;
+
+    // frames share lumps between rotations and sprites
+    for(i = 0; i < numsprites; ++i)
+    {
+        if(!present[i])
+        {
+            continue;
+        }
+
+        for(j = 0; j < sprites[i].numframes; ++j)
+        {
+            spriteframe_t *sf = &sprites[i].spriteframes[j];
+
+            for(k = 0; k < 8; ++k)
+            {
+                int lump = sf->lump[k];
+
+                if(lump < 0 || used[lump] ||
+                    (spriteTextures[0][lump].texture.texid == 0 && !spriteTextures[0][lump].bDecoding))
+                {
+                    continue;
+                }
+
+                used[lump] = 1;
+                lumps[numlumps++] = lump;
+            }
+        }
+    }
+
+    // tallest first packs shelves a lot tighter
+    qsort(lumps, numlumps, sizeof(int), SortAtlasLumps);
+
+    // paldata is used for every patch cached below
+    Z_LockCache();
+    paldata = (byte*)W_CacheLumpNum(playpallump, PU_CACHE);
+
+    for(i = 0; i < numlumps; ++i)
+    {
+        rbTextureData_t *texdata = &spriteTextures[0][lumps[i]];
+        rbTexture_t *texture = &texdata->texture;
+        atlas_t rect;
+        int page;
+        patch_t *patch;
+
+        page = RB_AtlasAlloc(texture->origwidth, texture->origheight, &rect);
+
+        if(page == -1)
+        {
+            // out of room; the rest keep using their own textures
+            break;
+        }
+
+        patch = (patch_t*)W_CacheLumpNum(firstspritelump + lumps[i], PU_CACHE);
+        RB_AtlasBlitPatch(&atlasPages[page], &rect, patch, paldata);
+
+        texdata->atlasNum = page + 1;
+        texdata->atlasRect = rect;
+    }
+
+    Z_UnlockCache();
+
+    for(i = 0; i < numAtlasPages; ++i)
+    {
+        rbAtlasPage_t *page = &atlasPages[i];
+
+        page->texture.colorMode = TCR_RGBA;
+        page->texture.width = page->texture.origwidth = atlasSize;
+        page->texture.height = page->texture.origheight = atlasSize;
+
+        RB_UploadTexture(&page->texture, page->data, TC_CLAMP, TF_NEAREST);
+        free(page->data);
+        page->data = NULL;
+
+        if(page->brightdata)
+        {
+            memcpy(&page->brightmap, &page->texture, sizeof(rbTexture_t));
+            page->brightmap.texid = 0;
+
+            RB_UploadTexture(&page->brightmap, page->brightdata, TC_CLAMP, TF_NEAREST);
+            free(page->brightdata);
+            page->brightdata = NULL;
+        }
     }
+
+    Z_Free(lumps);
+    Z_Free(used);
 }
 
 //
-// RB_FreeLightmapTextures
+// RB_GetSpriteAtlasPage
+//
+// Returns the atlas page a sprite was packed into, or -1
 //
 
-void RB_FreeLightmapTextures(void)
+int RB_GetSpriteAtlasPage(const int index, const int translation)
 {
-    int i;
+    if(!rbTextureAtlas || translation != 0 || index < 0 || !bInitialized)
+    {
+        return -1;
+    }
 
-    if(lightmapTextures)
+    return spriteTextures[0][index].atlasNum - 1;
+}
+
+//
+// RB_GetSpriteAtlasCoords
+//
+// Maps the 0..1 range of the sprite's own texture into its atlas page:
+// u' = uv[0] + u * uv[2], v' = uv[1] + v * uv[3]
+//
+
+void RB_GetSpriteAtlasCoords(const int index, float *uv)
+{
+    rbTextureData_t *texdata = &spriteTextures[0][index];
+
+    uv[0] = (float)texdata->atlasRect.x / (float)atlasSize;
+    uv[1] = (float)texdata->atlasRect.y / (float)atlasSize;
+    uv[2] = (float)texdata->texture.width / (float)atlasSize;
+    uv[3] = (float)texdata->texture.height / (float)atlasSize;
+}
+
+//
+// RB_GetAtlasTexture
+//
+
+rbTexture_t *RB_GetAtlasTexture(const int page, boolean bBrightmap)
+{
+    rbTexture_t *texture;
+
+    if(page < 0 || page >= numAtlasPages)
     {
-        for(i = 0; i < lightmapCount; ++i)
+        return NULL;
+    }
+
+    texture = bBrightmap ? &atlasPages[page].brightmap : &atlasPages[page].texture;
+    return (texture->texid != 0) ? texture : NULL;
+}
+
+//
+// RB_PrecacheSprites
+//
+// Returns the sprites that are in use (PU_STATIC, caller frees)
+//
+
+static char *RB_PrecacheSprites(void)
+{
+    char *present;
+    int i, j, k;
+    thinker_t *th;
+
+    present = (char*)Z_Calloc(1, numsprites, PU_STATIC, 0);
+    
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
+    {
+        if(th->function.acp1 == (actionf_p1)P_MobjThinker)
         {
-            RB_DeleteTexture(&lightmapTextures[i]);
+            present[((mobj_t*)th)->sprite] = 1;
         }
     }
+    
+    for(i = 0; i < numsprites; ++i)
+    {
+        if(present[i])
+        {
+            for(j = 0; j < sprites[i].numframes; ++j)
+            {
+                spriteframe_t *sf = &sprites[i].spriteframes[j];
+                
+                for(k = 0; k < 8; ++k)
+                {
+                    RB_CreateSpriteTexture(sf->lump[k], 0, false, DP_PRECACHE);
+                }
+            }
+        }
+    }
+
+    return present;
+}
+
+//
+// RB_BeginPrecacheLevel
+//
+// Called as soon as the level's things are spawned so their sprites
+// can decode in the background while the rest of the level loads
+//
+
+void RB_BeginPrecacheLevel(void)
+{
+    Z_Free(RB_PrecacheSprites());
 }
 
 //
@@ -902,8 +1919,7 @@ void RB_FreeLightmapTextures(void)
 void RB_PrecacheLevel(void)
 {
     char *present;
-    int i, j, k;
-    thinker_t *th;
+    int i, k;
     anim_t *anim;
     
     present = (char*)Z_Calloc(1, numflats, PU_STATIC, 0);
@@ -973,31 +1989,11 @@ void RB_PrecacheLevel(void)
     
     Z_Free(present);
     
-    present = (char*)Z_Calloc(1, numsprites, PU_STATIC, 0);
-    
-    for(th = thinkercap.next; th != &thinkercap; th = th->next)
-    {
-        if(th->function.acp1 == (actionf_p1)P_MobjThinker)
-        {
-            present[((mobj_t*)th)->sprite] = 1;
-        }
-    }
-    
-    for(i = 0; i < numsprites; ++i)
-    {
-        if(present[i])
-        {
-            for(j = 0; j < sprites[i].numframes; ++j)
-            {
-                spriteframe_t *sf = &sprites[i].spriteframes[j];
-                
-                for(k = 0; k < 8; ++k)
-                {
-                    RB_CreateSpriteTexture(sf->lump[k], 0, false);
-                }
-            }
-        }
-    }
+    // pick up anything spawned since RB_BeginPrecacheLevel. Whatever
+    // the decoders haven't finished yet is uploaded over the next few
+    // frames by RB_ProcessTextureUploads
+    present = RB_PrecacheSprites();
+    RB_BuildSpriteAtlas(present);
     
     Z_Free(present);
 }
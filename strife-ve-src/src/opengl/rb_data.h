@@ -48,10 +48,17 @@ boolean RB_DataInitialized(void);
 unsigned int RB_GetTextureFlags(const rbDataType_t type, const int index, const int translation);
 rbTexture_t *RB_GetTexture(const rbDataType_t type, const int index, const int translation);
 rbTexture_t *RB_GetBrightmap(const rbDataType_t type, const int index, const int translation);
+rbTexture_t *RB_GetPrioritySpriteTexture(const int index, const int translation);
 rbTexture_t *RB_GetSpriteOutlineTexture(const int index);
 void RB_InitLightmapTextures(byte *data, int count, int width, int height);
 void RB_FreeLightmapTextures(void);
+void RB_BeginPrecacheLevel(void);
 void RB_PrecacheLevel(void);
+void RB_ProcessTextureUploads(boolean bBudget);
+void RB_FlushTextureDecodes(void);
+int RB_GetSpriteAtlasPage(const int index, const int translation);
+void RB_GetSpriteAtlasCoords(const int index, float *uv);
+rbTexture_t *RB_GetAtlasTexture(const int page, boolean bBrightmap);
 
 static dinline boolean RB_GetPaletteRGB(byte *rgb, byte *paldata, byte index, const int translation)
 {
@@ -15,6 +15,12 @@
 // DESCRIPTION:
 //    Basic decal system
 //
+//    Decals live in a fixed pool and are linked into the subsector they
+//    sit in. When the pool (or gl_max_decals) runs out, the decal that
+//    has gone unseen the longest makes room for the new one. Carving a
+//    decal to the walls of its sector is put off until the BSP walker
+//    first reaches its subsector, which spreads it across the workers.
+//
 
 #include <math.h>
 
@@ -25,6 +31,7 @@
 #include "rb_data.h"
 #include "rb_draw.h"
 #include "rb_decal.h"
+#include "rb_instance.h"
 #include "rb_matrix.h"
 #include "m_random.h"
 #include "p_local.h"
@@ -36,9 +43,14 @@
 #include "m_parser.h"
 
 static rbDecal_t decalhead;
+static rbDecal_t decalpool[MAX_DECALS];
+static rbDecal_t *freedecals;
 static int activedecals;
 static line_t *decalwall = NULL;
 
+static int decaltic;
+static int nextexpiretic;
+
 static fixed_t decal_x;
 static fixed_t decal_y;
 static fixed_t decal_z;
@@ -171,7 +183,7 @@ static rbDecalDef_t *RB_GetDecalDef(mobjtype_t type)
 {
     int i;
     
-    for(i = 0; numDecalDefs; ++i)
+    for(i = 0; i < numDecalDefs; ++i)
     {
         if(decalDefs[i].mobjtype == type)
         {
@@ -193,20 +205,19 @@ static rbDecalDef_t *RB_GetDecalDef(mobjtype_t type)
 
 static void RB_LinkDecal(rbDecal_t *decal)
 {
-    sector_t *sec;
+    subsector_t *ssect;
 
-    decal->ssect = R_PointInSubsector(decal->x, decal->y);
-    sec = decal->ssect->sector;
+    ssect = decal->ssect = R_PointInSubsector(decal->x, decal->y);
 
     decal->sprev = NULL;
-    decal->snext = sec->decallist;
+    decal->snext = ssect->decallist;
 
-    if(sec->decallist)
+    if(ssect->decallist)
     {
-        sec->decallist->sprev = decal;
+        ssect->decallist->sprev = decal;
     }
 
-    sec->decallist = decal;
+    ssect->decallist = decal;
 }
 
 //
@@ -226,41 +237,124 @@ static void RB_UnlinkDecal(rbDecal_t *decal)
     }
     else
     {
-        decal->ssect->sector->decallist = decal->snext;
+        decal->ssect->decallist = decal->snext;
     }
 }
 
 //
-// RB_UpdateDecals
+// RB_FreeDecal
 //
 
-void RB_UpdateDecals(void)
+static void RB_FreeDecal(rbDecal_t *decal)
+{
+    decal->next->prev = decal->prev;
+    decal->prev->next = decal->next;
+
+    RB_UnlinkDecal(decal);
+
+    decal->next = freedecals;
+    freedecals = decal;
+
+    activedecals--;
+}
+
+//
+// RB_EvictDecal
+//
+// Frees the decal that has gone unseen the longest. The list
+// runs from oldest to newest, so ties go to the oldest
+//
+
+static void RB_EvictDecal(void)
 {
     rbDecal_t *decal;
+    rbDecal_t *best = NULL;
 
     for(decal = decalhead.next; decal != &decalhead; decal = decal->next)
     {
-        if(decal->tics <= decal->fadetime)
+        if(best == NULL || decal->lastseen < best->lastseen)
         {
-            decal->alpha -= (((float)decal->def->startingAlpha / decal->fadetime) / 255.0f);
-
-            if(decal->alpha < 0)
-            {
-                decal->alpha = 0;
-            }
+            best = decal;
         }
+    }
+
+    if(best)
+    {
+        RB_FreeDecal(best);
+    }
+}
+
+//
+// RB_DecalBudget
+//
+
+static int RB_DecalBudget(void)
+{
+    return MAX(MIN(rbMaxDecals, MAX_DECALS), 1);
+}
+
+//
+// RB_GetDecalAlpha
+//
+// Decals start fading once they have fadetime tics left
+//
+
+static float RB_GetDecalAlpha(rbDecal_t *decal)
+{
+    float alpha = (float)decal->def->startingAlpha / 255.0f;
+    int fadetics;
+
+    fadetics = (decaltic - decal->spawntic) - MAX(decal->def->lifetime - decal->fadetime, 0);
+
+    if(fadetics > 0 && decal->fadetime > 0)
+    {
+        alpha -= (((float)decal->def->startingAlpha / decal->fadetime) / 255.0f) * fadetics;
 
-        if(activedecals >= rbMaxDecals || !decal->tics--)
+        if(alpha < 0)
         {
-            rbDecal_t *decalTmp = decal;
-            rbDecal_t *next = decalTmp->next;
+            alpha = 0;
+        }
+    }
+
+    return alpha;
+}
 
-            (next->prev = decal = decalTmp->prev)->next = next;
+//
+// RB_UpdateDecals
+//
 
-            RB_UnlinkDecal(decalTmp);
-            Z_Free(decalTmp);
+void RB_UpdateDecals(void)
+{
+    rbDecal_t *decal;
+    rbDecal_t *next;
+
+    decaltic++;
+
+    // the budget can be lowered from the menu at any time
+    while(activedecals > RB_DecalBudget())
+    {
+        RB_EvictDecal();
+    }
+
+    // nothing runs out before then
+    if(decaltic < nextexpiretic)
+    {
+        return;
+    }
+
+    nextexpiretic = INT_MAX;
+
+    for(decal = decalhead.next; decal != &decalhead; decal = next)
+    {
+        next = decal->next;
 
-            activedecals--;
+        if(decaltic >= decal->dietic)
+        {
+            RB_FreeDecal(decal);
+        }
+        else if(decal->dietic < nextexpiretic)
+        {
+            nextexpiretic = decal->dietic;
         }
     }
 }
@@ -271,8 +365,19 @@ void RB_UpdateDecals(void)
 
 void RB_ClearDecalLinks(void)
 {
+    int i;
+
     decalhead.next = decalhead.prev = &decalhead;
     activedecals = 0;
+    nextexpiretic = INT_MAX;
+
+    freedecals = NULL;
+
+    for(i = MAX_DECALS - 1; i >= 0; --i)
+    {
+        decalpool[i].next = freedecals;
+        freedecals = &decalpool[i];
+    }
 }
 
 //
@@ -548,17 +653,34 @@ static void RB_CarveDecal(rbDecal_t *decal)
 static rbDecal_t *RB_CreateDecal(rbDecalDef_t *decalDef)
 {
     rbDecal_t *decal;
+
+    if(activedecals >= RB_DecalBudget() || freedecals == NULL)
+    {
+        RB_EvictDecal();
+    }
+
+    decal = freedecals;
+    freedecals = decal->next;
     
-    decal = Z_Calloc(1, sizeof(*decal), PU_LEVEL, 0);
+    memset(decal, 0, sizeof(*decal));
     decal->def = decalDef;
-    decal->tics = decalDef->lifetime;
+    decal->spawntic = decaltic;
+    decal->lastseen = decaltic;
     decal->lump = decalDef->lumpnum + (M_Random() % decalDef->count);
     decal->offset = M_Random() & 7;
-    decal->alpha = (float)decalDef->startingAlpha / 255.0f;
     decal->fadetime = decalDef->fadetime;
     decal->scale = decalDef->scale;
     decal->stickSector = NULL;
     decal->initialStickZ = 0;
+    decal->bPending = true;
+
+    // RB_UpdateDecals runs once more after the last tic of its life
+    decal->dietic = decaltic + MAX(decalDef->lifetime, 0) + 1;
+
+    if(decal->dietic < nextexpiretic)
+    {
+        nextexpiretic = decal->dietic;
+    }
     
     if(decalDef->randScaleFactor != 0)
     {
@@ -579,6 +701,8 @@ static rbDecal_t *RB_CreateDecal(rbDecalDef_t *decalDef)
     decal->prev = decalhead.prev;
     decalhead.prev = decal;
 
+    activedecals++;
+
     return decal;
 }
 
@@ -834,9 +958,6 @@ void RB_SpawnWallDecal(mobj_t *mobj)
         decal->points[i].x -= (nx * offs);
         decal->points[i].y -= (ny * offs);
     }
-
-    RB_RotateDecalTextureCoords(decal);
-    activedecals++;
 }
 
 //
@@ -927,10 +1048,49 @@ void RB_SpawnFloorDecal(mobj_t *mobj, boolean floor)
         decal->points[i].y += fy;
         decal->points[i].z += fz;
     }
-    
-    RB_CarveDecal(decal);
+}
+
+//
+// RB_FinishDecal
+//
+// Carving only looks at the decal and the level's lines, so this can
+// run on whichever worker reaches the decal's subsector
+//
+
+static void RB_FinishDecal(rbDecal_t *decal)
+{
+    if(decal->type == DCT_FLOOR || decal->type == DCT_CEILING)
+    {
+        RB_CarveDecal(decal);
+    }
+
     RB_RotateDecalTextureCoords(decal);
-    activedecals++;
+    decal->bPending = false;
+}
+
+//
+// RB_IsDecalParallelogram
+//
+// Most decals keep the four points they were spawned with and can be
+// drawn as one instanced quad. Decals carved against a floor or ceiling
+// can have any number of points and are fanned into triangles instead.
+//
+
+boolean RB_IsDecalParallelogram(rbDecal_t *decal)
+{
+    rbDecalVertex_t *p = decal->points;
+
+    if(decal->numpoints != 4)
+    {
+        return false;
+    }
+
+    // both diagonals must share their midpoint
+    return (fabs((p[0].x  + p[2].x)  - (p[1].x  + p[3].x))  < 0.01f &&
+            fabs((p[0].y  + p[2].y)  - (p[1].y  + p[3].y))  < 0.01f &&
+            fabs((p[0].z  + p[2].z)  - (p[1].z  + p[3].z))  < 0.01f &&
+            fabs((p[0].tu + p[2].tu) - (p[1].tu + p[3].tu)) < 0.001f &&
+            fabs((p[0].tv + p[2].tv) - (p[1].tv + p[3].tv)) < 0.001f);
 }
 
 //
@@ -942,6 +1102,7 @@ static boolean RB_GenerateDecal(vtxlist_t *vl, int *drawcount)
     vtx_t *v;
     rbDecal_t *decal;
     float offset;
+    byte alpha;
     int count;
     int i;
 
@@ -949,11 +1110,6 @@ static boolean RB_GenerateDecal(vtxlist_t *vl, int *drawcount)
     decal = (rbDecal_t*)vl->data;
     count = *drawcount;
 
-    for(i = 0; i < decal->numpoints - 2; ++i)
-    {
-        RB_AddTriangle(count, count + 1 + i, count + 2 + i);
-    }
-
     offset = 0;
 
     if(decal->type == DCT_UPPERWALL || decal->type == DCT_CEILING)
@@ -965,6 +1121,8 @@ static boolean RB_GenerateDecal(vtxlist_t *vl, int *drawcount)
         offset = FIXED2FLOAT(decal->initialStickZ - decal->stickSector->floorheight);
     }
 
+    alpha = (byte)(RB_GetDecalAlpha(decal) * 255.0f);
+
     for(i = 0; i < decal->numpoints; ++i)
     {
         v[i].x = decal->points[i].x;
@@ -973,11 +1131,19 @@ static boolean RB_GenerateDecal(vtxlist_t *vl, int *drawcount)
 
         v[i].tu = decal->points[i].tu;
         v[i].tv = decal->points[i].tv;
+    }
+
+    RB_SetVertexColor(v, alpha, alpha, alpha, alpha, decal->numpoints);
 
-        v[i].r =
-        v[i].g =
-        v[i].b =
-        v[i].a = (byte)(decal->alpha * 255.0f);
+    // the points go around the decal, so the corner
+    // opposite the first one is points[2]
+    if(!(INST_Enabled() && RB_IsDecalParallelogram(decal) &&
+         INST_AddQuad(&v[0], &v[1], &v[3], NULL)))
+    {
+        for(i = 0; i < decal->numpoints - 2; ++i)
+        {
+            RB_AddTriangle(count, count + 1 + i, count + 2 + i);
+        }
     }
 
     *drawcount += decal->numpoints;
@@ -988,11 +1154,11 @@ static boolean RB_GenerateDecal(vtxlist_t *vl, int *drawcount)
 // RB_AddDecalDrawlist
 //
 
-static void RB_AddDecalDrawlist(rbDecal_t *decal)
+static void RB_AddDecalDrawlist(drawlist_t *dl, rbDecal_t *decal)
 {
     vtxlist_t *list;
     
-    list = DL_AddVertexList(&drawlist[DLT_DECAL]);
+    list = DL_AddVertexList(dl);
     list->data = (rbDecal_t*)decal;
     list->procfunc = RB_GenerateDecal;
     list->preprocess = 0;
@@ -1003,19 +1169,22 @@ static void RB_AddDecalDrawlist(rbDecal_t *decal)
 //
 // RB_AddDecals
 //
+// dl is the decal draw list, or a worker's shard of it
+//
 
-void RB_AddDecals(subsector_t *sub)
+void RB_AddDecals(drawlist_t *dl, subsector_t *sub)
 {
     rbDecal_t *decal;
 
-    for(decal = sub->sector->decallist; decal; decal = decal->snext)
+    for(decal = sub->decallist; decal; decal = decal->snext)
     {
-        if(decal->ssect != sub)
+        if(decal->bPending)
         {
-            continue;
+            RB_FinishDecal(decal);
         }
 
-        RB_AddDecalDrawlist(decal);
+        decal->lastseen = decaltic;
+        RB_AddDecalDrawlist(dl, decal);
     }
 }
 
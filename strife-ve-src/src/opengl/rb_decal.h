@@ -21,6 +21,9 @@
 
 #define NUM_DECAL_POINTS    16
 
+// size of the decal pool. gl_max_decals can't go past this
+#define MAX_DECALS          128
+
 typedef struct
 {
     char        *lumpname;
@@ -58,7 +61,9 @@ typedef enum
 
 typedef struct rbDecal_s
 {
-    int                 tics;
+    int                 spawntic;
+    int                 dietic;
+    int                 lastseen;       // last tic it was added to a draw list
     int                 fadetime;
     int                 lump;
     fixed_t             x;
@@ -67,9 +72,9 @@ typedef struct rbDecal_s
     float               rotation;
     float               scale;
     int                 offset;
-    float               alpha;
     rbDecalVertex_t     points[NUM_DECAL_POINTS];
     int                 numpoints;
+    boolean             bPending;       // still needs carving before it's drawn
     struct sector_s     *stickSector;
     fixed_t             initialStickZ;
     rbDecalType_t       type;
@@ -81,10 +86,13 @@ typedef struct rbDecal_s
     struct rbDecal_s    *snext;
 } rbDecal_t;
 
+struct drawlist_s;
+
 void RB_InitDecals(void);
 void RB_UpdateDecals(void);
 void RB_ClearDecalLinks(void);
-void RB_AddDecals(struct subsector_s *sub);
+void RB_AddDecals(struct drawlist_s *dl, struct subsector_s *sub);
+boolean RB_IsDecalParallelogram(rbDecal_t *decal);
 void RB_SpawnWallDecal(mobj_t *mobj);
 void RB_SpawnFloorDecal(mobj_t *mobj, boolean floor);
 
@@ -32,6 +32,10 @@
 #include "rb_wipe.h"
 #include "rb_hudtext.h"
 #include "rb_things.h"
+#include "rb_dynlights.h"
+#include "rb_vbo.h"
+#include "rb_instance.h"
+#include "rb_profile.h"
 #include "fe_frontend.h"
 #include "m_argv.h"
 #include "i_system.h"
@@ -51,7 +55,7 @@
 //
 //=============================================================================
 
-#define MAXINDICES  0x10000
+#define INDICECHUNK 0x10000
 
 vtx_t drawVertex[MAXDLDRAWCOUNT];
 byte rbSectorLightTable[256];
@@ -75,8 +79,12 @@ static boolean bShowLightCells;
 static int lightGridIndex;
 
 // draw indices
-static word indicecnt = 0;
-static word drawIndices[MAXINDICES];
+static int indicecnt = 0;
+static int maxindices = 0;
+static word *drawIndices = NULL;
+
+// last client side vertex pointer
+static vtx_t *drawPointer = NULL;
 
 //=============================================================================
 //
@@ -84,16 +92,21 @@ static word drawIndices[MAXINDICES];
 //
 //=============================================================================
 
+// post processing. the back buffer is copied into postSceneFBO at
+// most once per pass that changes it and every pass reads from there
+static rbfbo_t postSceneFBO;
+static boolean bPostSceneValid;
+
 // fxaa
-static rbfbo_t fxaaFBO;
 static rbShader_t fxaaShader;
 
-// bloom
-static rbfbo_t bloomFBO;
+// bloom. two blur levels, each with a pair of targets to ping-pong
+// the separable passes between
+static rbfbo_t bloomFBO[2][2];
+static int bloomDownsample;
 static rbShader_t bloomShader;
 
 // blur
-static rbfbo_t blurFBO[2];
 static rbShader_t blurShader;
 
 // motion blur
@@ -218,6 +231,69 @@ void RB_DeleteExtraHudTextures(void)
     RB_DeleteTexture(extraHudTextures[2]);
 }
 
+//
+// RB_GetBloomDownsample
+//
+
+static int RB_GetBloomDownsample(void)
+{
+    return MIN(MAX(rbBloomDownsample, 0), 3);
+}
+
+//
+// RB_InitPostFBOs
+//
+
+static void RB_InitPostFBOs(int w, int h)
+{
+    int i;
+    int j;
+    int shift;
+
+    FBO_InitColorAttachment(&postSceneFBO, 0, w, h);
+
+    if(postSceneFBO.bLoaded)
+    {
+        // motion blur samples past the edges of the screen
+        dglBindTexture(GL_TEXTURE_2D, postSceneFBO.fboTexId);
+        dglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        dglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        RB_UnbindTexture();
+    }
+
+    bloomDownsample = RB_GetBloomDownsample();
+
+    for(i = 0; i < 2; ++i)
+    {
+        // the second level is a quarter the size of the first
+        shift = bloomDownsample + (i << 1);
+
+        for(j = 0; j < 2; ++j)
+        {
+            FBO_InitColorAttachment(&bloomFBO[i][j], 0, MAX(w >> shift, 1), MAX(h >> shift, 1));
+        }
+    }
+
+    bPostSceneValid = false;
+}
+
+//
+// RB_DeletePostFBOs
+//
+
+static void RB_DeletePostFBOs(void)
+{
+    int i;
+
+    FBO_Delete(&postSceneFBO);
+
+    for(i = 0; i < 2; ++i)
+    {
+        FBO_Delete(&bloomFBO[i][0]);
+        FBO_Delete(&bloomFBO[i][1]);
+    }
+}
+
 //
 // RB_InitDrawer
 //
@@ -237,18 +313,16 @@ void RB_InitDrawer(void)
 	SDL_GetWindowSize(windowscreen, &w, &h);
 
     FBO_InitColorAttachment(&spriteFBO, 0, w, h);
-    FBO_InitColorAttachment(&fxaaFBO, 0, w, h);
-    FBO_InitColorAttachment(&bloomFBO, 0, w, h);
-    FBO_InitColorAttachment(&bloomFBO, 0, w, h);
-
-    FBO_InitColorAttachment(&blurFBO[0], 0, w >> 1, h >> 1);
-    FBO_InitColorAttachment(&blurFBO[1], 0, w >> 3, h >> 3);
+    RB_InitPostFBOs(w, h);
 
     SP_LoadProgram(&motionBlurShader, "MBLUR");
     SP_LoadProgram(&fxaaShader, "FXAA");
     SP_LoadProgram(&blurShader, "BLUR");
     SP_LoadProgram(&bloomShader, "BLOOM");
 
+    RB_InitDynLightShader();
+    INST_Init();
+
     bShowLightCells = M_CheckParm("-showlightcells");
 }
 
@@ -263,10 +337,11 @@ void RB_ShutdownDrawer(void)
     SP_Delete(&bloomShader);
     SP_Delete(&motionBlurShader);
 
+    RB_DeleteDynLightShader();
+    INST_Delete();
+
     FBO_Delete(&spriteFBO);
-    FBO_Delete(&blurFBO[0]);
-    FBO_Delete(&blurFBO[1]);
-    FBO_Delete(&bloomFBO);
+    RB_DeletePostFBOs();
 
     RB_DeleteTexture(&whiteTexture);
     RB_DeleteTexture(&lightPointTexture);
@@ -275,6 +350,7 @@ void RB_ShutdownDrawer(void)
     RB_DeleteTexture(&mouseCursorTexture);
     
     RB_PatchBufferShutdown();
+    VBO_DeleteBuffers();
 }
 
 //
@@ -294,9 +370,7 @@ void RB_CheckReInitDrawer(void)
     }
 
     FBO_Delete(&spriteFBO);
-    FBO_Delete(&blurFBO[0]);
-    FBO_Delete(&blurFBO[1]);
-    FBO_Delete(&bloomFBO);
+    RB_DeletePostFBOs();
 
     RB_DeleteTexture(&frameBufferTexture);
     RB_DeleteTexture(&depthBufferTexture);
@@ -305,12 +379,7 @@ void RB_CheckReInitDrawer(void)
     screen_height = h;
 
     FBO_InitColorAttachment(&spriteFBO, 0, w, h);
-    FBO_InitColorAttachment(&fxaaFBO, 0, w, h);
-    FBO_InitColorAttachment(&bloomFBO, 0, w, h);
-    FBO_InitColorAttachment(&bloomFBO, 0, w, h);
-
-    FBO_InitColorAttachment(&blurFBO[0], 0, w >> 1, h >> 1);
-    FBO_InitColorAttachment(&blurFBO[1], 0, w >> 3, h >> 3);
+    RB_InitPostFBOs(w, h);
 
     // reset projection
     dglPushAttrib(GL_VIEWPORT_BIT);
@@ -613,60 +682,125 @@ void RB_DrawMouseCursor(const int x, const int y)
     dglPopMatrix();
 }
 
+//
+// RB_SetDrawPointers
+//
+
+static void RB_SetDrawPointers(vtx_t *vtx)
+{
+    dglTexCoordPointer(2, GL_FLOAT, sizeof(vtx_t), &vtx->tu);
+    dglVertexPointer(3, GL_FLOAT, sizeof(vtx_t), vtx);
+    dglColorPointer(4, GL_UNSIGNED_BYTE, sizeof(vtx_t), &vtx->r);
+}
+
 //
 // RB_BindDrawPointers
 //
 // Sets the pointer to the vertex data on the
-// client side. A better approach would to use
-// vertex buffer objects instead so everything
-// can be done on the GPU side.
-//
-// Having witness numerous issues with ATI cards
-// and seeing how vertex data will always be
-// changing/moving, I just don't see it being worth
-// while to support it
+// client side. Static level geometry is drawn
+// straight out of vertex buffer objects (see
+// rb_vbo.c), but anything that is changing or
+// moving still gets streamed through here
 //
 
 void RB_BindDrawPointers(vtx_t *vtx)
 {
-    static vtx_t *prevpointer = NULL;
-
-    if(prevpointer == vtx)
+    if(drawPointer == vtx)
     {
         return;
     }
 
-    prevpointer = vtx;
+    drawPointer = vtx;
+    RB_SetDrawPointers(vtx);
+}
 
-    dglTexCoordPointer(2, GL_FLOAT, sizeof(vtx_t), &vtx->tu);
-    dglVertexPointer(3, GL_FLOAT, sizeof(vtx_t), vtx);
-    dglColorPointer(4, GL_UNSIGNED_BYTE, sizeof(vtx_t), &vtx->r);
+//
+// RB_RestoreDrawPointers
+//
+// Resends the last client side pointers after
+// they were pointed at a vertex buffer object
+//
+
+void RB_RestoreDrawPointers(void)
+{
+    if(drawPointer)
+    {
+        RB_SetDrawPointers(drawPointer);
+    }
 }
 
 //
-// RB_AddTriangle
+// RB_CheckIndices
 //
 
-void RB_AddTriangle(int v0, int v1, int v2)
+static void RB_CheckIndices(int count)
 {
-    if(indicecnt + 3 >= MAXINDICES)
+    if(indicecnt + count > maxindices)
     {
-        fprintf(stderr, "RB_AddTriangle: Triangle indice overflow");
-        return;
+        // batches can span many segs and leafs, so the index
+        // list grows as needed. the vertices themselves are
+        // still limited to drawVertex so 16-bit indices are fine
+        maxindices += INDICECHUNK;
+        drawIndices = (word*)realloc(drawIndices, maxindices * sizeof(word));
+
+        if(!drawIndices)
+        {
+            I_Error("RB_CheckIndices: failed to grow index list (%i indices)", maxindices);
+        }
     }
+}
+
+//
+// RB_AddTriangle
+//
+
+void RB_AddTriangle(int v0, int v1, int v2)
+{
+    RB_CheckIndices(3);
 
     drawIndices[indicecnt++] = v0;
     drawIndices[indicecnt++] = v1;
     drawIndices[indicecnt++] = v2;
 }
 
+//
+// RB_AddQuad
+//
+// Both triangles of a quad whose four vertices start at v and
+// are laid out top left, top right, bottom left, bottom right
+//
+
+void RB_AddQuad(int v)
+{
+    word *idx;
+
+    RB_CheckIndices(6);
+
+    idx = &drawIndices[indicecnt];
+    idx[0] = v + 0;
+    idx[1] = v + 1;
+    idx[2] = v + 2;
+    idx[3] = v + 3;
+    idx[4] = v + 2;
+    idx[5] = v + 1;
+
+    indicecnt += 6;
+}
+
 //
 // RB_DrawElements
 //
 
 void RB_DrawElements(void)
 {
-    dglDrawElements(GL_TRIANGLES, indicecnt, GL_UNSIGNED_SHORT, drawIndices);
+    if(indicecnt)
+    {
+        dglDrawElements(GL_TRIANGLES, indicecnt, GL_UNSIGNED_SHORT, drawIndices);
+        rbState.numDrawCalls++;
+    }
+
+    VBO_DrawElements();
+    INST_DrawInstances();
 }
 
 //
@@ -676,6 +810,8 @@ void RB_DrawElements(void)
 void RB_ResetElements(void)
 {
     indicecnt = 0;
+    VBO_ResetElements();
+    INST_ResetInstances();
 }
 
 //=============================================================================
@@ -782,7 +918,9 @@ void RB_DrawPSprite(pspdef_t *psp, sector_t *sector, player_t *player)
     width = FIXED2FLOAT(spritewidth[spritenum]);
     height = FIXED2FLOAT(spriteheight[spritenum]);
     
-    if(!(texture = RB_GetTexture(RDT_SPRITE, spritenum, 0)))
+    // the weapon fills a good part of the screen, so it's
+    // never drawn with the placeholder
+    if(!(texture = RB_GetPrioritySpriteTexture(spritenum, 0)))
     {
         return;
     }
@@ -1169,29 +1307,84 @@ void RB_DrawDamageMarkers(player_t *player)
 //
 //=============================================================================
 
+//
+// RB_GrabPostScene
+//
+// Copies the back buffer into postSceneFBO unless it's already there
+//
+
+static void RB_GrabPostScene(void)
+{
+    int w;
+    int h;
+
+    if(bPostSceneValid)
+    {
+        return;
+    }
+
+    SDL_GetWindowSize(windowscreen, &w, &h);
+    FBO_CopyBackBuffer(&postSceneFBO, 0, 0, w, h);
+
+    bPostSceneValid = true;
+}
+
+//
+// RB_DrawPostPass
+//
+// Draws src across the whole of dst with whatever shader is enabled
+//
+
+static void RB_DrawPostPass(rbfbo_t *dst, rbfbo_t *src)
+{
+    vtx_t v[4];
+
+    RB_SetVertexColor(v, 0xff, 0xff, 0xff, 0xff, 4);
+    v[0].z = v[1].z = v[2].z = v[3].z = 0;
+
+    v[0].x = v[2].x = 0;
+    v[0].y = v[1].y = 0;
+    v[1].x = v[3].x = SCREENWIDTH;
+    v[2].y = v[3].y = SCREENHEIGHT;
+
+    v[0].tu = v[2].tu = 0;
+    v[0].tv = v[1].tv = 1;
+    v[1].tu = v[3].tu = 1;
+    v[2].tv = v[3].tv = 0;
+
+    FBO_Bind(dst);
+    FBO_BindImage(src);
+
+    dglPushAttrib(GL_VIEWPORT_BIT);
+    dglViewport(0, 0, dst->fboWidth, dst->fboHeight);
+
+    RB_DrawVtxQuadImmediate(v);
+
+    dglPopAttrib();
+    FBO_UnBind(dst);
+}
+
 //
 // RB_RenderFXAA
 //
 
-void RB_RenderFXAA(void)
+static void RB_RenderFXAA(void)
 {
+    vtx_t v[4];
+    int w;
+    int h;
+
     if(!has_GL_ARB_shader_objects       ||
        !has_GL_ARB_framebuffer_object   ||
+       !postSceneFBO.bLoaded            ||
        !rbEnableFXAA)
     {
         return;
     }
 
-    RB_SetBlend(GLSRC_SRC_ALPHA, GLDST_ONE_MINUS_SRC_ALPHA);
+    SDL_GetWindowSize(windowscreen, &w, &h);
+    RB_GrabPostScene();
 
-#if 1
-	int w;
-	int h;
-	SDL_GetWindowSize(windowscreen, &w, &h);
-	FBO_CopyBackBuffer(&fxaaFBO, 0, 0, w, h);
-#else
-    FBO_CopyBackBuffer(&fxaaFBO, 0, 0, SDL_GetWindowSurface(windowscreen)->w, SDL_GetWindowSurface(windowscreen)->h);
-#endif
     SP_Enable(&fxaaShader);
 
     SP_SetUniform1i(&fxaaShader, "uDiffuse", 0);
@@ -1203,47 +1396,63 @@ void RB_RenderFXAA(void)
     SP_SetUniform1f(&fxaaShader, "uReduceMax", 8.0f);
     SP_SetUniform1f(&fxaaShader, "uReduceMin", 128.0f);
 
-    FBO_Draw(&fxaaFBO, true);
+    RB_SetVertexColor(v, 0xff, 0xff, 0xff, 0xff, 4);
+    v[0].z = v[1].z = v[2].z = v[3].z = 0;
+
+    v[0].x = v[2].x = 0;
+    v[0].y = v[1].y = 0;
+    v[1].x = v[3].x = SCREENWIDTH;
+    v[2].y = v[3].y = SCREENHEIGHT;
+
+    v[0].tu = v[2].tu = 0;
+    v[0].tv = v[1].tv = 1;
+    v[1].tu = v[3].tu = 1;
+    v[2].tv = v[3].tv = 0;
+
+    // the scene copy may have the bloom in it while the back buffer
+    // doesn't, so it has to replace the back buffer outright
+    RB_SetState(GLSTATE_CULL, true);
+    RB_SetCull(GLCULL_FRONT);
+    RB_SetState(GLSTATE_DEPTHTEST, false);
+    RB_SetState(GLSTATE_BLEND, false);
+    RB_SetState(GLSTATE_ALPHATEST, false);
+
+    FBO_BindImage(&postSceneFBO);
+    RB_DrawVtxQuadImmediate(v);
+    FBO_UnBindImage(&postSceneFBO);
+
+    RB_SetState(GLSTATE_BLEND, true);
+    RB_SetState(GLSTATE_ALPHATEST, true);
+    RB_SetState(GLSTATE_DEPTHTEST, true);
+
     RB_DisableShaders();
+    bPostSceneValid = false;
 }
 
 //
 // RB_RenderBloom
 //
+// The bright parts of the scene are picked out straight into the first
+// downsampled level and blurred there, then blurred again at a quarter
+// of that size before being added back to the scene
+//
 
-void RB_RenderBloom(void)
+static void RB_RenderBloom(void)
 {
     static float bloomThreshold;
-    int i, w, h;
     short threshold;
     float curthreshold;
-    int vp[4];
-    vtx_t v[4];
+    rbfbo_t *level;
+    int i;
 
     if(!has_GL_ARB_shader_objects       ||
        !has_GL_ARB_framebuffer_object   ||
+       !postSceneFBO.bLoaded            ||
        !rbEnableBloom)
     {
         return;
     }
 
-    v[0].x = v[2].x = 0;
-    v[0].y = v[1].y = 0;
-    v[1].x = v[3].x = SCREENWIDTH;
-    v[2].y = v[3].y = SCREENHEIGHT;
-
-    v[0].tu = v[2].tu = 0;
-    v[0].tv = v[1].tv = 1;
-    v[1].tu = v[3].tu = 1;
-    v[2].tv = v[3].tv = 0;
-    
-    RB_SetVertexColor(v, 0xff, 0xff, 0xff, 0xff, 4);
-    v[0].z = v[1].z = v[2].z = v[3].z = 0;
-
-    RB_BindDrawPointers(v);
-    RB_AddTriangle(0, 1, 2);
-    RB_AddTriangle(3, 2, 1);
-
     // handle threshold overrides in sectors
     threshold = players[displayplayer].mo->subsector->sector->bloomthreshold;
     curthreshold = rbBloomThreshold;
@@ -1265,80 +1474,68 @@ void RB_RenderBloom(void)
     if(bloomThreshold < 0.5f) bloomThreshold = 0.5f;
     if(bloomThreshold > 1.0f) bloomThreshold = 1.0f;
 
-    // pass 1: bloom
-    RB_BindFrameBuffer(&frameBufferTexture);
-    FBO_Bind(&bloomFBO);
-    SP_Enable(&bloomShader);
-    SP_SetUniform1i(&bloomShader, "uDiffuse", 0);
-    SP_SetUniform1f(&bloomShader, "uBloomThreshold", bloomThreshold);
+    RB_GrabPostScene();
 
     RB_SetState(GLSTATE_CULL, true);
     RB_SetCull(GLCULL_FRONT);
     RB_SetState(GLSTATE_DEPTHTEST, false);
-    RB_SetState(GLSTATE_BLEND, true);
+    RB_SetState(GLSTATE_BLEND, false);
     RB_SetState(GLSTATE_ALPHATEST, false);
 
-    RB_DrawElements();
+    // pass 1: bloom
+    SP_Enable(&bloomShader);
+    SP_SetUniform1i(&bloomShader, "uDiffuse", 0);
+    SP_SetUniform1f(&bloomShader, "uBloomThreshold", bloomThreshold);
 
-    FBO_UnBind(&bloomFBO);
+    RB_DrawPostPass(&bloomFBO[0][0], &postSceneFBO);
 
     SP_Enable(&blurShader);
     SP_SetUniform1i(&blurShader, "uDiffuse", 0);
     SP_SetUniform1f(&blurShader, "uBlurRadius", 1.0f);
 
-#if 1
-	SDL_GetWindowSize(windowscreen, &w, &h);
-#else
-    w = SDL_GetWindowSurface(windowscreen)->w;
-    h = SDL_GetWindowSurface(windowscreen)->h;
-#endif
-
-    // pass 2: blur
+    // pass 2: blur. both levels read the first target of level 0: level
+    // 0 blurs the extracted image there in place, and level 1 then
+    // downsamples that blurred result in its horizontal pass
     for(i = 0; i < 2; ++i)
     {
+        level = bloomFBO[i];
+
         // horizonal
-        FBO_CopyFrameBuffer(&blurFBO[i], &bloomFBO, w, h);
-        FBO_Bind(&bloomFBO);
-        FBO_BindImage(&blurFBO[i]);
-        SP_SetUniform1f(&blurShader, "uSize", (float)blurFBO[i].fboWidth);
+        SP_SetUniform1f(&blurShader, "uSize", (float)bloomFBO[0][0].fboWidth);
         SP_SetUniform1i(&blurShader, "uDirection", 1);
-
-        RB_DrawElements();
-
-        FBO_UnBind(&bloomFBO);
+        RB_DrawPostPass(&level[1], &bloomFBO[0][0]);
 
         // vertical
-        FBO_CopyFrameBuffer(&blurFBO[i], &bloomFBO, w, h);
-        FBO_Bind(&bloomFBO);
-        FBO_BindImage(&blurFBO[i]);
-        SP_SetUniform1f(&blurShader, "uSize", (float)blurFBO[i].fboHeight);
+        SP_SetUniform1f(&blurShader, "uSize", (float)level[1].fboHeight);
         SP_SetUniform1i(&blurShader, "uDirection", 0);
-        
-        RB_DrawElements();
-
-        FBO_UnBind(&bloomFBO);
+        RB_DrawPostPass(&level[0], &level[1]);
     }
 
-    RB_ResetElements();
     RB_DisableShaders();
 
-    dglGetIntegerv(GL_VIEWPORT, vp);
-
-    // resize viewport to account for FBO dimentions
-    dglPushAttrib(GL_VIEWPORT_BIT);
-    dglViewport(0, 0, bloomFBO.fboWidth, bloomFBO.fboHeight);
-    
+    // add it back in. if fxaa is going to read the scene copy anyway,
+    // it may as well go there and save copying the back buffer again
     RB_SetBlend(GLSRC_ONE_MINUS_DST_COLOR, GLDST_ONE);
-    FBO_Draw(&bloomFBO, true);
 
-    dglPopAttrib();
+    if(rbEnableFXAA)
+    {
+        RB_SetState(GLSTATE_BLEND, true);
+        RB_SetState(GLSTATE_ALPHATEST, true);
+        RB_DrawPostPass(&postSceneFBO, &bloomFBO[1][0]);
+        RB_SetState(GLSTATE_DEPTHTEST, true);
+    }
+    else
+    {
+        FBO_Draw(&bloomFBO[1][0], true);
+        bPostSceneValid = false;
+    }
 }
 
 //
 // RB_RenderMotionBlur
 //
 
-void RB_RenderMotionBlur(void)
+static void RB_RenderMotionBlur(void)
 {
     matrix inverseMat;
     matrix motionMat;
@@ -1446,7 +1643,16 @@ void RB_RenderMotionBlur(void)
     
     // bind frame buffer to texture 0
     RB_SetTextureUnit(0);
-    RB_BindFrameBuffer(&frameBufferTexture);
+
+    if(postSceneFBO.bLoaded)
+    {
+        RB_GrabPostScene();
+        FBO_BindImage(&postSceneFBO);
+    }
+    else
+    {
+        RB_BindFrameBuffer(&frameBufferTexture);
+    }
     
     // setup quad vertices
     RB_SetVertexColor(v, 0xff, 0xff, 0xff, 0xff, 4);
@@ -1468,6 +1674,44 @@ void RB_RenderMotionBlur(void)
     RB_SetState(GLSTATE_TEXTURE1, false);
     RB_SetTextureUnit(0);
     RB_DisableShaders();
+
+    bPostSceneValid = false;
+}
+
+//
+// RB_RenderPostProcess
+//
+// Runs the post processing passes in order. The last pass to
+// run leaves the finished image in the back buffer
+//
+
+void RB_RenderPostProcess(void)
+{
+    int w;
+    int h;
+
+    // the scene copy is from last frame
+    bPostSceneValid = false;
+
+    if(has_GL_ARB_framebuffer_object && postSceneFBO.bLoaded &&
+       bloomDownsample != RB_GetBloomDownsample())
+    {
+        SDL_GetWindowSize(windowscreen, &w, &h);
+        RB_DeletePostFBOs();
+        RB_InitPostFBOs(w, h);
+    }
+
+    RB_ProfileBegin("Motion Blur");
+    RB_RenderMotionBlur();
+    RB_ProfileEnd();
+
+    RB_ProfileBegin("Bloom");
+    RB_RenderBloom();
+    RB_ProfileEnd();
+
+    RB_ProfileBegin("FXAA");
+    RB_RenderFXAA();
+    RB_ProfileEnd();
 }
 
 //=============================================================================
@@ -1675,6 +1919,7 @@ void RB_DrawScene(void)
         
         RB_BindTexture(&lightPointTexture);
         DL_ProcessDrawList(DLT_DYNLIGHT);
+        RB_DisableShaders();
         
         RB_SetDepth(GLFUNC_LEQUAL);
     }
@@ -46,7 +46,9 @@ void RB_DrawScreenTexture(rbTexture_t *texture, const int width, const int heigh
 void RB_DrawStretchPic(const char *pic, const float x, const float y, const int width, const int height);
 void RB_DrawMouseCursor(const int x, const int y);
 void RB_BindDrawPointers(vtx_t *vtx);
+void RB_RestoreDrawPointers(void);
 void RB_AddTriangle(int v0, int v1, int v2);
+void RB_AddQuad(int v);
 void RB_DrawElements(void);
 void RB_ResetElements(void);
 void RB_RenderPlayerSprites(player_t *player);
@@ -55,9 +57,7 @@ void RB_DrawDamageMarkers(player_t *player);
 void RB_DrawExtraHudPics(void);
 void RB_DrawPlayerNames(void);
 void RB_DrawScene(void);
-void RB_RenderMotionBlur(void);
-void RB_RenderFXAA(void);
-void RB_RenderBloom(void);
+void RB_RenderPostProcess(void);
 
 //
 // RB_DrawVtxQuadImmediate
@@ -23,12 +23,43 @@
 #include "rb_data.h"
 #include "rb_draw.h"
 #include "rb_things.h"
+#include "rb_dynlights.h"
+#include "rb_decal.h"
+#include "rb_instance.h"
 #include "rb_config.h"
+#include "rb_profile.h"
 #include "i_system.h"
+#include "i_timer.h"
 #include "z_zone.h"
 
+// a batch is flushed early once it gets this close to filling
+// drawVertex. leaves the largest single entry (a subsector with
+// a huge number of leafs) plenty of room to fit
+#define DL_MAXBATCHVERTICES (MAXDLDRAWCOUNT - 0x1000)
+
 drawlist_t drawlist[NUMDRAWLISTS];
 
+// profiler scope names, in drawlisttag_e order
+static const char *drawListNames[NUMDRAWLISTS] =
+{
+    "Walls",
+    "Masked Walls",
+    "Translucent Walls",
+    "Bright",
+    "Bright Masked",
+    "Flats",
+    "Sprites",
+    "Translucent Sprites",
+    "Bright Sprites",
+    "Sprite Outlines",
+    "Automap",
+    "Sky",
+    "Clip Lines",
+    "Decals",
+    "Lightmaps",
+    "Dynamic Lights"
+};
+
 //
 // DL_AddVertexList
 //
@@ -40,18 +71,29 @@ vtxlist_t *DL_AddVertexList(drawlist_t *dl)
     // exceeded max capacity?
     if(dl->index == dl->max)
     {
-        vtxlist_t *old = dl->list;
-        vtxlist_t *newlist;
-
         // expand stack
         dl->max += 128;
 
-        // allocate new array
-        newlist = (vtxlist_t*)Z_Calloc(dl->max, sizeof(vtxlist_t), PU_LEVEL, NULL);
-        memcpy(newlist, old, dl->index * sizeof(vtxlist_t));
+        if(dl->bShard)
+        {
+            // the zone isn't safe to use from worker threads
+            if(!(dl->list = (vtxlist_t*)realloc(dl->list, dl->max * sizeof(vtxlist_t))))
+            {
+                I_Error("DL_AddVertexList: failed to grow draw list shard");
+            }
+        }
+        else
+        {
+            vtxlist_t *old = dl->list;
+            vtxlist_t *newlist;
 
-        dl->list = newlist;
-        Z_Free(old);
+            // allocate new array
+            newlist = (vtxlist_t*)Z_Calloc(dl->max, sizeof(vtxlist_t), PU_LEVEL, NULL);
+            memcpy(newlist, old, dl->index * sizeof(vtxlist_t));
+
+            dl->list = newlist;
+            Z_Free(old);
+        }
     }
 
     list = &dl->list[dl->index];
@@ -64,6 +106,62 @@ vtxlist_t *DL_AddVertexList(drawlist_t *dl)
     return &dl->list[dl->index++];
 }
 
+//
+// DL_InitShard
+//
+// Sets up a private draw list that a worker thread can fill
+// without touching the zone. It is never freed.
+//
+
+void DL_InitShard(drawlist_t *dl, drawlisttag_e tag)
+{
+    memset(dl, 0, sizeof(drawlist_t));
+
+    dl->max     = 128;
+    dl->drawTag = tag;
+    dl->bShard  = true;
+
+    if(!(dl->list = (vtxlist_t*)malloc(dl->max * sizeof(vtxlist_t))))
+    {
+        I_Error("DL_InitShard: failed to allocate draw list shard");
+    }
+}
+
+//
+// DL_AppendDrawList
+//
+// Copies all entries of src onto the end of dl
+//
+
+void DL_AppendDrawList(drawlist_t *dl, drawlist_t *src)
+{
+    if(src->index == 0)
+    {
+        return;
+    }
+
+    if(dl->index + src->index > dl->max)
+    {
+        vtxlist_t *newlist;
+        int max = dl->max;
+
+        while(max < dl->index + src->index)
+        {
+            max += 128;
+        }
+
+        newlist = (vtxlist_t*)Z_Calloc(max, sizeof(vtxlist_t), PU_LEVEL, NULL);
+        memcpy(newlist, dl->list, dl->index * sizeof(vtxlist_t));
+
+        Z_Free(dl->list);
+        dl->list = newlist;
+        dl->max = max;
+    }
+
+    memcpy(&dl->list[dl->index], src->list, src->index * sizeof(vtxlist_t));
+    dl->index += src->index;
+}
+
 //
 // SortTranWalls
 //
@@ -80,16 +178,29 @@ static int SortTranWalls(const void *a, const void *b)
 //
 // Sorting
 //
-// haleyjd 20140919: [SVE] mergesort, even a relatively naive implementation,
-// is an order of magnitude faster than libc qsort for sprites.
+// Lists are sorted as 64-bit keys rather than moving the vtxlist_t entries
+// around. The upper 32 bits hold what is being sorted on and the lower 32
+// bits the index of the entry the key belongs to. The key buffers belong to
+// the draw list and only grow along with it.
 //
 //=============================================================================
 
+#define DL_KEYINDEX(key)    ((int)((key) & 0xffffffff))
+
+// bias the signed distance so it compares the same as an unsigned value
+#define DL_SPRITEKEY(dist)  ((uint64_t)((uint32_t)(dist) ^ 0x80000000) << 32)
+
 //
 // merge_sprite
 //
+// haleyjd 20140919: [SVE] mergesort, even a relatively naive implementation,
+// is an order of magnitude faster than libc qsort for sprites.
+//
+// Ties must be resolved exactly as before since they decide which sprite
+// is drawn on top, so only the data being moved around has changed here.
+//
 
-void merge_sprite(vtxlist_t *list, vtxlist_t *aux, int left, int right, int rightEnd)
+static void merge_sprite(uint64_t *keys, uint64_t *aux, int left, int right, int rightEnd)
 {
     int i, num, temp, leftEnd = right - 1;
     temp = left;
@@ -97,29 +208,26 @@ void merge_sprite(vtxlist_t *list, vtxlist_t *aux, int left, int right, int righ
 
     while(left <= leftEnd && right <= rightEnd)
     {
-        rbVisSprite_t *al = list[left].data;
-        rbVisSprite_t *ar = list[right].data;
-
-        if(al->dist > ar->dist)
+        if((keys[left] >> 32) > (keys[right] >> 32))
         {
-            aux[temp++] = list[left++];
+            aux[temp++] = keys[left++];
         }
         else
         {
-            aux[temp++] = list[right++];
+            aux[temp++] = keys[right++];
         }
     }
     while(left <= leftEnd)
     {
-        aux[temp++] = list[left++];
+        aux[temp++] = keys[left++];
     }
     while(right <= rightEnd)
     {
-        aux[temp++] = list[right++];
+        aux[temp++] = keys[right++];
     }
     for(i = 1; i <= num; i++, rightEnd--)
     {
-        list[rightEnd] = aux[rightEnd];
+        keys[rightEnd] = aux[rightEnd];
     }
 }
 
@@ -127,79 +235,234 @@ void merge_sprite(vtxlist_t *list, vtxlist_t *aux, int left, int right, int righ
 // msort_sprite
 //
 
-void msort_sprite(vtxlist_t *list, vtxlist_t *temp, int left, int right)
+static void msort_sprite(uint64_t *keys, uint64_t *temp, int left, int right)
 {
     int center;
 
     if(left < right)
     {
         center = (left+right) / 2;
-        msort_sprite(list, temp, left, center);
-        msort_sprite(list, temp, center+1, right);
-        merge_sprite(list, temp, left, center+1, right);
+        msort_sprite(keys, temp, left, center);
+        msort_sprite(keys, temp, center+1, right);
+        merge_sprite(keys, temp, left, center+1, right);
     }
 }
 
 //
-// merge_wall
+// radix_sort
 //
-// Also for regular walls, it's worth it.
+// Stable LSD radix sort on the upper half of the keys. Passes where every
+// key has the same digit are skipped, which for texture ids usually leaves
+// only one or two of them. Returns the buffer holding the result.
 //
 
-void merge_wall(vtxlist_t *list, vtxlist_t *aux, int left, int right, int rightEnd)
+static uint64_t *radix_sort(uint64_t *keys, uint64_t *temp, int count)
 {
-    int i, num, temp, leftEnd = right - 1;
-    temp = left;
-    num = rightEnd - left + 1;
+    int counts[4][256];
+    int pass;
+    int i;
 
-    while(left <= leftEnd && right <= rightEnd)
+    memset(counts, 0, sizeof(counts));
+
+    for(i = 0; i < count; ++i)
+    {
+        uint32_t k = (uint32_t)(keys[i] >> 32);
+
+        counts[0][k & 0xff]++;
+        counts[1][(k >> 8) & 0xff]++;
+        counts[2][(k >> 16) & 0xff]++;
+        counts[3][k >> 24]++;
+    }
+
+    for(pass = 0; pass < 4; ++pass)
     {
-        if(list[left].texid > list[right].texid)
+        int *c = counts[pass];
+        int shift = 32 + (pass << 3);
+        int sum = 0;
+        uint64_t *swap;
+
+        if(c[(keys[0] >> shift) & 0xff] == count)
         {
-            aux[temp++] = list[left++];
+            continue;
         }
-        else
+
+        for(i = 0; i < 256; ++i)
         {
-            aux[temp++] = list[right++];
+            int n = c[i];
+
+            c[i] = sum;
+            sum += n;
         }
+
+        for(i = 0; i < count; ++i)
+        {
+            temp[c[(keys[i] >> shift) & 0xff]++] = keys[i];
+        }
+
+        swap = keys;
+        keys = temp;
+        temp = swap;
     }
-    while(left <= leftEnd)
-    {
-        aux[temp++] = list[left++];
-    }
-    while(right <= rightEnd)
+
+    return keys;
+}
+
+//
+// End sorting
+//
+//=============================================================================
+
+//
+// DL_CheckSortBuffers
+//
+
+static void DL_CheckSortBuffers(drawlist_t *dl)
+{
+    if(dl->sortMax >= dl->max)
     {
-        aux[temp++] = list[right++];
+        return;
     }
-    for(i = 1; i <= num; i++, rightEnd--)
+
+    if(dl->sortKeys)
     {
-        list[rightEnd] = aux[rightEnd];
+        Z_Free(dl->sortKeys);
+        Z_Free(dl->sortTemp);
     }
+
+    dl->sortMax = dl->max;
+    dl->sortKeys = (uint64_t*)Z_Malloc(dl->sortMax * sizeof(uint64_t), PU_LEVEL, NULL);
+    dl->sortTemp = (uint64_t*)Z_Malloc(dl->sortMax * sizeof(uint64_t), PU_LEVEL, NULL);
 }
 
 //
-// msort_wall
+// DL_SortDrawList
+//
+// Returns the keys in the order the entries should be drawn in
 //
 
-void msort_wall(vtxlist_t *list, vtxlist_t *temp, int left, int right)
+static uint64_t *DL_SortDrawList(drawlist_t *dl, int tag)
 {
-    if(left < right)
+    uint64_t *keys;
+    int i;
+
+    DL_CheckSortBuffers(dl);
+    keys = dl->sortKeys;
+
+    switch(tag)
     {
-        int center = (left+right) / 2;
-        msort_wall(list, temp, left, center);
-        msort_wall(list, temp, center+1, right);
-        merge_wall(list, temp, left, center+1, right);
+    case DLT_DYNLIGHT:
+        if(!RB_DynLightSinglePass())
+        {
+            for(i = 0; i < dl->index; ++i)
+            {
+                keys[i] = i;
+            }
+            return keys;
+        }
+
+        // the lights only add or scale what is already there, so the
+        // order doesn't matter. group the surfaces by light mask
+        for(i = 0; i < dl->index; ++i)
+        {
+            keys[i] = ((uint64_t)dl->list[i].texid << 32) | i;
+        }
+
+        return radix_sort(keys, dl->sortTemp, dl->index);
+
+    case DLT_TRANSWALL:
+        // these are few and far between; keep the far to near
+        // order exactly as it always was
+        qsort(dl->list, dl->index, sizeof(vtxlist_t), SortTranWalls);
+
+        for(i = 0; i < dl->index; ++i)
+        {
+            keys[i] = i;
+        }
+        return keys;
+
+    case DLT_SPRITE:
+    case DLT_SPRITEALPHA:
+    case DLT_SPRITEOUTLINE:
+        for(i = 0; i < dl->index; ++i)
+        {
+            keys[i] = DL_SPRITEKEY(((rbVisSprite_t*)dl->list[i].data)->dist) | i;
+        }
+
+        msort_sprite(keys, dl->sortTemp, 0, dl->index - 1);
+        return keys;
+
+    default:
+        // everything else only needs to be grouped by texture
+        for(i = 0; i < dl->index; ++i)
+        {
+            keys[i] = ((uint64_t)dl->list[i].texid << 32) | i;
+        }
+
+        return radix_sort(keys, dl->sortTemp, dl->index);
     }
 }
 
 //
-// End sorting
+// DL_SameBatch
+//
+// Entries can only be drawn together if everything the
+// preprocess and postprocess callbacks would set up is the
+// same for both. Walls and flats in the brightmap list share
+// texids, so the callbacks themselves are compared too.
 //
-//=============================================================================
+
+static boolean DL_SameBatch(int tag, vtxlist_t *a, vtxlist_t *b)
+{
+    int page;
+
+    if(a->preprocess != b->preprocess ||
+       a->postprocess != b->postprocess ||
+       (a->flags & DLF_STATEFLAGS) != (b->flags & DLF_STATEFLAGS))
+    {
+        return false;
+    }
+
+    switch(tag)
+    {
+    case DLT_SPRITE:
+    case DLT_SPRITEALPHA:
+    case DLT_SPRITEBRIGHT:
+        // sprites packed into the same atlas page share a texture
+        page = RB_GetSpriteAtlasPage(a->texid, a->params);
+
+        if(page != -1 && page == RB_GetSpriteAtlasPage(b->texid, b->params))
+        {
+            return true;
+        }
+
+        // params holds the translation
+        return (a->texid == b->texid && a->params == b->params);
+
+    case DLT_DECAL:
+        // instanced quads are drawn after the batch's triangles, so
+        // decals fanned into triangles can't share a batch with them
+        // without changing the order overlapping decals blend in
+        if(INST_Enabled() &&
+           RB_IsDecalParallelogram((rbDecal_t*)a->data) !=
+           RB_IsDecalParallelogram((rbDecal_t*)b->data))
+        {
+            return false;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return (a->texid == b->texid);
+}
 
 //
 // DL_ProcessDrawList
 //
+// Draws the list in sorted order, flushing only when the next
+// entry needs different state or drawVertex is close to full
+//
 
 void DL_ProcessDrawList(int tag)
 {
@@ -207,7 +470,11 @@ void DL_ProcessDrawList(int tag)
     int i;
     int drawcount;
     vtxlist_t* head;
-    vtxlist_t* tail;
+    vtxlist_t* rover;
+    uint64_t *keys;
+    uint64_t sortStart;
+    rbTexture_t *lastTexture = NULL;
+    dtexture lastTexid = 0;
 
     if(tag < 0 && tag >= NUMDRAWLISTS)
     {
@@ -217,38 +484,17 @@ void DL_ProcessDrawList(int tag)
     dl = &drawlist[tag];
     drawcount = 0;
 
-    if(dl->max > 0)
+    if(dl->max > 0 && dl->index > 0)
     {
-        if(tag != DLT_DYNLIGHT)
-        {
-            if(tag != DLT_SPRITE && tag != DLT_SPRITEALPHA && tag != DLT_SPRITEOUTLINE)
-            {
-                if(tag == DLT_TRANSWALL)
-                {
-                    qsort(dl->list, dl->index, sizeof(vtxlist_t), SortTranWalls);
-                }
-                else
-                {
-                    vtxlist_t *temp = malloc(dl->index * sizeof(vtxlist_t));
-                    msort_wall(dl->list, temp, 0, dl->index - 1);
-                    free(temp);
-                }
-            }
-            else
-            {
-                vtxlist_t *temp = malloc(dl->index * sizeof(vtxlist_t));
-                msort_sprite(dl->list, temp, 0, dl->index - 1);
-                free(temp);
-            }
-        }
-        
-        tail = &dl->list[dl->index];
+        RB_ProfileBegin(drawListNames[tag]);
+
+        sortStart = I_GetTimeUS();
+        keys = DL_SortDrawList(dl, tag);
+        rbState.sortTime += (int)(I_GetTimeUS() - sortStart);
 
         for(i = 0; i < dl->index; ++i)
         {
-            vtxlist_t *rover;
-
-            head = &dl->list[i];
+            head = &dl->list[DL_KEYINDEX(keys[i])];
 
             // break if no data found in list
             if(!head->data)
@@ -260,18 +506,17 @@ void DL_ProcessDrawList(int tag)
             {
                 if(!head->procfunc(head, &drawcount))
                 {
-                    rover = &dl->list[i+1];
                     continue;
                 }
             }
 
-            rover = &dl->list[i+1];
-
-            if(tag != DLT_SPRITE)
+            if(drawcount < DL_MAXBATCHVERTICES)
             {
-                if(rover != tail)
+                if(i + 1 < dl->index)
                 {
-                    if(head->texid == rover->texid)
+                    rover = &dl->list[DL_KEYINDEX(keys[i+1])];
+
+                    if(DL_SameBatch(tag, head, rover))
                     {
                         continue;
                     }
@@ -316,10 +561,19 @@ void DL_ProcessDrawList(int tag)
                     break;
                 }
 
-                texture = RB_GetTexture(dataType, head->texid, 0);
+                // consecutive batches with the same texture only
+                // happen when a batch was split, so skip the lookup
+                if(head->texid != lastTexid || !lastTexture)
+                {
+                    lastTexture = RB_GetTexture(dataType, head->texid, 0);
+                    lastTexid = head->texid;
+                }
+
+                texture = lastTexture;
 
                 if(texture)
                 {
+                    // parameters are set on whatever is bound
                     RB_BindTexture(texture);
                     RB_ChangeTexParameters(texture, TC_REPEAT, TEXFILTER);
                 }
@@ -337,6 +591,8 @@ void DL_ProcessDrawList(int tag)
             rbState.numDrawnVertices += drawcount;
             drawcount = 0;
         }
+
+        RB_ProfileEnd();
     }
 }
 
@@ -426,6 +682,12 @@ void DL_Init(void)
         dl->max     = 128;
         dl->list    = Z_Calloc(1, sizeof(vtxlist_t) * dl->max, PU_LEVEL, 0);
         dl->drawTag = i;
+        dl->bShard  = false;
+
+        // sort buffers are allocated on first use
+        dl->sortKeys    = NULL;
+        dl->sortTemp    = NULL;
+        dl->sortMax     = 0;
     }
 }
 
@@ -21,9 +21,13 @@
 
 typedef enum
 {
-    DLF_CEILING = BIT(0)
+    DLF_CEILING     = BIT(0),
+    DLF_TRANSLUCENT = BIT(1)    // preprocess picks a different blend mode
 } drawlistflag_e;
 
+// flags that change render state and so can't share a batch
+#define DLF_STATEFLAGS  (DLF_TRANSLUCENT)
+
 typedef enum
 {
     DLT_WALL,
@@ -58,17 +62,23 @@ typedef struct vtxlist_s
     drawlisttag_e   drawTag;
 } vtxlist_t;
 
-typedef struct
+typedef struct drawlist_s
 {
     vtxlist_t       *list;
     int             index;
     int             max;
     drawlisttag_e   drawTag;
+    boolean         bShard;         // filled by a worker thread; lives outside the zone
+    uint64_t        *sortKeys;
+    uint64_t        *sortTemp;
+    int             sortMax;
 } drawlist_t;
 
 extern drawlist_t drawlist[NUMDRAWLISTS];
 
 vtxlist_t *DL_AddVertexList(drawlist_t *dl);
+void DL_InitShard(drawlist_t *dl, drawlisttag_e tag);
+void DL_AppendDrawList(drawlist_t *dl, drawlist_t *src);
 int DL_GetDrawListSize(int tag);
 void DL_BeginDrawList(void);
 void DL_ProcessDrawList(int tag);
@@ -22,6 +22,10 @@
 #include "rb_main.h"
 #include "rb_dynlights.h"
 #include "rb_view.h"
+#include "rb_gl.h"
+#include "rb_drawlist.h"
+#include "rb_shader.h"
+#include "rb_config.h"
 #include "p_local.h"
 #include "m_bbox.h"
 #include "r_defs.h"
@@ -392,7 +396,7 @@ void RB_AddDynLights(void)
     s1 = (players[displayplayer].mo->subsector - subsectors);
     vis = &pvsmatrix[(((numsubsectors + 7) / 8) * s1)];
 
-    for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
     {
         if(th->function.acp1 == (actionf_p1)P_MobjThinker)
         {
@@ -471,3 +475,163 @@ void RB_AddDynLights(void)
         }
     }
 }
+
+//=============================================================================
+//
+// Single pass lighting
+//
+// Instead of redrawing a surface once for every light touching its
+// subsector, the surface is drawn once with all of them (the light mask
+// of the subsector travels in the draw list's texid) and the fragment
+// shader adds them up. The falloff is the same projected LIGHT texture
+// the multipass path maps onto each surface.
+//
+//=============================================================================
+
+static rbShader_t dynLightShader;
+static boolean bDynLightShader = false;
+
+static const char *dynLightVertexSource =
+    "#version 110\n"
+    "varying vec3 worldPos;\n"
+    "void main()\n"
+    "{\n"
+    "    worldPos = gl_Vertex.xyz;\n"
+    // must match the fixed function depth exactly for GLFUNC_EQUAL
+    "    gl_Position = ftransform();\n"
+    "}\n";
+
+static const char *dynLightFragmentSource =
+    "#version 110\n"
+    "uniform sampler2D uLightTexture;\n"
+    "uniform vec3 uViewPos;\n"
+    "uniform float uFastBlend;\n"
+    "uniform int uNumLights;\n"
+    "uniform vec4 uLightPos[32];\n"
+    "uniform vec4 uLightColor[32];\n"
+    "varying vec3 worldPos;\n"
+    "void main()\n"
+    "{\n"
+    "    vec3 normal = normalize(cross(dFdx(worldPos), dFdy(worldPos)));\n"
+    "    vec3 added = vec3(0.0);\n"
+    "    vec3 scale = vec3(1.0);\n"
+    "    int i;\n"
+    "    if(dot(normal, uViewPos - worldPos) < 0.0)\n"
+    "        normal = -normal;\n"
+    "    for(i = 0; i < 32; i++)\n"
+    "    {\n"
+    "        vec3 delta;\n"
+    "        vec3 color;\n"
+    "        float dist;\n"
+    "        float radius;\n"
+    "        if(i >= uNumLights)\n"
+    "            break;\n"
+    "        radius = uLightPos[i].w;\n"
+    "        delta = uLightPos[i].xyz - worldPos;\n"
+    "        dist = dot(delta, normal);\n"
+    "        if(dist < 0.0)\n"
+    "            continue;\n"
+    "        delta -= normal * dist;\n"
+    "        color = texture2D(uLightTexture, vec2(0.5 + length(delta) / radius, 0.5)).rgb *\n"
+    "                uLightColor[i].rgb;\n"
+    "        added += color * (1.0 - clamp(dist / (radius * 0.5), 0.0, 1.0));\n"
+    "        scale *= (1.0 + color);\n"
+    "    }\n"
+    "    gl_FragColor = vec4(mix(scale - 1.0, added, uFastBlend), 1.0);\n"
+    "}\n";
+
+//
+// RB_InitDynLightShader
+//
+
+void RB_InitDynLightShader(void)
+{
+    bDynLightShader = false;
+
+    if(!has_GL_ARB_shader_objects)
+    {
+        return;
+    }
+
+    SP_LoadProgramDefault(&dynLightShader, "DLIGHT", dynLightVertexSource, dynLightFragmentSource);
+
+    if(dynLightShader.bLoaded && !dynLightShader.bHasErrors)
+    {
+        bDynLightShader = true;
+    }
+    else
+    {
+        fprintf(stderr, "RB_InitDynLightShader: using multipass dynamic lights\n");
+    }
+}
+
+//
+// RB_DeleteDynLightShader
+//
+
+void RB_DeleteDynLightShader(void)
+{
+    SP_Delete(&dynLightShader);
+    bDynLightShader = false;
+}
+
+//
+// RB_DynLightSinglePass
+//
+
+boolean RB_DynLightSinglePass(void)
+{
+    return (rbDynamicLightShader && bDynLightShader);
+}
+
+//
+// RB_PreProcessDynLights
+//
+// Loads the lights in the batch's mask into the shader
+//
+
+boolean RB_PreProcessDynLights(vtxlist_t *vl)
+{
+    static float pos[MAX_DYNLIGHTS * 4];
+    static float color[MAX_DYNLIGHTS * 4];
+    unsigned int mask = vl->texid;
+    rbDynLight_t *light;
+    int count = 0;
+    int i;
+
+    for(i = 0; i < RB_GetDynLightCount(); ++i)
+    {
+        if(!(mask & (1 << i)))
+        {
+            continue;
+        }
+
+        light = &dynlightlist[i];
+
+        pos[count * 4 + 0] = light->x;
+        pos[count * 4 + 1] = light->y;
+        pos[count * 4 + 2] = light->z;
+        pos[count * 4 + 3] = light->radius;
+
+        color[count * 4 + 0] = (float)light->rgb[0] / 255.0f;
+        color[count * 4 + 1] = (float)light->rgb[1] / 255.0f;
+        color[count * 4 + 2] = (float)light->rgb[2] / 255.0f;
+        color[count * 4 + 3] = 1.0f;
+
+        count++;
+    }
+
+    SP_Enable(&dynLightShader);
+    SP_SetUniform1i(&dynLightShader, "uLightTexture", 0);
+    SP_SetUniform3f(&dynLightShader, "uViewPos", rbPlayerView.x, rbPlayerView.y, rbPlayerView.z);
+    SP_SetUniform1f(&dynLightShader, "uFastBlend", rbDynamicLightFastBlend ? 1.0f : 0.0f);
+    SP_SetUniform1i(&dynLightShader, "uNumLights", count);
+
+    if(count > 0)
+    {
+        SP_SetUniform4fv(&dynLightShader, "uLightPos", count, pos);
+        SP_SetUniform4fv(&dynLightShader, "uLightColor", count, color);
+    }
+
+    return true;
+}
@@ -18,6 +18,8 @@
 
 #define MAX_DYNLIGHTS   32
 
+struct vtxlist_s;
+
 typedef struct
 {
     mobj_t      *thing;
@@ -36,4 +38,9 @@ void RB_AddDynLights(void);
 rbDynLight_t *RB_GetDynLight(const int num);
 unsigned int RB_SubsectorMarked(const int num);
 
+void RB_InitDynLightShader(void);
+void RB_DeleteDynLightShader(void);
+boolean RB_DynLightSinglePass(void);
+boolean RB_PreProcessDynLights(struct vtxlist_s *vl);
+
 #endif
@@ -31,6 +31,7 @@
 #include "rb_wallshade.h"
 #include "rb_lightgrid.h"
 #include "rb_dynlights.h"
+#include "rb_instance.h"
 #include "p_local.h"
 #include "r_defs.h"
 #include "r_state.h"
@@ -245,8 +246,7 @@ boolean RB_GenerateLowerSeg(vtxlist_t *vl, int *drawcount)
             v[2].tv = v[3].tv = rowoffs + (bbottom - bottom) / height;
         }
         
-        RB_AddTriangle(*drawcount + 0, *drawcount + 1, *drawcount + 2);
-        RB_AddTriangle(*drawcount + 3, *drawcount + 2, *drawcount + 1);
+        RB_AddQuad(*drawcount);
 
         *drawcount += 4;
         return true;
@@ -335,8 +335,7 @@ boolean RB_GenerateUpperSeg(vtxlist_t *vl, int *drawcount)
             v[0].tv = v[1].tv = 1 + rowoffs - (top - btop) / height;
         }
         
-        RB_AddTriangle(*drawcount + 0, *drawcount + 1, *drawcount + 2);
-        RB_AddTriangle(*drawcount + 3, *drawcount + 2, *drawcount + 1);
+        RB_AddQuad(*drawcount);
 
         *drawcount += 4;
         return true;
@@ -469,8 +468,7 @@ boolean RB_GenerateMiddleSeg(vtxlist_t *vl, int *drawcount)
         v[2].tv = v[3].tv = rowoffs + (top - bottom) / height;
     }
     
-    RB_AddTriangle(*drawcount + 0, *drawcount + 1, *drawcount + 2);
-    RB_AddTriangle(*drawcount + 3, *drawcount + 2, *drawcount + 1);
+    RB_AddQuad(*drawcount);
 
     *drawcount += 4;
     return true;
@@ -618,16 +616,19 @@ boolean RB_PreProcessSprite(vtxlist_t* vl)
     rbVisSprite_t   *vissprite;
     mobj_t          *thing;
     rbTexture_t     *texture;
+    rbTexture_t     *atlas;
     int             translation;
 
     vissprite = (rbVisSprite_t*)vl->data;
     thing = vissprite->spr;
     translation = vl->params;
     texture = NULL;
+    atlas = NULL;
 
     switch(vl->drawTag)
     {
     case DLT_SPRITEBRIGHT:
+        atlas = RB_GetAtlasTexture(RB_GetSpriteAtlasPage(vl->texid, translation), true);
         texture = RB_GetBrightmap(RDT_SPRITE, vl->texid, translation);
         break;
         
@@ -636,11 +637,18 @@ boolean RB_PreProcessSprite(vtxlist_t* vl)
         break;
 
     default:
+        atlas = RB_GetAtlasTexture(RB_GetSpriteAtlasPage(vl->texid, translation), false);
         texture = RB_GetTexture(RDT_SPRITE, vl->texid, translation);
         break;
     }
 
-    if(texture)
+    if(atlas)
+    {
+        // neighbours in the atlas must not wrap into each other
+        RB_BindTexture(atlas);
+        RB_ChangeTexParameters(atlas, TC_CLAMP, TEXFILTER);
+    }
+    else if(texture)
     {
         RB_BindTexture(texture);
         RB_ChangeTexParameters(texture, TC_REPEAT, TEXFILTER);
@@ -649,21 +657,21 @@ boolean RB_PreProcessSprite(vtxlist_t* vl)
 }
 
 //
-// RB_GenerateSpritePlane
+// RB_BuildSpritePlane
+//
+// Positions and texture coordinates of the sprite's quad
 //
 
-boolean RB_GenerateSpritePlane(vtxlist_t* vl, int* drawcount)
+static void RB_BuildSpritePlane(vtxlist_t *vl, rbVisSprite_t *vissprite, vtx_t *vertex, boolean drawOutline)
 {
-    float           x, y, z;
     spritedef_t     *sprdef;
     spriteframe_t   *sprframe;
     angle_t         ang;
-    byte            alpha;
     int             i;
     int             spritenum;
-    int             lightlevel = 0xff;
     int             rot;
     float           dx1, dx2;
+    float           dz1, dz2;
     float           tx;
     float           ty;
     float           yoffs;
@@ -671,24 +679,12 @@ boolean RB_GenerateSpritePlane(vtxlist_t* vl, int* drawcount)
     float           offs;
     float           topoffset;
     float           height;
-    rbVisSprite_t   *vissprite;
     float           centerz;
-    vtx_t           *vertex;
+    float           *rotation;
     rbTexture_t     *texture;
-    matrix          rotation;
-    boolean         drawOutline;
 
-    vissprite = (rbVisSprite_t*)vl->data;
     thing = vissprite->spr;
 
-    x = vissprite->x;
-    y = vissprite->y;
-    z = vissprite->z;
-
-    vissprite->indiceStart = *drawcount;
-
-    vertex = &drawVertex[*drawcount];
-
     sprdef = &sprites[thing->sprite];
     sprframe = &sprdef->spriteframes[thing->frame & FF_FRAMEMASK];
 
@@ -720,56 +716,6 @@ boolean RB_GenerateSpritePlane(vtxlist_t* vl, int* drawcount)
         offs = 0.0f;
     }
 
-    drawOutline = (vl->drawTag == DLT_SPRITEOUTLINE && thing->info->flags2 & MF2_DRAWOUTLINE);
-
-    if(vl->drawTag != DLT_SPRITEBRIGHT)
-    {
-        if(drawOutline)
-        {
-            RB_SetVertexColor(vertex, 0xff, 0, 0, 0xff, 4);
-        }
-        else
-        {
-            if(thing->frame & FF_FULLBRIGHT)
-            {
-                lightlevel = 0xff;
-            }
-            else
-            {
-                int sectorlight = (rbLightmaps && thing->subsector->sector->altlightlevel != -1) ?
-                thing->subsector->sector->altlightlevel :
-                thing->subsector->sector->lightlevel;
-                
-                lightlevel = sectorlight + (rbPlayerView.extralight << 4);
-                lightlevel += 32;
-
-                if(lightlevel > 255)
-                {
-                    lightlevel = 255;
-                }
-            }
-
-            // haleyjd 20140826: [SVE] corrected logic:
-            // * MF_SHADOW things are: ~25% translucent UNLESS...
-            // * They are also MF_MVIS and NOT translated, in which case they are ~75%.
-            alpha = 0xff;
-            if(thing->flags & MF_SHADOW)
-            {
-                alpha = 64;
-                if((thing->flags & MF_MVIS) && !(thing->flags & MF_TRANSLATION))
-                {
-                    alpha = 192;
-                }
-            }
-            else if(thing->flags & MF_MVIS)
-                alpha = 24; // ALMOST totally invisible.
-
-            RB_SetVertexColor(vertex, rbSectorLightTable[lightlevel],
-                                      rbSectorLightTable[lightlevel],
-                                      rbSectorLightTable[lightlevel], alpha, 4);
-        }
-    }
-
     // set offset
     if(sprframe->flip[rot])
     {
@@ -810,51 +756,149 @@ boolean RB_GenerateSpritePlane(vtxlist_t* vl, int* drawcount)
     vertex[0].tv = vertex[1].tv = 0.0f;
     vertex[2].tv = vertex[3].tv = ty - yoffs;
 
+    // remap into the level's sprite atlas (see RB_PreProcessSprite)
+    if(vl->drawTag != DLT_SPRITEOUTLINE && RB_GetSpriteAtlasPage(spritenum, vl->params) != -1)
+    {
+        float uv[4];
+
+        RB_GetSpriteAtlasCoords(spritenum, uv);
+
+        for(i = 0; i < 4; ++i)
+        {
+            vertex[i].tu = uv[0] + vertex[i].tu * uv[2];
+            vertex[i].tv = uv[1] + vertex[i].tv * uv[3];
+        }
+    }
+
     // rotate sprite's pitch from the center of the plane
     centerz = height * 0.5f;
 
-    // setup vertex coordinates
-    vertex[0].x = vertex[2].x = dx1;
-    vertex[0].y = vertex[2].y = 0;
-    vertex[1].x = vertex[3].x = dx2;
-    vertex[1].y = vertex[3].y = 0;
-
-    vertex[0].z = vertex[1].z = topoffset - centerz;
-    vertex[2].z = vertex[3].z = vertex[0].z - height;
+    dz1 = topoffset - centerz;
+    dz2 = dz1 - height;
 
     if(drawOutline)
     {
-        vertex[0].z = vertex[1].z = vertex[0].z + 2.0f;
-        vertex[2].z = vertex[3].z = vertex[2].z - 2.0f;
+        dz1 += 2.0f;
+        dz2 -= 2.0f;
     }
 
     if(thing->info->flags2 & MF2_DRAWBILLBOARD)
     {
         // sprite won't rotate along the x-axis
-        MTX_Copy(rotation, rbSpriteViewBillboardMatrix);
+        rotation = rbSpriteViewBillboardMatrix;
     }
     else
     {
         // always face the player view
-        MTX_Copy(rotation, rbSpriteViewMatrix);
+        rotation = rbSpriteViewMatrix;
     }
 
-    MTX_SetTranslation(rotation, 0, 0, centerz);
+    // the plane has no depth, so only the matrix's x and z axes
+    // are needed to place the corners
+    vertex[0].x = vissprite->x + rotation[0] * dx1 + rotation[ 8] * dz1;
+    vertex[0].y = vissprite->y + rotation[1] * dx1 + rotation[ 9] * dz1;
+    vertex[0].z = vissprite->z + rotation[2] * dx1 + rotation[10] * dz1 + centerz;
+
+    vertex[1].x = vissprite->x + rotation[0] * dx2 + rotation[ 8] * dz1;
+    vertex[1].y = vissprite->y + rotation[1] * dx2 + rotation[ 9] * dz1;
+    vertex[1].z = vissprite->z + rotation[2] * dx2 + rotation[10] * dz1 + centerz;
 
-    MTX_MultiplyVector(rotation, (float*)&vertex[0].x);
-    MTX_MultiplyVector(rotation, (float*)&vertex[1].x);
-    MTX_MultiplyVector(rotation, (float*)&vertex[2].x);
-    MTX_MultiplyVector(rotation, (float*)&vertex[3].x);
+    vertex[2].x = vissprite->x + rotation[0] * dx1 + rotation[ 8] * dz2;
+    vertex[2].y = vissprite->y + rotation[1] * dx1 + rotation[ 9] * dz2;
+    vertex[2].z = vissprite->z + rotation[2] * dx1 + rotation[10] * dz2 + centerz;
 
-    for(i = 0; i < 4; ++i)
+    vertex[3].x = vissprite->x + rotation[0] * dx2 + rotation[ 8] * dz2;
+    vertex[3].y = vissprite->y + rotation[1] * dx2 + rotation[ 9] * dz2;
+    vertex[3].z = vissprite->z + rotation[2] * dx2 + rotation[10] * dz2 + centerz;
+}
+
+//
+// RB_GenerateSpritePlane
+//
+
+boolean RB_GenerateSpritePlane(vtxlist_t* vl, int* drawcount)
+{
+    byte            alpha;
+    int             lightlevel = 0xff;
+    mobj_t          *thing;
+    rbVisSprite_t   *vissprite;
+    vtx_t           *vertex;
+    boolean         drawOutline;
+    float           cellpos[4];
+    float           *lightpos = NULL;
+
+    vissprite = (rbVisSprite_t*)vl->data;
+    thing = vissprite->spr;
+
+    vissprite->indiceStart = *drawcount;
+
+    vertex = &drawVertex[*drawcount];
+
+    drawOutline = (vl->drawTag == DLT_SPRITEOUTLINE && thing->info->flags2 & MF2_DRAWOUTLINE);
+
+    // outlines are a bit larger and never come from the atlas
+    if(vl->drawTag == DLT_SPRITEOUTLINE)
+    {
+        RB_BuildSpritePlane(vl, vissprite, vertex, drawOutline);
+    }
+    else if(vissprite->bQuadCached)
     {
-        vertex[i].x += x;
-        vertex[i].y += y;
-        vertex[i].z += z;
+        memcpy(vertex, vissprite->quad, sizeof(vissprite->quad));
+    }
+    else
+    {
+        RB_BuildSpritePlane(vl, vissprite, vertex, false);
+        memcpy(vissprite->quad, vertex, sizeof(vissprite->quad));
+        vissprite->bQuadCached = true;
     }
 
     if(vl->drawTag != DLT_SPRITEBRIGHT)
     {
+        if(drawOutline)
+        {
+            RB_SetVertexColor(vertex, 0xff, 0, 0, 0xff, 4);
+        }
+        else
+        {
+            if(thing->frame & FF_FULLBRIGHT)
+            {
+                lightlevel = 0xff;
+            }
+            else
+            {
+                int sectorlight = (rbLightmaps && thing->subsector->sector->altlightlevel != -1) ?
+                thing->subsector->sector->altlightlevel :
+                thing->subsector->sector->lightlevel;
+                
+                lightlevel = sectorlight + (rbPlayerView.extralight << 4);
+                lightlevel += 32;
+
+                if(lightlevel > 255)
+                {
+                    lightlevel = 255;
+                }
+            }
+
+            // haleyjd 20140826: [SVE] corrected logic:
+            // * MF_SHADOW things are: ~25% translucent UNLESS...
+            // * They are also MF_MVIS and NOT translated, in which case they are ~75%.
+            alpha = 0xff;
+            if(thing->flags & MF_SHADOW)
+            {
+                alpha = 64;
+                if((thing->flags & MF_MVIS) && !(thing->flags & MF_TRANSLATION))
+                {
+                    alpha = 192;
+                }
+            }
+            else if(thing->flags & MF_MVIS)
+                alpha = 24; // ALMOST totally invisible.
+
+            RB_SetVertexColor(vertex, rbSectorLightTable[lightlevel],
+                                      rbSectorLightTable[lightlevel],
+                                      rbSectorLightTable[lightlevel], alpha, 4);
+        }
+
         if(rbWallShades)
         {
             if(!(drawOutline || (thing->frame & FF_FULLBRIGHT)))
@@ -865,8 +909,16 @@ boolean RB_GenerateSpritePlane(vtxlist_t* vl, int* drawcount)
 
         if(!drawOutline && !(thing->flags & (MF_SHADOW|MF_MVIS)) && !(thing->frame & FF_FULLBRIGHT))
         {
-            RB_SetSpriteCellColor(vertex, thing->x, thing->y, thing->z + (64*FRACUNIT),
-                                  thing->subsector->sector);
+            if(INST_LightGridEnabled())
+            {
+                // leave the cell to the instance shader
+                RB_GetThingCellPos(cellpos, thing, thing->z + (64*FRACUNIT));
+                lightpos = cellpos;
+            }
+            else
+            {
+                RB_SetThingCellColor(vertex, thing, thing->z + (64*FRACUNIT));
+            }
         }
     }
     else
@@ -874,8 +926,17 @@ boolean RB_GenerateSpritePlane(vtxlist_t* vl, int* drawcount)
         RB_SetVertexColor(vertex, 0xff, 0xff, 0xff, 0xff, 4);
     }
 
-    RB_AddTriangle(*drawcount + 0, *drawcount + 1, *drawcount + 2);
-    RB_AddTriangle(*drawcount + 3, *drawcount + 2, *drawcount + 1);
+    // the quad is a flat rectangle and shades/cell colors only change
+    // between its top and bottom rows, so three corners describe it
+    if(!INST_AddQuad(&vertex[0], &vertex[1], &vertex[2], lightpos))
+    {
+        if(lightpos)
+        {
+            RB_SetThingCellColor(vertex, thing, thing->z + (64*FRACUNIT));
+        }
+
+        RB_AddQuad(*drawcount);
+    }
     
     *drawcount += 4;
 
@@ -930,8 +991,7 @@ boolean RB_GenerateClipLine(vtxlist_t *vl, int *drawcount)
 
         RB_SetVertexColor(&v[vtxCount], 0xff, 0xff, 0xff, 0xff, 4);
         
-        RB_AddTriangle(*drawcount + 0, *drawcount + 1, *drawcount + 2);
-        RB_AddTriangle(*drawcount + 3, *drawcount + 2, *drawcount + 1);
+        RB_AddQuad(*drawcount);
 
         *drawcount += 4;
         vtxCount += 4;
@@ -960,8 +1020,7 @@ boolean RB_GenerateClipLine(vtxlist_t *vl, int *drawcount)
 
             RB_SetVertexColor(&v[vtxCount], 0xff, 0xff, 0xff, 0xff, 4);
 
-            RB_AddTriangle(*drawcount + 0, *drawcount + 1, *drawcount + 2);
-            RB_AddTriangle(*drawcount + 3, *drawcount + 2, *drawcount + 1);
+            RB_AddQuad(*drawcount);
 
             *drawcount += 4;
             vtxCount += 4;
@@ -1019,8 +1078,7 @@ boolean RB_GenerateClipLine(vtxlist_t *vl, int *drawcount)
 
             RB_SetVertexColor(&v[vtxCount], 0xff, 0xff, 0xff, 0xff, 4);
 
-            RB_AddTriangle(*drawcount + 0, *drawcount + 1, *drawcount + 2);
-            RB_AddTriangle(*drawcount + 3, *drawcount + 2, *drawcount + 1);
+            RB_AddQuad(*drawcount);
 
             *drawcount += 4;
             vtxCount += 4;
@@ -1057,8 +1115,7 @@ boolean RB_GenerateSkyLine(vtxlist_t *vl, int *drawcount)
 
     RB_SetVertexColor(v, 0xff, 0xff, 0xff, 0xff, 4);
 
-    RB_AddTriangle(*drawcount + 0, *drawcount + 1, *drawcount + 2);
-    RB_AddTriangle(*drawcount + 3, *drawcount + 2, *drawcount + 1);
+    RB_AddQuad(*drawcount);
 
     *drawcount += 4;
     return true;
@@ -1141,8 +1198,7 @@ boolean RB_GenerateLightmapLowerSeg(vtxlist_t *vl, int *drawcount)
         v[3].tu = lmi->coords[3 * 2 + 0];
         v[1].tv = lmi->coords[3 * 2 + 1];
         
-        RB_AddTriangle(*drawcount + 0, *drawcount + 1, *drawcount + 2);
-        RB_AddTriangle(*drawcount + 3, *drawcount + 2, *drawcount + 1);
+        RB_AddQuad(*drawcount);
 
         *drawcount += 4;
         return true;
@@ -1207,8 +1263,7 @@ boolean RB_GenerateLightmapUpperSeg(vtxlist_t *vl, int *drawcount)
         v[3].tu = lmi->coords[3 * 2 + 0];
         v[1].tv = lmi->coords[3 * 2 + 1];
         
-        RB_AddTriangle(*drawcount + 0, *drawcount + 1, *drawcount + 2);
-        RB_AddTriangle(*drawcount + 3, *drawcount + 2, *drawcount + 1);
+        RB_AddQuad(*drawcount);
 
         *drawcount += 4;
         return true;
@@ -1285,8 +1340,7 @@ boolean RB_GenerateLightmapMiddleSeg(vtxlist_t *vl, int *drawcount)
     v[3].tu = lmi->coords[3 * 2 + 0];
     v[1].tv = lmi->coords[3 * 2 + 1];
     
-    RB_AddTriangle(*drawcount + 0, *drawcount + 1, *drawcount + 2);
-    RB_AddTriangle(*drawcount + 3, *drawcount + 2, *drawcount + 1);
+    RB_AddQuad(*drawcount);
 
     *drawcount += 4;
     return true;
@@ -1477,8 +1531,7 @@ boolean RB_GenerateDynLightLowerSeg(vtxlist_t *vl, int *drawcount)
         
         RB_SetupDynLightWall(v, seg, light);
         
-        RB_AddTriangle(*drawcount + 0, *drawcount + 1, *drawcount + 2);
-        RB_AddTriangle(*drawcount + 3, *drawcount + 2, *drawcount + 1);
+        RB_AddQuad(*drawcount);
         
         *drawcount += 4;
         return true;
@@ -1532,8 +1585,7 @@ boolean RB_GenerateDynLightUpperSeg(vtxlist_t *vl, int *drawcount)
         
         RB_SetupDynLightWall(v, seg, light);
         
-        RB_AddTriangle(*drawcount + 0, *drawcount + 1, *drawcount + 2);
-        RB_AddTriangle(*drawcount + 3, *drawcount + 2, *drawcount + 1);
+        RB_AddQuad(*drawcount);
         
         *drawcount += 4;
         return true;
@@ -1599,8 +1651,7 @@ boolean RB_GenerateDynLightMiddleSeg(vtxlist_t *vl, int *drawcount)
     
     RB_SetupDynLightWall(v, seg, light);
     
-    RB_AddTriangle(*drawcount + 0, *drawcount + 1, *drawcount + 2);
-    RB_AddTriangle(*drawcount + 3, *drawcount + 2, *drawcount + 1);
+    RB_AddQuad(*drawcount);
     
     *drawcount += 4;
     return true;
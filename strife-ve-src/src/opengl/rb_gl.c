@@ -27,6 +27,7 @@
 
 GL_ARB_multitexture_Define();
 GL_EXT_compiled_vertex_array_Define();
+GL_EXT_multi_draw_arrays_Define();
 GL_ARB_texture_non_power_of_two_Define();
 GL_ARB_texture_env_combine_Define();
 GL_EXT_texture_env_combine_Define();
@@ -34,6 +35,12 @@ GL_EXT_texture_filter_anisotropic_Define();
 GL_ARB_vertex_buffer_object_Define();
 GL_ARB_shader_objects_Define();
 GL_ARB_framebuffer_object_Define();
+GL_ARB_occlusion_query_Define();
+GL_ARB_timer_query_Define();
+GL_ARB_vertex_shader_Define();
+GL_ARB_instanced_arrays_Define();
+GL_ARB_draw_instanced_Define();
+GL_EXT_texture3D_Define();
 
 //
 // FindExtension
@@ -179,6 +186,7 @@ void GL_Init(void)
 {
     GL_ARB_multitexture_Init();
     GL_EXT_compiled_vertex_array_Init();
+    GL_EXT_multi_draw_arrays_Init();
     GL_ARB_texture_non_power_of_two_Init();
     GL_ARB_texture_env_combine_Init();
     GL_EXT_texture_env_combine_Init();
@@ -186,4 +194,10 @@ void GL_Init(void)
     GL_ARB_vertex_buffer_object_Init();
     GL_ARB_shader_objects_Init();
     GL_ARB_framebuffer_object_Init();
+    GL_ARB_occlusion_query_Init();
+    GL_ARB_timer_query_Init();
+    GL_ARB_vertex_shader_Init();
+    GL_ARB_instanced_arrays_Init();
+    GL_ARB_draw_instanced_Init();
+    GL_EXT_texture3D_Init();
 }
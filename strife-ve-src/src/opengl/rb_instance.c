@@ -0,0 +1,413 @@
+//
+// Copyright(C) 2007-2014 Samuel Villarreal
+// Copyright(C) 2014 Night Dive Studios, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//    Instanced sprite and decal quads
+//
+//    Sprites and most decals are flat parallelograms, so a quad can be
+//    described by one corner, the two edges leaving it, the texture
+//    coordinates along those edges and a color for its top and bottom
+//    rows. Instead of four vertices and six indices per quad, each batch
+//    streams one such record per quad into a buffer and draws all of them
+//    with a single instanced call over a shared four-corner strip.
+//
+//    Sprites lit by the light grid also carry the point their cell is
+//    looked up from. The shader finds the cell in the grid texture and
+//    mixes it into the row colors the same way RB_ApplyLightGridRGB does.
+//
+//    This needs GLSL and instanced arrays. Without them, or with
+//    gl_instancing off, INST_AddQuad refuses every quad and the callers
+//    keep using drawVertex and RB_AddQuad/RB_AddTriangle.
+//
+
+#include <stddef.h>
+
+#include "rb_main.h"
+#include "rb_gl.h"
+#include "rb_instance.h"
+#include "rb_draw.h"
+#include "rb_shader.h"
+#include "rb_config.h"
+#include "rb_lightgrid.h"
+
+// a batch never holds more vertices than drawVertex does
+#define MAXINSTANCES    (MAXDLDRAWCOUNT / 4)
+
+typedef struct
+{
+    float   origin[3];
+    float   axisu[3];
+    float   axisv[3];
+    float   texcoord[2];
+    float   texaxisu[2];
+    float   texaxisv[2];
+    byte    top[4];
+    byte    bottom[4];
+    float   lightpos[4];    // w is 1 in sky sectors, -1 for no light grid
+} rbInstance_t;
+
+typedef enum
+{
+    IA_ORIGIN   = 0,
+    IA_AXISU,
+    IA_AXISV,
+    IA_TEXCOORD,
+    IA_TEXAXISU,
+    IA_TEXAXISV,
+    IA_TOPCOLOR,
+    IA_BOTTOMCOLOR,
+    IA_LIGHTPOS,
+    NUMINSTATTRIBS
+} instAttrib_t;
+
+typedef struct
+{
+    const char  *name;
+    int         size;
+    GLenum      type;
+    GLboolean   normalized;
+    size_t      offset;
+} instAttribDef_t;
+
+static const instAttribDef_t instAttribDefs[NUMINSTATTRIBS] =
+{
+    { "aOrigin",        3,  GL_FLOAT,           GL_FALSE,   offsetof(rbInstance_t, origin)      },
+    { "aAxisU",         3,  GL_FLOAT,           GL_FALSE,   offsetof(rbInstance_t, axisu)       },
+    { "aAxisV",         3,  GL_FLOAT,           GL_FALSE,   offsetof(rbInstance_t, axisv)       },
+    { "aTexCoord",      2,  GL_FLOAT,           GL_FALSE,   offsetof(rbInstance_t, texcoord)    },
+    { "aTexAxisU",      2,  GL_FLOAT,           GL_FALSE,   offsetof(rbInstance_t, texaxisu)    },
+    { "aTexAxisV",      2,  GL_FLOAT,           GL_FALSE,   offsetof(rbInstance_t, texaxisv)    },
+    { "aTopColor",      4,  GL_UNSIGNED_BYTE,   GL_TRUE,    offsetof(rbInstance_t, top)         },
+    { "aBottomColor",   4,  GL_UNSIGNED_BYTE,   GL_TRUE,    offsetof(rbInstance_t, bottom)      },
+    { "aLightPos",      4,  GL_FLOAT,           GL_FALSE,   offsetof(rbInstance_t, lightpos)    }
+};
+
+static GLint instAttribLocs[NUMINSTATTRIBS];
+
+static rbShader_t instShader;
+static boolean bInstancing = false;
+
+static GLuint cornerBuffer = 0;
+static GLuint instanceBuffer = 0;
+
+static rbInstance_t instances[MAXINSTANCES];
+static int numInstances = 0;
+
+static const char *instVertexSource =
+    "#version 110\n"
+    "attribute vec3 aOrigin;\n"
+    "attribute vec3 aAxisU;\n"
+    "attribute vec3 aAxisV;\n"
+    "attribute vec2 aTexCoord;\n"
+    "attribute vec2 aTexAxisU;\n"
+    "attribute vec2 aTexAxisV;\n"
+    "attribute vec4 aTopColor;\n"
+    "attribute vec4 aBottomColor;\n"
+    "attribute vec4 aLightPos;\n"
+    "uniform vec3 uGridBias;\n"
+    "uniform vec3 uGridUnit;\n"
+    "uniform vec3 uGridBlocks;\n"
+    "varying vec2 texCoord;\n"
+    "varying vec4 color;\n"
+    "varying vec4 lightCoord;\n"
+    "void main()\n"
+    "{\n"
+    // gl_Vertex is the corner of the quad, (0,0) to (1,1)
+    "    vec2 corner = gl_Vertex.xy;\n"
+    "    vec3 pos = aOrigin + aAxisU * corner.x + aAxisV * corner.y;\n"
+    "    texCoord = aTexCoord + aTexAxisU * corner.x + aTexAxisV * corner.y;\n"
+    "    color = mix(aTopColor, aBottomColor, corner.y);\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * vec4(pos, 1.0);\n"
+    "    lightCoord = vec4(0.0);\n"
+    "    if(aLightPos.w >= 0.0)\n"
+    "    {\n"
+    // same cell as RB_GetLightGridIndex, sky cells are in the upper half
+    "        vec3 cell = floor(floor(aLightPos.xyz - uGridBias) * uGridUnit);\n"
+    "        cell = clamp(cell, vec3(0.0), uGridBlocks - 1.0);\n"
+    "        cell.z += aLightPos.w * uGridBlocks.z;\n"
+    "        lightCoord.xyz = (cell + 0.5) / (uGridBlocks * vec3(1.0, 1.0, 2.0));\n"
+    "        lightCoord.w = 1.0;\n"
+    "    }\n"
+    "}\n";
+
+static const char *instFragmentSource =
+    "#version 110\n"
+    "uniform sampler2D uTexture;\n"
+    "uniform sampler3D uLightGrid;\n"
+    "varying vec2 texCoord;\n"
+    "varying vec4 color;\n"
+    "varying vec4 lightCoord;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 c = color;\n"
+    "    if(lightCoord.w > 0.5)\n"
+    "    {\n"
+    // alpha is the cell type, see RB_UploadLightGridTexture
+    "        vec4 cell = texture3D(uLightGrid, lightCoord.xyz);\n"
+    "        if(cell.a > 0.9)\n"
+    "        {\n"
+    "            c.rgb = mix(c.rgb, cell.rgb, 0.5);\n"
+    "        }\n"
+    "        else if(cell.a > 0.1)\n"
+    "        {\n"
+    "            if(cell.a > 0.5)\n"
+    "                c.rgb = mix(c.rgb, c.rgb * 0.5, 0.635);\n"
+    // written exactly like RB_MixLightGridColor, where only the cell
+    // term is halved: c1 + (min(c1 * c2 + c2, 1) / 2)
+    "            c.rgb = min((c.rgb + ((min((c.rgb * cell.rgb) + cell.rgb, 1.0))) / 2.0), 1.0);\n"
+    "        }\n"
+    "    }\n"
+    // same as the fixed function modulate; alpha testing still applies
+    "    gl_FragColor = texture2D(uTexture, texCoord) * c;\n"
+    "}\n";
+
+//
+// INST_Init
+//
+
+void INST_Init(void)
+{
+    static const float corners[8] =
+    {
+        0, 0,
+        1, 0,
+        0, 1,
+        1, 1
+    };
+    int i;
+
+    bInstancing = false;
+    numInstances = 0;
+
+    if(!has_GL_ARB_shader_objects ||
+       !has_GL_ARB_vertex_shader ||
+       !has_GL_ARB_vertex_buffer_object ||
+       !has_GL_ARB_instanced_arrays ||
+       !has_GL_ARB_draw_instanced)
+    {
+        return;
+    }
+
+    SP_LoadProgramDefault(&instShader, "INST", instVertexSource, instFragmentSource);
+
+    if(!instShader.bLoaded || instShader.bHasErrors)
+    {
+        fprintf(stderr, "INST_Init: drawing sprites and decals without instancing\n");
+        return;
+    }
+
+    for(i = 0; i < NUMINSTATTRIBS; ++i)
+    {
+        instAttribLocs[i] = dglGetAttribLocationARB(instShader.programObj, instAttribDefs[i].name);
+
+        if(instAttribLocs[i] == -1)
+        {
+            fprintf(stderr, "INST_Init: %s not found, drawing sprites and decals without instancing\n",
+                    instAttribDefs[i].name);
+            return;
+        }
+    }
+
+    SP_Enable(&instShader);
+    SP_SetUniform1i(&instShader, "uTexture", 0);
+    SP_SetUniform1i(&instShader, "uLightGrid", 1);
+    RB_DisableShaders();
+
+    dglGenBuffersARB(1, &cornerBuffer);
+    dglBindBufferARB(GL_ARRAY_BUFFER_ARB, cornerBuffer);
+    dglBufferDataARB(GL_ARRAY_BUFFER_ARB, sizeof(corners), corners, GL_STATIC_DRAW_ARB);
+
+    dglGenBuffersARB(1, &instanceBuffer);
+    dglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+
+    bInstancing = true;
+}
+
+//
+// INST_Delete
+//
+
+void INST_Delete(void)
+{
+    SP_Delete(&instShader);
+
+    if(cornerBuffer)
+    {
+        dglDeleteBuffersARB(1, &cornerBuffer);
+        cornerBuffer = 0;
+    }
+
+    if(instanceBuffer)
+    {
+        dglDeleteBuffersARB(1, &instanceBuffer);
+        instanceBuffer = 0;
+    }
+
+    bInstancing = false;
+    numInstances = 0;
+}
+
+//
+// INST_Enabled
+//
+
+boolean INST_Enabled(void)
+{
+    return (rbInstancing && bInstancing);
+}
+
+//
+// INST_LightGridEnabled
+//
+// Whether instances can leave the light grid to the shader
+//
+
+boolean INST_LightGridEnabled(void)
+{
+    return (INST_Enabled() && RB_LightGridTextureEnabled());
+}
+
+//
+// INST_AddQuad
+//
+// Queues the quad spanned from origin towards right and down. The fourth
+// corner is implied, so the caller must only pass parallelograms whose
+// colors only change from the top row to the bottom row. lightpos is
+// the light grid sample from RB_GetThingCellPos, or NULL. Returns false
+// if the quad has to be drawn through drawVertex instead.
+//
+
+boolean INST_AddQuad(const vtx_t *origin, const vtx_t *right, const vtx_t *down,
+                     const float *lightpos)
+{
+    rbInstance_t *inst;
+
+    if(!INST_Enabled() || numInstances >= MAXINSTANCES)
+    {
+        return false;
+    }
+
+    inst = &instances[numInstances++];
+
+    inst->origin[0] = origin->x;
+    inst->origin[1] = origin->y;
+    inst->origin[2] = origin->z;
+    inst->axisu[0] = right->x - origin->x;
+    inst->axisu[1] = right->y - origin->y;
+    inst->axisu[2] = right->z - origin->z;
+    inst->axisv[0] = down->x - origin->x;
+    inst->axisv[1] = down->y - origin->y;
+    inst->axisv[2] = down->z - origin->z;
+
+    inst->texcoord[0] = origin->tu;
+    inst->texcoord[1] = origin->tv;
+    inst->texaxisu[0] = right->tu - origin->tu;
+    inst->texaxisu[1] = right->tv - origin->tv;
+    inst->texaxisv[0] = down->tu - origin->tu;
+    inst->texaxisv[1] = down->tv - origin->tv;
+
+    inst->top[0] = origin->r;
+    inst->top[1] = origin->g;
+    inst->top[2] = origin->b;
+    inst->top[3] = origin->a;
+    inst->bottom[0] = down->r;
+    inst->bottom[1] = down->g;
+    inst->bottom[2] = down->b;
+    inst->bottom[3] = down->a;
+
+    if(lightpos)
+    {
+        inst->lightpos[0] = lightpos[0];
+        inst->lightpos[1] = lightpos[1];
+        inst->lightpos[2] = lightpos[2];
+        inst->lightpos[3] = lightpos[3];
+    }
+    else
+    {
+        inst->lightpos[3] = -1;
+    }
+
+    return true;
+}
+
+//
+// INST_DrawInstances
+//
+
+void INST_DrawInstances(void)
+{
+    int i;
+
+    if(numInstances == 0)
+    {
+        return;
+    }
+
+    dglBindBufferARB(GL_ARRAY_BUFFER_ARB, instanceBuffer);
+    dglBufferDataARB(GL_ARRAY_BUFFER_ARB, numInstances * sizeof(rbInstance_t),
+                     instances, GL_STREAM_DRAW_ARB);
+
+    for(i = 0; i < NUMINSTATTRIBS; ++i)
+    {
+        const instAttribDef_t *def = &instAttribDefs[i];
+
+        dglEnableVertexAttribArrayARB(instAttribLocs[i]);
+        dglVertexAttribPointerARB(instAttribLocs[i], def->size, def->type, def->normalized,
+                                  sizeof(rbInstance_t), (GLvoid*)def->offset);
+        dglVertexAttribDivisorARB(instAttribLocs[i], 1);
+    }
+
+    // the shader only reads the corner from gl_Vertex
+    dglDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    dglDisableClientState(GL_COLOR_ARRAY);
+
+    dglBindBufferARB(GL_ARRAY_BUFFER_ARB, cornerBuffer);
+    dglVertexPointer(2, GL_FLOAT, 0, 0);
+    rbState.numStateChanges++;
+
+    SP_Enable(&instShader);
+
+    if(INST_LightGridEnabled())
+    {
+        RB_SetLightGridShaderParams(&instShader, 1);
+    }
+
+    dglDrawArraysInstancedARB(GL_TRIANGLE_STRIP, 0, 4, numInstances);
+    rbState.numDrawCalls++;
+
+    RB_DisableShaders();
+
+    // some drivers alias the generic attributes onto the
+    // fixed function arrays, so leave none of them enabled
+    for(i = 0; i < NUMINSTATTRIBS; ++i)
+    {
+        dglVertexAttribDivisorARB(instAttribLocs[i], 0);
+        dglDisableVertexAttribArrayARB(instAttribLocs[i]);
+    }
+
+    dglEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    dglEnableClientState(GL_COLOR_ARRAY);
+
+    dglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+    RB_RestoreDrawPointers();
+}
+
+//
+// INST_ResetInstances
+//
+
+void INST_ResetInstances(void)
+{
+    numInstances = 0;
+}
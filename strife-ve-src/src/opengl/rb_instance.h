@@ -0,0 +1,32 @@
+//
+// Copyright(C) 2007-2014 Samuel Villarreal
+// Copyright(C) 2014 Night Dive Studios, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#ifndef __RB_INSTANCE_H__
+#define __RB_INSTANCE_H__
+
+#include "rb_main.h"
+
+void INST_Init(void);
+void INST_Delete(void);
+boolean INST_Enabled(void);
+boolean INST_LightGridEnabled(void);
+
+boolean INST_AddQuad(const vtx_t *origin, const vtx_t *right, const vtx_t *down,
+                     const float *lightpos);
+
+void INST_DrawInstances(void);
+void INST_ResetInstances(void);
+
+#endif
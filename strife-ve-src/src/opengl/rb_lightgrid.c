@@ -15,6 +15,13 @@
 // DESCRIPTION:
 //    Light grid utilities
 //
+//    The grid is also uploaded as a 3D texture so the instance shader
+//    can look sprites up in it (see rb_instance.c). The texture is twice
+//    as deep as the grid: the upper half holds the cells that samples in
+//    sky sectors are remapped to. Alpha encodes the cell type, zero for
+//    cells without light. Without 3D textures, or for anything drawn
+//    through drawVertex, RB_ApplyLightGridRGB still mixes on the CPU.
+//
 
 #include <math.h>
 
@@ -22,49 +29,29 @@
 #include "rb_main.h"
 #include "rb_lightgrid.h"
 #include "rb_draw.h"
+#include "rb_config.h"
+#include "rb_shader.h"
 #include "r_defs.h"
 #include "r_state.h"
+#include "z_zone.h"
 
-//
-// RB_GetLightGridIndex
-//
+// grid origin in map units, less half a cell
+static float lgBias[3];
 
-int RB_GetLightGridIndex(fixed_t x, fixed_t y, fixed_t z)
-{
-    int idx;
-    int i;
-    int origin[3];
-    int pos[3];
-    float size[3];
+// cell actually used for each cell, depending on whether the
+// sample is in a sky sector or not. see RB_ApplyLightGridRGB
+static int *lgCellRemap;
 
-    for(i = 0; i < 3; ++i)
-    {
-        size[i] = MAX(floorf(((float)lightgrid.blockSize[i] / (float)lightgrid.gridSize[i]) * 2.0f), 1);
-    }
+// result of mixing a vertex color component with a cell color
+// component for each cell type
+static byte lgMixTable[NUMLIGHTGRIDTYPES][256][256];
+static boolean bMixTableBuilt = false;
 
-    // try to convert the origin to local coordinates
-    origin[0] = (x >> FRACBITS) - (lightgrid.min[0] - (lightgrid.blockSize[0] / size[0]));
-    origin[1] = (y >> FRACBITS) - (lightgrid.min[1] - (lightgrid.blockSize[1] / size[1]));
-    origin[2] = (z >> FRACBITS) - (lightgrid.min[2] - (lightgrid.blockSize[2] / size[2]));
+// the grid for the instance shader, 0 if it couldn't be uploaded
+static dtexture lgTexture = 0;
 
-    for(i = 0; i < 3; ++i)
-    {
-        // determine what grid we're standing in
-        pos[i] = MIN(MAX(floorf(origin[i] * lightgrid.gridUnit[i]), 0), lightgrid.blockSize[i]-1);
-    }
-
-    // convert to grid cell index
-    idx = pos[0] +
-          pos[1] * lightgrid.blockSize[0] +
-          pos[2] * (lightgrid.blockSize[0] * lightgrid.blockSize[1]);
-
-    if((idx < 0 || idx >= lightgrid.count) || lightgrid.bits[idx] == 0)
-    {
-        return -1;
-    }
-
-    return idx;
-}
+// texture alpha for each cell type
+static const byte lgTypeAlpha[NUMLIGHTGRIDTYPES] = { 85, 170, 255 };
 
 //
 // RB_OverrideNeighborCell
@@ -101,74 +88,299 @@ static int RB_OverrideNeighborCell(int index, rbLightGridType_t checkType)
 }
 
 //
-// RB_ApplyLightGridRGB
+// RB_MixLightGridColor
+//
+// Blends one vertex color component with the cell color
 //
 
-void RB_ApplyLightGridRGB(vtx_t *vtx, int index, boolean insky)
+static byte RB_MixLightGridColor(byte vc, byte cc, rbLightGridType_t type)
 {
-    byte *rgb;
-    float r, g, b;
-    float r1, r2;
-    float g1, g2;
-    float b1, b2;
+    float c1 = (float)vc / 255.0f;
+    float c2 = (float)cc / 255.0f;
+    float c;
 
-    if(index <= -1)
+    if(type == LGT_SUNSHADE)
+    {
+        // sunshade types lerps color to a slightly darker shade
+        c1 = (((vc>>1) / 255.0f) - c1) * 0.635f + c1;
+    }
+    else if(type == LGT_SUN)
+    {
+        // sun types lerps half the sun color to the vertex color
+        return (byte)(((c2 - c1) * 0.5f + c1) * 255.0f);
+    }
+
+    // mix colors together
+    c = MIN((c1 + ((MIN((c1 * c2) + c2, 1))) / 2), 1);
+
+    return (byte)(c * 255.0f);
+}
+
+//
+// RB_UploadLightGridTexture
+//
+
+static void RB_UploadLightGridTexture(void)
+{
+    int     bx = lightgrid.blockSize[0];
+    int     by = lightgrid.blockSize[1];
+    int     bz = lightgrid.blockSize[2];
+    int     maxSize;
+    int     sky;
+    int     idx;
+    int     cell;
+    int     type;
+    byte    *data;
+    byte    *texel;
+
+    if(lightgrid.count <= 0 || !has_GL_ARB_shader_objects ||
+       !has_GL_EXT_texture3D || !has_GL_ARB_texture_non_power_of_two)
     {
         return;
     }
-    
+
+    dglGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxSize);
+
+    if(bx > maxSize || by > maxSize || bz * 2 > maxSize)
+    {
+        fprintf(stderr, "RB_UploadLightGridTexture: %ix%ix%i grid is too large\n", bx, by, bz);
+        return;
+    }
+
+    data = (byte*)Z_Calloc(1, bx * by * bz * 2 * 4, PU_STATIC, 0);
+    texel = data;
+
+    for(sky = 0; sky < 2; ++sky)
+    {
+        for(idx = 0; idx < bx * by * bz; ++idx, texel += 4)
+        {
+            // same as RB_GetLightGridIndex and RB_ApplyLightGridRGB
+            if(idx >= lightgrid.count || lightgrid.bits[idx] == 0)
+            {
+                continue;
+            }
+
+            cell = lgCellRemap[idx * 2 + sky];
+            type = lightgrid.types[cell];
+
+            texel[0] = lightgrid.rgb[cell * 3 + 0];
+            texel[1] = lightgrid.rgb[cell * 3 + 1];
+            texel[2] = lightgrid.rgb[cell * 3 + 2];
+            texel[3] = lgTypeAlpha[type < NUMLIGHTGRIDTYPES ? type : LGT_NONE];
+        }
+    }
+
+    dglGenTextures(1, &lgTexture);
+    dglBindTexture(GL_TEXTURE_3D, lgTexture);
+    dglTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    dglTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    dglTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    dglTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    dglTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    dglTexImage3DEXT(GL_TEXTURE_3D, 0, GL_RGBA8, bx, by, bz * 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    dglBindTexture(GL_TEXTURE_3D, 0);
+
+    Z_Free(data);
+}
+
+//
+// RB_InitLightGrid
+//
+// Works out everything about the grid that doesn't change
+// while the level is running. Called once the level is loaded
+//
+
+void RB_InitLightGrid(void)
+{
+    float size;
+    int i;
+    int j;
+    int k;
+
+    if(!bMixTableBuilt)
+    {
+        for(i = 0; i < NUMLIGHTGRIDTYPES; ++i)
+        {
+            for(j = 0; j < 256; ++j)
+            {
+                for(k = 0; k < 256; ++k)
+                {
+                    lgMixTable[i][j][k] = RB_MixLightGridColor(j, k, i);
+                }
+            }
+        }
+
+        bMixTableBuilt = true;
+    }
+
+    lgCellRemap = NULL;
+
+    if(lgTexture)
+    {
+        dglDeleteTextures(1, &lgTexture);
+        lgTexture = 0;
+    }
+
+    if(lightgrid.count <= 0)
+    {
+        return;
+    }
+
+    for(i = 0; i < 3; ++i)
+    {
+        size = MAX(floorf(((float)lightgrid.blockSize[i] / (float)lightgrid.gridSize[i]) * 2.0f), 1);
+        lgBias[i] = lightgrid.min[i] - (lightgrid.blockSize[i] / size);
+    }
+
+    lgCellRemap = (int*)Z_Malloc(lightgrid.count * 2 * sizeof(int), PU_LEVEL, 0);
+
     // some cells that aren't in shade may still overlap sectors with
     // a sky flat, which results in sudden 'flickering' of
     // the lightlevel brightness when moving between a shaded cell and
     // a normal cell. this checks for surrounding cells that are in shade
     // so we can appropriately avoid this glitch
-    if(insky && lightgrid.types[index] == LGT_NONE)
+    for(i = 0; i < lightgrid.count; ++i)
     {
-        // if standing in a sky sector but cell isn't shaded, then
-        // look for neighbor cells that is a shade type
-        index = RB_OverrideNeighborCell(index, LGT_SUNSHADE);
+        lgCellRemap[i * 2 + 0] = i;
+        lgCellRemap[i * 2 + 1] = i;
+
+        if(lightgrid.types[i] == LGT_NONE)
+        {
+            // if standing in a sky sector but cell isn't shaded, then
+            // look for neighbor cells that is a shade type
+            lgCellRemap[i * 2 + 1] = RB_OverrideNeighborCell(i, LGT_SUNSHADE);
+        }
+        else if(lightgrid.types[i] == LGT_SUNSHADE)
+        {
+            // if not standing in a sky sector but cell is shaded, then
+            // look for neighbor cells that isn't a shade type
+            lgCellRemap[i * 2 + 0] = RB_OverrideNeighborCell(i, LGT_NONE);
+        }
     }
-    else if(!insky && lightgrid.types[index] == LGT_SUNSHADE)
+
+    RB_UploadLightGridTexture();
+}
+
+//
+// RB_GetLightGridIndex
+//
+
+int RB_GetLightGridIndex(fixed_t x, fixed_t y, fixed_t z)
+{
+    int idx;
+    int i;
+    int origin[3];
+    int pos[3];
+
+    // try to convert the origin to local coordinates
+    origin[0] = (x >> FRACBITS) - lgBias[0];
+    origin[1] = (y >> FRACBITS) - lgBias[1];
+    origin[2] = (z >> FRACBITS) - lgBias[2];
+
+    for(i = 0; i < 3; ++i)
     {
-        // if not standing in a sky sector but cell is shaded, then
-        // look for neighbor cells that isn't a shade type
-        index = RB_OverrideNeighborCell(index, LGT_NONE);
+        // determine what grid we're standing in
+        pos[i] = MIN(MAX(floorf(origin[i] * lightgrid.gridUnit[i]), 0), lightgrid.blockSize[i]-1);
     }
-    
-    rgb = lightgrid.rgb + (index * 3);
-    
-    r1 = (float)vtx->r / 255.0f;
-    g1 = (float)vtx->g / 255.0f;
-    b1 = (float)vtx->b / 255.0f;
-    
-    r2 = (float)rgb[0] / 255.0f;
-    g2 = (float)rgb[1] / 255.0f;
-    b2 = (float)rgb[2] / 255.0f;
 
-    if(lightgrid.types[index] == LGT_SUNSHADE)
+    // convert to grid cell index
+    idx = pos[0] +
+          pos[1] * lightgrid.blockSize[0] +
+          pos[2] * (lightgrid.blockSize[0] * lightgrid.blockSize[1]);
+
+    if((idx < 0 || idx >= lightgrid.count) || lightgrid.bits[idx] == 0)
     {
-        // sunshade types lerps color to a slightly darker shade
-        r1 = (((vtx->r>>1) / 255.0f) - r1) * 0.635f + r1;
-        g1 = (((vtx->g>>1) / 255.0f) - g1) * 0.635f + g1;
-        b1 = (((vtx->b>>1) / 255.0f) - b1) * 0.635f + b1;
+        return -1;
+    }
+
+    return idx;
+}
+
+//
+// RB_GetThingLightGridIndex
+//
+// Things keep the cell they were last found in until
+// they move to another map unit
+//
+
+int RB_GetThingLightGridIndex(mobj_t *thing, fixed_t z)
+{
+    int x = thing->x >> FRACBITS;
+    int y = thing->y >> FRACBITS;
+
+    z >>= FRACBITS;
+
+    if(!thing->lightcellvalid ||
+       thing->lightcellpos[0] != x ||
+       thing->lightcellpos[1] != y ||
+       thing->lightcellpos[2] != z)
+    {
+        thing->lightcell = RB_GetLightGridIndex(thing->x, thing->y, z << FRACBITS);
+        thing->lightcellpos[0] = x;
+        thing->lightcellpos[1] = y;
+        thing->lightcellpos[2] = z;
+        thing->lightcellvalid = true;
     }
-    else if(lightgrid.types[index] == LGT_SUN)
+
+    return thing->lightcell;
+}
+
+//
+// RB_ApplyLightGridRGB
+//
+
+void RB_ApplyLightGridRGB(vtx_t *vtx, int index, boolean insky)
+{
+    byte *rgb;
+    byte (*mix)[256];
+    int type;
+
+    if(index <= -1)
     {
-        // sun types lerps half the sun color to the vertex color
-        vtx->r = (byte)(((r2 - r1) * 0.5f + r1) * 255.0f);
-        vtx->g = (byte)(((g2 - g1) * 0.5f + g1) * 255.0f);
-        vtx->b = (byte)(((b2 - b1) * 0.5f + b1) * 255.0f);
         return;
     }
+    
+    index = lgCellRemap[index * 2 + (insky ? 1 : 0)];
+    rgb = lightgrid.rgb + (index * 3);
+    type = lightgrid.types[index];
 
-    // mix colors together
-    r = MIN((r1 + ((MIN((r1 * r2) + r2, 1))) / 2), 1);
-    g = MIN((g1 + ((MIN((g1 * g2) + g2, 1))) / 2), 1);
-    b = MIN((b1 + ((MIN((b1 * b2) + b2, 1))) / 2), 1);
+    // unknown types mix the same way as LGT_NONE
+    mix = lgMixTable[type < NUMLIGHTGRIDTYPES ? type : LGT_NONE];
+
+    vtx->r = mix[vtx->r][rgb[0]];
+    vtx->g = mix[vtx->g][rgb[1]];
+    vtx->b = mix[vtx->b][rgb[2]];
+}
+
+//
+// RB_LightGridTextureEnabled
+//
+
+boolean RB_LightGridTextureEnabled(void)
+{
+    return (rbLightmaps && lgTexture != 0);
+}
 
-    vtx->r = (byte)(r * 255.0f);
-    vtx->g = (byte)(g * 255.0f);
-    vtx->b = (byte)(b * 255.0f);
+//
+// RB_SetLightGridShaderParams
+//
+// Binds the grid texture to the given unit and hands the shader
+// what it needs to find the cell a sample falls in
+//
+
+void RB_SetLightGridShaderParams(rbShader_t *shader, int unit)
+{
+    RB_SetTextureUnit(unit);
+    dglBindTexture(GL_TEXTURE_3D, lgTexture);
+    RB_SetTextureUnit(0);
+
+    SP_SetUniform3f(shader, "uGridBias", lgBias[0], lgBias[1], lgBias[2]);
+    SP_SetUniform3f(shader, "uGridUnit", lightgrid.gridUnit[0],
+                                         lightgrid.gridUnit[1],
+                                         lightgrid.gridUnit[2]);
+    SP_SetUniform3f(shader, "uGridBlocks", lightgrid.blockSize[0],
+                                           lightgrid.blockSize[1],
+                                           lightgrid.blockSize[2]);
 }
 
 //
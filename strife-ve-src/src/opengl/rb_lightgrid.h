@@ -16,8 +16,14 @@
 #ifndef __RB_LIGHTGRID_H__
 #define __RB_LIGHTGRID_H__
 
+#include "rb_shader.h"
+
+void RB_InitLightGrid(void);
 int RB_GetLightGridIndex(fixed_t x, fixed_t y, fixed_t z);
+int RB_GetThingLightGridIndex(mobj_t *thing, fixed_t z);
 void RB_ApplyLightGridRGB(vtx_t *vtx, int index, boolean insky);
+boolean RB_LightGridTextureEnabled(void);
+void RB_SetLightGridShaderParams(rbShader_t *shader, int unit);
 void RB_DrawLightGridCell(int index);
 
 #endif
@@ -25,7 +25,10 @@
 #include "rb_drawlist.h"
 #include "rb_hudtext.h"
 #include "rb_config.h"
+#include "rb_clipper.h"
+#include "rb_profile.h"
 #include "i_system.h"
+#include "i_timer.h"
 #include "i_video.h"
 #include "m_misc.h"
 #include "m_argv.h"
@@ -81,6 +84,8 @@ void RB_Init(void)
     RB_InitDrawer();
 
     bPrintStats = M_CheckParm("-printglstats");
+    RB_InitProfiler();
+    RB_Clipper_Init();
 #ifndef SVE_PLAT_SWITCH
     I_AtExit(RB_Shutdown, true);
 #endif
@@ -94,6 +99,7 @@ void RB_Shutdown(void)
 {
     RB_DeleteData();
     RB_HudTextShutdown();
+    RB_ShutdownProfiler();
     RB_ShutdownDrawer();
 }
 
@@ -173,6 +179,15 @@ int RB_GetMaxAnisotropic(void)
     return maxAnisotropic;
 }
 
+//
+// RB_GetMaxTextureSize
+//
+
+int RB_GetMaxTextureSize(void)
+{
+    return maxTextureSize;
+}
+
 //
 // RB_GetMaxColorAttachments
 //
@@ -340,18 +355,29 @@ angle_t RB_PointToBam(fixed_t x, fixed_t y)
 
 void RB_SwapBuffers(void)
 {
+    static uint64_t lastSwapTime = 0;
+    uint64_t swapTime;
+
     if(bPrintStats)
     {
         RB_Printf(0, 0, "State Changes: %i", rbState.numStateChanges);
         RB_Printf(0, 12, "Texture Binds: %i", rbState.numTextureBinds);
+        RB_Printf(0, 24, "Draw Calls: %i", rbState.numDrawCalls);
 
         RB_Printf(0, 36, "Wall list size: %i", DL_GetDrawListSize(DLT_WALL));
         RB_Printf(0, 48, "Flat list size: %i", DL_GetDrawListSize(DLT_FLAT));
         RB_Printf(0, 60, "Sprite list size: %i", DL_GetDrawListSize(DLT_SPRITE));
         
         RB_Printf(0, 84, "Drawn Vertices: %i", rbState.numDrawnVertices);
+
+        RB_Printf(0, 108, "Frame Time: %.2f ms", (float)rbState.frameTime / 1000.0f);
+        RB_Printf(0, 120, "Sort Time: %.3f ms", (float)rbState.sortTime / 1000.0f);
+        RB_Printf(0, 132, "Shade Cache: %i hits, %i misses", rbState.numShadeCacheHits,
+                                                             rbState.numShadeCacheMisses);
     }
 
+    RB_DrawProfiler();
+
 #ifndef SVE_PLAT_SWITCH
     if(rbForceSync)
 #endif
@@ -362,10 +388,25 @@ void RB_SwapBuffers(void)
 
     SDL_GL_SwapWindow(windowscreen);
 
+    swapTime = I_GetTimeUS();
+
+    if(lastSwapTime != 0)
+    {
+        rbState.frameTime = (int)(swapTime - lastSwapTime);
+    }
+
+    lastSwapTime = swapTime;
+
+    RB_ProfileEndFrame();
+
     // reset debugging info
     rbState.numStateChanges = 0;
     rbState.numTextureBinds = 0;
+    rbState.numDrawCalls = 0;
     rbState.numDrawnVertices = 0;
+    rbState.sortTime = 0;
+    rbState.numShadeCacheHits = 0;
+    rbState.numShadeCacheMisses = 0;
 }
 
 //
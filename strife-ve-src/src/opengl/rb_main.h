@@ -134,7 +134,12 @@ typedef struct
     texUnit_t       textureUnits[MAX_TEXTURE_UNITS];
     int             numStateChanges;
     int             numTextureBinds;
+    int             numDrawCalls;
     int             numDrawnVertices;
+    int             sortTime;           // microseconds spent sorting draw lists
+    int             numShadeCacheHits;
+    int             numShadeCacheMisses;
+    int             frameTime;          // microseconds between buffer swaps
     GLenum          drawBuffer;
     GLenum          readBuffer;
 } rbState_t;
@@ -149,6 +154,7 @@ void RB_Shutdown(void);
 void RB_InitDefaultState(void);
 void RB_ResetViewPort(void);
 int RB_GetMaxAnisotropic(void);
+int RB_GetMaxTextureSize(void);
 int RB_GetMaxColorAttachments(void);
 angle_t RB_PointToAngle(fixed_t x, fixed_t y);
 angle_t RB_PointToBam(fixed_t x, fixed_t y);
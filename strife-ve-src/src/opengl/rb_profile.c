@@ -0,0 +1,511 @@
+//
+// Copyright(C) 2014 Night Dive Studios, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//    Renderer pass timing
+//
+//    Passes are wrapped in RB_ProfileBegin/RB_ProfileEnd pairs which
+//    nest into a tree of scopes. CPU time is taken from I_GetTimeUS and,
+//    where GL_ARB_timer_query is available, GPU time from a pair of
+//    timestamp queries per call. The queries are read back a few frames
+//    later so that the readback never waits on the GPU.
+//
+//    -glprofile shows the overlay, -glprofilecsv <file> writes every
+//    frame out to a CSV file and -noglprofilegpu skips the timer queries.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "rb_profile.h"
+#include "rb_main.h"
+#include "rb_gl.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "i_video.h"
+#include "m_argv.h"
+#include "m_misc.h"
+
+#define MAX_PROFILE_SCOPES      64
+#define MAX_PROFILE_DEPTH       16
+#define MAX_PROFILE_CALLS       256
+
+// how many frames of queries are kept in flight before being read back
+#define PROFILE_QUERY_FRAMES    4
+
+// how quickly the overlay averages follow the frame times
+#define PROFILE_SMOOTHING       0.1f
+
+typedef struct
+{
+    const char      *name;
+    int             parent;
+    int             depth;
+    int             cpuTime[PROFILE_QUERY_FRAMES];  // microseconds
+    boolean         bUsed[PROFILE_QUERY_FRAMES];
+    float           cpuAverage;                     // milliseconds
+    float           gpuAverage;                     // milliseconds
+} rbProfileScope_t;
+
+typedef struct
+{
+    int             scope;
+    GLuint          queries[2];
+} rbProfileCall_t;
+
+typedef struct
+{
+    int             scope;
+    uint64_t        cpuStart;
+    int             call;
+} rbProfileStack_t;
+
+boolean rbProfileActive = false;
+
+static boolean              bProfileOverlay;
+static boolean              bProfileGPU;
+static FILE                 *profileCSV;
+
+static rbProfileScope_t     profileScopes[MAX_PROFILE_SCOPES];
+static int                  numProfileScopes;
+
+static rbProfileStack_t     profileStack[MAX_PROFILE_DEPTH];
+static int                  profileDepth;
+
+static rbProfileCall_t      profileCalls[PROFILE_QUERY_FRAMES][MAX_PROFILE_CALLS];
+static int                  numProfileCalls[PROFILE_QUERY_FRAMES];
+static GLuint               profileQueries[PROFILE_QUERY_FRAMES][MAX_PROFILE_CALLS * 2];
+static GLuint               lastProfileQuery[PROFILE_QUERY_FRAMES];
+
+static int                  profileFrame;
+
+//
+// RB_InitProfiler
+//
+
+void RB_InitProfiler(void)
+{
+    int p;
+
+    bProfileOverlay = M_CheckParm("-glprofile");
+
+    p = M_CheckParmWithArgs("-glprofilecsv", 1);
+
+    if(p)
+    {
+        profileCSV = fopen(myargv[p + 1], "w");
+
+        if(profileCSV)
+        {
+            fprintf(profileCSV, "frame,scope,parent,depth,cpu_ms,gpu_ms\n");
+        }
+        else
+        {
+            fprintf(stderr, "RB_InitProfiler: couldn't open %s\n", myargv[p + 1]);
+        }
+    }
+
+    rbProfileActive = (bProfileOverlay || profileCSV != NULL);
+
+    if(!rbProfileActive)
+    {
+        return;
+    }
+
+    bProfileGPU = (has_GL_ARB_timer_query && !M_CheckParm("-noglprofilegpu"));
+
+    if(bProfileGPU)
+    {
+        int i;
+
+        for(i = 0; i < PROFILE_QUERY_FRAMES; ++i)
+        {
+            dglGenQueriesARB(MAX_PROFILE_CALLS * 2, profileQueries[i]);
+        }
+    }
+
+    numProfileScopes = 0;
+    profileDepth = 0;
+    profileFrame = 0;
+    memset(numProfileCalls, 0, sizeof(numProfileCalls));
+}
+
+//
+// RB_ShutdownProfiler
+//
+
+void RB_ShutdownProfiler(void)
+{
+    int i;
+
+    if(bProfileGPU)
+    {
+        for(i = 0; i < PROFILE_QUERY_FRAMES; ++i)
+        {
+            dglDeleteQueriesARB(MAX_PROFILE_CALLS * 2, profileQueries[i]);
+        }
+
+        bProfileGPU = false;
+    }
+
+    if(profileCSV)
+    {
+        fclose(profileCSV);
+        profileCSV = NULL;
+    }
+
+    rbProfileActive = false;
+}
+
+//
+// RB_GetProfileScope
+//
+// Finds the child of parent with the given name, adding it if this
+// is the first time it's been seen
+//
+
+static int RB_GetProfileScope(const char *name, const int parent)
+{
+    rbProfileScope_t *scope;
+    int i;
+
+    for(i = 0; i < numProfileScopes; ++i)
+    {
+        scope = &profileScopes[i];
+
+        if(scope->parent == parent &&
+           (scope->name == name || !strcmp(scope->name, name)))
+        {
+            return i;
+        }
+    }
+
+    if(numProfileScopes >= MAX_PROFILE_SCOPES)
+    {
+        return -1;
+    }
+
+    scope = &profileScopes[numProfileScopes];
+    memset(scope, 0, sizeof(rbProfileScope_t));
+
+    scope->name = name;
+    scope->parent = parent;
+    scope->depth = (parent == -1) ? 0 : profileScopes[parent].depth + 1;
+
+    return numProfileScopes++;
+}
+
+//
+// RB_ProfileBegin
+//
+
+void RB_ProfileBegin(const char *name)
+{
+    rbProfileStack_t *stack;
+    rbProfileCall_t *call;
+    int slot;
+    int parent;
+
+    if(!rbProfileActive)
+    {
+        return;
+    }
+
+    if(profileDepth >= MAX_PROFILE_DEPTH)
+    {
+        // still count it so the matching end pops the right entry
+        profileDepth++;
+        return;
+    }
+
+    slot = profileFrame % PROFILE_QUERY_FRAMES;
+    parent = (profileDepth == 0) ? -1 : profileStack[profileDepth-1].scope;
+
+    stack = &profileStack[profileDepth];
+    stack->call = -1;
+
+    // if the parent didn't fit then neither does anything under it
+    if(profileDepth > 0 && parent == -1)
+    {
+        stack->scope = -1;
+    }
+    else
+    {
+        stack->scope = RB_GetProfileScope(name, parent);
+    }
+
+    profileDepth++;
+
+    if(stack->scope == -1)
+    {
+        return;
+    }
+
+    profileScopes[stack->scope].bUsed[slot] = true;
+
+    if(bProfileGPU && numProfileCalls[slot] < MAX_PROFILE_CALLS)
+    {
+        stack->call = numProfileCalls[slot]++;
+
+        call = &profileCalls[slot][stack->call];
+        call->scope = stack->scope;
+        call->queries[0] = profileQueries[slot][stack->call * 2 + 0];
+        call->queries[1] = profileQueries[slot][stack->call * 2 + 1];
+
+        dglQueryCounter(call->queries[0], GL_TIMESTAMP);
+    }
+
+    stack->cpuStart = I_GetTimeUS();
+}
+
+//
+// RB_ProfileEnd
+//
+
+void RB_ProfileEnd(void)
+{
+    rbProfileStack_t *stack;
+    int slot;
+
+    if(!rbProfileActive || profileDepth <= 0)
+    {
+        return;
+    }
+
+    if(profileDepth-- > MAX_PROFILE_DEPTH)
+    {
+        return;
+    }
+
+    stack = &profileStack[profileDepth];
+
+    if(stack->scope == -1)
+    {
+        return;
+    }
+
+    slot = profileFrame % PROFILE_QUERY_FRAMES;
+    profileScopes[stack->scope].cpuTime[slot] += (int)(I_GetTimeUS() - stack->cpuStart);
+
+    if(stack->call != -1)
+    {
+        lastProfileQuery[slot] = profileCalls[slot][stack->call].queries[1];
+        dglQueryCounter(lastProfileQuery[slot], GL_TIMESTAMP);
+    }
+}
+
+//
+// RB_ResolveProfileFrame
+//
+// Reads back the timers for the frame that last used slot and folds
+// them into the averages. Returns false if the GPU hasn't finished
+// with the frame yet, in which case its GPU times are dropped
+//
+
+static boolean RB_ResolveProfileFrame(const int slot, float *gpuTime)
+{
+    rbProfileCall_t *call;
+    GLuint available;
+    GLuint64 start;
+    GLuint64 end;
+    int i;
+
+    for(i = 0; i < numProfileScopes; ++i)
+    {
+        gpuTime[i] = 0;
+    }
+
+    if(!bProfileGPU || numProfileCalls[slot] == 0)
+    {
+        return false;
+    }
+
+    // timestamps land in order, so if the last one is in so are the rest
+    available = 0;
+    dglGetQueryObjectuivARB(lastProfileQuery[slot], GL_QUERY_RESULT_AVAILABLE_ARB, &available);
+
+    if(!available)
+    {
+        return false;
+    }
+
+    for(i = 0; i < numProfileCalls[slot]; ++i)
+    {
+        call = &profileCalls[slot][i];
+
+        dglGetQueryObjectui64v(call->queries[0], GL_QUERY_RESULT_ARB, &start);
+        dglGetQueryObjectui64v(call->queries[1], GL_QUERY_RESULT_ARB, &end);
+
+        if(end > start)
+        {
+            gpuTime[call->scope] += (float)(end - start) / 1000000.0f;
+        }
+    }
+
+    return true;
+}
+
+//
+// RB_WriteProfileCSV
+//
+
+static void RB_WriteProfileCSV(const int frame, const int slot,
+                               const float *gpuTime, const boolean bHasGPU)
+{
+    rbProfileScope_t *scope;
+    int i;
+
+    for(i = 0; i < numProfileScopes; ++i)
+    {
+        scope = &profileScopes[i];
+
+        if(!scope->bUsed[slot])
+        {
+            continue;
+        }
+
+        fprintf(profileCSV, "%i,%s,%s,%i,%.4f,", frame, scope->name,
+                scope->parent == -1 ? "" : profileScopes[scope->parent].name,
+                scope->depth, (float)scope->cpuTime[slot] / 1000.0f);
+
+        if(bHasGPU)
+        {
+            fprintf(profileCSV, "%.4f\n", gpuTime[i]);
+        }
+        else
+        {
+            fprintf(profileCSV, "\n");
+        }
+    }
+}
+
+//
+// RB_ProfileEndFrame
+//
+// Called once the frame has been handed to the driver. Updates the
+// averages with this frame's CPU times, then moves on to the next slot,
+// whose queries are from PROFILE_QUERY_FRAMES frames ago
+//
+
+void RB_ProfileEndFrame(void)
+{
+    static float gpuTime[MAX_PROFILE_SCOPES];
+    rbProfileScope_t *scope;
+    boolean bHasGPU;
+    int slot;
+    int i;
+
+    if(!rbProfileActive)
+    {
+        return;
+    }
+
+    // anything left open didn't get closed this frame
+    profileDepth = 0;
+
+    slot = profileFrame % PROFILE_QUERY_FRAMES;
+
+    for(i = 0; i < numProfileScopes; ++i)
+    {
+        scope = &profileScopes[i];
+        scope->cpuAverage += ((float)scope->cpuTime[slot] / 1000.0f - scope->cpuAverage) * PROFILE_SMOOTHING;
+    }
+
+    profileFrame++;
+    slot = profileFrame % PROFILE_QUERY_FRAMES;
+
+    if(profileFrame >= PROFILE_QUERY_FRAMES)
+    {
+        bHasGPU = RB_ResolveProfileFrame(slot, gpuTime);
+
+        if(bHasGPU)
+        {
+            for(i = 0; i < numProfileScopes; ++i)
+            {
+                scope = &profileScopes[i];
+                scope->gpuAverage += (gpuTime[i] - scope->gpuAverage) * PROFILE_SMOOTHING;
+            }
+        }
+
+        if(profileCSV)
+        {
+            RB_WriteProfileCSV(profileFrame - PROFILE_QUERY_FRAMES, slot, gpuTime, bHasGPU);
+        }
+    }
+
+    // clear out the slot for the frame about to start
+    for(i = 0; i < numProfileScopes; ++i)
+    {
+        profileScopes[i].cpuTime[slot] = 0;
+        profileScopes[i].bUsed[slot] = false;
+    }
+
+    numProfileCalls[slot] = 0;
+}
+
+//
+// RB_DrawProfileScopes
+//
+
+static void RB_DrawProfileScopes(const int x, int *y, const int parent)
+{
+    rbProfileScope_t *scope;
+    int i;
+
+    for(i = 0; i < numProfileScopes; ++i)
+    {
+        scope = &profileScopes[i];
+
+        if(scope->parent != parent)
+        {
+            continue;
+        }
+
+        if(bProfileGPU)
+        {
+            RB_Printf(x + scope->depth * 12, *y, "%s: %.3f / %.3f ms", scope->name,
+                      scope->cpuAverage, scope->gpuAverage);
+        }
+        else
+        {
+            RB_Printf(x + scope->depth * 12, *y, "%s: %.3f ms", scope->name,
+                      scope->cpuAverage);
+        }
+
+        *y += 12;
+        RB_DrawProfileScopes(x, y, i);
+    }
+}
+
+//
+// RB_DrawProfiler
+//
+
+void RB_DrawProfiler(void)
+{
+    int x;
+    int y;
+
+    if(!bProfileOverlay)
+    {
+        return;
+    }
+
+    x = screen_width / 2;
+    y = 0;
+
+    RB_Printf(x, y, bProfileGPU ? "Pass: CPU / GPU" : "Pass: CPU");
+    y += 12;
+
+    RB_DrawProfileScopes(x, &y, -1);
+}
@@ -0,0 +1,29 @@
+//
+// Copyright(C) 2014 Night Dive Studios, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#ifndef __RB_PROFILE_H__
+#define __RB_PROFILE_H__
+
+#include "doomtype.h"
+
+extern boolean rbProfileActive;
+
+void RB_InitProfiler(void);
+void RB_ShutdownProfiler(void);
+void RB_ProfileBegin(const char *name);
+void RB_ProfileEnd(void);
+void RB_ProfileEndFrame(void);
+void RB_DrawProfiler(void);
+
+#endif
@@ -0,0 +1,436 @@
+//
+// Copyright(C) 2014 Night Dive Studios, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//    Potentially visible set generation for maps without a GL_PVS lump
+//
+//    Every seg with a partner on the other side is a portal between two
+//    subsectors. From each portal out of a subsector, the flow walks on
+//    through the portals of the subsectors behind it, clipping each one
+//    to the separating lines between the source and the portal it is
+//    seen through. Anything that is still left of a portal is potentially
+//    visible. All of this is done in 2D; doors and lifts may open at any
+//    time, so two sided lines never block. Whenever there's any doubt
+//    (degenerate portals, too much work) the result errs towards visible.
+//
+
+#include <math.h>
+
+#include "rb_main.h"
+#include "rb_pvs.h"
+#include "rb_level.h"
+#include "i_thread.h"
+#include "i_system.h"
+#include "i_swap.h"
+#include "r_state.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+// distance (in map units) at which a point counts as lying on a line
+#define PVS_EPSILON     0.125f
+
+// portals visited for a single subsector before giving up on it
+#define PVS_MAXSTEPS    0x40000
+
+typedef struct
+{
+    float   x1;
+    float   y1;
+    float   x2;
+    float   y2;
+} pvsWinding_t;
+
+typedef struct
+{
+    pvsWinding_t    w;
+    int             target;     // subsector on the other side
+} pvsPortal_t;
+
+typedef struct
+{
+    pvsPortal_t     *portals;
+    int             *firstportal;   // numsubsectors + 1 entries
+    byte            *pvs;
+    int             rowlength;
+    int             numjobs;
+} pvsWork_t;
+
+typedef struct
+{
+    pvsWork_t       *work;
+    byte            *row;
+    byte            *onstack;
+    int             steps;
+} pvsFlow_t;
+
+//
+// RB_PVSSide
+//
+// Signed distance of a point from the line a->b. Positive is to the left
+//
+
+static float RB_PVSSide(float ax, float ay, float bx, float by, float x, float y)
+{
+    float dx = bx - ax;
+    float dy = by - ay;
+    float len = sqrtf(dx * dx + dy * dy);
+
+    return (dx * (y - ay) - dy * (x - ax)) / len;
+}
+
+//
+// RB_ClipWinding
+//
+// Keeps the part of w that is on the given side of a->b (or on it).
+// Returns false if nothing is left
+//
+
+static boolean RB_ClipWinding(pvsWinding_t *w, float ax, float ay, float bx, float by, float side)
+{
+    float d1 = RB_PVSSide(ax, ay, bx, by, w->x1, w->y1) * side;
+    float d2 = RB_PVSSide(ax, ay, bx, by, w->x2, w->y2) * side;
+    float frac;
+
+    if(d1 >= -PVS_EPSILON && d2 >= -PVS_EPSILON)
+    {
+        return true;
+    }
+
+    if(d1 < -PVS_EPSILON && d2 < -PVS_EPSILON)
+    {
+        return false;
+    }
+
+    frac = d1 / (d1 - d2);
+
+    if(d1 < 0)
+    {
+        w->x1 = w->x1 + (w->x2 - w->x1) * frac;
+        w->y1 = w->y1 + (w->y2 - w->y1) * frac;
+    }
+    else
+    {
+        w->x2 = w->x1 + (w->x2 - w->x1) * frac;
+        w->y2 = w->y1 + (w->y2 - w->y1) * frac;
+    }
+
+    return true;
+}
+
+//
+// RB_ClipToSeparators
+//
+// Clips target to what can be seen from source through pass. The lines
+// running from an end of the source to an end of the pass portal with
+// the two on opposite sides bound that region. Lines that can't be
+// trusted to separate them are skipped, which only lets more through.
+//
+
+static boolean RB_ClipToSeparators(pvsWinding_t *source, pvsWinding_t *pass, pvsWinding_t *target)
+{
+    float sx[2], sy[2];
+    float px[2], py[2];
+    float ds, dp;
+    float dx, dy;
+    int i, j;
+
+    sx[0] = source->x1; sy[0] = source->y1;
+    sx[1] = source->x2; sy[1] = source->y2;
+    px[0] = pass->x1; py[0] = pass->y1;
+    px[1] = pass->x2; py[1] = pass->y2;
+
+    for(i = 0; i < 2; i++)
+    {
+        for(j = 0; j < 2; j++)
+        {
+            dx = px[j] - sx[i];
+            dy = py[j] - sy[i];
+
+            if(dx * dx + dy * dy < PVS_EPSILON * PVS_EPSILON)
+            {
+                continue;
+            }
+
+            ds = RB_PVSSide(sx[i], sy[i], px[j], py[j], sx[i^1], sy[i^1]);
+            dp = RB_PVSSide(sx[i], sy[i], px[j], py[j], px[j^1], py[j^1]);
+
+            if(!((ds < -PVS_EPSILON && dp > PVS_EPSILON) ||
+                 (ds > PVS_EPSILON && dp < -PVS_EPSILON)))
+            {
+                continue;
+            }
+
+            if(!RB_ClipWinding(target, sx[i], sy[i], px[j], py[j], dp > 0 ? 1.0f : -1.0f))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+//
+// RB_PortalFlow
+//
+
+static void RB_PortalFlow(pvsFlow_t *flow, pvsWinding_t *source, pvsWinding_t *pass, int num)
+{
+    pvsWork_t *work = flow->work;
+    pvsPortal_t *p;
+    pvsWinding_t target;
+    pvsWinding_t newsource;
+    int i;
+
+    flow->row[num >> 3] |= (1 << (num & 7));
+
+    if(++flow->steps > PVS_MAXSTEPS)
+    {
+        return;
+    }
+
+    flow->onstack[num] = true;
+
+    for(i = work->firstportal[num]; i < work->firstportal[num + 1]; i++)
+    {
+        p = &work->portals[i];
+
+        // a straight line can't come back into a convex subsector
+        if(flow->onstack[p->target])
+        {
+            continue;
+        }
+
+        target = p->w;
+        newsource = *source;
+
+        // must be in front of the source portal. one lying along
+        // its line can't be looked through from behind it
+        if(RB_PVSSide(source->x1, source->y1, source->x2, source->y2, target.x1, target.y1) <= PVS_EPSILON &&
+           RB_PVSSide(source->x1, source->y1, source->x2, source->y2, target.x2, target.y2) <= PVS_EPSILON)
+        {
+            continue;
+        }
+
+        if(!RB_ClipWinding(&target, source->x1, source->y1, source->x2, source->y2, 1.0f))
+        {
+            continue;
+        }
+
+        if(pass != NULL)
+        {
+            if(!RB_ClipToSeparators(source, pass, &target))
+            {
+                continue;
+            }
+
+            // and only the part of the source that can still see it
+            if(!RB_ClipToSeparators(&target, pass, &newsource))
+            {
+                continue;
+            }
+        }
+
+        RB_PortalFlow(flow, &newsource, &target, p->target);
+    }
+
+    flow->onstack[num] = false;
+}
+
+//
+// RB_PVSJob
+//
+
+static void RB_PVSJob(int job, void *data)
+{
+    pvsWork_t *work = (pvsWork_t*)data;
+    pvsFlow_t flow;
+    pvsPortal_t *p;
+    int count;
+    int first;
+    int i;
+    int j;
+
+    count = (numsubsectors + work->numjobs - 1) / work->numjobs;
+    first = job * count;
+
+    if(first + count > numsubsectors)
+    {
+        count = numsubsectors - first;
+    }
+
+    if(count <= 0)
+    {
+        return;
+    }
+
+    flow.work = work;
+
+    if(!(flow.onstack = (byte*)calloc(numsubsectors, 1)))
+    {
+        I_Error("RB_PVSJob: failed to allocate flow stack");
+    }
+
+    for(i = first; i < first + count; i++)
+    {
+        flow.row = work->pvs + (i * work->rowlength);
+        flow.row[i >> 3] |= (1 << (i & 7));
+        flow.steps = 0;
+        flow.onstack[i] = true;
+
+        for(j = work->firstportal[i]; j < work->firstportal[i + 1]; j++)
+        {
+            p = &work->portals[j];
+
+            if(!flow.onstack[p->target])
+            {
+                RB_PortalFlow(&flow, &p->w, NULL, p->target);
+            }
+        }
+
+        flow.onstack[i] = false;
+
+        if(flow.steps > PVS_MAXSTEPS)
+        {
+            memset(flow.row, 0xff, work->rowlength);
+        }
+    }
+
+    free(flow.onstack);
+}
+
+//
+// RB_GeneratePVS
+//
+// Fills pvs (already sized for the level) from the current segs and
+// subsectors. seglump is the GL_SEGS lump, which holds the partner segs.
+// Returns false if the level doesn't have what is needed.
+//
+
+boolean RB_GeneratePVS(byte *pvs, int seglump)
+{
+    glSeg_t *glsegs;
+    int *segsubsector;
+    pvsWork_t work;
+    pvsPortal_t *p;
+    seg_t *seg;
+    word partner;
+    int i;
+    int j;
+    int k;
+
+    if(W_LumpLength(seglump) / sizeof(glSeg_t) != numsegs || numsubsectors <= 0)
+    {
+        return false;
+    }
+
+    segsubsector = (int*)Z_Malloc(numsegs * sizeof(int), PU_STATIC, 0);
+
+    for(i = 0; i < numsegs; i++)
+    {
+        segsubsector[i] = -1;
+    }
+
+    for(i = 0; i < numsubsectors; i++)
+    {
+        for(j = 0; j < subsectors[i].numlines; j++)
+        {
+            k = subsectors[i].firstline + j;
+
+            if(k >= 0 && k < numsegs)
+            {
+                segsubsector[k] = i;
+            }
+        }
+    }
+
+    work.portals = (pvsPortal_t*)Z_Malloc(numsegs * sizeof(pvsPortal_t), PU_STATIC, 0);
+    work.firstportal = (int*)Z_Malloc((numsubsectors + 1) * sizeof(int), PU_STATIC, 0);
+    work.rowlength = (numsubsectors + 7) / 8;
+    work.pvs = pvs;
+
+    glsegs = (glSeg_t*)W_CacheLumpNum(seglump, PU_STATIC);
+    p = work.portals;
+
+    // segs run clockwise around their subsector, so whatever is
+    // behind a portal is always to the left of it
+    for(i = 0; i < numsubsectors; i++)
+    {
+        work.firstportal[i] = p - work.portals;
+
+        for(j = 0; j < subsectors[i].numlines; j++)
+        {
+            k = subsectors[i].firstline + j;
+            partner = SHORT(glsegs[k].partner);
+
+            if(partner == 0xFFFF || partner >= numsegs ||
+                segsubsector[partner] == -1 || segsubsector[partner] == i)
+            {
+                continue;
+            }
+
+            seg = &segs[k];
+
+            p->w.x1 = seg->v1->fx;
+            p->w.y1 = seg->v1->fy;
+            p->w.x2 = seg->v2->fx;
+            p->w.y2 = seg->v2->fy;
+            p->target = segsubsector[partner];
+
+            if(p->w.x1 == p->w.x2 && p->w.y1 == p->w.y2)
+            {
+                continue;
+            }
+
+            p++;
+        }
+    }
+
+    work.firstportal[numsubsectors] = p - work.portals;
+
+    W_ReleaseLumpNum(seglump);
+    Z_Free(segsubsector);
+
+    memset(pvs, 0, work.rowlength * numsubsectors);
+
+    // every subsector is independent of the others
+    work.numjobs = (I_GetNumWorkerThreads() + 1) * 4;
+
+    if(work.numjobs > numsubsectors)
+    {
+        work.numjobs = numsubsectors;
+    }
+
+    I_RunJobs(RB_PVSJob, &work, work.numjobs);
+
+    // seeing is mutual, make sure both sides agree
+    for(i = 0; i < numsubsectors; i++)
+    {
+        for(j = i + 1; j < numsubsectors; j++)
+        {
+            byte *a = &pvs[i * work.rowlength + (j >> 3)];
+            byte *b = &pvs[j * work.rowlength + (i >> 3)];
+
+            if((*a & (1 << (j & 7))) || (*b & (1 << (i & 7))))
+            {
+                *a |= (1 << (j & 7));
+                *b |= (1 << (i & 7));
+            }
+        }
+    }
+
+    Z_Free(work.portals);
+    Z_Free(work.firstportal);
+
+    return true;
+}
@@ -107,6 +107,48 @@ void SP_SetUniform1f(rbShader_t *shader, const char *name, const float val)
     }
 }
 
+//
+// SP_SetUniform3f
+//
+
+void SP_SetUniform3f(rbShader_t *shader, const char *name, const float x, const float y, const float z)
+{
+    int loc;
+    
+    if(!has_GL_ARB_shader_objects)
+    {
+        return;
+    }
+
+    loc = dglGetUniformLocationARB(shader->programObj, name);
+
+    if(loc != -1)
+    {
+        dglUniform3fARB(loc, x, y, z);
+    }
+}
+
+//
+// SP_SetUniform4fv
+//
+
+void SP_SetUniform4fv(rbShader_t *shader, const char *name, const int count, const float *val)
+{
+    int loc;
+    
+    if(!has_GL_ARB_shader_objects)
+    {
+        return;
+    }
+
+    loc = dglGetUniformLocationARB(shader->programObj, name);
+
+    if(loc != -1)
+    {
+        dglUniform4fvARB(loc, count, val);
+    }
+}
+
 //
 // SP_SetUniformMat4
 //
@@ -129,22 +171,13 @@ void SP_SetUniformMat4(rbShader_t *shader, const char *name, matrix val, boolean
 }
 
 //
-// SP_Compile
+// SP_CompileSource
 //
 
-static void SP_Compile(rbShader_t *shader, const char *name, rShaderType_t type)
+static void SP_CompileSource(rbShader_t *shader, const char *source, rShaderType_t type)
 {
-    byte *data;
-    int length;
-    int lump;
     rhandle *handle;
 
-    lump = W_GetNumForName((char*)name);
-    length = W_LumpLength(lump);
-
-    data = (byte*)Z_Calloc(length+1, sizeof(char), PU_STATIC, NULL);
-    W_ReadLump(lump, data);
-    
     if(type == RST_VERTEX)
     {
         shader->vertexProgram = dglCreateShaderObjectARB(GL_VERTEX_SHADER_ARB);
@@ -157,13 +190,31 @@ static void SP_Compile(rbShader_t *shader, const char *name, rShaderType_t type)
     }
     else
     {
-        Z_Free(data);
         return;
     }
     
-    dglShaderSourceARB(*handle, 1, (const GLcharARB**)&data, NULL);
+    dglShaderSourceARB(*handle, 1, (const GLcharARB**)&source, NULL);
     dglCompileShaderARB(*handle);
     dglAttachObjectARB(shader->programObj, *handle);
+}
+
+//
+// SP_Compile
+//
+
+static void SP_Compile(rbShader_t *shader, const char *name, rShaderType_t type)
+{
+    byte *data;
+    int length;
+    int lump;
+
+    lump = W_GetNumForName((char*)name);
+    length = W_LumpLength(lump);
+
+    data = (byte*)Z_Calloc(length+1, sizeof(char), PU_STATIC, NULL);
+    W_ReadLump(lump, data);
+    
+    SP_CompileSource(shader, (const char*)data, type);
     
     Z_Free(data);
 }
@@ -243,3 +294,50 @@ void SP_LoadProgram(rbShader_t *shader, const char *program)
 
     SP_Link(shader);
 }
+
+//
+// SP_LoadProgramDefault
+//
+// Same as SP_LoadProgram, but falls back to the given
+// source for any part of the program that has no lump
+//
+
+void SP_LoadProgramDefault(rbShader_t *shader, const char *program,
+                           const char *vertexSource, const char *fragmentSource)
+{
+    char namebuf[9];
+
+    shader->bHasErrors = false;
+    shader->bLoaded = false;
+
+    if(!has_GL_ARB_shader_objects)
+    {
+        return;
+    }
+    
+    shader->programObj = dglCreateProgramObjectARB();
+
+    DEH_snprintf(namebuf, 9, "%s_V", program);
+
+    if(W_CheckNumForName(namebuf) != -1)
+    {
+        SP_Compile(shader, namebuf, RST_VERTEX);
+    }
+    else
+    {
+        SP_CompileSource(shader, vertexSource, RST_VERTEX);
+    }
+
+    DEH_snprintf(namebuf, 9, "%s_F", program);
+
+    if(W_CheckNumForName(namebuf) != -1)
+    {
+        SP_Compile(shader, namebuf, RST_FRAGMENT);
+    }
+    else
+    {
+        SP_CompileSource(shader, fragmentSource, RST_FRAGMENT);
+    }
+
+    SP_Link(shader);
+}
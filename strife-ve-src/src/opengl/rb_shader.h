@@ -38,7 +38,11 @@ void SP_Enable(rbShader_t *shader);
 void SP_Delete(rbShader_t *shader);
 void SP_SetUniform1i(rbShader_t *shader, const char *name, const int val);
 void SP_SetUniform1f(rbShader_t *shader, const char *name, const float val);
+void SP_SetUniform3f(rbShader_t *shader, const char *name, const float x, const float y, const float z);
+void SP_SetUniform4fv(rbShader_t *shader, const char *name, const int count, const float *val);
 void SP_SetUniformMat4(rbShader_t *shader, const char *name, matrix val, boolean bTranspose);
 void SP_LoadProgram(rbShader_t *shader, const char *program);
+void SP_LoadProgramDefault(rbShader_t *shader, const char *program,
+                           const char *vertexSource, const char *fragmentSource);
 
 #endif
@@ -93,17 +93,49 @@ static void RB_AddSpriteDrawlist(rbVisSprite_t *vis, int texid)
 }
 
 //
-// RB_AddSprites
+// RB_SpriteInView
 //
 
-void RB_AddSprites(subsector_t *sub)
+static boolean RB_SpriteInView(mobj_t *thing)
 {
-    mobj_t *thing;
     fixed_t height;
     spritedef_t *sprdef;
     spriteframe_t *sprframe;
     fixed_t bbox[4];
 
+    bbox[BOXRIGHT]  = thing->x + thing->radius;
+    bbox[BOXLEFT]   = thing->x - thing->radius;
+    bbox[BOXTOP]    = thing->y + thing->radius;
+    bbox[BOXBOTTOM] = thing->y - thing->radius;
+
+    sprdef = &sprites[thing->sprite];
+    sprframe = &sprdef->spriteframes[thing->frame & FF_FRAMEMASK];
+
+    if(sprframe)
+    {
+        height = spriteheight[sprframe->lump[0]] + (16*FRACUNIT);
+
+        if(height < thing->height)
+        {
+            height = thing->height;
+        }
+    }
+    else
+    {
+        height = thing->height;
+    }
+
+    return RB_CheckBoxInView(&rbPlayerView, bbox, thing->z, thing->z + height);
+}
+
+//
+// RB_AddSprites
+//
+
+void RB_AddSprites(subsector_t *sub)
+{
+    mobj_t *thing;
+
     // Handle all things in sector.
     for(thing = sub->sector->thinglist; thing; thing = thing->snext)
     {
@@ -125,36 +157,66 @@ void RB_AddSprites(subsector_t *sub)
             return;
         }
         
-        bbox[BOXRIGHT]  = thing->x + thing->radius;
-        bbox[BOXLEFT]   = thing->x - thing->radius;
-        bbox[BOXTOP]    = thing->y + thing->radius;
-        bbox[BOXBOTTOM] = thing->y - thing->radius;
+        if(!RB_SpriteInView(thing))
+        {
+            continue;
+        }
 
-        sprdef = &sprites[thing->sprite];
-        sprframe = &sprdef->spriteframes[thing->frame & FF_FRAMEMASK];
+        vissprite->spr = thing;
+        vissprite++;
+    }
+}
 
-        if(sprframe)
-        {
-            height = spriteheight[sprframe->lump[0]] + (16*FRACUNIT);
+//
+// RB_FindSprites
+//
+// Same checks as RB_AddSprites, but only hands back the things that
+// should be added. Safe to call from the BSP worker threads. Returns
+// the number of things found, which may be more than maxthings.
+//
 
-            if(height < thing->height)
-            {
-                height = thing->height;
-            }
-        }
-        else
+int RB_FindSprites(subsector_t *sub, mobj_t **things, int maxthings)
+{
+    mobj_t *thing;
+    int count = 0;
+
+    for(thing = sub->sector->thinglist; thing; thing = thing->snext)
+    {
+        if(thing->subsector != sub || thing->flags & MF_NOSECTOR)
         {
-            height = thing->height;
+            continue;
         }
-        
-        if(!RB_CheckBoxInView(&rbPlayerView, bbox, thing->z, thing->z + height))
+
+        if(!RB_SpriteInView(thing))
         {
             continue;
         }
 
-        vissprite->spr = thing;
-        vissprite++;
+        if(count < maxthings)
+        {
+            things[count] = thing;
+        }
+
+        count++;
+    }
+
+    return count;
+}
+
+//
+// RB_AddSprite
+//
+
+void RB_AddSprite(mobj_t *thing)
+{
+    if(vissprite - visspritelist >= MAX_SPRITES)
+    {
+        fprintf(stderr, "RB_AddSprites: Sprite overflow");
+        return;
     }
+
+    vissprite->spr = thing;
+    vissprite++;
 }
 
 //
@@ -230,6 +292,7 @@ void RB_SetupSprites(void)
         vis->z = FIXED2FLOAT(pos.z);
 
         vis->indiceStart = 0;
+        vis->bQuadCached = false;
 
         // determine distance from player's view
         vis->dist = (int)((vis->x - rbPlayerView.x) * rbPlayerView.rotyaw.c +
@@ -245,6 +308,27 @@ void RB_SetupSprites(void)
     }
 }
 
+//
+// RB_ApplySpriteCellColor
+//
+
+static void RB_ApplySpriteCellColor(vtx_t *v, int lightGridIndex, sector_t *sector)
+{
+    boolean insky;
+
+    if(lightGridIndex == -1)
+    {
+        return;
+    }
+
+    insky = sector->ceilingpic == skyflatnum;
+    
+    RB_ApplyLightGridRGB(&v[0], lightGridIndex, insky);
+    RB_ApplyLightGridRGB(&v[1], lightGridIndex, insky);
+    RB_ApplyLightGridRGB(&v[2], lightGridIndex, insky);
+    RB_ApplyLightGridRGB(&v[3], lightGridIndex, insky);
+}
+
 //
 // RB_SetSpriteCellColor
 //
@@ -253,16 +337,36 @@ void RB_SetSpriteCellColor(vtx_t *v, fixed_t x, fixed_t y, fixed_t z, sector_t *
 {
     if(rbLightmaps && lightgrid.count > 0)
     {
-        int lightGridIndex;
-        
-        if((lightGridIndex = RB_GetLightGridIndex(x, y, z)) != -1)
-        {
-            boolean insky = sector->ceilingpic == skyflatnum;
-            
-            RB_ApplyLightGridRGB(&v[0], lightGridIndex, insky);
-            RB_ApplyLightGridRGB(&v[1], lightGridIndex, insky);
-            RB_ApplyLightGridRGB(&v[2], lightGridIndex, insky);
-            RB_ApplyLightGridRGB(&v[3], lightGridIndex, insky);
-        }
+        RB_ApplySpriteCellColor(v, RB_GetLightGridIndex(x, y, z), sector);
+    }
+}
+
+//
+// RB_SetThingCellColor
+//
+// Same as RB_SetSpriteCellColor, but uses the cell cached in the thing
+//
+
+void RB_SetThingCellColor(vtx_t *v, mobj_t *thing, fixed_t z)
+{
+    if(rbLightmaps && lightgrid.count > 0)
+    {
+        RB_ApplySpriteCellColor(v, RB_GetThingLightGridIndex(thing, z),
+                                thing->subsector->sector);
     }
 }
+
+//
+// RB_GetThingCellPos
+//
+// Where the instance shader looks the thing up in the light grid
+// texture instead of RB_SetThingCellColor. w is 1 in sky sectors
+//
+
+void RB_GetThingCellPos(float *pos, mobj_t *thing, fixed_t z)
+{
+    pos[0] = (float)(thing->x >> FRACBITS);
+    pos[1] = (float)(thing->y >> FRACBITS);
+    pos[2] = (float)(z >> FRACBITS);
+    pos[3] = (thing->subsector->sector->ceilingpic == skyflatnum) ? 1.0f : 0.0f;
+}
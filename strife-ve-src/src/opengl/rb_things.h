@@ -30,6 +30,11 @@ typedef struct
     float   x;
     float   y;
     float   z;
+
+    // the plane is built by the first pass that draws the sprite;
+    // the brightmap pass only needs to copy it
+    boolean bQuadCached;
+    vtx_t   quad[4];
 } rbVisSprite_t;
 
 extern matrix rbSpriteViewMatrix;
@@ -37,7 +42,11 @@ extern matrix rbSpriteViewBillboardMatrix; // for very tall sprites
 
 void RB_ClearSprites(void);
 void RB_AddSprites(subsector_t *sub);
+int RB_FindSprites(subsector_t *sub, mobj_t **things, int maxthings);
+void RB_AddSprite(mobj_t *thing);
 void RB_SetupSprites(void);
 void RB_SetSpriteCellColor(vtx_t *v, fixed_t x, fixed_t y, fixed_t z, sector_t *sector);
+void RB_SetThingCellColor(vtx_t *v, mobj_t *thing, fixed_t z);
+void RB_GetThingCellPos(float *pos, mobj_t *thing, fixed_t z);
 
 #endif
@@ -0,0 +1,755 @@
+//
+// Copyright(C) 2007-2014 Samuel Villarreal
+// Copyright(C) 2014 Night Dive Studios, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//    Static level geometry stored in vertex buffer objects
+//
+//    Every solid wall and flat surface of the level is baked into a
+//    set of vertex/index buffer pages when the level is loaded. Each
+//    surface remembers what it was baked against (heights, light,
+//    texture, offsets, shades). As long as that still matches at draw
+//    time, the surface is queued as an index range into its page and
+//    no vertex data leaves the client. Surfaces that no longer match
+//    are streamed through the regular generators; once their sectors
+//    have come to rest, the freshly generated vertices are written
+//    back into the page so the next frame can draw them statically.
+//
+
+#include <stddef.h>
+
+#include "rb_main.h"
+#include "rb_gl.h"
+#include "rb_vbo.h"
+#include "rb_draw.h"
+#include "rb_geom.h"
+#include "rb_view.h"
+#include "rb_config.h"
+#include "rb_wallshade.h"
+#include "r_state.h"
+#include "i_system.h"
+#include "z_zone.h"
+#include "doomstat.h"
+
+// 16-bit indices limit how many vertices can go into a page
+#define VBO_PAGESIZE    0x10000
+#define VBO_MAXPAGES    32
+
+typedef enum
+{
+    VS_LOWER    = 0,
+    VS_UPPER,
+    VS_MIDDLE,
+    NUMVBOSEGSIDES
+} vboSegSide_t;
+
+typedef struct
+{
+    int             stamp;
+    int             light;
+    int             texid;
+    int             translation;
+    fixed_t         heights[4];
+    fixed_t         offsets[2];
+    int             pics[2];
+    int             sectorlight;
+    rbShadeDef_t    *shades[2];
+} vboSurfaceKey_t;
+
+typedef struct
+{
+    vboSurfaceKey_t key;
+    int             page;
+    int             firstVertex;
+    int             firstIndex;
+    int             numVertices;
+    int             numIndices;
+    boolean         valid;
+} vboSurface_t;
+
+typedef struct
+{
+    dtexture        vertexBuffer;
+    dtexture        indexBuffer;
+    int             numVertices;
+    int             numIndices;
+    int             numSurfaces;
+
+    // index ranges queued for the current batch
+    GLsizei         *counts;
+    GLvoid          **offsets;
+    int             numRanges;
+    int             lastIndex;
+} vboPage_t;
+
+static vboPage_t vboPages[VBO_MAXPAGES];
+static int numVboPages = 0;
+
+static vboSurface_t *segSurfaces = NULL;
+static vboSurface_t *leafSurfaces = NULL;
+
+// bumped whenever something not covered by the surface keys changes
+static int vboGeneration = 1;
+
+// staging area for the page that is being built
+static vtx_t *stageVertices = NULL;
+static word *stageIndices = NULL;
+
+//=============================================================================
+//
+// Surface keys
+//
+//=============================================================================
+
+//
+// VBO_KeyStamp
+//
+
+static int VBO_KeyStamp(void)
+{
+    return (vboGeneration << 2) | (rbWallShades ? 1 : 0) | (rbLightmaps ? 2 : 0);
+}
+
+//
+// VBO_SetupSegKey
+//
+
+static void VBO_SetupSegKey(vtxlist_t *vl, vboSurfaceKey_t *key)
+{
+    seg_t *seg = (seg_t*)vl->data;
+    sector_t *front = seg->frontsector;
+    sector_t *back = seg->backsector;
+
+    memset(key, 0, sizeof(vboSurfaceKey_t));
+
+    key->stamp          = VBO_KeyStamp();
+    key->light          = vl->params + (rbPlayerView.extralight << 4);
+    key->texid          = vl->texid;
+    key->translation    = texturetranslation[vl->texid];
+    key->heights[0]     = front->floorheight;
+    key->heights[1]     = front->ceilingheight;
+    key->offsets[0]     = seg->sidedef->textureoffset;
+    key->offsets[1]     = seg->sidedef->rowoffset;
+    key->pics[0]        = front->ceilingpic;
+    key->sectorlight    = front->lightlevel;
+    key->shades[0]      = front->floorshade;
+    key->shades[1]      = front->ceilingshade;
+
+    if(back)
+    {
+        key->heights[2] = back->floorheight;
+        key->heights[3] = back->ceilingheight;
+        key->pics[1]    = back->ceilingpic;
+    }
+}
+
+//
+// VBO_SetupLeafKey
+//
+
+static void VBO_SetupLeafKey(vtxlist_t *vl, vboSurfaceKey_t *key)
+{
+    sector_t *sector = ((subsector_t*)vl->data)->sector;
+
+    memset(key, 0, sizeof(vboSurfaceKey_t));
+
+    key->stamp          = VBO_KeyStamp();
+    key->light          = vl->params + (rbPlayerView.extralight << 4);
+    key->texid          = vl->texid;
+    key->heights[0]     = sector->floorheight;
+    key->heights[1]     = sector->ceilingheight;
+    key->sectorlight    = sector->lightlevel;
+    key->shades[0]      = sector->floorshade;
+    key->shades[1]      = sector->ceilingshade;
+}
+
+//
+// VBO_SectorInMotion
+//
+// Movers and interpolated sectors change every frame, so there is
+// no point in writing them back into the static buffers
+//
+
+static boolean VBO_SectorInMotion(sector_t *sector)
+{
+    return (sector->specialdata != NULL || sectorinterps[sector - sectors].interpolated);
+}
+
+//
+// VBO_SectorLight
+//
+
+static int VBO_SectorLight(sector_t *sector)
+{
+    return (rbLightmaps && sector->altlightlevel != -1) ? sector->altlightlevel : sector->lightlevel;
+}
+
+//=============================================================================
+//
+// Level setup
+//
+//=============================================================================
+
+//
+// VBO_UploadPage
+//
+
+static void VBO_UploadPage(vboPage_t *page)
+{
+    dglGenBuffersARB(1, &page->vertexBuffer);
+    dglBindBufferARB(GL_ARRAY_BUFFER_ARB, page->vertexBuffer);
+    dglBufferDataARB(GL_ARRAY_BUFFER_ARB, page->numVertices * sizeof(vtx_t),
+                     stageVertices, GL_STATIC_DRAW_ARB);
+
+    dglGenBuffersARB(1, &page->indexBuffer);
+    dglBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, page->indexBuffer);
+    dglBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, page->numIndices * sizeof(word),
+                     stageIndices, GL_STATIC_DRAW_ARB);
+
+    dglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+    dglBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+
+    page->counts = (GLsizei*)Z_Malloc(page->numSurfaces * sizeof(GLsizei), PU_LEVEL, NULL);
+    page->offsets = (GLvoid**)Z_Malloc(page->numSurfaces * sizeof(GLvoid*), PU_LEVEL, NULL);
+    page->numRanges = 0;
+    page->lastIndex = -1;
+}
+
+//
+// VBO_AllocSurface
+//
+// Reserves room in the current page, moving on to
+// a new page when it can't hold the surface
+//
+
+static boolean VBO_AllocSurface(vboSurface_t *surf, int numVertices, int numIndices)
+{
+    vboPage_t *page;
+
+    if(numVboPages == 0 || vboPages[numVboPages-1].numVertices + numVertices > VBO_PAGESIZE)
+    {
+        if(numVboPages == VBO_MAXPAGES)
+        {
+            // surface will always be streamed
+            return false;
+        }
+
+        if(numVboPages > 0)
+        {
+            VBO_UploadPage(&vboPages[numVboPages-1]);
+        }
+
+        numVboPages++;
+    }
+
+    page = &vboPages[numVboPages-1];
+
+    surf->page          = numVboPages-1;
+    surf->firstVertex   = page->numVertices;
+    surf->firstIndex    = page->numIndices;
+    surf->numVertices   = numVertices;
+    surf->numIndices    = numIndices;
+    surf->valid         = false;
+
+    memset(&stageVertices[surf->firstVertex], 0, numVertices * sizeof(vtx_t));
+
+    page->numVertices += numVertices;
+    page->numIndices += numIndices;
+    page->numSurfaces++;
+
+    return true;
+}
+
+//
+// VBO_BakeSurface
+//
+
+static void VBO_BakeSurface(vboSurface_t *surf, vtxlist_t *vl,
+                            boolean (*genfunc)(vtxlist_t*, int*))
+{
+    int drawcount = 0;
+
+    surf->valid = genfunc(vl, &drawcount);
+
+    // only the vertices are wanted here
+    RB_ResetElements();
+
+    if(surf->valid && drawcount == surf->numVertices)
+    {
+        memcpy(&stageVertices[surf->firstVertex], drawVertex, drawcount * sizeof(vtx_t));
+    }
+    else
+    {
+        // leave the key blank so it gets baked the first time it's drawn
+        memset(&surf->key, 0, sizeof(vboSurfaceKey_t));
+        surf->valid = false;
+    }
+}
+
+//
+// VBO_BakeSeg
+//
+
+static void VBO_BakeSeg(seg_t *seg, vboSegSide_t side, int texid,
+                        boolean (*genfunc)(vtxlist_t*, int*))
+{
+    vboSurface_t *surf = &segSurfaces[(seg - segs) * NUMVBOSEGSIDES + side];
+    word *indices;
+    vtxlist_t vl;
+
+    if(!VBO_AllocSurface(surf, 4, 6))
+    {
+        return;
+    }
+
+    indices = &stageIndices[surf->firstIndex];
+
+    indices[0] = surf->firstVertex + 0;
+    indices[1] = surf->firstVertex + 1;
+    indices[2] = surf->firstVertex + 2;
+    indices[3] = surf->firstVertex + 3;
+    indices[4] = surf->firstVertex + 2;
+    indices[5] = surf->firstVertex + 1;
+
+    if(texid == 0)
+    {
+        // nothing to bake; may still get a texture later on
+        return;
+    }
+
+    memset(&vl, 0, sizeof(vtxlist_t));
+    vl.data = seg;
+    vl.texid = texid;
+    vl.params = VBO_SectorLight(seg->frontsector);
+    vl.drawTag = DLT_WALL;
+
+    VBO_SetupSegKey(&vl, &surf->key);
+    VBO_BakeSurface(surf, &vl, genfunc);
+}
+
+//
+// VBO_BakeLeaf
+//
+
+static void VBO_BakeLeaf(subsector_t *sub, boolean bCeiling)
+{
+    vboSurface_t *surf = &leafSurfaces[(sub - subsectors) * 2 + bCeiling];
+    word *indices;
+    vtxlist_t vl;
+    int j;
+
+    if(!VBO_AllocSurface(surf, sub->numleafs, (sub->numleafs - 2) * 3))
+    {
+        return;
+    }
+
+    indices = &stageIndices[surf->firstIndex];
+
+    for(j = 0; j < sub->numleafs - 2; ++j)
+    {
+        *indices++ = surf->firstVertex;
+        *indices++ = surf->firstVertex + 1 + j;
+        *indices++ = surf->firstVertex + 2 + j;
+    }
+
+    memset(&vl, 0, sizeof(vtxlist_t));
+    vl.data = sub;
+    vl.texid = bCeiling ? sub->sector->ceilingpic : sub->sector->floorpic;
+    vl.params = VBO_SectorLight(sub->sector);
+    vl.flags = bCeiling ? DLF_CEILING : 0;
+    vl.drawTag = DLT_FLAT;
+
+    VBO_SetupLeafKey(&vl, &surf->key);
+    VBO_BakeSurface(surf, &vl, RB_GenerateSubSectors);
+}
+
+//
+// VBO_BuildLevel
+//
+// Called after the level's textures have been precached
+//
+
+void VBO_BuildLevel(void)
+{
+    int i;
+
+    VBO_DeleteBuffers();
+
+    if(!rbStaticGeometry || !has_GL_ARB_vertex_buffer_object)
+    {
+        return;
+    }
+
+    segSurfaces = (vboSurface_t*)Z_Calloc(numsegs * NUMVBOSEGSIDES, sizeof(vboSurface_t), PU_LEVEL, NULL);
+    leafSurfaces = (vboSurface_t*)Z_Calloc(numsubsectors * 2, sizeof(vboSurface_t), PU_LEVEL, NULL);
+
+    stageVertices = (vtx_t*)Z_Malloc(VBO_PAGESIZE * sizeof(vtx_t), PU_STATIC, NULL);
+    stageIndices = (word*)Z_Malloc(VBO_PAGESIZE * 3 * sizeof(word), PU_STATIC, NULL);
+
+    // shades are normally looked up as subsectors are visited
+    for(i = 0; i < numsectors; ++i)
+    {
+        RB_SetSectorShades(&sectors[i]);
+    }
+
+    for(i = 0; i < numsegs; ++i)
+    {
+        seg_t *seg = &segs[i];
+
+        if(!seg->linedef)
+        {
+            continue;
+        }
+
+        // two-sided middle textures are always masked or translucent
+        // so only the lower/upper sides are of interest there
+        if(seg->backsector)
+        {
+            VBO_BakeSeg(seg, VS_LOWER, seg->sidedef->bottomtexture, RB_GenerateLowerSeg);
+            VBO_BakeSeg(seg, VS_UPPER, seg->sidedef->toptexture, RB_GenerateUpperSeg);
+        }
+        else
+        {
+            VBO_BakeSeg(seg, VS_MIDDLE, seg->sidedef->midtexture, RB_GenerateMiddleSeg);
+        }
+    }
+
+    for(i = 0; i < numsubsectors; ++i)
+    {
+        if(subsectors[i].numleafs < 3)
+        {
+            continue;
+        }
+
+        VBO_BakeLeaf(&subsectors[i], false);
+        VBO_BakeLeaf(&subsectors[i], true);
+    }
+
+    if(numVboPages > 0)
+    {
+        VBO_UploadPage(&vboPages[numVboPages-1]);
+    }
+
+    Z_Free(stageVertices);
+    Z_Free(stageIndices);
+    stageVertices = NULL;
+    stageIndices = NULL;
+}
+
+//
+// VBO_DeleteBuffers
+//
+
+void VBO_DeleteBuffers(void)
+{
+    int i;
+
+    for(i = 0; i < numVboPages; ++i)
+    {
+        vboPage_t *page = &vboPages[i];
+
+        if(page->vertexBuffer)
+        {
+            dglDeleteBuffersARB(1, &page->vertexBuffer);
+        }
+
+        if(page->indexBuffer)
+        {
+            dglDeleteBuffersARB(1, &page->indexBuffer);
+        }
+    }
+
+    memset(vboPages, 0, sizeof(vboPages));
+    numVboPages = 0;
+
+    // these are PU_LEVEL and may already be gone
+    segSurfaces = NULL;
+    leafSurfaces = NULL;
+}
+
+//
+// VBO_InvalidateSurfaces
+//
+// Forces every surface to be rebaked the next time it is drawn
+//
+
+void VBO_InvalidateSurfaces(void)
+{
+    vboGeneration++;
+}
+
+//
+// VBO_StaticGeometryEnabled
+//
+
+boolean VBO_StaticGeometryEnabled(void)
+{
+    return (rbStaticGeometry && numVboPages > 0);
+}
+
+//=============================================================================
+//
+// Drawing
+//
+//=============================================================================
+
+//
+// VBO_UploadSurface
+//
+
+static void VBO_UploadSurface(vboSurface_t *surf, vtx_t *vtx)
+{
+    dglBindBufferARB(GL_ARRAY_BUFFER_ARB, vboPages[surf->page].vertexBuffer);
+    dglBufferSubDataARB(GL_ARRAY_BUFFER_ARB, surf->firstVertex * sizeof(vtx_t),
+                        surf->numVertices * sizeof(vtx_t), vtx);
+    dglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+}
+
+//
+// VBO_AddSurface
+//
+// Queues the surface's indices for the next RB_DrawElements call,
+// extending the previous range when they follow each other
+//
+
+static boolean VBO_AddSurface(vboSurface_t *surf)
+{
+    vboPage_t *page = &vboPages[surf->page];
+
+    if(page->numRanges > 0 && page->lastIndex == surf->firstIndex)
+    {
+        page->counts[page->numRanges-1] += surf->numIndices;
+    }
+    else
+    {
+        if(page->numRanges == page->numSurfaces)
+        {
+            return false;
+        }
+
+        page->counts[page->numRanges] = surf->numIndices;
+        page->offsets[page->numRanges] = (GLvoid*)(surf->firstIndex * sizeof(word));
+        page->numRanges++;
+    }
+
+    page->lastIndex = surf->firstIndex + surf->numIndices;
+    rbState.numDrawnVertices += surf->numVertices;
+
+    return true;
+}
+
+//
+// VBO_ProcessSurface
+//
+
+static boolean VBO_ProcessSurface(vtxlist_t *vl, int *drawcount, vboSurface_t *surf,
+                                  vboSurfaceKey_t *key, boolean bInMotion,
+                                  boolean (*genfunc)(vtxlist_t*, int*))
+{
+    int first;
+    boolean valid;
+
+    if(!memcmp(key, &surf->key, sizeof(vboSurfaceKey_t)))
+    {
+        if(!surf->valid)
+        {
+            return false;
+        }
+
+        if(VBO_AddSurface(surf))
+        {
+            return true;
+        }
+
+        return genfunc(vl, drawcount);
+    }
+
+    // baked copy is out of date; stream this one in the meantime
+    first = *drawcount;
+    valid = genfunc(vl, drawcount);
+
+    if(!bInMotion)
+    {
+        if(valid && *drawcount - first == surf->numVertices)
+        {
+            VBO_UploadSurface(surf, &drawVertex[first]);
+            surf->valid = true;
+            surf->key = *key;
+        }
+        else if(!valid)
+        {
+            surf->valid = false;
+            surf->key = *key;
+        }
+    }
+
+    return valid;
+}
+
+//
+// VBO_ProcessSeg
+//
+
+static boolean VBO_ProcessSeg(vtxlist_t *vl, int *drawcount, vboSegSide_t side,
+                              boolean (*genfunc)(vtxlist_t*, int*))
+{
+    seg_t *seg = (seg_t*)vl->data;
+    vboSurface_t *surf;
+    vboSurfaceKey_t key;
+    boolean bInMotion;
+
+    if(!seg || !segSurfaces)
+    {
+        return genfunc(vl, drawcount);
+    }
+
+    surf = &segSurfaces[(seg - segs) * NUMVBOSEGSIDES + side];
+
+    if(surf->numVertices == 0)
+    {
+        return genfunc(vl, drawcount);
+    }
+
+    VBO_SetupSegKey(vl, &key);
+
+    bInMotion = VBO_SectorInMotion(seg->frontsector) ||
+                (seg->backsector && VBO_SectorInMotion(seg->backsector));
+
+    return VBO_ProcessSurface(vl, drawcount, surf, &key, bInMotion, genfunc);
+}
+
+//
+// VBO_GenerateLowerSeg
+//
+
+boolean VBO_GenerateLowerSeg(vtxlist_t *vl, int *drawcount)
+{
+    return VBO_ProcessSeg(vl, drawcount, VS_LOWER, RB_GenerateLowerSeg);
+}
+
+//
+// VBO_GenerateUpperSeg
+//
+
+boolean VBO_GenerateUpperSeg(vtxlist_t *vl, int *drawcount)
+{
+    return VBO_ProcessSeg(vl, drawcount, VS_UPPER, RB_GenerateUpperSeg);
+}
+
+//
+// VBO_GenerateMiddleSeg
+//
+
+boolean VBO_GenerateMiddleSeg(vtxlist_t *vl, int *drawcount)
+{
+    return VBO_ProcessSeg(vl, drawcount, VS_MIDDLE, RB_GenerateMiddleSeg);
+}
+
+//
+// VBO_GenerateSubSectors
+//
+
+boolean VBO_GenerateSubSectors(vtxlist_t *vl, int *drawcount)
+{
+    subsector_t *sub = (subsector_t*)vl->data;
+    vboSurface_t *surf;
+    vboSurfaceKey_t key;
+
+    if(!leafSurfaces)
+    {
+        return RB_GenerateSubSectors(vl, drawcount);
+    }
+
+    surf = &leafSurfaces[(sub - subsectors) * 2 + ((vl->flags & DLF_CEILING) ? 1 : 0)];
+
+    if(surf->numVertices == 0)
+    {
+        return RB_GenerateSubSectors(vl, drawcount);
+    }
+
+    VBO_SetupLeafKey(vl, &key);
+
+    return VBO_ProcessSurface(vl, drawcount, surf, &key,
+                              VBO_SectorInMotion(sub->sector), RB_GenerateSubSectors);
+}
+
+//
+// VBO_DrawElements
+//
+// Draws all queued ranges straight out of the buffer pages
+// and puts the client side pointers back the way they were
+//
+
+void VBO_DrawElements(void)
+{
+    int i;
+    int j;
+    boolean bound = false;
+
+    for(i = 0; i < numVboPages; ++i)
+    {
+        vboPage_t *page = &vboPages[i];
+
+        if(page->numRanges == 0)
+        {
+            continue;
+        }
+
+        dglBindBufferARB(GL_ARRAY_BUFFER_ARB, page->vertexBuffer);
+        dglBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, page->indexBuffer);
+
+        dglTexCoordPointer(2, GL_FLOAT, sizeof(vtx_t), (GLvoid*)offsetof(vtx_t, tu));
+        dglVertexPointer(3, GL_FLOAT, sizeof(vtx_t), (GLvoid*)offsetof(vtx_t, x));
+        dglColorPointer(4, GL_UNSIGNED_BYTE, sizeof(vtx_t), (GLvoid*)offsetof(vtx_t, r));
+        rbState.numStateChanges++;
+
+        if(page->numRanges > 1 && has_GL_EXT_multi_draw_arrays)
+        {
+            dglMultiDrawElementsEXT(GL_TRIANGLES, page->counts, GL_UNSIGNED_SHORT,
+                                    (void*)page->offsets, page->numRanges);
+            rbState.numDrawCalls++;
+        }
+        else
+        {
+            for(j = 0; j < page->numRanges; ++j)
+            {
+                dglDrawElements(GL_TRIANGLES, page->counts[j], GL_UNSIGNED_SHORT, page->offsets[j]);
+                rbState.numDrawCalls++;
+            }
+        }
+
+        bound = true;
+    }
+
+    if(bound)
+    {
+        dglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+        dglBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+        RB_RestoreDrawPointers();
+    }
+}
+
+//
+// VBO_ResetElements
+//
+
+void VBO_ResetElements(void)
+{
+    int i;
+
+    for(i = 0; i < numVboPages; ++i)
+    {
+        vboPages[i].numRanges = 0;
+        vboPages[i].lastIndex = -1;
+    }
+}
@@ -0,0 +1,34 @@
+//
+// Copyright(C) 2007-2014 Samuel Villarreal
+// Copyright(C) 2014 Night Dive Studios, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+
+#ifndef __RB_VBO_H__
+#define __RB_VBO_H__
+
+#include "rb_drawlist.h"
+
+void VBO_BuildLevel(void);
+void VBO_DeleteBuffers(void);
+void VBO_InvalidateSurfaces(void);
+boolean VBO_StaticGeometryEnabled(void);
+
+boolean VBO_GenerateLowerSeg(vtxlist_t *vl, int *drawcount);
+boolean VBO_GenerateUpperSeg(vtxlist_t *vl, int *drawcount);
+boolean VBO_GenerateMiddleSeg(vtxlist_t *vl, int *drawcount);
+boolean VBO_GenerateSubSectors(vtxlist_t *vl, int *drawcount);
+
+void VBO_DrawElements(void);
+void VBO_ResetElements(void);
+
+#endif
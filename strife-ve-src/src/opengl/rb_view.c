@@ -27,6 +27,7 @@
 #include "rb_things.h"
 #include "rb_draw.h"
 #include "rb_dynlights.h"
+#include "rb_profile.h"
 #include "p_local.h"
 #include "i_video.h"
 #include "r_main.h"
@@ -391,13 +392,18 @@ void RB_ProjectPointToView(rbView_t *view, fixed_t fx, fixed_t fy, fixed_t fz, f
 
 void RB_RenderPlayerView(player_t *player)
 {
+    // pick up textures that finished decoding in the background
+    RB_ProcessTextureUploads(true);
+
     // setup view and sprite list
     RB_SetupView(player, &rbPlayerView, rbFOV);
     RB_ClearSprites();
     
     if(rbDynamicLights)
     {
+        RB_ProfileBegin("Dynamic Lights");
 		RB_AddDynLights();
+        RB_ProfileEnd();
     }
 
     // setup draw lists
@@ -407,14 +413,21 @@ void RB_RenderPlayerView(player_t *player)
     NetUpdate ();
 
     // render nodes and determine sprite distances
-    RB_RenderBSPNode(numnodes-1);
+    RB_ProfileBegin("BSP");
+    RB_RenderBSP();
+    RB_ProfileEnd();
+
+    RB_ProfileBegin("Sprites");
     RB_SetupSprites();
+    RB_ProfileEnd();
 
     // check for new console commands.
     NetUpdate ();
 
     // draw scene
+    RB_ProfileBegin("Scene");
     RB_DrawScene();
+    RB_ProfileEnd();
 
     // check for new console commands.
     NetUpdate ();
@@ -443,9 +456,9 @@ void RB_RenderPlayerView(player_t *player)
     // fancy post-process stuff
     // dimitrisg 20201806 : broken on NX 
 #ifndef SVE_PLAT_SWITCH
-    RB_RenderMotionBlur();
-    RB_RenderBloom();
-    RB_RenderFXAA();
+    RB_ProfileBegin("Post Process");
+    RB_RenderPostProcess();
+    RB_ProfileEnd();
 #endif
     
     // render player flash
@@ -20,6 +20,7 @@
 #include "rb_config.h"
 #include "rb_wallshade.h"
 #include "rb_geom.h"
+#include "rb_vbo.h"
 #include "r_state.h"
 #include "deh_str.h"
 #include "m_parser.h"
@@ -28,6 +29,16 @@
 static rbShadeDef_t *shadedefs;
 static int numshadedefs;
 
+// shade colors for every light level, filled in as they're needed.
+// a shadedef's color only changes for the sky (see RB_SetSkyShade)
+typedef struct
+{
+    byte    rgb[256][3];
+    byte    valid[256];
+} rbShadeCache_t;
+
+static rbShadeCache_t *shadecache;
+
 //
 // dfcmp
 //
@@ -246,6 +257,7 @@ void RB_InitWallShades(void)
         const int size = sizeof(rbShadeDef_t) * numshadedefs;
 
         shadedefs = (rbShadeDef_t*)Z_Calloc(1, size, PU_STATIC, 0);
+        shadecache = (rbShadeCache_t*)Z_Calloc(numshadedefs, sizeof(rbShadeCache_t), PU_STATIC, 0);
         M_ParserReset(lexer);
 
         shade = shadedefs;
@@ -384,6 +396,46 @@ static rbShadeDef_t *RB_FindShadeDef(int pic)
     return i >= 0 ? &shadedefs[i] : NULL;
 }
 
+//
+// RB_GetShadeRGB
+//
+// Color of a shadedef at the given light level
+//
+
+static void RB_GetShadeRGB(rbShadeDef_t *shadedef, int light, int *r, int *g, int *b)
+{
+    rbShadeCache_t *cache = NULL;
+    int v;
+
+    if(light >= 0 && light <= 255)
+    {
+        cache = &shadecache[shadedef->self];
+
+        if(cache->valid[light])
+        {
+            rbState.numShadeCacheHits++;
+
+            *r = cache->rgb[light][0];
+            *g = cache->rgb[light][1];
+            *b = cache->rgb[light][2];
+            return;
+        }
+    }
+
+    rbState.numShadeCacheMisses++;
+
+    v = MIN((int)((float)shadedef->v * ((float)(light << 2) / 1024)), 255);
+    RB_GetRGB(shadedef->h, shadedef->s, v, r, g, b);
+
+    if(cache)
+    {
+        cache->rgb[light][0] = *r;
+        cache->rgb[light][1] = *g;
+        cache->rgb[light][2] = *b;
+        cache->valid[light] = true;
+    }
+}
+
 //
 // RB_SetSkyShade
 //
@@ -401,6 +453,13 @@ void RB_SetSkyShade(byte r, byte g, byte b)
 
     if((rsd = RB_FindShadeDef(R_FlatNumForName("F_SKY001"))))
     {
+        if(rsd->r != r || rsd->g != g || rsd->b != b)
+        {
+            // baked static geometry still has the old color
+            VBO_InvalidateSurfaces();
+            memset(shadecache[rsd->self].valid, 0, sizeof(shadecache[rsd->self].valid));
+        }
+
         rsd->r = r;
         rsd->g = g;
         rsd->b = b;
@@ -549,14 +608,13 @@ static void RB_SetupWallShadeColor(seg_t *seg, rbShadeDef_t *shadedef, int *r, i
     else
     {
         // need to adjust value for sector's brightness level
-        int seglight, v;
+        int seglight;
         if(shadedef->flags & RBSF_SEGLIGHTING)
             seglight = *l; // preserve fake contrast already set on the seg
         else
             seglight = seg->frontsector->lightlevel; // go back to sector lighting
 
-        v = MIN((int)((float)shadedef->v * ((float)(seglight << 2) / 1024)), 255);
-        RB_GetRGB(shadedef->h, shadedef->s, v, r, g, b);
+        RB_GetShadeRGB(shadedef, seglight, r, g, b);
     }
 }
 
@@ -644,7 +702,6 @@ boolean RB_SetWallShade(vtx_t *vtx, int lightlevel, seg_t *seg, rbWallSide_t sid
 
 boolean RB_GetFloorShade(sector_t *sector, byte *r, byte *g, byte *b)
 {
-    int v;
     int tr, tg, tb;
     rbShadeDef_t *shadedef = sector->floorshade;
 
@@ -658,8 +715,7 @@ boolean RB_GetFloorShade(sector_t *sector, byte *r, byte *g, byte *b)
         return false;
     }
     
-    v = MIN((int)((float)shadedef->v * ((float)(sector->lightlevel << 2) / 1024)), 255);
-    RB_GetRGB(shadedef->h, shadedef->s, v, &tr, &tg, &tb);
+    RB_GetShadeRGB(shadedef, sector->lightlevel, &tr, &tg, &tb);
 
     *r = (byte)tr;
     *g = (byte)tg;
@@ -674,7 +730,6 @@ boolean RB_GetFloorShade(sector_t *sector, byte *r, byte *g, byte *b)
 
 boolean RB_GetCeilingShade(sector_t *sector, byte *r, byte *g, byte *b)
 {
-    int v;
     int tr, tg, tb;
     rbShadeDef_t *shadedef = sector->ceilingshade;
 
@@ -683,8 +738,7 @@ boolean RB_GetCeilingShade(sector_t *sector, byte *r, byte *g, byte *b)
         return false;
     }
     
-    v = MIN((int)((float)shadedef->v * ((float)(sector->lightlevel << 2) / 1024)), 255);
-    RB_GetRGB(shadedef->h, shadedef->s, v, &tr, &tg, &tb);
+    RB_GetShadeRGB(shadedef, sector->lightlevel, &tr, &tg, &tb);
 
     *r = (byte)tr;
     *g = (byte)tg;
@@ -711,9 +765,7 @@ static void RB_SetupThingShadeColor(sector_t *sec, rbShadeDef_t *shadedef,
     else
     {
         // need to adjust value for sector's brightness level
-        int v = MIN((int)((float)shadedef->v * ((float)(sec->lightlevel << 2) / 1024)), 255);
-
-        RB_GetRGB(shadedef->h, shadedef->s, v, r, g, b);
+        RB_GetShadeRGB(shadedef, sec->lightlevel, r, g, b);
     }
 }
 
@@ -67,6 +67,8 @@
 #include "i_swap.h"
 
 #include "g_game.h"
+#include "g_bench.h" // [SVE]
+#include "p_prof.h" // [SVE]
 
 #include "hu_stuff.h"
 #include "wi_stuff.h"
@@ -307,13 +309,13 @@ void D_Display (void)
             break;
         if (automapactive)
             AM_Drawer ();
-        if (wipe || (viewheight != 200 && fullscreen) )
+        if (wipe || (scaledviewheight != 200 && fullscreen) )
             redrawsbar = true;
         // haleyjd 08/29/10: [STRIFE] Always redraw sbar if menu is/was active
         if (menuactivestate || (inhelpscreensstate && !inhelpscreens))
             redrawsbar = true;              // just put away the help screen
-        ST_Drawer (viewheight == 200, redrawsbar );
-        fullscreen = viewheight == 200;
+        ST_Drawer (scaledviewheight == 200, redrawsbar );
+        fullscreen = scaledviewheight == 200;
         break;
       
      // haleyjd 08/23/2010: [STRIFE] No intermission
@@ -384,6 +386,7 @@ void D_Display (void)
     if (gamestate == GS_LEVEL && gametic)
     {
         HU_Drawer ();
+        P_DrawThinkerProfile (); // [SVE]
         if(ST_DrawExternal()) 
             popupactivestate = true;
         else if(popupactivestate)
@@ -538,6 +541,9 @@ void D_BindVariables(void)
     M_BindVariable("startskill",  &startskill);
     M_BindVariable("timelimit",   &timelimit);
     M_BindVariable("d_fpslimit",  &d_fpslimit);
+    M_BindVariable("render_threads", &r_renderthreads);
+    M_BindVariable("render_width",   &r_renderwidth);
+    M_BindVariable("render_height",  &r_renderheight);
 
     // [SVE]: Gyroscope
     M_BindVariable("joy_gyroscope", &joy_gyroscope);
@@ -1376,7 +1382,8 @@ static void D_InitFrontend()
        M_CheckParm("-autojoin")      || // UDP client modes
        M_CheckParm("-connect")       ||
        M_CheckParm("-drone")         ||
-       M_CheckParm("-solo-net"))
+       M_CheckParm("-solo-net")      ||
+       simbenchmark)                    // [SVE] headless benchmark
     {
         dofrontend = false;
     }
@@ -1660,6 +1667,22 @@ void D_DoomMain (void)
     if (M_ParmExists("-nograph"))
         showintro = false;
 
+    //!
+    // @arg <demo|dir> ...
+    // @category demo
+    //
+    // [SVE] Play back the given demos, or every .lmp file in the given
+    // directories, without opening a window or the sound device, and
+    // report how long the tics took and a checksum of the game state at
+    // the end of each demo. See also -simbenchref and -simbenchrecord.
+    //
+
+    if (M_CheckParmWithArgs("-simbench", 1))
+    {
+        simbenchmark = true;
+        showintro = false;
+    }
+
     // Undocumented:
     // Invoked by setup to test the controls.
 
@@ -2055,8 +2078,13 @@ void D_DoomMain (void)
     // fraggle 20130405: I_InitTimer is needed here for the netgame
     // startup. Start low-level sound init here too.
     I_InitTimer();
-    I_InitSound(true);
-    I_InitMusic();
+
+    // [SVE] the benchmark plays without sound
+    if (!simbenchmark)
+    {
+        I_InitSound(true);
+        I_InitMusic();
+    }
 
 #ifdef FEATURE_MULTIPLAYER
     if(devparm) // [STRIFE]
@@ -2311,6 +2339,10 @@ void D_DoomMain (void)
     }
     D_IntroTick(); // [STRIFE]
 
+    // [SVE] headless playsim benchmark; never returns
+    if (simbenchmark)
+        G_RunSimBenchmark ();
+
     p = M_CheckParmWithArgs("-playdemo", 1);
     if (p)
     {
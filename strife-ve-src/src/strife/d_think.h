@@ -62,6 +62,12 @@ typedef struct thinker_s
     struct thinker_s*	next;
     think_t		function;
     int                 references; // haleyjd 20140926: [SVE]
+
+    // [SVE] list of thinkers of the same class, in the same
+    // order as the main list, and the slab pool it came from
+    struct thinker_s*	cprev;
+    struct thinker_s*	cnext;
+    int                 thclass;
 } thinker_t;
 
 
@@ -292,6 +292,7 @@ extern int		skyflatnum;
 
 
 extern	int		rndindex;
+extern	int		prndindex; // [SVE] for G_BenchChecksum
 
 extern  ticcmd_t        *netcmds;
 
@@ -302,6 +302,7 @@ wipe_EndScreen
     wipe_scr_end = Z_Malloc(SCREENWIDTH * SCREENHEIGHT, PU_STATIC, NULL);
     I_ReadScreen(wipe_scr_end);
     V_DrawBlock(x, y, width, height, wipe_scr_start); // restore start scr.
+    I_SetViewLayer(NULL, 0, 0, 0, 0, 0, 0); // [SVE] the wipe is 320x200
     return 0;
 }
 
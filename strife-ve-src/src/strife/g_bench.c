@@ -0,0 +1,530 @@
+//
+// Copyright(C) 2014 Night Dive Studios, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//    [SVE] Headless playsim benchmark over recorded demos
+//
+//    -simbench replays a list of demo files, or every .lmp in a
+//    directory, by calling G_Ticker directly. Nothing is drawn, and
+//    neither the window nor the sound device is ever opened, so it
+//    runs on machines with no display. Each tic is timed as a whole
+//    and in the parts P_Ticker is made of, and the game state is
+//    hashed when each demo ends so that a change in the simulation
+//    shows up as a different checksum.
+//
+
+// For GNU C and POSIX targets, dirent.h should be available. Otherwise, for
+// Visual C++, we need to include the win_opendir module.
+#if defined(_MSC_VER)
+#include <win_opendir.h>
+#elif defined(__GNUC__) || defined(POSIX)
+#include <dirent.h>
+#else
+#error Need an include for dirent.h!
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "z_zone.h"
+#include "doomstat.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "m_saves.h"
+#include "p_local.h"
+#include "r_state.h"
+#include "s_sound.h"
+#include "sha1.h"
+#include "g_game.h"
+#include "g_bench.h"
+
+boolean simbenchmark;
+
+static const char *benchsectionnames[NUMBENCHSECTIONS] =
+{
+    "P_PlayerThink",
+    "P_RunThinkers",
+    "P_UpdateSpecials",
+    "S_UpdateSounds",
+    "tic"
+};
+
+// time spent in each section during the current tic
+static uint64_t curtictimes[NUMBENCHSECTIONS];
+
+// every tic of every demo, in microseconds
+static uint32_t *tictimes[NUMBENCHSECTIONS];
+static int       numtics;
+static int       maxtics;
+
+// demo files to play
+static char **benchdemos;
+static int    numbenchdemos;
+static int    maxbenchdemos;
+
+// reference checksums from -simbenchref
+typedef struct
+{
+    const char *checksum;
+    const char *name;
+} benchref_t;
+
+static benchref_t *refs;
+static int         numrefs;
+static int         maxrefs;
+
+//
+// G_BenchSection
+//
+// Adds the time since start to a section of the current tic and returns
+// the time now, so that consecutive sections can be chained.
+//
+uint64_t G_BenchSection(benchsection_t section, uint64_t start)
+{
+    uint64_t now = I_GetTimeUS();
+
+    curtictimes[section] += now - start;
+
+    return now;
+}
+
+//
+// G_BenchEndTic
+//
+// Moves the current tic's times onto the end of the list.
+//
+static void G_BenchEndTic(void)
+{
+    int i;
+
+    if(numtics == maxtics)
+    {
+        maxtics = maxtics ? maxtics * 2 : 4096;
+
+        for(i = 0; i < NUMBENCHSECTIONS; i++)
+            tictimes[i] = Z_Realloc(tictimes[i], maxtics * sizeof(uint32_t), PU_STATIC, NULL);
+    }
+
+    for(i = 0; i < NUMBENCHSECTIONS; i++)
+    {
+        tictimes[i][numtics] = (uint32_t)curtictimes[i];
+        curtictimes[i] = 0;
+    }
+
+    numtics++;
+}
+
+static int G_compareTimes(const void *a, const void *b)
+{
+    uint32_t ta = *(const uint32_t *)a;
+    uint32_t tb = *(const uint32_t *)b;
+
+    return ta < tb ? -1 : ta > tb;
+}
+
+//
+// G_BenchReport
+//
+// Prints the mean, median, 99th percentile and worst time of each section
+// over a run of tics.
+//
+static void G_BenchReport(int first, int count)
+{
+    uint32_t *sorted;
+    uint64_t  total;
+    int i, j;
+
+    if(count <= 0)
+        return;
+
+    sorted = Z_Malloc(count * sizeof(uint32_t), PU_STATIC, NULL);
+
+    printf("    %-18s %10s %8s %8s %8s\n", "us per tic", "mean", "p50", "p99", "max");
+
+    for(i = 0; i < NUMBENCHSECTIONS; i++)
+    {
+        memcpy(sorted, tictimes[i] + first, count * sizeof(uint32_t));
+        qsort(sorted, count, sizeof(uint32_t), G_compareTimes);
+
+        total = 0;
+        for(j = 0; j < count; j++)
+            total += sorted[j];
+
+        printf("    %-18s %10.2f %8u %8u %8u\n", benchsectionnames[i],
+               (double)total / count,
+               sorted[(count - 1) * 50 / 100],
+               sorted[(count - 1) * 99 / 100],
+               sorted[count - 1]);
+    }
+
+    Z_Free(sorted);
+}
+
+//
+// G_BenchChecksum
+//
+// Hashes the parts of the game state a desync would show up in: the
+// random number index, the players, every mobj and every sector.
+//
+static void G_BenchChecksum(char *hex)
+{
+    sha1_context_t context;
+    sha1_digest_t  digest;
+    thinker_t     *th;
+    int i, j;
+
+    SHA1_Init(&context);
+
+    SHA1_UpdateInt32(&context, gamemap);
+    SHA1_UpdateInt32(&context, leveltime);
+    SHA1_UpdateInt32(&context, prndindex);
+
+    for(i = 0; i < MAXPLAYERS; i++)
+    {
+        player_t *player = &players[i];
+
+        SHA1_UpdateInt32(&context, player->playerstate);
+        SHA1_UpdateInt32(&context, player->health);
+        SHA1_UpdateInt32(&context, player->armorpoints);
+        SHA1_UpdateInt32(&context, player->readyweapon);
+        SHA1_UpdateInt32(&context, player->killcount);
+
+        for(j = 0; j < NUMAMMO; j++)
+            SHA1_UpdateInt32(&context, player->ammo[j]);
+
+        for(j = 0; j < NUMPOWERS; j++)
+            SHA1_UpdateInt32(&context, player->powers[j]);
+    }
+
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
+    {
+        mobj_t *mo;
+
+        if(th->function.acp1 != (actionf_p1)P_MobjThinker)
+            continue;
+
+        mo = (mobj_t *)th;
+
+        SHA1_UpdateInt32(&context, mo->type);
+        SHA1_UpdateInt32(&context, mo->x);
+        SHA1_UpdateInt32(&context, mo->y);
+        SHA1_UpdateInt32(&context, mo->z);
+        SHA1_UpdateInt32(&context, mo->angle);
+        SHA1_UpdateInt32(&context, mo->momx);
+        SHA1_UpdateInt32(&context, mo->momy);
+        SHA1_UpdateInt32(&context, mo->momz);
+        SHA1_UpdateInt32(&context, mo->health);
+        SHA1_UpdateInt32(&context, mo->flags);
+        SHA1_UpdateInt32(&context, mo->tics);
+        SHA1_UpdateInt32(&context, mo->state ? mo->state - states : -1);
+    }
+
+    for(i = 0; i < numsectors; i++)
+    {
+        SHA1_UpdateInt32(&context, sectors[i].floorheight);
+        SHA1_UpdateInt32(&context, sectors[i].ceilingheight);
+        SHA1_UpdateInt32(&context, sectors[i].lightlevel);
+        SHA1_UpdateInt32(&context, sectors[i].special);
+    }
+
+    SHA1_Final(digest, &context);
+
+    for(i = 0; i < sizeof(sha1_digest_t); i++)
+        M_snprintf(hex + i * 2, 3, "%02x", digest[i]);
+}
+
+//
+// G_addBenchDemo
+//
+static void G_addBenchDemo(char *path)
+{
+    if(numbenchdemos == maxbenchdemos)
+    {
+        maxbenchdemos = maxbenchdemos ? maxbenchdemos * 2 : 16;
+        benchdemos = Z_Realloc(benchdemos, maxbenchdemos * sizeof(char *), PU_STATIC, NULL);
+    }
+
+    benchdemos[numbenchdemos++] = path;
+}
+
+static int G_compareNames(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+//
+// G_addBenchDemoDir
+//
+// Adds every .lmp file in a directory, sorted by name so the order doesn't
+// depend on the file system. Returns false if the path isn't a directory.
+//
+static boolean G_addBenchDemoDir(const char *path)
+{
+    DIR *dir;
+    struct dirent *f;
+    int first = numbenchdemos;
+
+    if(!(dir = opendir(path)))
+        return false;
+
+    while((f = readdir(dir)))
+    {
+        if(M_StringEndsWith(f->d_name, ".lmp") || M_StringEndsWith(f->d_name, ".LMP"))
+            G_addBenchDemo(M_SafeFilePath(path, f->d_name));
+    }
+
+    closedir(dir);
+
+    qsort(benchdemos + first, numbenchdemos - first, sizeof(char *), G_compareNames);
+
+    return true;
+}
+
+//
+// G_benchDemoName
+//
+// Demos are matched to reference checksums by file name alone, so the
+// reference file works wherever the demos are unpacked.
+//
+static const char *G_benchDemoName(const char *path)
+{
+    const char *name = path;
+    const char *p;
+
+    for(p = path; *p; p++)
+    {
+        if(*p == '/' || *p == '\\')
+            name = p + 1;
+    }
+
+    return name;
+}
+
+//
+// G_loadReferences
+//
+// Reads a reference file made up of lines of
+// "<checksum> <demo file name>".
+//
+static void G_loadReferences(const char *path)
+{
+    char *buffer, *line, *next, *name, *end;
+
+    if(!M_ReadFileAsString(path, &buffer))
+        I_Error("G_RunSimBenchmark: couldn't read %s", path);
+
+    for(line = buffer; *line; line = next)
+    {
+        if((next = strchr(line, '\n')))
+            *next++ = '\0';
+        else
+            next = line + strlen(line);
+
+        end = line + strlen(line);
+        while(end > line && (end[-1] == '\r' || end[-1] == ' '))
+            *--end = '\0';
+
+        name = strchr(line, ' ');
+
+        if(!name || name - line != 40)
+            continue;
+
+        *name++ = '\0';
+
+        if(numrefs == maxrefs)
+        {
+            maxrefs = maxrefs ? maxrefs * 2 : 16;
+            refs = Z_Realloc(refs, maxrefs * sizeof(benchref_t), PU_STATIC, NULL);
+        }
+
+        refs[numrefs].checksum = line;
+        refs[numrefs].name = name;
+        numrefs++;
+    }
+}
+
+//
+// G_findReference
+//
+static const char *G_findReference(const char *name)
+{
+    int i;
+
+    for(i = 0; i < numrefs; i++)
+    {
+        if(!strcmp(refs[i].name, name))
+            return refs[i].checksum;
+    }
+
+    return NULL;
+}
+
+// stands in for the commands RunTic would hand G_Ticker
+static ticcmd_t benchcmds[MAXPLAYERS];
+
+//
+// G_BenchDemo
+//
+// Plays one demo through to the end, timing every tic.
+//
+static void G_BenchDemo(const char *path, char *checksum)
+{
+    byte     *buffer;
+    uint64_t  start, ticstart, now;
+    int       first = numtics;
+
+    M_ReadFile((char *)path, &buffer);
+
+    // keep the tic counter the same from one run to the next
+    gametic = 0;
+
+    start = I_GetTimeUS();
+    G_PlayDemoBuffer(buffer);
+    printf("  %s: map %02i loaded in %.1f ms\n", G_benchDemoName(path), gamemap,
+           (I_GetTimeUS() - start) / 1000.0);
+
+    // the tics run here, not through D_DoomLoop, so netcmds has never
+    // been pointed anywhere; G_ReadDemoTiccmd fills these in
+    memset(benchcmds, 0, sizeof(benchcmds));
+    netcmds = benchcmds;
+
+    start = I_GetTimeUS();
+
+    while(demoplayback)
+    {
+        ticstart = I_GetTimeUS();
+
+        G_Ticker();
+
+        now = I_GetTimeUS();
+        S_UpdateSounds(players[consoleplayer].mo);
+        now = G_BenchSection(BENCH_SOUNDS, now);
+        G_BenchSection(BENCH_TIC, ticstart);
+
+        gametic++;
+        G_BenchEndTic();
+    }
+
+    printf("  %s: %i tics in %.1f ms\n", G_benchDemoName(path), numtics - first,
+           (I_GetTimeUS() - start) / 1000.0);
+
+    G_BenchChecksum(checksum);
+    G_BenchReport(first, numtics - first);
+
+    Z_Free(buffer);
+}
+
+//
+// G_RunSimBenchmark
+//
+// Plays every demo given to -simbench and quits, with an error if any of
+// them didn't match its reference checksum. Never returns.
+//
+void G_RunSimBenchmark(void)
+{
+    FILE       *record = NULL;
+    boolean     checking;
+    const char *refsum;
+    char        checksum[41];
+    int         failures = 0, unchecked = 0;
+    int         i, p;
+
+    p = M_CheckParmWithArgs("-simbench", 1);
+
+    for(++p; p < myargc && myargv[p][0] != '-'; p++)
+    {
+        if(!G_addBenchDemoDir(myargv[p]))
+            G_addBenchDemo(myargv[p]);
+    }
+
+    if(!numbenchdemos)
+        I_Error("G_RunSimBenchmark: no demos to play");
+
+    //!
+    // @arg <file>
+    // @category demo
+    //
+    // With -simbench, check the checksum at the end of each demo against
+    // the one listed for it in the given file.
+    //
+
+    p = M_CheckParmWithArgs("-simbenchref", 1);
+    checking = (p != 0);
+    if(checking)
+        G_loadReferences(myargv[p + 1]);
+
+    //!
+    // @arg <file>
+    // @category demo
+    //
+    // With -simbench, write the checksum at the end of each demo to the
+    // given file, for use with -simbenchref.
+    //
+
+    p = M_CheckParmWithArgs("-simbenchrecord", 1);
+    if(p && !(record = fopen(myargv[p + 1], "w")))
+        I_Error("G_RunSimBenchmark: couldn't write %s", myargv[p + 1]);
+
+    // The level is set up the way the software renderer sets it up,
+    // which needs no GL context; nothing is drawn either way.
+    use3drenderer = false;
+
+    printf("G_RunSimBenchmark: playing %i demo(s)\n", numbenchdemos);
+
+    for(i = 0; i < numbenchdemos; i++)
+    {
+        const char *name = G_benchDemoName(benchdemos[i]);
+
+        G_BenchDemo(benchdemos[i], checksum);
+
+        if(record)
+            fprintf(record, "%s %s\n", checksum, name);
+
+        if(!checking)
+            printf("    checksum %s\n", checksum);
+        else if(!(refsum = G_findReference(name)))
+        {
+            printf("    checksum %s (no reference)\n", checksum);
+            unchecked++;
+        }
+        else if(strcmp(checksum, refsum))
+        {
+            printf("    checksum %s MISMATCH, expected %s\n", checksum, refsum);
+            failures++;
+        }
+        else
+            printf("    checksum %s ok\n", checksum);
+    }
+
+    printf("G_RunSimBenchmark: all demos, %i tics\n", numtics);
+    G_BenchReport(0, numtics);
+
+    if(record)
+        fclose(record);
+
+    if(unchecked)
+        printf("G_RunSimBenchmark: %i demo(s) had no reference checksum\n", unchecked);
+
+    if(failures)
+    {
+        I_Error("G_RunSimBenchmark: %i of %i demo(s) failed the checksum",
+                failures, numbenchdemos);
+    }
+
+    I_Quit();
+}
+
+// EOF
+
@@ -0,0 +1,46 @@
+//
+// Copyright(C) 2014 Night Dive Studios, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//    [SVE] Headless playsim benchmark over recorded demos
+//
+
+#ifndef G_BENCH_H__
+#define G_BENCH_H__
+
+#include "doomtype.h"
+
+//
+// benchsection_t
+//
+// The parts of a tic that are timed separately.
+//
+typedef enum
+{
+    BENCH_PLAYERTHINK,  // P_PlayerThink for every player
+    BENCH_THINKERS,     // P_RunThinkers
+    BENCH_SPECIALS,     // P_UpdateSpecials
+    BENCH_SOUNDS,       // S_UpdateSounds
+    BENCH_TIC,          // the whole tic
+    NUMBENCHSECTIONS
+} benchsection_t;
+
+extern boolean simbenchmark;
+
+uint64_t G_BenchSection(benchsection_t section, uint64_t start);
+void G_RunSimBenchmark(void);
+
+#endif
+
+// EOF
+
@@ -69,6 +69,7 @@
 #include "p_dialog.h"   // villsa [STRIFE]
 
 #include "g_game.h"
+#include "g_bench.h" // [SVE]
 
 // [SVE] svillarreal
 #include "i_joystick.h"
@@ -1709,7 +1710,7 @@ static void G_RemovePrisoners(void)
 {
     thinker_t *th;
 
-    for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
     {
         if(th->function.acp1 == (actionf_p1)P_MobjThinker)
         {
@@ -3053,12 +3054,24 @@ static char *DemoVersionDescription(int version)
 //
 void G_DoPlayDemo (void) 
 { 
+    gameaction = ga_nothing; 
+    G_PlayDemoBuffer (W_CacheLumpName (defdemoname, PU_STATIC));
+}
+
+//
+// G_PlayDemoBuffer
+//
+// [SVE] Starts playing back a demo that is already in memory.
+// Split out of G_DoPlayDemo for the playsim benchmark, which reads
+// its demos from files rather than lumps.
+//
+void G_PlayDemoBuffer (byte *buffer)
+{
     skill_t skill; 
     int     i, map; 
     int     demoversion;
 
-    gameaction = ga_nothing; 
-    demobuffer = demo_p = W_CacheLumpName (defdemoname, PU_STATIC); 
+    demobuffer = demo_p = buffer; 
 
     demoversion = *demo_p++;
 
@@ -3181,7 +3194,9 @@ boolean G_CheckDemoStatus (void)
 
     if (demoplayback) 
     { 
-        W_ReleaseLumpName(defdemoname);
+        // [SVE] the benchmark frees its own demo buffers
+        if (!simbenchmark)
+            W_ReleaseLumpName(defdemoname);
         demoplayback = false; 
         netdemo = false;
         netgame = false;
@@ -3191,6 +3206,10 @@ boolean G_CheckDemoStatus (void)
         fastparm = start_fastparm;
         nomonsters = false;
         consoleplayer = 0;
+
+        // [SVE] back to G_RunSimBenchmark for the next demo
+        if (simbenchmark)
+            return true;
         
         if (singledemo) 
             I_Quit (); 
@@ -56,6 +56,7 @@ void G_RecordDemo (char* name);
 void G_BeginRecording (void);
 
 void G_PlayDemo (char* name);
+void G_PlayDemoBuffer (byte *buffer); // [SVE]
 void G_TimeDemo (char* name);
 boolean G_CheckDemoStatus (void);
 
@@ -907,7 +907,7 @@ static boolean P_MourelVeteranAction(player_t *player)
 
     // find Harris and set his dialog state
     // 20141108: also, remove any chalices dropped on the ground... :P
-    for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
     {
         if(th->function.acp1 == (actionf_p1)P_MobjThinker)
         {
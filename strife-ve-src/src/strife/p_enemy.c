@@ -763,7 +763,7 @@ static boolean P_allyFindMonster(mobj_t *actor)
     if(classicmode || deathmatch)
         return false; // this isn't for classic or for multiplayer
 
-    for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
     {
         mobj_t *mo;
 
@@ -1073,7 +1073,7 @@ static void P_allyFindCTCTarget(mobj_t *rebel, boolean setstate)
     }
 
     // check for enemy rebels
-    for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
     {
         mobj_t *mo;
 
@@ -2108,7 +2108,7 @@ void A_AlertSpectreC(mobj_t* actor)
 {
     thinker_t *th;
 
-    for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
     {
         if(th->function.acp1 == (actionf_p1)P_MobjThinker)
         {
@@ -2990,7 +2990,7 @@ boolean P_ClaxonsActive(void)
 {
     thinker_t *th;
 
-    for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
     {
         if(th->function.acp1 == (actionf_p1)P_MobjThinker)
         {
@@ -3251,7 +3251,7 @@ static void P_CalmRebels(void)
         P_SetTarget(&sectors[i].soundtarget, NULL);
 
     // put all rebels back to being idle.
-    for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
     {
         if(th->function.acp1 == (actionf_p1)P_MobjThinker)
         {
@@ -3309,7 +3309,7 @@ void A_BossDeath (mobj_t* actor)
         return; // everybody's dead.
 
     // check for a still living boss
-    for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
     {
         if(th->function.acp1 == (actionf_p1) P_MobjThinker)
         {
@@ -3349,7 +3349,7 @@ void A_BossDeath (mobj_t* actor)
         // causes a bug sometimes! The Oracle, in its death state, sets the
         // Spectre C back to its seestate. If the Spectre C is already dead,
         // it becomes an undead ghost monster. Then it's a REAL spectre ;)
-        for(th = thinkercap.next; th != &thinkercap; th = th->next)
+        for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
         {
             if(th->function.acp1 == (actionf_p1) P_MobjThinker)
             {
@@ -3463,7 +3463,7 @@ void A_AcolyteSpecial(mobj_t* actor)
     if(i == 8)
         return;
 
-    for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
     {
         if(th->function.acp1 == (actionf_p1) P_MobjThinker)
         {
@@ -3842,7 +3842,7 @@ void A_OreSpawner(mobj_t *actor)
     if(!inrange)
         return;
 
-    for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
     {
         if(th->function.acp1 == (actionf_p1)P_MobjThinker)
         {
@@ -3961,7 +3961,7 @@ void A_FlagStandCheck(mobj_t *actor)
 
     // ok nobody seems to be carrying the flag around, so, has it flopped out
     // onto the ground somewhere?
-    for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
     {
         if(th->function.acp1 == (actionf_p1)P_MobjThinker)
         {
@@ -325,7 +325,7 @@ EV_DoFloor
 
         // new floor thinker
         rtn = 1;
-        floor = Z_Malloc (sizeof(*floor), PU_LEVSPEC, 0);
+        floor = P_AllocThinker (th_mover, sizeof(*floor));
         P_AddThinker (&floor->thinker);
         sec->specialdata = floor;
         floor->thinker.function.acp1 = (actionf_p1) T_MoveFloor;
@@ -559,7 +559,7 @@ EV_BuildStairs
 
         // new floor thinker
         rtn = 1;
-        floor = Z_Malloc (sizeof(*floor), PU_LEVSPEC, 0);
+        floor = P_AllocThinker (th_mover, sizeof(*floor));
         P_AddThinker (&floor->thinker);
         sec->tag = 0; // haleyjd 20140919: [STRIFE] zeroes tag
         sec->specialdata = floor;
@@ -608,7 +608,7 @@ EV_BuildStairs
 
                 sec = tsec;
                 secnum = newsecnum;
-                floor = Z_Malloc (sizeof(*floor), PU_LEVSPEC, 0);
+                floor = P_AllocThinker (th_mover, sizeof(*floor));
 
                 P_AddThinker (&floor->thinker);
 
@@ -485,7 +485,7 @@ static void P_returnChaliceToBase(mobj_t *special, mobj_t *toucher)
     else
         return; // eh??
 
-    for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
     {
         if(th->function.acp1 == (actionf_p1)P_MobjThinker)
         {
@@ -590,7 +590,7 @@ static void P_checkForCTCScore(mobj_t *special, mobj_t *toucher)
 
     // make sure own team's chalice is secure; it must be within 64 units 
     // of the team's flag base.
-    for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
     {
         if(th->function.acp1 == (actionf_p1)P_MobjThinker)
         {
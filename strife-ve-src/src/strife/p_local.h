@@ -68,8 +68,23 @@
 // both the head and tail of the thinker list
 extern	thinker_t	thinkercap;	
 
+// [SVE] thinker classes, each kept in its own list as well
+typedef enum
+{
+    th_mobj,
+    th_mover,   // ceilings, doors, floors and plats
+    th_light,
+    NUMTHINKERCLASSES
+} thclass_t;
+
+// [SVE] head and tail of the list for each class
+extern	thinker_t	thinkerclasscap[NUMTHINKERCLASSES];
+
 
+void P_InitThinkerPools (void);
 void P_InitThinkers (void);
+void *P_AllocThinker (thclass_t thclass, size_t size);
+void P_FreeThinker (thinker_t* thinker);
 void P_AddThinker (thinker_t* thinker);
 void P_RemoveThinker (thinker_t* thinker);
 
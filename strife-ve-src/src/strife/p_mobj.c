@@ -746,8 +746,7 @@ P_SpawnMobj
     state_t*	st;
     mobjinfo_t*	info;
 
-    mobj = Z_Malloc (sizeof(*mobj), PU_LEVEL, NULL);
-    memset (mobj, 0, sizeof (*mobj));
+    mobj = P_AllocThinker (th_mobj, sizeof(*mobj)); // [SVE] zeroed
     info = &mobjinfo[type];
 
     mobj->type = type;
@@ -286,6 +286,12 @@ typedef struct mobj_s
     // haleyjd 20140902: [SVE] interpolation data
     prevpos_t           prevpos;
 
+    // [SVE] light grid cell the renderer last found this thing in,
+    // and the map unit it was looked up for
+    int                 lightcell;
+    int                 lightcellpos[3];
+    boolean             lightcellvalid;
+
     // Interaction info, by BLOCKMAP.
     // Links in blocks (if needed).
     struct mobj_s*      bnext;
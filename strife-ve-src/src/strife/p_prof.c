@@ -0,0 +1,388 @@
+//
+// Copyright(C) 2014 Night Dive Studios, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//    [SVE] Per thinker function and per mobj type playsim profiling
+//
+//    With -thinkprof, P_RunThinkers switches to a copy of its loop that
+//    times every thinker call and hands the time here. Calls are counted
+//    against the thinker function and, for mobjs, against the mobj type.
+//    The last full second is shown as an overlay, and a report for each
+//    level is printed when the next level is set up and at exit.
+//
+//    Without -thinkprof the only cost is the one flag test per tic in
+//    P_RunThinkers.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "z_zone.h"
+#include "doomstat.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_menu.h"
+#include "m_misc.h"
+#include "p_local.h"
+#include "p_spec.h"
+#include "p_tick.h"
+#include "p_prof.h"
+
+// how many mobj types the overlay and the report list
+#define OVERLAYTYPES    5
+#define OVERLAYFUNCS    5
+#define REPORTTYPES     20
+
+typedef struct
+{
+    uint64_t     ticks;
+    unsigned int calls;
+} profcount_t;
+
+typedef struct
+{
+    actionf_p1  func;
+    const char *name;
+} thinkername_t;
+
+#define THINKERNAME(f) { (actionf_p1) f, #f }
+
+static thinkername_t thinkernames[] =
+{
+    THINKERNAME(P_MobjThinker),
+    THINKERNAME(T_MoveCeiling),
+    THINKERNAME(T_MoveFloor),
+    THINKERNAME(T_VerticalDoor),
+    THINKERNAME(T_SlidingDoor),
+    THINKERNAME(T_PlatRaise),
+    THINKERNAME(T_LightFlash),
+    THINKERNAME(T_StrobeFlash),
+    THINKERNAME(T_FireFlicker),
+    THINKERNAME(T_Glow),
+    THINKERNAME(P_RemoveThinkerDelayed),
+};
+
+#define NUMTHINKERNAMES ((int) arrlen(thinkernames))
+
+// one more bucket for anything that isn't in the table
+#define NUMTHINKERFUNCS (NUMTHINKERNAMES + 1)
+
+typedef struct
+{
+    profcount_t funcs[NUMTHINKERFUNCS];
+    profcount_t types[NUMMOBJTYPES];
+    int         tics;
+} profstats_t;
+
+boolean thinkerprofile = false;
+
+static profstats_t levelstats;  // since the level was set up
+static profstats_t windowstats; // the second being counted
+static profstats_t shownstats;  // the last full second, for the overlay
+
+static int      profilemap;
+static uint64_t frequency;
+
+// counts being sorted by P_compareCounts
+static profcount_t *sortcounts;
+
+//
+// P_ProfileThinker
+//
+// Counts one call to a thinker function, taking the given number of
+// I_GetPerfCounter ticks. type is the mobj type for P_MobjThinker, or
+// -1 for everything else.
+//
+void P_ProfileThinker(actionf_p1 func, int type, uint64_t ticks)
+{
+    int i;
+
+    for(i = 0; i < NUMTHINKERNAMES; i++)
+    {
+        if(thinkernames[i].func == func)
+            break;
+    }
+
+    levelstats.funcs[i].ticks += ticks;
+    levelstats.funcs[i].calls++;
+    windowstats.funcs[i].ticks += ticks;
+    windowstats.funcs[i].calls++;
+
+    if(type >= 0 && type < NUMMOBJTYPES)
+    {
+        levelstats.types[type].ticks += ticks;
+        levelstats.types[type].calls++;
+        windowstats.types[type].ticks += ticks;
+        windowstats.types[type].calls++;
+    }
+}
+
+//
+// P_ThinkerProfileTic
+//
+// Called once P_RunThinkers has been through every thinker. Rolls the
+// overlay over to the new counts every second.
+//
+void P_ThinkerProfileTic(void)
+{
+    if(levelstats.tics++ == 0)
+        profilemap = gamemap;
+
+    if(++windowstats.tics == TICRATE)
+    {
+        shownstats = windowstats;
+        memset(&windowstats, 0, sizeof(windowstats));
+    }
+}
+
+//
+// P_tickMicroseconds
+//
+static double P_tickMicroseconds(uint64_t ticks)
+{
+    return (double)ticks * 1000000.0 / (double)frequency;
+}
+
+//
+// P_thinkerName
+//
+static const char *P_thinkerName(int func)
+{
+    return func < NUMTHINKERNAMES ? thinkernames[func].name : "(other)";
+}
+
+//
+// P_mobjTypeName
+//
+// Most types have no in-game name, so fall back to the type number.
+//
+static const char *P_mobjTypeName(int type)
+{
+    static char buffer[32];
+
+    if(mobjinfo[type].name)
+        M_snprintf(buffer, sizeof(buffer), "%s", mobjinfo[type].name);
+    else
+        M_snprintf(buffer, sizeof(buffer), "type %i", type);
+
+    return buffer;
+}
+
+//
+// P_compareCounts
+//
+// qsort callback putting the most expensive entries first.
+//
+static int P_compareCounts(const void *a, const void *b)
+{
+    const profcount_t *ca = &sortcounts[*(const int *)a];
+    const profcount_t *cb = &sortcounts[*(const int *)b];
+
+    if(ca->ticks != cb->ticks)
+        return ca->ticks < cb->ticks ? 1 : -1;
+
+    return *(const int *)a - *(const int *)b;
+}
+
+//
+// P_sortCounts
+//
+// Fills order with the indices of the counts that were called at all,
+// most expensive first, and returns how many there are.
+//
+static int P_sortCounts(profcount_t *counts, int numcounts, int *order)
+{
+    int i;
+    int count = 0;
+
+    for(i = 0; i < numcounts; i++)
+    {
+        if(counts[i].calls)
+            order[count++] = i;
+    }
+
+    sortcounts = counts;
+    qsort(order, count, sizeof(int), P_compareCounts);
+
+    return count;
+}
+
+//
+// P_totalTicks
+//
+static uint64_t P_totalTicks(const profstats_t *stats)
+{
+    uint64_t total = 0;
+    int i;
+
+    for(i = 0; i < NUMTHINKERFUNCS; i++)
+        total += stats->funcs[i].ticks;
+
+    return total;
+}
+
+//
+// P_printCounts
+//
+static void P_printCounts(const profcount_t *count, int tics, uint64_t total,
+                          const char *name)
+{
+    printf("    %-24s %9.1f %9.2f %9.3f %6.1f%%\n", name,
+           (double)count->calls / tics,
+           P_tickMicroseconds(count->ticks) / tics,
+           P_tickMicroseconds(count->ticks) / count->calls,
+           total ? 100.0 * count->ticks / total : 0.0);
+}
+
+//
+// P_ThinkerProfileReport
+//
+// Prints what the level that just ended spent in each thinker function
+// and the most expensive mobj types, then starts counting afresh.
+//
+void P_ThinkerProfileReport(void)
+{
+    int      order[NUMMOBJTYPES];
+    uint64_t total;
+    int      count;
+    int      i;
+
+    if(!thinkerprofile || levelstats.tics == 0)
+        return;
+
+    total = P_totalTicks(&levelstats);
+
+    printf("P_ThinkerProfileReport: map %02i, %i tics, %.2f ms per tic in thinkers\n",
+           profilemap, levelstats.tics,
+           P_tickMicroseconds(total) / levelstats.tics / 1000.0);
+    printf("    %-24s %9s %9s %9s %7s\n",
+           "function", "calls/tic", "us/tic", "us/call", "share");
+
+    count = P_sortCounts(levelstats.funcs, NUMTHINKERFUNCS, order);
+
+    for(i = 0; i < count; i++)
+    {
+        P_printCounts(&levelstats.funcs[order[i]], levelstats.tics, total,
+                      P_thinkerName(order[i]));
+    }
+
+    printf("    %-24s %9s %9s %9s %7s\n",
+           "mobj type", "calls/tic", "us/tic", "us/call", "share");
+
+    count = P_sortCounts(levelstats.types, NUMMOBJTYPES, order);
+
+    for(i = 0; i < count && i < REPORTTYPES; i++)
+    {
+        P_printCounts(&levelstats.types[order[i]], levelstats.tics, total,
+                      P_mobjTypeName(order[i]));
+    }
+
+    if(count > REPORTTYPES)
+        printf("    (%i more types)\n", count - REPORTTYPES);
+
+    Z_PrintPoolStats();
+
+    memset(&levelstats, 0, sizeof(levelstats));
+    memset(&windowstats, 0, sizeof(windowstats));
+    memset(&shownstats, 0, sizeof(shownstats));
+}
+
+//
+// P_drawOverlayLine
+//
+static int P_drawOverlayLine(int y, const char *name, const profcount_t *count,
+                             int tics)
+{
+    char buffer[32];
+
+    M_WriteText(4, y, name);
+
+    M_snprintf(buffer, sizeof(buffer), "%.1f",
+               P_tickMicroseconds(count->ticks) / tics);
+    M_WriteText(150, y, buffer);
+
+    M_snprintf(buffer, sizeof(buffer), "%.0f", (double)count->calls / tics);
+    M_WriteText(200, y, buffer);
+
+    return y + 8;
+}
+
+//
+// P_DrawThinkerProfile
+//
+// Overlay of the last full second: the thinker functions and the mobj
+// types that took the most time, in microseconds and calls per tic.
+//
+void P_DrawThinkerProfile(void)
+{
+    int  order[NUMMOBJTYPES];
+    char buffer[64];
+    int  count;
+    int  i;
+    int  y = 24;
+
+    if(!thinkerprofile || shownstats.tics == 0)
+        return;
+
+    M_snprintf(buffer, sizeof(buffer), "thinkers %.2f ms/tic",
+               P_tickMicroseconds(P_totalTicks(&shownstats))
+               / shownstats.tics / 1000.0);
+    M_WriteText(4, y, buffer);
+    M_WriteText(150, y, "us");
+    M_WriteText(200, y, "calls");
+    y += 10;
+
+    count = P_sortCounts(shownstats.funcs, NUMTHINKERFUNCS, order);
+
+    for(i = 0; i < count && i < OVERLAYFUNCS; i++)
+    {
+        y = P_drawOverlayLine(y, P_thinkerName(order[i]),
+                              &shownstats.funcs[order[i]], shownstats.tics);
+    }
+
+    y += 2;
+    count = P_sortCounts(shownstats.types, NUMMOBJTYPES, order);
+
+    for(i = 0; i < count && i < OVERLAYTYPES; i++)
+    {
+        y = P_drawOverlayLine(y, P_mobjTypeName(order[i]),
+                              &shownstats.types[order[i]], shownstats.tics);
+    }
+}
+
+//
+// P_InitThinkerProfile
+//
+void P_InitThinkerProfile(void)
+{
+    //!
+    // @category obscure
+    //
+    // Time every thinker call, by thinker function and by mobj type.
+    // The last second is shown on screen and a report for each level
+    // is printed to stdout.
+    //
+
+    if(!M_CheckParm("-thinkprof"))
+        return;
+
+    thinkerprofile = true;
+    frequency = I_GetPerfFrequency();
+
+    I_AtExit(P_ThinkerProfileReport, false);
+}
+
+// EOF
+
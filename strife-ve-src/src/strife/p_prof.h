@@ -0,0 +1,35 @@
+//
+// Copyright(C) 2014 Night Dive Studios, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//    [SVE] Per thinker function and per mobj type playsim profiling
+//
+
+#ifndef P_PROF_H__
+#define P_PROF_H__
+
+#include "doomtype.h"
+#include "d_think.h"
+
+extern boolean thinkerprofile;
+
+void P_InitThinkerProfile(void);
+void P_ProfileThinker(actionf_p1 func, int type, uint64_t ticks);
+void P_ThinkerProfileTic(void);
+void P_ThinkerProfileReport(void);
+void P_DrawThinkerProfile(void);
+
+#endif
+
+// EOF
+
@@ -1963,7 +1963,7 @@ void P_ArchiveThinkers (void)
     thinker_t*          th;
 
     // save off the current thinkers
-    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    for (th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
     {
         if (th->function.acp1 == (actionf_p1)P_MobjThinker)
         {
@@ -2011,7 +2011,7 @@ void P_UnArchiveThinkers (void)
         if (currentthinker->function.acp1 == (actionf_p1)P_MobjThinker)
             P_RemoveMobj ((mobj_t *)currentthinker);
         else
-            Z_Free (currentthinker);
+            P_FreeThinker (currentthinker);
 
         currentthinker = next;
     }
@@ -2029,7 +2029,7 @@ void P_UnArchiveThinkers (void)
 
         case tc_mobj:
             saveg_read_pad();
-            mobj = Z_Malloc (sizeof(*mobj), PU_LEVEL, NULL);
+            mobj = P_AllocThinker (th_mobj, sizeof(*mobj));
             saveg_read_mobj_t(mobj);
 
             // haleyjd 09/29/10: Strife sets the targets of non-allied creatures
@@ -2061,6 +2061,7 @@ void P_UnArchiveThinkers (void)
             // to set this here will almost certainly crash Choco.
             mobj->tracer = NULL;
             P_MobjBackupPosition(mobj); // [SVE] interpolation
+            mobj->lightcellvalid = false; // [SVE] not saved
             P_SetThingPosition(mobj);
             mobj->info = &mobjinfo[mobj->type];
             // [STRIFE]: doesn't set these
@@ -2079,7 +2080,7 @@ void P_UnArchiveThinkers (void)
 
     // haleyjd 20140817: [SVE] now that all mobjs have been spawned, set their
     // targets.
-    for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    for(th = thinkerclasscap[th_mobj].cnext; th != &thinkerclasscap[th_mobj]; th = th->cnext)
     {
         if(th->function.acp1 == (actionf_p1)P_MobjThinker)
         {
@@ -2135,8 +2136,13 @@ void P_ArchiveSpecials (void)
     int                 i;
 
     // save off the current thinkers
+    // [SVE] from the main list, so that movers and lights are
+    // loaded back in the order they ran in
     for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
     {
+        if (th->thclass == th_mobj)
+            continue;
+
         if (th->function.acv == (actionf_v)NULL)
         {
             // haleyjd 20140817: [SVE] remove activeceilings limit
@@ -2261,7 +2267,7 @@ void P_UnArchiveSpecials (void)
 
         case tc_ceiling:
             saveg_read_pad();
-            ceiling = Z_Malloc (sizeof(*ceiling), PU_LEVEL, NULL);
+            ceiling = P_AllocThinker (th_mover, sizeof(*ceiling));
             saveg_read_ceiling_t(ceiling);
             ceiling->sector->specialdata = ceiling;
 
@@ -2274,7 +2280,7 @@ void P_UnArchiveSpecials (void)
 
         case tc_door:
             saveg_read_pad();
-            door = Z_Malloc (sizeof(*door), PU_LEVEL, NULL);
+            door = P_AllocThinker (th_mover, sizeof(*door));
             saveg_read_vldoor_t(door);
             door->sector->specialdata = door;
             door->thinker.function.acp1 = (actionf_p1)T_VerticalDoor;
@@ -2284,7 +2290,7 @@ void P_UnArchiveSpecials (void)
         case tc_slidingdoor:
             // haleyjd 09/29/10: [STRIFE] New thinker type for sliding doors
             saveg_read_pad();
-            slidedoor = Z_Malloc(sizeof(*slidedoor), PU_LEVEL, NULL);
+            slidedoor = P_AllocThinker(th_mover, sizeof(*slidedoor));
             saveg_read_slidedoor_t(slidedoor);
             slidedoor->frontsector->specialdata = slidedoor;
             slidedoor->thinker.function.acp1 = (actionf_p1)T_SlidingDoor;
@@ -2293,7 +2299,7 @@ void P_UnArchiveSpecials (void)
 
         case tc_floor:
             saveg_read_pad();
-            floor = Z_Malloc (sizeof(*floor), PU_LEVEL, NULL);
+            floor = P_AllocThinker (th_mover, sizeof(*floor));
             saveg_read_floormove_t(floor);
             floor->sector->specialdata = floor;
             floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
@@ -2302,7 +2308,7 @@ void P_UnArchiveSpecials (void)
 
         case tc_plat:
             saveg_read_pad();
-            plat = Z_Malloc (sizeof(*plat), PU_LEVEL, NULL);
+            plat = P_AllocThinker (th_mover, sizeof(*plat));
             saveg_read_plat_t(plat);
             plat->sector->specialdata = plat;
 
@@ -2315,7 +2321,7 @@ void P_UnArchiveSpecials (void)
 
         case tc_flash:
             saveg_read_pad();
-            flash = Z_Malloc (sizeof(*flash), PU_LEVEL, NULL);
+            flash = P_AllocThinker (th_light, sizeof(*flash));
             saveg_read_lightflash_t(flash);
             flash->thinker.function.acp1 = (actionf_p1)T_LightFlash;
             P_AddThinker (&flash->thinker);
@@ -2323,7 +2329,7 @@ void P_UnArchiveSpecials (void)
 
         case tc_strobe:
             saveg_read_pad();
-            strobe = Z_Malloc (sizeof(*strobe), PU_LEVEL, NULL);
+            strobe = P_AllocThinker (th_light, sizeof(*strobe));
             saveg_read_strobe_t(strobe);
             strobe->thinker.function.acp1 = (actionf_p1)T_StrobeFlash;
             P_AddThinker (&strobe->thinker);
@@ -2331,7 +2337,7 @@ void P_UnArchiveSpecials (void)
 
         case tc_glow:
             saveg_read_pad();
-            glow = Z_Malloc (sizeof(*glow), PU_LEVEL, NULL);
+            glow = P_AllocThinker (th_light, sizeof(*glow));
             saveg_read_glow_t(glow);
             glow->thinker.function.acp1 = (actionf_p1)T_Glow;
             P_AddThinker (&glow->thinker);
@@ -2340,7 +2346,7 @@ void P_UnArchiveSpecials (void)
         case tc_fireflicker:
             // [SVE]: fireflicker thinkers
             saveg_read_pad();
-            flicker = Z_Malloc (sizeof(*flicker), PU_LEVEL, NULL);
+            flicker = P_AllocThinker (th_light, sizeof(*flicker));
             saveg_read_fireflicker_t(flicker);
             flicker->thinker.function.acp1 = (actionf_p1)T_FireFlicker;
             P_AddThinker (&flicker->thinker);
@@ -26,11 +26,14 @@
 #include "rb_config.h"
 #include "rb_common.h"
 #include "rb_drawlist.h"
+#include "rb_vbo.h"
 #include "rb_wallshade.h"
 #include "rb_decal.h"
 #include "rb_level.h"
 #include "rb_data.h"
 #include "rb_dynlights.h"
+#include "rb_pvs.h"
+#include "rb_lightgrid.h"
 
 #include "z_zone.h"
 #include "deh_main.h"
@@ -46,6 +49,7 @@
 #include "st_stuff.h"
 #include "doomstat.h"
 #include "p_locations.h"
+#include "p_prof.h"
 
 
 void    P_SpawnMapThing (mapthing_t*    mthing);
@@ -496,7 +500,6 @@ void P_LoadSectors (int lump)
         ss->thinglist = NULL;
         ss->floorshade   = NULL; // haleyjd [SVE]
         ss->ceilingshade = NULL;
-        ss->decallist = NULL; // [SVE] svillarreal
         ss->altlightlevel = -1; // [SVE] svillarreal
         ss->validclip[0] = -1;
         ss->validclip[1] = -1;
@@ -1312,7 +1315,7 @@ static void P_LoadReject(int lumpnum)
 // P_LoadPVS
 //
 
-static void P_LoadPVS(int lumpnum)
+static void P_LoadPVS(int lumpnum, int seglump)
 {
     int minlength;
     int lumplen;
@@ -1323,7 +1326,12 @@ static void P_LoadPVS(int lumpnum)
     if(lumplen == 0 || lumplen != minlength)
     {
         pvsmatrix = Z_Malloc(minlength, PU_LEVEL, (void**)&pvsmatrix);
-        memset(pvsmatrix, 0xff, minlength);
+
+        // [SVE] build one from the gl nodes so the renderer can still cull
+        if(!rbGeneratePVS || !RB_GeneratePVS(pvsmatrix, seglump))
+        {
+            memset(pvsmatrix, 0xff, minlength);
+        }
         return;
     }
 
@@ -1342,6 +1350,9 @@ void P_SetupLevel(int map, int playermask, skill_t skill)
     int     gllumpnum;
     wad_file_t *mapwadfile; // [SVE] svillarreal
 
+    // [SVE] report on the level being left before its thinkers go
+    P_ThinkerProfileReport();
+
     // haleyjd 20110205 [STRIFE]: removed totalitems and wminfo
     totalkills =  totalsecret = 0;
 
@@ -1375,6 +1386,10 @@ void P_SetupLevel(int map, int playermask, skill_t skill)
     // [SVE] svillarreal
     ST_ClearDamageMarkers();
     
+    // [SVE] memory held by the level being left
+    if (M_ParmExists("-zonestats"))
+        Z_DumpStats ();
+
 #if 0 // UNUSED
     if (debugfile)
     {
@@ -1436,7 +1451,7 @@ void P_SetupLevel(int map, int playermask, skill_t skill)
         P_LoadSubsectors(gllumpnum+ML_GL_SSECT);
         P_LoadNodes(gllumpnum+ML_GL_NODES);
         P_LoadGLSegs(gllumpnum+ML_GL_SEGS);
-        P_LoadPVS(gllumpnum+ML_GL_PVS);
+        P_LoadPVS(gllumpnum+ML_GL_PVS, gllumpnum+ML_GL_SEGS);
 
         P_BuildLeafs();
 
@@ -1476,6 +1491,12 @@ void P_SetupLevel(int map, int playermask, skill_t skill)
     capturethechalice = false;
     ctcbluescore = ctcredscore = 0;
     P_LoadThings(lumpnum+ML_THINGS);
+
+    // [SVE] start decoding sprites while the rest of the level loads
+    if(use3drenderer)
+    {
+        RB_BeginPrecacheLevel();
+    }
     
     // if deathmatch, randomly spawn the active players
     if(deathmatch)
@@ -1511,7 +1532,9 @@ void P_SetupLevel(int map, int playermask, skill_t skill)
     {
         RB_PrecacheLevel();
         RB_InitLightMarks();
+        RB_InitLightGrid();
         DL_Init();
+        VBO_BuildLevel();
     }
 
     //printf ("free memory: 0x%x\n", Z_FreeMemory());
@@ -1536,4 +1559,8 @@ void P_Init (void)
 
     // [SVE] haleyjd
     P_InitLocations();
+
+    // [SVE]
+    P_InitThinkerPools();
+    P_InitThinkerProfile();
 }
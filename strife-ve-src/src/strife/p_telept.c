@@ -75,10 +75,9 @@ EV_Teleport
     {
         if (sectors[ i ].tag == tag )
         {
-            thinker = thinkercap.next;
-            for (thinker = thinkercap.next;
-                thinker != &thinkercap;
-                thinker = thinker->next)
+            for (thinker = thinkerclasscap[th_mobj].cnext;
+                thinker != &thinkerclasscap[th_mobj];
+                thinker = thinker->cnext)
             {
                 // not a mobj
                 if (thinker->function.acp1 != (actionf_p1)P_MobjThinker)
@@ -19,21 +19,29 @@
 //
 
 
+#include <string.h>
+
 #include "z_zone.h"
+#include "i_system.h"
 #include "p_local.h"
+#include "p_spec.h"
 
 #include "doomstat.h"
 
 // [SVE] svillarreal
 #include "rb_decal.h"
 
+#include "g_bench.h"
+#include "i_timer.h"
+#include "p_prof.h"
+
 
 int leveltime;
 
 //
 // THINKERS
-// All thinkers should be allocated by Z_Malloc
-// so they can be operated on uniformly.
+// All thinkers should be allocated by P_AllocThinker
+// so they can be operated on uniformly. [SVE]
 // The actual structures will vary in size,
 // but the first element must be thinker_t.
 //
@@ -43,33 +51,121 @@ int leveltime;
 // Both the head and tail of the thinker list.
 thinker_t   thinkercap;
 
+// [SVE] Each class also has a list of its own, so code that only wants
+// mobjs doesn't have to step over every light and mover. The thinkers
+// still run from the main list, in the order they were added, and the
+// class lists keep that order.
+thinker_t   thinkerclasscap[NUMTHINKERCLASSES];
+
+//
+// [SVE] Thinker pools
+//
+// Thinkers of each class come from a zone pool of PU_LEVEL slabs
+// instead of being allocated one by one, so that the ones which run
+// one after the other sit next to each other in memory, and the puffs,
+// blood and missiles that come and go all the time reuse the memory of
+// the ones before them. The slabs are freed with the rest of the level.
+//
+
+static zpool_t thinkerpools[NUMTHINKERCLASSES];
+
+//
+// P_InitThinkerPools
+//
+// [SVE] Each class's pool is sized to the largest thinker in it.
+//
+void P_InitThinkerPools (void)
+{
+    size_t mover;
+    size_t light;
+
+    mover = MAX(sizeof(ceiling_t), sizeof(vldoor_t));
+    mover = MAX(mover, sizeof(slidedoor_t));
+    mover = MAX(mover, sizeof(floormove_t));
+    mover = MAX(mover, sizeof(plat_t));
+
+    light = MAX(sizeof(lightflash_t), sizeof(strobe_t));
+    light = MAX(light, sizeof(glow_t));
+    light = MAX(light, sizeof(fireflicker_t));
+
+    Z_PoolInit (&thinkerpools[th_mobj], "mobjs", sizeof(mobj_t), 256, PU_LEVEL);
+    Z_PoolInit (&thinkerpools[th_mover], "movers", mover, 64, PU_LEVEL);
+    Z_PoolInit (&thinkerpools[th_light], "lights", light, 128, PU_LEVEL);
+}
 
 //
 // P_InitThinkers
 //
 // [STRIFE] Verified unmodified
+// [SVE]: Also resets the class lists.
 //
 void P_InitThinkers (void)
 {
+    int i;
+
     thinkercap.prev = thinkercap.next  = &thinkercap;
+
+    for (i = 0; i < NUMTHINKERCLASSES; i++)
+    {
+        thinker_t *cap = &thinkerclasscap[i];
+        cap->cprev = cap->cnext = cap;
+    }
 }
 
+//
+// P_AllocThinker
+//
+// [SVE] Returns a zeroed thinker of the given class from its pool.
+// Takes the place of Z_Malloc for thinkers, and the memory must be
+// given back with P_FreeThinker rather than Z_Free.
+//
+void *P_AllocThinker (thclass_t thclass, size_t size)
+{
+    zpool_t   *pool = &thinkerpools[thclass];
+    thinker_t *thinker;
 
+    if (size > pool->size)
+        I_Error ("P_AllocThinker: %i bytes is too big for the %s pool", (int)size, pool->name);
 
+    thinker = Z_PoolAlloc (pool);
+    memset (thinker, 0, pool->size);
+    thinker->thclass = thclass;
+
+    return thinker;
+}
+
+//
+// P_FreeThinker
+//
+// [SVE] Gives a thinker from P_AllocThinker back to its pool. It must
+// no longer be in the thinker lists.
+//
+void P_FreeThinker (thinker_t *thinker)
+{
+    Z_PoolFree (&thinkerpools[thinker->thclass], thinker);
+}
 
 //
 // P_AddThinker
 // Adds a new thinker at the end of the list.
 //
 // [STRIFE] Verified unmodified
+// [SVE]: And at the end of the list for its class.
 //
 void P_AddThinker (thinker_t* thinker)
 {
+    thinker_t *cap = &thinkerclasscap[thinker->thclass];
+
     thinkercap.prev->next = thinker;
     thinker->next = &thinkercap;
     thinker->prev = thinkercap.prev;
     thinkercap.prev = thinker;
 
+    cap->cprev->cnext = thinker;
+    thinker->cnext = cap;
+    thinker->cprev = cap->cprev;
+    cap->cprev = thinker;
+
     thinker->references = 0; // haleyjd: [SVE]
 }
 
@@ -87,7 +183,13 @@ void P_RemoveThinkerDelayed(thinker_t *thinker)
     {
         thinker_t *next = thinker->next;
         (next->prev = currentthinker = thinker->prev)->next = next;
-        Z_Free(thinker);
+
+        // [SVE] removed thinkers stay in their class list until now, the
+        // same as in the main list
+        next = thinker->cnext;
+        (next->cprev = thinker->cprev)->cnext = next;
+
+        P_FreeThinker(thinker);
     }
 }
 
@@ -117,6 +219,38 @@ void P_SetTarget(mobj_t **mop, mobj_t *target)
         target->thinker.references++;
 }
 
+//
+// P_RunThinkersProfiled
+//
+// [SVE] P_RunThinkers for -thinkprof, timing each call. What the thinker
+// was is noted first, since P_RemoveThinkerDelayed frees it.
+//
+static void P_RunThinkersProfiled (void)
+{
+    actionf_p1 func;
+    uint64_t start;
+    int type;
+
+    for(currentthinker = thinkercap.next;
+        currentthinker != &thinkercap;
+        currentthinker = currentthinker->next)
+    {
+        if(!(func = currentthinker->function.acp1))
+            continue;
+
+        if(func == (actionf_p1)P_MobjThinker)
+            type = ((mobj_t *)currentthinker)->type;
+        else
+            type = -1;
+
+        start = I_GetPerfCounter();
+        func(currentthinker);
+        P_ProfileThinker(func, type, I_GetPerfCounter() - start);
+    }
+
+    P_ThinkerProfileTic();
+}
+
 //
 // P_RunThinkers
 //
@@ -125,6 +259,13 @@ void P_SetTarget(mobj_t **mop, mobj_t *target)
 //
 void P_RunThinkers (void)
 {
+    // [SVE] kept out of the loop below so it costs nothing when off
+    if(thinkerprofile)
+    {
+        P_RunThinkersProfiled();
+        return;
+    }
+
     for(currentthinker = thinkercap.next;
         currentthinker != &thinkercap;
         currentthinker = currentthinker->next)
@@ -142,6 +283,7 @@ void P_RunThinkers (void)
 void P_Ticker (void)
 {
     int     i;
+    uint64_t benchtime = 0;
     
     // run the tic
     if (paused)
@@ -160,12 +302,27 @@ void P_Ticker (void)
     // haleyjd 20140904: [SVE] interpolation: save current sector heights
     P_SaveSectorPositions();
 
+    // [SVE] time each part for -simbench
+    if (simbenchmark)
+        benchtime = I_GetTimeUS();
+
     for (i=0 ; i<MAXPLAYERS ; i++)
         if (playeringame[i])
             P_PlayerThink (&players[i]);
 
+    if (simbenchmark)
+        benchtime = G_BenchSection(BENCH_PLAYERTHINK, benchtime);
+
     P_RunThinkers ();
+
+    if (simbenchmark)
+        benchtime = G_BenchSection(BENCH_THINKERS, benchtime);
+
     P_UpdateSpecials ();
+
+    if (simbenchmark)
+        G_BenchSection(BENCH_SPECIALS, benchtime);
+
     P_RespawnSpecials ();
 
     // [SVE] svillarreal
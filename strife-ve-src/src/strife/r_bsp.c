@@ -81,7 +81,7 @@ typedef	struct
 } cliprange_t;
 
 // haleyjd 20140831: [SVE] raised MAXSEGS to proper amount; more shoutouts to Lee Killough
-#define MAXSEGS (SCREENWIDTH/2 + 1)
+#define MAXSEGS (MAXRENDERWIDTH/2 + 1)
 
 // newend is one past the last valid seg
 cliprange_t*	newend;
@@ -197,9 +197,6 @@ typedef struct sector_s
     // [SVE] svillarreal - minimum bloom threshold
     short bloomthreshold;
 
-    // [SVE] svillarreal - decal links
-    struct rbDecal_s *decallist;
-
 } sector_t;
 
 
@@ -341,6 +338,9 @@ typedef struct subsector_s
     word            numleafs;
     word            leaf;
     lightMapInfo_t  lightMapInfo[2];
+
+    // [SVE] svillarreal - decal links
+    struct rbDecal_s *decallist;
 } subsector_t;
 
 
@@ -553,18 +553,22 @@ typedef struct visplane_s
   
   // leave pads for [minx-1]/[maxx+1]
   
-  byte      pad1;
+  // [SVE] 16 bits so that views taller than 255 rows fit
+  unsigned short pad1;
   // Here lies the rub for all
   //  dynamic resize/change of resolution.
-  byte      top[SCREENWIDTH];
-  byte      pad2;
-  byte      pad3;
+  unsigned short top[MAXRENDERWIDTH];
+  unsigned short pad2;
+  unsigned short pad3;
   // See above.
-  byte      bottom[SCREENWIDTH];
-  byte      pad4;
+  unsigned short bottom[MAXRENDERWIDTH];
+  unsigned short pad4;
 
 } visplane_t;
 
+// top[] of a column the visplane doesn't cover
+#define VISPLANEEMPTY	0xffff
+
 
 
 
@@ -37,10 +37,6 @@
 #include "doomstat.h"
 
 
-// ?
-#define MAXWIDTH			1120
-#define MAXHEIGHT			832
-
 // status bar height at bottom of screen
 // haleyjd 08/31/10: Verified unmodified.
 #define SBARHEIGHT              32
@@ -61,8 +57,25 @@ int		scaledviewwidth;
 int		viewheight;
 int		viewwindowx;
 int		viewwindowy; 
-byte*		ylookup[MAXHEIGHT]; 
-int		columnofs[MAXWIDTH]; 
+byte*		ylookup[MAXRENDERHEIGHT]; 
+int		columnofs[MAXRENDERWIDTH]; 
+
+// [SVE] Size to draw the view at, counted for the whole screen. When
+// it is bigger than 320x200 the view goes into renderbuffer instead of
+// the screen, and I_FinishUpdate shows it under the 2D graphics.
+// viewwidth and viewheight are in renderbuffer pixels; scaledviewwidth,
+// scaledviewheight and viewwindowx/y stay on the 320x200 screen.
+int		r_renderwidth = 0;
+int		r_renderheight = 0;
+
+int		scaledviewheight;
+int		renderwidth = SCREENWIDTH;
+int		renderheight = SCREENHEIGHT;
+int		renderwindowx;
+int		renderwindowy;
+int		viewstride = SCREENWIDTH;
+
+static byte	*renderbuffer = NULL;
 
 // Color tables for different players,
 //  translate a limited part to another
@@ -105,34 +118,63 @@ int			dccount;
 //  be used. It has also been used with Wolfenstein 3D.
 // 
 void R_DrawColumn (void) 
+{ 
+    drawcolumn_t	dc;
+
+#ifdef RANGECHECK 
+    if (dc_yh >= dc_yl
+	&& ((unsigned)dc_x >= viewwidth
+	|| dc_yl < 0
+	|| dc_yh >= viewheight))
+	I_Error ("R_DrawColumn: %i to %i at %i", dc_yl, dc_yh, dc_x); 
+#endif 
+
+    dc.colormap = dc_colormap;
+    dc.source = dc_source;
+    dc.x = dc_x;
+    dc.yl = dc_yl;
+    dc.yh = dc_yh;
+    dc.iscale = dc_iscale;
+    dc.texturemid = dc_texturemid;
+
+    R_DrawColumnFrom (&dc);
+} 
+
+//
+// R_DrawColumnFrom
+// [SVE] The R_DrawColumn inner loop, taking its parameters from a
+// drawcolumn_t so that render strip workers can replay columns
+// recorded during the BSP walk without touching the dc_ globals.
+//
+void R_DrawColumnFrom (const drawcolumn_t *dc) 
 { 
     int			count; 
     byte*		dest; 
+    byte*		source;
+    lighttable_t*	colormap;
     fixed_t		frac;
     fixed_t		fracstep;	 
+    int			stride;
  
-    count = dc_yh - dc_yl; 
+    count = dc->yh - dc->yl; 
 
     // Zero length, column does not exceed a pixel.
     if (count < 0) 
 	return; 
-				 
-#ifdef RANGECHECK 
-    if ((unsigned)dc_x >= SCREENWIDTH
-	|| dc_yl < 0
-	|| dc_yh >= SCREENHEIGHT) 
-	I_Error ("R_DrawColumn: %i to %i at %i", dc_yl, dc_yh, dc_x); 
-#endif 
 
     // Framebuffer destination address.
     // Use ylookup LUT to avoid multiply with ScreenWidth.
     // Use columnofs LUT for subwindows? 
-    dest = ylookup[dc_yl] + columnofs[dc_x];  
+    dest = ylookup[dc->yl] + columnofs[dc->x];  
 
     // Determine scaling,
     //  which is the only mapping to be done.
-    fracstep = dc_iscale; 
-    frac = dc_texturemid + (dc_yl-centery)*fracstep; 
+    fracstep = dc->iscale; 
+    frac = dc->texturemid + (dc->yl-centery)*fracstep; 
+
+    source = dc->source;
+    colormap = dc->colormap;
+    stride = viewstride;
 
     // Inner loop that does the actual texture mapping,
     //  e.g. a DDA-lile scaling.
@@ -141,14 +183,92 @@ void R_DrawColumn (void)
     {
 	// Re-map color indices from wall texture column
 	//  using a lighting/special effects LUT.
-	*dest = dc_colormap[dc_source[(frac>>FRACBITS)&127]];
+	*dest = colormap[source[(frac>>FRACBITS)&127]];
 	
-	dest += SCREENWIDTH; 
+	dest += stride; 
 	frac += fracstep;
 	
     } while (count--); 
 } 
 
+//
+// R_DrawColumn4From
+// [SVE] Draws four recorded columns side by side, at x to x+3. In a
+// wide view each row of a column is in a cache line of its own, and
+// drawing the neighbours one after another fetches all of those lines
+// again for every column; here the rows the four share are written
+// together instead. The rows above and below that only some of them
+// cover are drawn a column at a time. Every column still gets the same
+// texels at the same pixels, so this draws what four R_DrawColumnFrom
+// calls would.
+//
+void R_DrawColumn4From (const drawcolumn_t *const *dc)
+{
+    drawcolumn_t	part;
+    int			yl;
+    int			yh;
+    int			count;
+    int			i;
+    byte*		dest;
+    byte*		source[4];
+    lighttable_t*	colormap[4];
+    fixed_t		frac[4];
+    fixed_t		fracstep[4];
+    int			stride;
+
+    yl = MAX(MAX(dc[0]->yl, dc[1]->yl), MAX(dc[2]->yl, dc[3]->yl));
+    yh = MIN(MIN(dc[0]->yh, dc[1]->yh), MIN(dc[2]->yh, dc[3]->yh));
+
+    if (yh < yl)
+    {
+	for (i = 0; i < 4; i++)
+	    R_DrawColumnFrom (dc[i]);
+	return;
+    }
+
+    for (i = 0; i < 4; i++)
+    {
+	part = *dc[i];
+
+	if (part.yl < yl)
+	{
+	    part.yh = yl - 1;
+	    R_DrawColumnFrom (&part);
+	}
+
+	if (dc[i]->yh > yh)
+	{
+	    part.yl = yh + 1;
+	    part.yh = dc[i]->yh;
+	    R_DrawColumnFrom (&part);
+	}
+
+	source[i] = dc[i]->source;
+	colormap[i] = dc[i]->colormap;
+	fracstep[i] = dc[i]->iscale;
+	frac[i] = dc[i]->texturemid + (yl-centery)*fracstep[i];
+    }
+
+    count = yh - yl;
+    dest = ylookup[yl] + columnofs[dc[0]->x];
+    stride = viewstride;
+
+    do
+    {
+	dest[0] = colormap[0][source[0][(frac[0]>>FRACBITS)&127]];
+	dest[1] = colormap[1][source[1][(frac[1]>>FRACBITS)&127]];
+	dest[2] = colormap[2][source[2][(frac[2]>>FRACBITS)&127]];
+	dest[3] = colormap[3][source[3][(frac[3]>>FRACBITS)&127]];
+
+	dest += stride;
+	frac[0] += fracstep[0];
+	frac[1] += fracstep[1];
+	frac[2] += fracstep[2];
+	frac[3] += fracstep[3];
+
+    } while (count--);
+}
+
 
 
 // UNUSED.
@@ -229,6 +349,7 @@ void R_DrawMVisTLColumn(void)
     byte*               dest; 
     fixed_t             frac;
     fixed_t             fracstep;
+    int                 stride;
 
     // Adjust borders. Low... 
     if (!dc_yl) 
@@ -245,8 +366,8 @@ void R_DrawMVisTLColumn(void)
         return; 
 
 #ifdef RANGECHECK 
-    if ((unsigned)dc_x >= SCREENWIDTH
-        || dc_yl < 0 || dc_yh >= SCREENHEIGHT)
+    if ((unsigned)dc_x >= viewwidth
+        || dc_yl < 0 || dc_yh >= viewheight)
     {
         I_Error ("R_DrawFuzzColumn: %i to %i at %i",
                  dc_yl, dc_yh, dc_x);
@@ -254,6 +375,7 @@ void R_DrawMVisTLColumn(void)
 #endif
     
     dest = ylookup[dc_yl] + columnofs[dc_x];
+    stride = viewstride;
 
     // Looks familiar.
     fracstep = dc_iscale; 
@@ -264,7 +386,7 @@ void R_DrawMVisTLColumn(void)
         byte src = dc_colormap[dc_source[(frac>>FRACBITS)&127]];
         byte col = xlatab[*dest + (src << 8)];
         *dest = col;
-        dest += SCREENWIDTH;
+        dest += stride;
         frac += fracstep;
     } while(count--);
 }
@@ -282,6 +404,7 @@ void R_DrawTLColumn(void)
     byte*               dest; 
     fixed_t             frac;
     fixed_t             fracstep;	 
+    int                 stride;
 
     // Adjust borders. Low... 
     if (!dc_yl) 
@@ -298,8 +421,8 @@ void R_DrawTLColumn(void)
         return; 
 
 #ifdef RANGECHECK 
-    if ((unsigned)dc_x >= SCREENWIDTH
-        || dc_yl < 0 || dc_yh >= SCREENHEIGHT)
+    if ((unsigned)dc_x >= viewwidth
+        || dc_yl < 0 || dc_yh >= viewheight)
     {
         I_Error ("R_DrawFuzzColumn2: %i to %i at %i",
                  dc_yl, dc_yh, dc_x);
@@ -307,6 +430,7 @@ void R_DrawTLColumn(void)
 #endif
     
     dest = ylookup[dc_yl] + columnofs[dc_x];
+    stride = viewstride;
 
     // Looks familiar.
     fracstep = dc_iscale; 
@@ -317,7 +441,7 @@ void R_DrawTLColumn(void)
         byte src = dc_colormap[dc_source[(frac>>FRACBITS)&127]];
         byte col = xlatab[(*dest << 8) + src];
         *dest = col;
-        dest += SCREENWIDTH;
+        dest += stride;
         frac += fracstep;
     } while(count--);
 }
@@ -342,15 +466,16 @@ void R_DrawTranslatedColumn (void)
     byte*               dest; 
     fixed_t             frac;
     fixed_t             fracstep;
+    int                 stride;
 
     count = dc_yh - dc_yl; 
     if (count < 0) 
         return; 
 
 #ifdef RANGECHECK 
-    if ((unsigned)dc_x >= SCREENWIDTH
+    if ((unsigned)dc_x >= viewwidth
         || dc_yl < 0
-        || dc_yh >= SCREENHEIGHT)
+        || dc_yh >= viewheight)
     {
         I_Error ( "R_DrawColumn: %i to %i at %i",
                  dc_yl, dc_yh, dc_x);
@@ -359,6 +484,7 @@ void R_DrawTranslatedColumn (void)
 #endif 
 
     dest = ylookup[dc_yl] + columnofs[dc_x]; 
+    stride = viewstride;
 
     // Looks familiar.
     fracstep = dc_iscale; 
@@ -373,7 +499,7 @@ void R_DrawTranslatedColumn (void)
         // Thus the "green" ramp of the player 0 sprite
         //  is mapped to gray, red, black/indigo. 
         *dest = dc_colormap[dc_translation[dc_source[frac>>FRACBITS]]];
-        dest += SCREENWIDTH;
+        dest += stride;
         frac += fracstep; 
     } while (count--); 
 } 
@@ -392,15 +518,16 @@ void R_DrawTRTLColumn(void)
     byte*               dest; 
     fixed_t             frac;
     fixed_t             fracstep;
+    int                 stride;
 
     count = dc_yh - dc_yl; 
     if (count < 0) 
         return; 
 
 #ifdef RANGECHECK 
-    if ((unsigned)dc_x >= SCREENWIDTH
+    if ((unsigned)dc_x >= viewwidth
         || dc_yl < 0
-        || dc_yh >= SCREENHEIGHT)
+        || dc_yh >= viewheight)
     {
         I_Error ( "R_DrawColumn: %i to %i at %i",
                  dc_yl, dc_yh, dc_x);
@@ -408,6 +535,7 @@ void R_DrawTRTLColumn(void)
 #endif 
 
     dest = ylookup[dc_yl] + columnofs[dc_x]; 
+    stride = viewstride;
 
     // Looks familiar.
     fracstep = dc_iscale; 
@@ -419,7 +547,7 @@ void R_DrawTRTLColumn(void)
         byte src = dc_colormap[dc_translation[dc_source[frac>>FRACBITS&127]]];
         byte col = xlatab[(*dest << 8) + src];
         *dest = col;
-        dest += SCREENWIDTH;
+        dest += stride;
         frac += fracstep; 
     } while (count--); 
 }
@@ -588,17 +716,13 @@ int			dscount;
 // Draws the actual span.
 void R_DrawSpan (void) 
 { 
-    unsigned int position, step;
-    byte *dest;
-    int count;
-    int spot;
-    unsigned int xtemp, ytemp;
+    drawspan_t ds;
 
 #ifdef RANGECHECK
     if (ds_x2 < ds_x1
 	|| ds_x1<0
-	|| ds_x2>=SCREENWIDTH
-	|| (unsigned)ds_y>SCREENHEIGHT)
+	|| ds_x2>=viewwidth
+	|| (unsigned)ds_y>viewheight)
     {
 	I_Error( "R_DrawSpan: %i to %i at %i",
 		 ds_x1,ds_x2,ds_y);
@@ -606,22 +730,84 @@ void R_DrawSpan (void)
 //	dscount++;
 #endif
 
+    ds.colormap = ds_colormap;
+    ds.source = ds_source;
+    ds.y = ds_y;
+    ds.x1 = ds_x1;
+    ds.x2 = ds_x2;
+    ds.xfrac = ds_xfrac;
+    ds.yfrac = ds_yfrac;
+    ds.xstep = ds_xstep;
+    ds.ystep = ds_ystep;
+
+    R_DrawSpanFrom (&ds, ds_x1, ds_x2);
+}
+
+//
+// R_DrawSpanFrom
+// [SVE] The R_DrawSpan inner loop for the part of a drawspan_t
+// between x1 and x2. The packed position is advanced to x1 with a
+// single multiply, which wraps exactly the same way as stepping one
+// pixel at a time, so a span drawn in pieces by several render strip
+// workers matches the one drawn whole.
+//
+void R_DrawSpanFrom (const drawspan_t *ds, int x1, int x2) 
+{ 
+    unsigned int position, step;
+    byte *dest;
+    byte *source;
+    lighttable_t *colormap;
+    int count;
+    int spot;
+    unsigned int xtemp, ytemp;
+
     // Pack position and step variables into a single 32-bit integer,
     // with x in the top 16 bits and y in the bottom 16 bits.  For
     // each 16-bit part, the top 6 bits are the integer part and the
     // bottom 10 bits are the fractional part of the pixel position.
 
-    position = ((ds_xfrac << 10) & 0xffff0000)
-             | ((ds_yfrac >> 6)  & 0x0000ffff);
-    step = ((ds_xstep << 10) & 0xffff0000)
-         | ((ds_ystep >> 6)  & 0x0000ffff);
+    position = ((ds->xfrac << 10) & 0xffff0000)
+             | ((ds->yfrac >> 6)  & 0x0000ffff);
+    step = ((ds->xstep << 10) & 0xffff0000)
+         | ((ds->ystep >> 6)  & 0x0000ffff);
 
-    dest = ylookup[ds_y] + columnofs[ds_x1];
+    position += (unsigned int)(x1 - ds->x1) * step;
+
+    dest = ylookup[ds->y] + columnofs[x1];
+    source = ds->source;
+    colormap = ds->colormap;
 
     // We do not check for zero spans here?
-    count = ds_x2 - ds_x1;
+    count = x2 - x1 + 1;
 
-    do
+    // [SVE] four pixels at a time, then the rest
+    while (count >= 4)
+    {
+        ytemp = (position >> 4) & 0x0fc0;
+        xtemp = (position >> 26);
+        dest[0] = colormap[source[xtemp | ytemp]];
+        position += step;
+
+        ytemp = (position >> 4) & 0x0fc0;
+        xtemp = (position >> 26);
+        dest[1] = colormap[source[xtemp | ytemp]];
+        position += step;
+
+        ytemp = (position >> 4) & 0x0fc0;
+        xtemp = (position >> 26);
+        dest[2] = colormap[source[xtemp | ytemp]];
+        position += step;
+
+        ytemp = (position >> 4) & 0x0fc0;
+        xtemp = (position >> 26);
+        dest[3] = colormap[source[xtemp | ytemp]];
+        position += step;
+
+        dest += 4;
+        count -= 4;
+    }
+
+    while (count-- > 0)
     {
 	// Calculate current texture index in u,v.
         ytemp = (position >> 4) & 0x0fc0;
@@ -630,11 +816,10 @@ void R_DrawSpan (void)
 
 	// Lookup pixel from flat texture tile,
 	//  re-index using light/colormap.
-	*dest++ = ds_colormap[ds_source[spot]];
+	*dest++ = colormap[source[spot]];
 
         position += step;
-
-    } while (count--);
+    }
 }
 
 
@@ -772,6 +957,54 @@ void R_DrawSpanLow (void)
 //  for getting the framebuffer address
 //  of a pixel to draw.
 //
+// [SVE] The first renderbuffer pixel that is at or right of / below
+// screen pixel x / y; with no renderbuffer these are just x and y.
+#define RENDERX(x)	(((x)*renderwidth + SCREENWIDTH-1) / SCREENWIDTH)
+#define RENDERY(y)	(((y)*renderheight + SCREENHEIGHT-1) / SCREENHEIGHT)
+
+//
+// R_InitRenderBuffer
+// [SVE] Sets up renderbuffer for render_width x render_height, or does
+// away with it if the view is to be drawn straight to the screen.
+//
+static void R_InitRenderBuffer (void)
+{
+    int		width;
+    int		height;
+
+    width = SCREENWIDTH;
+    height = SCREENHEIGHT;
+
+    // the GL renderer draws the view itself
+    if (!use3drenderer && r_renderwidth > 0 && r_renderheight > 0)
+    {
+	width = BETWEEN(SCREENWIDTH, MAXRENDERWIDTH, r_renderwidth);
+	height = BETWEEN(SCREENHEIGHT, MAXRENDERHEIGHT, r_renderheight);
+    }
+
+    if (renderbuffer && (width != renderwidth || height != renderheight))
+    {
+	Z_Free (renderbuffer);
+	renderbuffer = NULL;
+    }
+
+    renderwidth = width;
+    renderheight = height;
+
+    if (width == SCREENWIDTH && height == SCREENHEIGHT)
+    {
+	viewimage = I_VideoBuffer;
+	viewstride = SCREENWIDTH;
+	return;
+    }
+
+    if (!renderbuffer)
+	renderbuffer = Z_Malloc (width * height, PU_STATIC, NULL);
+
+    viewimage = renderbuffer;
+    viewstride = width;
+}
+
 void
 R_InitBuffer
 ( int		width,
@@ -784,20 +1017,75 @@ R_InitBuffer
     //  with border and/or status bar.
     viewwindowx = (SCREENWIDTH-width) >> 1; 
 
-    // Column offset. For windows.
-    for (i=0 ; i<width ; i++) 
-	columnofs[i] = viewwindowx + i;
-
     // Samw with base row offset.
     if (width == SCREENWIDTH) 
 	viewwindowy = 0; 
     else 
 	viewwindowy = (SCREENHEIGHT-SBARHEIGHT-height) >> 1; 
 
+    // [SVE] the same part of the screen, in renderbuffer pixels
+    R_InitRenderBuffer ();
+
+    renderwindowx = RENDERX(viewwindowx);
+    renderwindowy = RENDERY(viewwindowy);
+    width = RENDERX(viewwindowx + width) - renderwindowx;
+    height = RENDERY(viewwindowy + height) - renderwindowy;
+
+    viewwidth = width>>detailshift;
+    viewheight = height;
+
+    // Column offset. For windows.
+    for (i=0 ; i<width ; i++) 
+	columnofs[i] = renderwindowx + i;
+
     // Preclaculate all row offsets.
     for (i=0 ; i<height ; i++) 
-	ylookup[i] = I_VideoBuffer + (i+viewwindowy)*SCREENWIDTH; 
+	ylookup[i] = viewimage + (i+renderwindowy)*viewstride; 
 } 
+
+//
+// R_FinishView
+// [SVE] Once the view is drawn into renderbuffer, puts a 320x200 copy
+// of it on the screen for everything that reads the screen back, and
+// hands it to I_FinishUpdate to be shown in place of that copy.
+//
+void R_FinishView (void)
+{
+    static int	xmap[SCREENWIDTH];
+    byte*	src;
+    byte*	dest;
+    int		x1;
+    int		x2;
+    int		x;
+    int		y;
+
+    if (!renderbuffer)
+	return;
+
+    // the middle of each screen pixel, kept inside the view
+    x1 = viewwindowx;
+    x2 = viewwindowx + scaledviewwidth;
+
+    for (x = x1 ; x < x2 ; x++)
+    {
+	xmap[x] = ((2*x + 1) * renderwidth) / (2*SCREENWIDTH);
+	xmap[x] = BETWEEN(renderwindowx, renderwindowx + viewwidth - 1, xmap[x]);
+    }
+
+    for (y = viewwindowy ; y < viewwindowy + scaledviewheight ; y++)
+    {
+	src = ylookup[BETWEEN(0, viewheight - 1,
+			      ((2*y + 1) * renderheight) / (2*SCREENHEIGHT)
+			      - renderwindowy)];
+	dest = I_VideoBuffer + y*SCREENWIDTH;
+
+	for (x = x1 ; x < x2 ; x++)
+	    dest[x] = src[xmap[x]];
+    }
+
+    I_SetViewLayer (renderbuffer, renderwidth, renderheight,
+		    viewwindowx, viewwindowy, scaledviewwidth, scaledviewheight);
+}
  
  
 
@@ -878,14 +1166,14 @@ void R_FillBackScreen (void)
     patch = W_CacheLumpName(DEH_String("brdr_b"),PU_CACHE);
 
     for (x=0 ; x<scaledviewwidth ; x+=8)
-	V_DrawPatch(viewwindowx+x, viewwindowy+viewheight, patch);
+	V_DrawPatch(viewwindowx+x, viewwindowy+scaledviewheight, patch);
     patch = W_CacheLumpName(DEH_String("brdr_l"),PU_CACHE);
 
-    for (y=0 ; y<viewheight ; y+=8)
+    for (y=0 ; y<scaledviewheight ; y+=8)
 	V_DrawPatch(viewwindowx-8, viewwindowy+y, patch);
     patch = W_CacheLumpName(DEH_String("brdr_r"),PU_CACHE);
 
-    for (y=0 ; y<viewheight ; y+=8)
+    for (y=0 ; y<scaledviewheight ; y+=8)
 	V_DrawPatch(viewwindowx+scaledviewwidth, viewwindowy+y, patch);
 
     // Draw beveled edge. 
@@ -898,11 +1186,11 @@ void R_FillBackScreen (void)
                 W_CacheLumpName(DEH_String("brdr_tr"),PU_CACHE));
     
     V_DrawPatch(viewwindowx-8,
-                viewwindowy+viewheight,
+                viewwindowy+scaledviewheight,
                 W_CacheLumpName(DEH_String("brdr_bl"),PU_CACHE));
     
     V_DrawPatch(viewwindowx+scaledviewwidth,
-                viewwindowy+viewheight,
+                viewwindowy+scaledviewheight,
                 W_CacheLumpName(DEH_String("brdr_br"),PU_CACHE));
 
     V_RestoreBuffer();
@@ -945,21 +1233,21 @@ void R_DrawViewBorder (void)
     if (scaledviewwidth == SCREENWIDTH) 
 	return; 
   
-    top = ((SCREENHEIGHT-SBARHEIGHT)-viewheight)/2; 
+    top = ((SCREENHEIGHT-SBARHEIGHT)-scaledviewheight)/2; 
     side = (SCREENWIDTH-scaledviewwidth)/2; 
  
     // copy top and one line of left side 
     R_VideoErase (0, top*SCREENWIDTH+side); 
  
     // copy one line of right side and bottom 
-    ofs = (viewheight+top)*SCREENWIDTH-side; 
+    ofs = (scaledviewheight+top)*SCREENWIDTH-side; 
     R_VideoErase (ofs, top*SCREENWIDTH+side); 
  
     // copy sides using wraparound 
     ofs = top*SCREENWIDTH + SCREENWIDTH-side; 
     side <<= 1;
     
-    for (i=1 ; i<viewheight ; i++) 
+    for (i=1 ; i<scaledviewheight ; i++) 
     { 
 	R_VideoErase (ofs, side); 
 	ofs += SCREENWIDTH; 
@@ -33,11 +33,39 @@ extern fixed_t		dc_texturemid;
 // first pixel in a column
 extern byte*		dc_source;		
 
+// [SVE] A column or span with its parameters captured so that it can
+// be drawn later, by a render strip worker (see r_strips.c)
+typedef struct
+{
+    lighttable_t	*colormap;
+    byte		*source;
+    int			x;
+    int			yl;
+    int			yh;
+    fixed_t		iscale;
+    fixed_t		texturemid;
+} drawcolumn_t;
+
+typedef struct
+{
+    lighttable_t	*colormap;
+    byte		*source;
+    int			y;
+    int			x1;
+    int			x2;
+    fixed_t		xfrac;
+    fixed_t		yfrac;
+    fixed_t		xstep;
+    fixed_t		ystep;
+} drawspan_t;
+
 
 // The span blitting interface.
 // Hook in assembler or system specific BLT
 //  here.
 void 	R_DrawColumn (void);
+void 	R_DrawColumnFrom (const drawcolumn_t *dc);
+void 	R_DrawColumn4From (const drawcolumn_t *const *dc);
 void 	R_DrawColumnLow (void);
 
 // The Spectre/Invisibility effect.
@@ -83,6 +111,7 @@ extern char *back_flat; // haleyjd 08/29/10: [STRIFE]
 // Span blitting for rows, floor/ceiling.
 // No Sepctre effect needed.
 void 	R_DrawSpan (void);
+void 	R_DrawSpanFrom (const drawspan_t *ds, int x1, int x2);
 
 // Low resolution mode, 160x200?
 void 	R_DrawSpanLow (void);
@@ -93,6 +122,18 @@ R_InitBuffer
 ( int		width,
   int		height );
 
+// [SVE] Size to draw the view at (render_width / render_height in the
+// config), and the size it was set up with. viewstride is the distance
+// between rows of the view, which can be wider than the screen.
+extern int		r_renderwidth;
+extern int		r_renderheight;
+extern int		renderwidth;
+extern int		renderheight;
+extern int		viewstride;
+
+// [SVE] Shows a view drawn at a higher resolution than the screen.
+void R_FinishView (void);
+
 
 // Initialize color translation tables,
 //  for player rendering etc.
@@ -66,6 +66,14 @@ fixed_t			centerxfrac;
 fixed_t			centeryfrac;
 fixed_t			projection;
 
+// [SVE] A renderbuffer pixel needn't be the shape of a screen pixel,
+// so heights are projected on their own. viewaspect is how much more
+// the view is scaled up vertically than across, and scalelightmul
+// brings scales back to the 320x200 screen's for picking a light level.
+fixed_t			projectiony;
+fixed_t			viewaspect;
+fixed_t			scalelightmul;
+
 // just for profiling purposes
 int			framecount;	
 
@@ -105,7 +113,7 @@ int			viewangletox[FINEANGLES/2];
 // The xtoviewangleangle[] table maps a screen pixel
 // to the lowest viewangle that maps back to x ranges
 // from clipangle to -clipangle.
-angle_t			xtoviewangle[SCREENWIDTH+1];
+angle_t			xtoviewangle[MAXRENDERWIDTH+1];
 
 lighttable_t*		scalelight[LIGHTLEVELS][MAXLIGHTSCALE];
 lighttable_t*		scalelightfixed[MAXLIGHTSCALE];
@@ -489,7 +497,7 @@ fixed_t R_ScaleFromGlobalAngle (angle_t visangle)
     // both sines are allways positive
     sinea = finesine[anglea>>ANGLETOFINESHIFT];	
     sineb = finesine[angleb>>ANGLETOFINESHIFT];
-    num = FixedMul(projection,sineb)<<detailshift;
+    num = FixedMul(projectiony,sineb)<<detailshift;
     den = FixedMul(rw_distance,sinea);
 
     if (den > num>>16)
@@ -688,26 +696,35 @@ void R_ExecuteSetViewSize (void)
     if (setblocks == 11)
     {
 	scaledviewwidth = SCREENWIDTH;
-	viewheight = SCREENHEIGHT;
+	scaledviewheight = SCREENHEIGHT;
     }
     else
     {
 	scaledviewwidth = setblocks*32;
-	viewheight = (setblocks*168/10)&~7;
+	scaledviewheight = (setblocks*168/10)&~7;
     }
     
     detailshift = setdetail;
-    viewwidth = scaledviewwidth>>detailshift;
+
+    // [SVE] sets viewwidth and viewheight, in renderbuffer pixels
+    R_InitBuffer (scaledviewwidth, scaledviewheight);
 	
     // villsa [STRIFE] calculate centery from player's pitch
+    // [SVE] the pitch is in screen pixels
     centery = (setblocks*(players[consoleplayer].pitch>>FRACBITS));
-    centery = (unsigned int)(centery/10)+viewheight/2;
+    centery = (centery/10)*viewheight/scaledviewheight+viewheight/2;
 
     centerx = viewwidth/2;
     centerxfrac = centerx<<FRACBITS;
     centeryfrac = centery<<FRACBITS;
     projection = centerxfrac;
 
+    // [SVE] same as projection unless the renderbuffer is stretched
+    viewaspect = FixedDiv(renderheight*SCREENWIDTH, renderwidth*SCREENHEIGHT);
+    projectiony = FixedMul(projection, viewaspect);
+    scalelightmul = FixedDiv((scaledviewwidth>>detailshift)/2*FRACUNIT,
+			     projectiony);
+
     //if (!detailshift) // villsa [STRIFE]
     {
 	colfunc = basecolfunc = R_DrawColumn;
@@ -724,13 +741,13 @@ void R_ExecuteSetViewSize (void)
 	spanfunc = R_DrawSpanLow;
     }*/
 
-    R_InitBuffer (scaledviewwidth, viewheight);
-	
     R_InitTextureMapping ();
     
     // psprite scales
     pspritescale = FRACUNIT*viewwidth/SCREENWIDTH;
     pspriteiscale = FRACUNIT*SCREENWIDTH/viewwidth;
+    pspriteyscale = FixedMul(pspritescale, viewaspect);
+    pspriteyiscale = FixedDiv(pspriteiscale, viewaspect);
     
     // thing clipping
     for (i=0 ; i<viewwidth ; i++)
@@ -742,7 +759,7 @@ void R_ExecuteSetViewSize (void)
 	// haleyjd 20120208: [STRIFE] viewheight/2 -> centery, accounts for up/down look
         dy = ((i - centery)<<FRACBITS) + FRACUNIT/2;
 	dy = abs(dy);
-	yslope[i] = FixedDiv ( (viewwidth<<detailshift)/2*FRACUNIT, dy);
+	yslope[i] = FixedDiv (projectiony<<detailshift, dy);
     }
 	
     for (i=0 ; i<viewwidth ; i++)
@@ -758,7 +775,8 @@ void R_ExecuteSetViewSize (void)
 	startmap = ((LIGHTLEVELS-1-i)*2)*NUMCOLORMAPS/LIGHTLEVELS;
 	for (j=0 ; j<MAXLIGHTSCALE ; j++)
 	{
-	    level = startmap - j*SCREENWIDTH/(viewwidth<<detailshift)/DISTMAP;
+	    // [SVE] j is on the screen's scale, see scalelightmul
+	    level = startmap - j*SCREENWIDTH/scaledviewwidth/DISTMAP;
 	    
 	    if (level < 0)
 		level = 0;
@@ -876,12 +894,12 @@ void R_SetupPitch(player_t* player)
         }
         
         pitchfrac   = (setblocks * (viewpitch>>FRACBITS)) / 10;
-        centery     = pitchfrac + viewheight / 2;
+        centery     = pitchfrac * viewheight / scaledviewheight + viewheight / 2;
         centeryfrac = centery << FRACBITS;
 
         for(i = 0; i < viewheight; i++)
         {
-            yslope[i] = FixedDiv(viewwidth / 2 * FRACUNIT,
+            yslope[i] = FixedDiv(projectiony,
                                  abs(((i - centery) << FRACBITS) + (FRACUNIT/2)));
         }
     }
@@ -1087,6 +1105,9 @@ void R_RenderPlayerView (player_t* player)
     // check for new console commands.
     NetUpdate ();
 
+    // [SVE] record walls and flats for the strip workers
+    R_BeginStrips ();
+
     // The head node is the last node output.
     R_RenderBSPNode (numnodes-1);
     
@@ -1094,12 +1115,17 @@ void R_RenderPlayerView (player_t* player)
     NetUpdate ();
     
     R_DrawPlanes ();
+
+    R_FinishStrips ();
     
     // Check for new console commands.
     NetUpdate ();
     
     R_DrawMasked ();
 
+    // [SVE] show the view if it went into the renderbuffer
+    R_FinishView ();
+
     // haleyjd 20140904: [SVE] remove sector interpolations
     if(viewlerp != FRACUNIT)
         R_SetSectorInterpolationState(SEC_NORMAL);
@@ -44,6 +44,9 @@ extern int		centery;
 extern fixed_t		centerxfrac;
 extern fixed_t		centeryfrac;
 extern fixed_t		projection;
+extern fixed_t		projectiony;
+extern fixed_t		viewaspect;
+extern fixed_t		scalelightmul;
 
 extern int		validcount;
 
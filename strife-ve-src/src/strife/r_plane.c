@@ -45,10 +45,14 @@ planefunction_t		ceilingfunc;
 // Here comes the obnoxious "visplane".
 // haleyjd 20100829: [STRIFE] MAXVISPLANES increased to 200
 // haleyjd 20140831: [SVE] removed limit; shoutouts to Lee Killough
+// [SVE] the hash starts at MINVISPLANEHASH chains and is doubled by
+// R_ClearPlanes whenever the last frame used more planes than chains
 #define NUMINITVISPLANES   200
-#define MAXVISPLANES	   128
+#define MINVISPLANEHASH	   128
 visplane_t   initvisplanes[NUMINITVISPLANES];
-visplane_t  *visplanes[MAXVISPLANES];
+visplane_t **visplanes;
+unsigned int numvisplanehash;
+unsigned int numvisplanesused;
 visplane_t  *freetail;
 visplane_t **freehead = &freetail;
 
@@ -58,13 +62,15 @@ visplane_t *ceilingplane;
 #define planehash(pic, light, height) \
     (((unsigned)(pic)*3 +             \
       (unsigned)(light) +             \
-      (unsigned)(height >> 16)*7) & (MAXVISPLANES - 1))
+      (unsigned)(height >> 16)*7) & (numvisplanehash - 1))
 
 // ?
 // haleyjd 20140831: [SVE] MAXOPENINGS raised to proper limit
+// [SVE] now only the starting size; R_StoreWallRange grows it
 #define MAXOPENINGS	SCREENWIDTH*SCREENHEIGHT
-short			openings[MAXOPENINGS];
+short*			openings;
 short*			lastopening;
+unsigned int		maxopenings;
 
 
 //
@@ -72,15 +78,15 @@ short*			lastopening;
 //  floorclip starts out SCREENHEIGHT
 //  ceilingclip starts out -1
 //
-short			floorclip[SCREENWIDTH];
-short			ceilingclip[SCREENWIDTH];
+short			floorclip[MAXRENDERWIDTH];
+short			ceilingclip[MAXRENDERWIDTH];
 
 //
 // spanstart holds the start of a plane span
 // initialized to 0 at start
 //
-int			spanstart[SCREENHEIGHT];
-int			spanstop[SCREENHEIGHT];
+int			spanstart[MAXRENDERHEIGHT];
+int			spanstop[MAXRENDERHEIGHT];
 
 //
 // texture mapping
@@ -88,15 +94,36 @@ int			spanstop[SCREENHEIGHT];
 lighttable_t**		planezlight;
 fixed_t			planeheight;
 
-fixed_t			yslope[SCREENHEIGHT];
-fixed_t			distscale[SCREENWIDTH];
+fixed_t			yslope[MAXRENDERHEIGHT];
+fixed_t			distscale[MAXRENDERWIDTH];
 fixed_t			basexscale;
 fixed_t			baseyscale;
 
-fixed_t			cachedheight[SCREENHEIGHT];
-fixed_t			cacheddistance[SCREENHEIGHT];
-fixed_t			cachedxstep[SCREENHEIGHT];
-fixed_t			cachedystep[SCREENHEIGHT];
+fixed_t			cachedheight[MAXRENDERHEIGHT];
+fixed_t			cacheddistance[MAXRENDERHEIGHT];
+fixed_t			cachedxstep[MAXRENDERHEIGHT];
+fixed_t			cachedystep[MAXRENDERHEIGHT];
+
+//
+// [SVE] Row tables for each distinct plane height in the frame, so
+// planes at the same height share their distances and steps however
+// they are ordered in the hash. The per row cache above is only used
+// once the tables run out.
+//
+#define MAXPLANEROWS		32
+
+typedef struct
+{
+    fixed_t		height;
+    fixed_t		distance[MAXRENDERHEIGHT];
+    fixed_t		xstep[MAXRENDERHEIGHT];
+    fixed_t		ystep[MAXRENDERHEIGHT];
+    boolean		cached[MAXRENDERHEIGHT];
+} planerows_t;
+
+static planerows_t	planerows[MAXPLANEROWS];
+static int		numplanerows;
+static planerows_t*	curplanerows;
 
 
 
@@ -108,6 +135,9 @@ void R_InitPlanes(void)
 {
     int i = 0;
 
+    numvisplanehash = MINVISPLANEHASH;
+    visplanes = Z_Calloc(numvisplanehash, sizeof(*visplanes), PU_STATIC, NULL);
+
     // haleyjd 20140831: [SVE] add init planes to the visplane hash;
     // R_ClearPlanes will move them to the free list the first time it runs.
     for(; i < NUMINITVISPLANES; i++)
@@ -149,7 +179,21 @@ R_MapPlane
     }
 #endif
 
-    if (planeheight != cachedheight[y])
+    if (curplanerows)
+    {
+        if (!curplanerows->cached[y])
+        {
+            curplanerows->cached[y] = true;
+            distance = curplanerows->distance[y] = FixedMul (planeheight, yslope[y]);
+            curplanerows->xstep[y] = FixedMul (distance,basexscale);
+            curplanerows->ystep[y] = FixedMul (distance,baseyscale);
+        }
+
+        distance = curplanerows->distance[y];
+        ds_xstep = curplanerows->xstep[y];
+        ds_ystep = curplanerows->ystep[y];
+    }
+    else if (planeheight != cachedheight[y])
     {
         cachedheight[y] = planeheight;
         distance = cacheddistance[y] = FixedMul (planeheight, yslope[y]);
@@ -206,16 +250,35 @@ void R_ClearPlanes (void)
     }
 
     // haleyjd 20140831: [SVE] free visplanes
-    for(i = 0; i < MAXVISPLANES; i++)
+    for(i = 0; i < numvisplanehash; i++)
     {
         for(*freehead = visplanes[i], visplanes[i] = NULL; *freehead; )
             freehead = &(*freehead)->next;
     }
 
+    // [SVE] keep the chains short as the planes per frame go up
+    if (numvisplanesused > numvisplanehash)
+    {
+        while (numvisplanehash < numvisplanesused)
+            numvisplanehash *= 2;
+
+        Z_Free(visplanes);
+        visplanes = Z_Calloc(numvisplanehash, sizeof(*visplanes), PU_STATIC, NULL);
+    }
+
+    numvisplanesused = 0;
+
+    if (!openings)
+    {
+        maxopenings = MAXOPENINGS;
+        openings = Z_Malloc(maxopenings * sizeof(*openings), PU_STATIC, NULL);
+    }
+
     lastopening = openings;
 
     // texture calculation
-    memset (cachedheight, 0, sizeof(cachedheight));
+    memset (cachedheight, 0, viewheight * sizeof(*cachedheight));
+    numplanerows = 0;
 
     // left to right mapping
     angle = (viewangle-ANG90)>>ANGLETOFINESHIFT;
@@ -228,6 +291,7 @@ void R_ClearPlanes (void)
 static visplane_t *R_newVisplane(unsigned int hash)
 {
     visplane_t *check = freetail;
+    numvisplanesused++;
     if(!check)
         check = Z_Calloc(1, sizeof(visplane_t), PU_STATIC, NULL);
     else if(!(freetail = freetail->next))
@@ -273,10 +337,11 @@ R_FindPlane
     check->height = height;
     check->picnum = picnum;
     check->lightlevel = lightlevel;
-    check->minx = SCREENWIDTH;
+    check->minx = viewwidth;
     check->maxx = -1;
 
-    memset (check->top,0xff,sizeof(check->top));
+    // [SVE] only the columns in the view are ever looked at
+    memset (check->top,0xff,viewwidth*sizeof(*check->top));
 
     return check;
 }
@@ -321,7 +386,7 @@ R_CheckPlane
 
     for (x=intrl ; x<= intrh ; x++)
     {
-        if (pl->top[x] != 0xff)
+        if (pl->top[x] != VISPLANEEMPTY)
             break;
     }
 
@@ -344,13 +409,40 @@ R_CheckPlane
         pl = npl;
         pl->minx = start;
         pl->maxx = stop;
-        memset(pl->top, 0xff, sizeof(pl->top));
+        memset(pl->top, 0xff, viewwidth*sizeof(*pl->top));
     }
 
     return pl;		
 }
 
 
+//
+// R_GetPlaneRows
+// [SVE] Finds or starts the row tables for a plane height,
+// or returns NULL once they have all been taken.
+//
+static planerows_t *R_GetPlaneRows (fixed_t height)
+{
+    planerows_t*	rows;
+    int			i;
+
+    for (i = 0; i < numplanerows; i++)
+    {
+        if (planerows[i].height == height)
+            return &planerows[i];
+    }
+
+    if (numplanerows == MAXPLANEROWS)
+        return NULL;
+
+    rows = &planerows[numplanerows++];
+    rows->height = height;
+    memset (rows->cached, 0, sizeof(rows->cached));
+
+    return rows;
+}
+
+
 //
 // R_MakeSpans
 //
@@ -401,7 +493,7 @@ void R_DrawPlanes (void)
     int			angle;
     int                 lumpnum;
 
-    for(i = 0; i < MAXVISPLANES; i++)
+    for(i = 0; i < numvisplanehash; i++)
     {
         for(pl = visplanes[i]; pl; pl = pl->next)
         {
@@ -411,7 +503,7 @@ void R_DrawPlanes (void)
             // sky flat
             if (pl->picnum == skyflatnum)
             {
-                dc_iscale = pspriteiscale>>detailshift;
+                dc_iscale = pspriteyiscale>>detailshift;
 
                 // Sky is allways drawn full bright,
                 //  i.e. colormaps[0] is used.
@@ -440,6 +532,7 @@ void R_DrawPlanes (void)
             ds_source = W_CacheLumpNum(lumpnum, PU_STATIC);
 
             planeheight = abs(pl->height-viewz);
+            curplanerows = R_GetPlaneRows(planeheight);
             light = (pl->lightlevel >> LIGHTSEGSHIFT)+extralight;
 
             if (light >= LIGHTLEVELS)
@@ -450,8 +543,8 @@ void R_DrawPlanes (void)
 
             planezlight = zlight[light];
 
-            pl->top[pl->maxx+1] = 0xff;
-            pl->top[pl->minx-1] = 0xff;
+            pl->top[pl->maxx+1] = VISPLANEEMPTY;
+            pl->top[pl->minx-1] = VISPLANEEMPTY;
 
             stop = pl->maxx + 1;
 
@@ -463,7 +556,9 @@ void R_DrawPlanes (void)
                             pl->bottom[x]);
             }
 
-            W_ReleaseLumpNum(lumpnum);
+            R_ReleaseStripLump(lumpnum);
         }
     }
+
+    curplanerows = NULL;
 }
@@ -26,7 +26,9 @@
 
 
 // Visplane related.
+extern  short*		openings;
 extern  short*		lastopening;
+extern  unsigned int	maxopenings;
 
 
 typedef void (*planefunction_t) (int top, int bottom);
@@ -34,11 +36,11 @@ typedef void (*planefunction_t) (int top, int bottom);
 extern planefunction_t	floorfunc;
 extern planefunction_t	ceilingfunc_t;
 
-extern short		floorclip[SCREENWIDTH];
-extern short		ceilingclip[SCREENWIDTH];
+extern short		floorclip[MAXRENDERWIDTH];
+extern short		ceilingclip[MAXRENDERWIDTH];
 
-extern fixed_t		yslope[SCREENHEIGHT];
-extern fixed_t		distscale[SCREENWIDTH];
+extern fixed_t		yslope[MAXRENDERHEIGHT];
+extern fixed_t		distscale[MAXRENDERWIDTH];
 
 void R_InitPlanes (void);
 void R_ClearPlanes (void);
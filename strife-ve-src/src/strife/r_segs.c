@@ -169,7 +169,7 @@ R_RenderMaskedSegRange
 	{
 	    if (!fixedcolormap)
 	    {
-		index = spryscale>>LIGHTSCALESHIFT;
+		index = FixedMul(spryscale, scalelightmul)>>LIGHTSCALESHIFT;
 
 		if (index >=  MAXLIGHTSCALE )
 		    index = MAXLIGHTSCALE-1;
@@ -270,7 +270,7 @@ void R_RenderSegLoop (void)
 	    texturecolumn = rw_offset-FixedMul(finetangent[angle],rw_distance);
 	    texturecolumn >>= FRACBITS;
 	    // calculate lighting
-	    index = rw_scale>>LIGHTSCALESHIFT;
+	    index = FixedMul(rw_scale, scalelightmul)>>LIGHTSCALESHIFT;
 
 	    if (index >=  MAXLIGHTSCALE )
 		index = MAXLIGHTSCALE-1;
@@ -376,6 +376,52 @@ void R_RenderSegLoop (void)
 
 
 
+//
+// R_MoveOpening
+// [SVE] Moves a clip array saved in a drawseg across when openings is
+// reallocated. They point at x1 into their part of openings, unless
+// they're NULL or one of the constant arrays, which are left alone.
+//
+static short *R_MoveOpening (short *clip, int x1, short *oldopenings)
+{
+    if (clip && clip + x1 >= oldopenings && clip + x1 < oldopenings + maxopenings)
+	return openings + (clip - oldopenings);
+
+    return clip;
+}
+
+//
+// R_CheckOpenings
+// [SVE] Makes sure there's room for count more openings.
+//
+static void R_CheckOpenings (int count)
+{
+    short	*oldopenings;
+    drawseg_t	*ds;
+    unsigned int newmax;
+
+    if (lastopening + count <= openings + maxopenings)
+	return;
+
+    newmax = maxopenings;
+
+    while (newmax < (lastopening - openings) + count)
+	newmax *= 2;
+
+    oldopenings = openings;
+    openings = Z_Realloc(openings, newmax * sizeof(*openings), PU_STATIC, NULL);
+    lastopening = openings + (lastopening - oldopenings);
+
+    for (ds = drawsegs; ds < ds_p; ds++)
+    {
+	ds->sprtopclip = R_MoveOpening (ds->sprtopclip, ds->x1, oldopenings);
+	ds->sprbottomclip = R_MoveOpening (ds->sprbottomclip, ds->x1, oldopenings);
+	ds->maskedtexturecol = R_MoveOpening (ds->maskedtexturecol, ds->x1, oldopenings);
+    }
+
+    maxopenings = newmax;
+}
+
 //
 // R_StoreWallRange
 // A wall segment will be drawn
@@ -404,6 +450,10 @@ R_StoreWallRange
         ds_p = drawsegs + maxdrawsegs;
         maxdrawsegs = newmax;
     }
+
+    // [SVE] remove openings limit; the masked columns and both
+    // sprite clips take at most one entry per column each
+    R_CheckOpenings (3 * (stop - start + 1));
 		
 #ifdef RANGECHECK
     if (start >=viewwidth || start > stop)
@@ -47,6 +47,7 @@ extern lighttable_t*    colormaps;
 extern int      viewwidth;
 extern int      scaledviewwidth;
 extern int      viewheight;
+extern int      scaledviewheight;
 
 extern int      firstflat;
 
@@ -116,7 +117,7 @@ extern fixed_t viewlerp; // haleyjd [SVE]
 extern angle_t      clipangle;
 
 extern int      viewangletox[FINEANGLES/2];
-extern angle_t      xtoviewangle[SCREENWIDTH+1];
+extern angle_t      xtoviewangle[MAXRENDERWIDTH+1];
 //extern fixed_t        finetangent[FINEANGLES/2];
 
 extern fixed_t      rw_distance;
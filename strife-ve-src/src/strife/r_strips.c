@@ -0,0 +1,349 @@
+//
+// Copyright(C) 2014 Night Dive Studios, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	[SVE] Multithreaded wall and flat drawing in screen strips.
+//
+//	While the BSP is walked and the visplanes are drawn, colfunc and
+//	spanfunc are pointed at functions that record each column and span
+//	instead of drawing it. The view is split into vertical strips, and
+//	every record goes into the list of each strip it touches, with spans
+//	that cross a strip edge going into both. The strips are then drawn
+//	by the worker threads. Strips never share a pixel and each strip
+//	draws its records in the order they were made, so every pixel is
+//	written by the same draws in the same order as the single threaded
+//	renderer and the frame is byte for byte the same.
+//
+//	Clipping, visplane building and sprites stay on the main thread.
+//	Masked walls and sprites are drawn afterwards by R_DrawMasked as
+//	before, since they read what the walls left behind.
+//
+//	A run of columns at x to x+3, as a wall or the sky gives, is drawn
+//	four at a time by R_DrawColumn4From. Two sided walls record an
+//	upper and a lower column at each x, so runs of those are split into
+//	the two sets of four. Columns at different x never share a pixel,
+//	so drawing them in another order leaves the same frame. This pays
+//	off in wide views, which is why the strips are also recorded there
+//	when there are no worker threads to draw them.
+//
+
+#include <stdlib.h>
+
+#include "doomdef.h"
+#include "i_system.h"
+#include "i_thread.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+#include "r_local.h"
+#include "r_strips.h"
+
+#define MAXSTRIPS		64
+
+// strips per thread, to even out the load between
+// busy and empty parts of the view
+#define STRIPSPERTHREAD		4
+
+typedef struct
+{
+    boolean		isspan;
+    union
+    {
+	drawcolumn_t	column;
+	drawspan_t	span;
+    } u;
+} stripcmd_t;
+
+typedef struct
+{
+    int			x1;
+    int			x2;
+    stripcmd_t		*cmds;
+    int			numcmds;
+    int			maxcmds;
+} strip_t;
+
+int			r_renderthreads = 0;
+
+static strip_t		strips[MAXSTRIPS];
+static int		numstrips;
+static byte		stripforx[MAXRENDERWIDTH];
+static boolean		stripsactive;
+
+// flats can't go back to the cache until their spans are drawn
+static int		*striplumps;
+static int		numstriplumps;
+static int		maxstriplumps;
+
+//
+// R_AddStripCmd
+//
+static stripcmd_t *R_AddStripCmd (strip_t *strip)
+{
+    if (strip->numcmds == strip->maxcmds)
+    {
+	strip->maxcmds = strip->maxcmds ? strip->maxcmds * 2 : 1024;
+	strip->cmds = realloc(strip->cmds, strip->maxcmds * sizeof(stripcmd_t));
+
+	if (!strip->cmds)
+	    I_Error ("R_AddStripCmd: failed to grow strip to %i", strip->maxcmds);
+    }
+
+    return &strip->cmds[strip->numcmds++];
+}
+
+//
+// R_QueueColumn
+// Stands in for colfunc while strips are being recorded.
+//
+static void R_QueueColumn (void)
+{
+    stripcmd_t	*cmd;
+
+    // R_DrawColumn wouldn't draw anything either
+    if (dc_yh < dc_yl)
+	return;
+
+    // the source is PU_CACHE, but the cache budget is held off while
+    // recording, and otherwise the zone only purges the cache when
+    // malloc fails; the strips are drawn before the frame ends
+
+#ifdef RANGECHECK
+    if ((unsigned)dc_x >= viewwidth
+	|| dc_yl < 0
+	|| dc_yh >= viewheight)
+	I_Error ("R_QueueColumn: %i to %i at %i", dc_yl, dc_yh, dc_x);
+#endif
+
+    cmd = R_AddStripCmd (&strips[stripforx[dc_x]]);
+    cmd->isspan = false;
+    cmd->u.column.colormap = dc_colormap;
+    cmd->u.column.source = dc_source;
+    cmd->u.column.x = dc_x;
+    cmd->u.column.yl = dc_yl;
+    cmd->u.column.yh = dc_yh;
+    cmd->u.column.iscale = dc_iscale;
+    cmd->u.column.texturemid = dc_texturemid;
+}
+
+//
+// R_QueueSpan
+// Stands in for spanfunc while strips are being recorded.
+//
+static void R_QueueSpan (void)
+{
+    stripcmd_t	*cmd;
+    int		i;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1
+	|| ds_x1<0
+	|| ds_x2>=viewwidth
+	|| (unsigned)ds_y>viewheight)
+    {
+	I_Error( "R_QueueSpan: %i to %i at %i",
+		 ds_x1,ds_x2,ds_y);
+    }
+#endif
+
+    for (i = stripforx[ds_x1]; i <= stripforx[ds_x2]; i++)
+    {
+	cmd = R_AddStripCmd (&strips[i]);
+	cmd->isspan = true;
+	cmd->u.span.colormap = ds_colormap;
+	cmd->u.span.source = ds_source;
+	cmd->u.span.y = ds_y;
+	cmd->u.span.x1 = ds_x1;
+	cmd->u.span.x2 = ds_x2;
+	cmd->u.span.xfrac = ds_xfrac;
+	cmd->u.span.yfrac = ds_yfrac;
+	cmd->u.span.xstep = ds_xstep;
+	cmd->u.span.ystep = ds_ystep;
+    }
+}
+
+//
+// R_ColumnRun
+// Checks whether the four records from cmd on, step apart, are
+// columns at x to x+3, and if so points column at them.
+//
+static boolean R_ColumnRun (stripcmd_t *cmd, int step,
+			    const drawcolumn_t **column)
+{
+    int		i;
+
+    for (i = 0; i < 4; i++, cmd += step)
+    {
+	if (cmd->isspan)
+	    return false;
+
+	column[i] = &cmd->u.column;
+
+	if (column[i]->x != column[0]->x + i)
+	    return false;
+    }
+
+    return true;
+}
+
+//
+// R_DrawStrip
+// Worker job; draws everything recorded for one strip.
+//
+static void R_DrawStrip (int job, void *data)
+{
+    strip_t	*strip = &strips[job];
+    stripcmd_t	*cmd;
+    const drawcolumn_t	*upper[4];
+    const drawcolumn_t	*lower[4];
+    int		i;
+
+    for (i = 0; i < strip->numcmds; i++)
+    {
+	cmd = &strip->cmds[i];
+
+	if (cmd->isspan)
+	{
+	    R_DrawSpanFrom (&cmd->u.span,
+			    MAX(cmd->u.span.x1, strip->x1),
+			    MIN(cmd->u.span.x2, strip->x2));
+	}
+	else if (i + 8 <= strip->numcmds
+		 && R_ColumnRun (cmd, 2, upper)
+		 && R_ColumnRun (cmd + 1, 2, lower))
+	{
+	    // upper and lower columns of a two sided wall
+	    R_DrawColumn4From (upper);
+	    R_DrawColumn4From (lower);
+	    i += 7;
+	}
+	else if (i + 4 <= strip->numcmds
+		 && R_ColumnRun (cmd, 1, upper))
+	{
+	    R_DrawColumn4From (upper);
+	    i += 3;
+	}
+	else
+	{
+	    R_DrawColumnFrom (&cmd->u.column);
+	}
+    }
+}
+
+//
+// R_BeginStrips
+// Starts recording walls and flats instead of drawing them. Returns
+// false, leaving the draw functions alone, if strip drawing is off
+// or can't be used with the current draw functions.
+//
+boolean R_BeginStrips (void)
+{
+    int		threads;
+    int		i;
+    int		x;
+
+    stripsactive = false;
+
+    // only the plain column and span drawers are recorded
+    if (colfunc != R_DrawColumn || spanfunc != R_DrawSpan)
+	return false;
+
+    threads = 0;
+
+    if (r_renderthreads > 0)
+	threads = I_StartWorkerThreads (r_renderthreads);
+
+    // without workers, only wide views gain from recording
+    if (threads <= 0 && viewstride == SCREENWIDTH)
+	return false;
+
+    numstrips = (threads + 1) * STRIPSPERTHREAD;
+
+    if (numstrips > MAXSTRIPS)
+	numstrips = MAXSTRIPS;
+
+    if (numstrips > viewwidth)
+	numstrips = viewwidth;
+
+    for (i = 0; i < numstrips; i++)
+    {
+	strips[i].x1 = i * viewwidth / numstrips;
+	strips[i].x2 = (i + 1) * viewwidth / numstrips - 1;
+	strips[i].numcmds = 0;
+
+	for (x = strips[i].x1; x <= strips[i].x2; x++)
+	    stripforx[x] = i;
+    }
+
+    numstriplumps = 0;
+
+    colfunc = R_QueueColumn;
+    spanfunc = R_QueueSpan;
+
+    Z_LockCache ();
+
+    stripsactive = true;
+    return true;
+}
+
+//
+// R_FinishStrips
+// Draws everything recorded since R_BeginStrips across the
+// worker threads and puts the draw functions back.
+//
+void R_FinishStrips (void)
+{
+    int		i;
+
+    if (!stripsactive)
+	return;
+
+    stripsactive = false;
+
+    colfunc = R_DrawColumn;
+    spanfunc = R_DrawSpan;
+
+    I_RunJobs (R_DrawStrip, NULL, numstrips);
+
+    for (i = 0; i < numstriplumps; i++)
+	W_ReleaseLumpNum (striplumps[i]);
+
+    numstriplumps = 0;
+
+    Z_UnlockCache ();
+}
+
+//
+// R_ReleaseStripLump
+// Releases a flat once R_DrawPlanes is done with it, or if its spans
+// have only been recorded, once R_FinishStrips has drawn them.
+//
+void R_ReleaseStripLump (int lumpnum)
+{
+    if (!stripsactive)
+    {
+	W_ReleaseLumpNum (lumpnum);
+	return;
+    }
+
+    if (numstriplumps == maxstriplumps)
+    {
+	maxstriplumps = maxstriplumps ? maxstriplumps * 2 : 64;
+	striplumps = realloc(striplumps, maxstriplumps * sizeof(int));
+
+	if (!striplumps)
+	    I_Error ("R_ReleaseStripLump: failed to grow lump list to %i", maxstriplumps);
+    }
+
+    striplumps[numstriplumps++] = lumpnum;
+}
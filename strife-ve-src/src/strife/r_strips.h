@@ -0,0 +1,31 @@
+//
+// Copyright(C) 2014 Night Dive Studios, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	[SVE] Multithreaded wall and flat drawing in screen strips.
+//
+
+
+#ifndef __R_STRIPS__
+#define __R_STRIPS__
+
+// worker threads used to draw walls and flats; 0 draws them as the
+// BSP is walked, the same as vanilla, unless the view is drawn wider
+// than the screen
+extern int		r_renderthreads;
+
+boolean R_BeginStrips (void);
+void	R_FinishStrips (void);
+void	R_ReleaseStripLump (int lumpnum);
+
+#endif
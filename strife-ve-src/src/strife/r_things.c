@@ -22,6 +22,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 #include "deh_main.h"
@@ -72,13 +73,15 @@ typedef struct
 //
 fixed_t		pspritescale;
 fixed_t		pspriteiscale;
+fixed_t		pspriteyscale;	// [SVE] see viewaspect
+fixed_t		pspriteyiscale;
 
 lighttable_t**	spritelights;
 
 // constant arrays
 //  used for psprite clipping and initializing clipping
-short		negonearray[SCREENWIDTH];
-short		screenheightarray[SCREENWIDTH];
+short		negonearray[MAXRENDERWIDTH];
+short		screenheightarray[MAXRENDERWIDTH];
 
 
 //
@@ -283,8 +286,10 @@ void R_InitSpriteDefs (char** namelist)
 //
 // GAME FUNCTIONS
 //
-vissprite_t	vissprites[MAXVISSPRITES];
+// [SVE] remove vissprites limit
+vissprite_t*	vissprites;
 vissprite_t*	vissprite_p;
+unsigned int	maxvissprites;
 int		newvissprite;
 int             sprbotscreen;       // villsa [STRIFE]
 
@@ -298,7 +303,7 @@ void R_InitSprites (char** namelist)
 {
     int		i;
 	
-    for (i=0 ; i<SCREENWIDTH ; i++)
+    for (i=0 ; i<MAXRENDERWIDTH ; i++)
     {
 	negonearray[i] = -1;
     }
@@ -321,12 +326,19 @@ void R_ClearSprites (void)
 //
 // R_NewVisSprite
 //
-vissprite_t	overflowsprite;
-
+// [SVE] Grows the array rather than dropping sprites once it's full.
+// Nothing links the vissprites together until they are sorted, so
+// they can be moved until then.
+//
 vissprite_t* R_NewVisSprite (void)
 {
-    if (vissprite_p == &vissprites[MAXVISSPRITES])
-	return &overflowsprite;
+    if (vissprite_p == vissprites + maxvissprites)
+    {
+        unsigned int newmax = maxvissprites ? maxvissprites*2 : MAXVISSPRITES;
+        vissprites = Z_Realloc(vissprites, newmax * sizeof(*vissprites), PU_STATIC, NULL);
+        vissprite_p = vissprites + maxvissprites;
+        maxvissprites = newmax;
+    }
     
     vissprite_p++;
     return vissprite_p-1;
@@ -458,7 +470,8 @@ R_DrawVisSprite
         dc_translation = translationtables - 256 + (translation >> (MF_TRANSSHIFT - 8));
     }
 
-    dc_iscale = abs(vis->xiscale)>>detailshift;
+    // [SVE] xiscale is across; the renderbuffer may be stretched
+    dc_iscale = FixedDiv(abs(vis->xiscale), viewaspect)>>detailshift;
     dc_texturemid = vis->texturemid;
     frac = vis->startfrac;
     spryscale = vis->scale;
@@ -523,6 +536,7 @@ void R_ProjectSprite (mobj_t* thing)
     fixed_t		tz;
 
     fixed_t		xscale;
+    fixed_t		yscale;
     
     int			x1;
     int			x2;
@@ -558,6 +572,7 @@ void R_ProjectSprite (mobj_t* thing)
 	return;
     
     xscale = FixedDiv(projection, tz);
+    yscale = FixedDiv(projectiony, tz);
 	
     gxt = -FixedMul(tr_x,viewsin); 
     gyt = FixedMul(tr_y,viewcos); 
@@ -614,7 +629,7 @@ void R_ProjectSprite (mobj_t* thing)
     // store information in a vissprite
     vis = R_NewVisSprite ();
     vis->mobjflags = thing->flags;
-    vis->scale = xscale<<detailshift;
+    vis->scale = yscale<<detailshift;
     vis->gx = spritepos.x;
     vis->gy = spritepos.y;
     vis->gz = spritepos.z;
@@ -667,7 +682,7 @@ void R_ProjectSprite (mobj_t* thing)
     else
     {
 	// diminished light
-	index = xscale>>(LIGHTSCALESHIFT-detailshift);
+	index = FixedMul(yscale, scalelightmul)>>(LIGHTSCALESHIFT-detailshift);
 
 	if (index >= MAXLIGHTSCALE) 
 	    index = MAXLIGHTSCALE-1;
@@ -769,7 +784,7 @@ void R_DrawPSprite (pspdef_t* psp)
     vis->mobjflags = 0;
     vis->x1 = x1 < 0 ? 0 : x1;
     vis->x2 = x2 >= viewwidth ? viewwidth-1 : x2;	
-    vis->scale = pspritescale<<detailshift;
+    vis->scale = pspriteyscale<<detailshift;
     
     if (flip)
     {
@@ -784,7 +799,7 @@ void R_DrawPSprite (pspdef_t* psp)
 
     // villsa [STRIFE] calculate y offset with view pitch
     vis->texturemid = ((BASEYCENTER<<FRACBITS)+FRACUNIT/2)-(psp->sy-spritetopoffset[lump])
-        + FixedMul(vis->xiscale, (centery-viewheight/2)<<FRACBITS);
+        + FixedMul(FixedDiv(vis->xiscale, viewaspect), (centery-viewheight/2)<<FRACBITS);
 
     if (vis->x1 > x1)
         vis->startfrac += vis->xiscale*(vis->x1-x1);
@@ -874,60 +889,159 @@ void R_DrawPlayerSprites (void)
 //
 // R_SortVisSprites
 //
+// [SVE] Stable merge sort by scale in place of vanilla's selection
+// sort. The selection sort takes the first of equal scales each time,
+// so sprites of equal scale still come out in the order they were
+// made and the draw order doesn't change.
+//
 vissprite_t	vsprsortedhead;
 
+static vissprite_t**	vsprsortbuf[2];
+static unsigned int	maxvsprsort;
 
 void R_SortVisSprites (void)
 {
     int			i;
     int			count;
+    int			width;
+    int			lo;
+    int			mid;
+    int			hi;
+    int			a;
+    int			b;
+    vissprite_t**	src;
+    vissprite_t**	dst;
+    vissprite_t**	swap;
     vissprite_t*	ds;
-    vissprite_t*	best;
-    vissprite_t		unsorted;
-    fixed_t		bestscale;
 
     count = vissprite_p - vissprites;
-	
-    unsorted.next = unsorted.prev = &unsorted;
+
+    vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
 
     if (!count)
 	return;
-		
-    for (ds=vissprites ; ds<vissprite_p ; ds++)
+
+    if (maxvsprsort < maxvissprites)
     {
-	ds->next = ds+1;
-	ds->prev = ds-1;
+	maxvsprsort = maxvissprites;
+	for (i=0 ; i<2 ; i++)
+	    vsprsortbuf[i] = Z_Realloc(vsprsortbuf[i], maxvsprsort * sizeof(vissprite_t*), PU_STATIC, NULL);
     }
-    
-    vissprites[0].prev = &unsorted;
-    unsorted.next = &vissprites[0];
-    (vissprite_p-1)->next = &unsorted;
-    unsorted.prev = vissprite_p-1;
-    
-    // pull the vissprites out by scale
 
-    vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
+    src = vsprsortbuf[0];
+    dst = vsprsortbuf[1];
+
     for (i=0 ; i<count ; i++)
+	src[i] = &vissprites[i];
+
+    // merge runs of width into runs of width*2
+    for (width=1 ; width<count ; width*=2)
     {
-	bestscale = INT_MAX;
-        best = unsorted.next;
-	for (ds=unsorted.next ; ds!= &unsorted ; ds=ds->next)
+	for (lo=0 ; lo<count ; lo+=width*2)
 	{
-	    if (ds->scale < bestscale)
+	    mid = MIN(lo+width, count);
+	    hi = MIN(lo+width*2, count);
+
+	    for (a=lo, b=mid, i=lo ; i<hi ; i++)
 	    {
-		bestscale = ds->scale;
-		best = ds;
+		// take from the left run on ties to keep it stable
+		if (a < mid && (b >= hi || src[a]->scale <= src[b]->scale))
+		    dst[i] = src[a++];
+		else
+		    dst[i] = src[b++];
 	    }
 	}
-	best->next->prev = best->prev;
-	best->prev->next = best->next;
-	best->next = &vsprsortedhead;
-	best->prev = vsprsortedhead.prev;
-	vsprsortedhead.prev->next = best;
-	vsprsortedhead.prev = best;
+
+	swap = src;
+	src = dst;
+	dst = swap;
+    }
+
+    // link them up smallest scale first
+    for (i=0 ; i<count ; i++)
+    {
+	ds = src[i];
+	ds->next = &vsprsortedhead;
+	ds->prev = vsprsortedhead.prev;
+	vsprsortedhead.prev->next = ds;
+	vsprsortedhead.prev = ds;
+    }
+}
+
+
+
+//
+// [SVE] Drawseg index for sprite clipping.
+//
+// The drawsegs that can clip a sprite (those with a silhouette or a
+// masked mid texture) are marked in a bitmask per bucket of screen
+// columns, so R_DrawSprite only looks at drawsegs that overlap the
+// columns it covers. The masks are walked from the highest bit down,
+// which visits the drawsegs in the same back to front order as the
+// vanilla scan of every drawseg.
+//
+#define DSBUCKETSHIFT		4
+#define DSBUCKETS		((MAXRENDERWIDTH + (1 << DSBUCKETSHIFT) - 1) >> DSBUCKETSHIFT)
+
+static uint32_t*	dsbuckets;
+static unsigned int	dsbucketwords;
+static unsigned int	maxdsbucketwords;
+
+//
+// R_BuildDrawSegBuckets
+// Called once all the drawsegs for the frame are in.
+//
+static void R_BuildDrawSegBuckets (void)
+{
+    drawseg_t*		ds;
+    unsigned int	count;
+    unsigned int	i;
+    int			b;
+
+    count = ds_p - drawsegs;
+    dsbucketwords = (count + 31) >> 5;
+
+    if (!dsbucketwords)
+	return;
+
+    if (dsbucketwords > maxdsbucketwords)
+    {
+	maxdsbucketwords = dsbucketwords * 2;
+	dsbuckets = Z_Realloc(dsbuckets, DSBUCKETS * maxdsbucketwords * sizeof(uint32_t), PU_STATIC, NULL);
+    }
+
+    // only the buckets the view covers are used
+    memset(dsbuckets, 0, (((viewwidth - 1) >> DSBUCKETSHIFT) + 1)
+			 * dsbucketwords * sizeof(uint32_t));
+
+    for (i=0 ; i<count ; i++)
+    {
+	ds = &drawsegs[i];
+
+	if (!ds->silhouette && !ds->maskedtexturecol)
+	    continue;
+
+	for (b = ds->x1 >> DSBUCKETSHIFT ; b <= ds->x2 >> DSBUCKETSHIFT ; b++)
+	    dsbuckets[b*dsbucketwords + (i>>5)] |= 1u << (i&31);
     }
 }
 
+//
+// R_HighestBit
+//
+static int R_HighestBit (uint32_t bits)
+{
+    int		bit = 0;
+
+    if (bits & 0xffff0000) { bits >>= 16; bit += 16; }
+    if (bits & 0xff00) { bits >>= 8; bit += 8; }
+    if (bits & 0xf0) { bits >>= 4; bit += 4; }
+    if (bits & 0xc) { bits >>= 2; bit += 2; }
+    if (bits & 0x2) { bit += 1; }
+
+    return bit;
+}
+
 
 
 //
@@ -936,14 +1050,20 @@ void R_SortVisSprites (void)
 void R_DrawSprite (vissprite_t* spr)
 {
     drawseg_t*		ds;
-    short		clipbot[SCREENWIDTH];
-    short		cliptop[SCREENWIDTH];
+    short		clipbot[MAXRENDERWIDTH];
+    short		cliptop[MAXRENDERWIDTH];
     int			x;
     int			r1;
     int			r2;
     fixed_t		scale;
     fixed_t		lowscale;
     int			silhouette;
+    int			b;
+    int			b1;
+    int			b2;
+    int			w;
+    int			bit;
+    uint32_t		bits;
 		
     for (x = spr->x1 ; x<=spr->x2 ; x++)
 	clipbot[x] = cliptop[x] = -2;
@@ -951,83 +1071,95 @@ void R_DrawSprite (vissprite_t* spr)
     // Scan drawsegs from end to start for obscuring segs.
     // The first drawseg that has a greater scale
     //  is the clip seg.
-    // haleyjd 20140831: [SVE] remove undefined behavior
-    //for (ds=ds_p-1 ; ds >= drawsegs ; ds--)
-    for(ds = ds_p; ds-- > drawsegs; )
+    // [SVE] only the drawsegs in the buckets the sprite covers
+    b1 = spr->x1 >> DSBUCKETSHIFT;
+    b2 = spr->x2 >> DSBUCKETSHIFT;
+
+    for (w = dsbucketwords ; w-- > 0 ; )
     {
-	// determine if the drawseg obscures the sprite
-	if (ds->x1 > spr->x2
-	    || ds->x2 < spr->x1
-	    || (!ds->silhouette
-		&& !ds->maskedtexturecol) )
-	{
-	    // does not cover sprite
-	    continue;
-	}
-			
-	r1 = ds->x1 < spr->x1 ? spr->x1 : ds->x1;
-	r2 = ds->x2 > spr->x2 ? spr->x2 : ds->x2;
+	bits = 0;
+	for (b = b1 ; b <= b2 ; b++)
+	    bits |= dsbuckets[b*dsbucketwords + w];
 
-	if (ds->scale1 > ds->scale2)
+	while (bits)
 	{
-	    lowscale = ds->scale2;
-	    scale = ds->scale1;
-	}
-	else
-	{
-	    lowscale = ds->scale1;
-	    scale = ds->scale2;
-	}
-		
-	if (scale < spr->scale
-	    || ( lowscale < spr->scale
-		 && !R_PointOnSegSide (spr->gx, spr->gy, ds->curline) ) )
-	{
-	    // masked mid texture?
-	    if (ds->maskedtexturecol)	
-		R_RenderMaskedSegRange (ds, r1, r2);
-	    // seg is behind sprite
-	    continue;			
-	}
+	    bit = R_HighestBit (bits);
+	    bits &= ~(1u << bit);
+	    ds = &drawsegs[(w<<5) + bit];
+
+	    // determine if the drawseg obscures the sprite
+	    if (ds->x1 > spr->x2
+		|| ds->x2 < spr->x1
+		|| (!ds->silhouette
+		    && !ds->maskedtexturecol) )
+	    {
+		// does not cover sprite
+		continue;
+	    }
 
-	
-	// clip this piece of the sprite
-	silhouette = ds->silhouette;
-	
-	if (spr->gz >= ds->bsilheight)
-	    silhouette &= ~SIL_BOTTOM;
+	    r1 = ds->x1 < spr->x1 ? spr->x1 : ds->x1;
+	    r2 = ds->x2 > spr->x2 ? spr->x2 : ds->x2;
 
-	if (spr->gzt <= ds->tsilheight)
-	    silhouette &= ~SIL_TOP;
-			
-	if (silhouette == 1)
-	{
-	    // bottom sil
-	    for (x=r1 ; x<=r2 ; x++)
-		if (clipbot[x] == -2)
-		    clipbot[x] = ds->sprbottomclip[x];
-	}
-	else if (silhouette == 2)
-	{
-	    // top sil
-	    for (x=r1 ; x<=r2 ; x++)
-		if (cliptop[x] == -2)
-		    cliptop[x] = ds->sprtopclip[x];
-	}
-	else if (silhouette == 3)
-	{
-	    // both
-	    for (x=r1 ; x<=r2 ; x++)
+	    if (ds->scale1 > ds->scale2)
 	    {
-		if (clipbot[x] == -2)
-		    clipbot[x] = ds->sprbottomclip[x];
-		if (cliptop[x] == -2)
-		    cliptop[x] = ds->sprtopclip[x];
+		lowscale = ds->scale2;
+		scale = ds->scale1;
+	    }
+	    else
+	    {
+		lowscale = ds->scale1;
+		scale = ds->scale2;
+	    }
+
+	    if (scale < spr->scale
+		|| ( lowscale < spr->scale
+		     && !R_PointOnSegSide (spr->gx, spr->gy, ds->curline) ) )
+	    {
+		// masked mid texture?
+		if (ds->maskedtexturecol)
+		    R_RenderMaskedSegRange (ds, r1, r2);
+		// seg is behind sprite
+		continue;
+	    }
+
+
+	    // clip this piece of the sprite
+	    silhouette = ds->silhouette;
+
+	    if (spr->gz >= ds->bsilheight)
+		silhouette &= ~SIL_BOTTOM;
+
+	    if (spr->gzt <= ds->tsilheight)
+		silhouette &= ~SIL_TOP;
+
+	    if (silhouette == 1)
+	    {
+		// bottom sil
+		for (x=r1 ; x<=r2 ; x++)
+		    if (clipbot[x] == -2)
+			clipbot[x] = ds->sprbottomclip[x];
+	    }
+	    else if (silhouette == 2)
+	    {
+		// top sil
+		for (x=r1 ; x<=r2 ; x++)
+		    if (cliptop[x] == -2)
+			cliptop[x] = ds->sprtopclip[x];
+	    }
+	    else if (silhouette == 3)
+	    {
+		// both
+		for (x=r1 ; x<=r2 ; x++)
+		{
+		    if (clipbot[x] == -2)
+			clipbot[x] = ds->sprbottomclip[x];
+		    if (cliptop[x] == -2)
+			cliptop[x] = ds->sprtopclip[x];
+		}
 	    }
 	}
-		
     }
-    
+
     // all clipping has been performed, so draw the sprite
 
     // check for unclipped columns
@@ -1060,6 +1192,8 @@ void R_DrawMasked (void)
 
     if (vissprite_p > vissprites)
     {
+	R_BuildDrawSegBuckets ();
+
 	// draw all vissprites back to front
 	for (spr = vsprsortedhead.next ;
 	     spr != &vsprsortedhead ;
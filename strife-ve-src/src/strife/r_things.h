@@ -22,16 +22,18 @@
 
 
 
+// [SVE] initial size; the array grows whenever it fills up
 #define MAXVISSPRITES  	128
 
-extern vissprite_t	vissprites[MAXVISSPRITES];
+extern vissprite_t*	vissprites;
 extern vissprite_t*	vissprite_p;
+extern unsigned int	maxvissprites;
 extern vissprite_t	vsprsortedhead;
 
 // Constant arrays used for psprite clipping
 //  and initializing clipping.
-extern short		negonearray[SCREENWIDTH];
-extern short		screenheightarray[SCREENWIDTH];
+extern short		negonearray[MAXRENDERWIDTH];
+extern short		screenheightarray[MAXRENDERWIDTH];
 
 // vars for R_DrawMaskedColumn
 extern short*		mfloorclip;
@@ -41,6 +43,8 @@ extern fixed_t		sprtopscreen;
 
 extern fixed_t		pspritescale;
 extern fixed_t		pspriteiscale;
+extern fixed_t		pspriteyscale;
+extern fixed_t		pspriteyiscale;
 
 
 // villsa [STIFE] new argument
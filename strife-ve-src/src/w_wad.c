@@ -369,9 +369,11 @@ void *W_CacheLumpNum(int lumpnum, int tag)
     else if (lump->cache != NULL)
     {
         // Already cached, so just switch the zone tag.
+        // [SVE] This can move a level arena block, so the pointer is
+        // read back afterwards.
 
-        result = lump->cache;
         Z_ChangeTag(lump->cache, tag);
+        result = lump->cache;
     }
     else
     {
@@ -18,12 +18,15 @@
 //      haleyjd: Yeah, no. Replaced with native heap implementation.
 //
 
+#include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "z_zone.h"
 #include "i_system.h"
 #include "doomtype.h"
+#include "m_argv.h"
 
 //
 // ZONE MEMORY ALLOCATION
@@ -46,19 +49,370 @@ typedef struct memblock
     size_t size;
     void **user;
     unsigned char tag;
+    unsigned char arena; // [SVE] carved out of the level arena
 } memblock_t;
 
 static const size_t header_size = (sizeof(memblock_t) + 15) & ~15;
 
 static memblock_t *blockbytag[PU_NUM_TAGS];
 
+// [SVE] accounting for Z_DumpStats
+static int    tagblocks[PU_NUM_TAGS];
+static size_t tagbytes[PU_NUM_TAGS];
+static size_t tagpeak[PU_NUM_TAGS];
+
+static const char *tagnames[PU_NUM_TAGS] =
+{
+    "", "static", "sound", "music", "free", "level", "levspec",
+    "purgelevel", "cache"
+};
+
+//
+// [SVE] Level arena
+//
+// With -zonearena, PU_LEVEL and PU_LEVSPEC blocks are bumped out of
+// large chunks instead of being malloced one by one. Freeing one of them
+// only clears its owner; the memory comes back all at once when
+// Z_FreeTags frees both level tags, and the chunks are kept for the
+// next level. Arena blocks with an owner are kept on a list so that the
+// owners can be cleared then as well.
+//
+
+#define ARENA_CHUNK_SIZE    (1024 * 1024)
+
+// blocks bigger than this get a chunk of their own
+#define ARENA_MAX_SHARED    (ARENA_CHUNK_SIZE / 4)
+
+#define Z_ArenaTag(tag) ((tag) == PU_LEVEL || (tag) == PU_LEVSPEC)
+
+typedef struct zchunk_s
+{
+    struct zchunk_s *next;
+    size_t size;     // usable bytes after the header
+    size_t used;
+} zchunk_t;
+
+static const size_t chunk_header_size = (sizeof(zchunk_t) + 15) & ~15;
+
+static boolean     arenamode;
+static zchunk_t   *arenachunks; // in use, the one being filled first
+static zchunk_t   *sparechunks; // emptied, waiting for the next level
+static memblock_t *arenaowned;  // arena blocks that have an owner
+static size_t      arenasize;   // bytes in the chunks in use
+static size_t      arenapeak;
+
+//
+// [SVE] Cache budget
+//
+// With -cachebudget, PU_CACHE blocks are purged least recently used
+// first whenever the cache would grow past the budget, down to seven
+// eighths of it. Blocks go to the head of the cache list when they are
+// allocated or have their tag set to PU_CACHE again (W_CacheLumpNum on a
+// cached lump), so the tail is always the one used longest ago.
+//
+// Code that still holds on to PU_CACHE pointers for a while, like the
+// software renderer's strips, can hold the purge off with Z_LockCache.
+//
+
+static size_t      cachebudget;
+static memblock_t *cachetail;
+static int         cachelocks;
+static int         cachepurges;
+
+// [SVE] every pool set up with Z_PoolInit
+static zpool_t *zonepools;
+
+struct zpoolslab_s
+{
+    zpoolslab_t *next;
+};
+
+#define POOL_ALIGN(x) (((x) + 15) & ~(size_t)15)
+
 //
 // Z_Init
 //
+// [SVE] Picks the zone backend from the command line.
+//
 void Z_Init(void)
 {
+    int p;
+
+    //!
+    // @category obscure
+    //
+    // Allocate level memory from large arenas which are released all
+    // at once when the level ends.
+    //
+
+    arenamode = M_ParmExists("-zonearena");
+
+    //!
+    // @arg <mb>
+    // @category obscure
+    //
+    // Keep the lump and texture cache under the given number of
+    // megabytes, purging the least recently used entries.
+    //
+
+    p = M_CheckParmWithArgs("-cachebudget", 1);
+
+    if(p)
+        cachebudget = (size_t)atoi(myargv[p + 1]) * 1024 * 1024;
+
+    //!
+    // @category obscure
+    //
+    // Print zone memory statistics at every level change and at exit.
+    //
+
+    if(M_ParmExists("-zonestats"))
+        I_AtExit(Z_DumpStats, false);
+}
+
+//
+// Z_account
+//
+// [SVE] count is 1 for a new block of the tag, -1 for one going away.
+//
+static void Z_account(int tag, size_t size, int count)
+{
+    tagblocks[tag] += count;
+
+    if(count > 0)
+    {
+        tagbytes[tag] += size;
+        if(tagbytes[tag] > tagpeak[tag])
+            tagpeak[tag] = tagbytes[tag];
+    }
+    else
+        tagbytes[tag] -= size;
+}
+
+//
+// Z_linkBlock
+//
+// [SVE] Puts a block at the head of a list, either a tag list or the
+// list of owned arena blocks.
+//
+static void Z_linkBlock(memblock_t *block, memblock_t **head)
+{
+    if((block->next = *head))
+        block->next->prev = &block->next;
+    else if(head == &blockbytag[PU_CACHE])
+        cachetail = block;
+
+    *head = block;
+    block->prev = head;
 }
 
+//
+// Z_unlinkBlock
+//
+static void Z_unlinkBlock(memblock_t *block)
+{
+    // step the tail back to the block before this one, if any
+    if(block == cachetail)
+    {
+        if(block->prev == &blockbytag[PU_CACHE])
+            cachetail = NULL;
+        else
+            cachetail = (memblock_t *)((byte *)block->prev - offsetof(memblock_t, next));
+    }
+
+    if((*block->prev = block->next))
+        block->next->prev = block->prev;
+}
+
+//
+// Z_dropUser
+//
+// [SVE] Detaches a block from its owner without clearing the owner,
+// for when the owner is being handed a new block.
+//
+static void Z_dropUser(memblock_t *block)
+{
+    if(block->arena && block->user)
+        Z_unlinkBlock(block);
+
+    block->user = NULL;
+}
+
+//
+// Z_systemAlloc
+//
+// Falls back to purging the cache if malloc fails.
+//
+static void *Z_systemAlloc(size_t size)
+{
+    void *ptr;
+
+    if(!(ptr = malloc(size)))
+    {
+        if(blockbytag[PU_CACHE])
+        {
+            Z_FreeTags(PU_CACHE, PU_CACHE);
+            ptr = malloc(size);
+        }
+    }
+
+    if(!ptr)
+        I_Error("Z_Malloc: failed on allocation of %u bytes", (unsigned int)size);
+
+    return ptr;
+}
+
+//
+// Z_arenaAlloc
+//
+// [SVE] Bumps size bytes off the level arena.
+//
+static void *Z_arenaAlloc(size_t size)
+{
+    zchunk_t *chunk = arenachunks;
+    byte     *ptr;
+
+    size = (size + 15) & ~(size_t)15;
+
+    if(size > ARENA_MAX_SHARED)
+    {
+        // a chunk of its own, behind the one being filled
+        chunk = Z_systemAlloc(chunk_header_size + size);
+        chunk->size = chunk->used = size;
+        arenasize += size;
+
+        if(arenachunks)
+        {
+            chunk->next = arenachunks->next;
+            arenachunks->next = chunk;
+        }
+        else
+        {
+            chunk->next = NULL;
+            arenachunks = chunk;
+        }
+
+        ptr = (byte *)chunk + chunk_header_size;
+    }
+    else
+    {
+        if(!chunk || chunk->size - chunk->used < size)
+        {
+            if((chunk = sparechunks))
+                sparechunks = chunk->next;
+            else
+            {
+                chunk = Z_systemAlloc(chunk_header_size + ARENA_CHUNK_SIZE);
+                chunk->size = ARENA_CHUNK_SIZE;
+            }
+
+            chunk->used = 0;
+            chunk->next = arenachunks;
+            arenachunks = chunk;
+            arenasize += chunk->size;
+        }
+
+        ptr = (byte *)chunk + chunk_header_size + chunk->used;
+        chunk->used += size;
+    }
+
+    if(arenasize > arenapeak)
+        arenapeak = arenasize;
+
+    return ptr;
+}
+
+//
+// Z_releaseArena
+//
+// [SVE] Called by Z_FreeTags once the ordinary blocks are gone. Arena
+// blocks with an owner in the range are freed to clear the owner. The
+// memory itself only comes back once both level tags have been freed.
+//
+static void Z_releaseArena(int lowtag, int hightag)
+{
+    memblock_t *block;
+    memblock_t *next;
+    zchunk_t   *chunk;
+    int         tag;
+
+    for(block = arenaowned; block; block = next)
+    {
+        next = block->next;
+
+        if(block->tag >= lowtag && block->tag <= hightag)
+            Z_Free((byte *)block + header_size);
+    }
+
+    if(lowtag > PU_LEVEL || hightag < PU_LEVSPEC)
+        return;
+
+    while((chunk = arenachunks))
+    {
+        arenachunks = chunk->next;
+
+        if(chunk->size == ARENA_CHUNK_SIZE)
+        {
+            chunk->next = sparechunks;
+            sparechunks = chunk;
+        }
+        else
+            free(chunk);
+    }
+
+    arenasize = 0;
+
+    // what's left are the blocks nobody owned
+    for(tag = PU_LEVEL; tag <= PU_LEVSPEC; tag++)
+    {
+        tagblocks[tag] = 0;
+        tagbytes[tag] = 0;
+    }
+}
+
+//
+// Z_trimCache
+//
+// [SVE] Purges the least recently used cache blocks until the cache,
+// with incoming more bytes, fits the budget.
+//
+static void Z_trimCache(size_t incoming)
+{
+    size_t target;
+
+    if(!cachebudget || cachelocks)
+        return;
+
+    if(tagbytes[PU_CACHE] + incoming <= cachebudget)
+        return;
+
+    target = cachebudget - cachebudget / 8;
+
+    while(cachetail && tagbytes[PU_CACHE] + incoming > target)
+    {
+        Z_Free((byte *)cachetail + header_size);
+        cachepurges++;
+    }
+}
+
+//
+// Z_LockCache
+//
+// [SVE] Holds off cache budget purges until the matching Z_UnlockCache.
+//
+void Z_LockCache(void)
+{
+    cachelocks++;
+}
+
+//
+// Z_UnlockCache
+//
+void Z_UnlockCache(void)
+{
+    if(cachelocks > 0 && --cachelocks == 0)
+        Z_trimCache(0);
+}
 
 //
 // Z_Free
@@ -66,6 +420,7 @@ void Z_Init(void)
 void Z_Free(void* ptr)
 {
     memblock_t *block = (memblock_t *)((byte *)ptr - header_size);
+    int tag;
     
     if(!ptr)
         I_Error("Z_Free: freed a NULL pointer");
@@ -80,15 +435,28 @@ void Z_Free(void* ptr)
         I_Error("Z_Free: freed a pointer with invalid tag");
 
     // mark freed
+    tag = block->tag;
     block->tag = PU_FREE;
 
+    Z_account(tag, block->size, -1);
+
+    // [SVE] arena memory stays put until the arena is released
+    if(block->arena)
+    {
+        if(block->user)
+        {
+            *block->user = NULL;
+            Z_unlinkBlock(block);
+        }
+        return;
+    }
+
     // nullify user if one exists
     if(block->user)
         *block->user = NULL;
 
     // unlink block
-    if((*block->prev = block->next))
-        block->next->prev = block->prev;
+    Z_unlinkBlock(block);
 
     free(block);
 }
@@ -108,29 +476,37 @@ void *Z_Malloc(int size, int tag, void **user)
     if(!size)
         size = 32; // vanilla compat
 
-    if(!(block = (memblock_t *)(malloc(size + header_size))))
+    if(tag == PU_CACHE)
+        Z_trimCache(size);
+
+    if(arenamode && Z_ArenaTag(tag))
     {
-        if(blockbytag[PU_CACHE])
+        // [SVE] level arena
+        block = Z_arenaAlloc(size + header_size);
+        block->arena = true;
+
+        if(user)
+            Z_linkBlock(block, &arenaowned);
+        else
         {
-            Z_FreeTags(PU_CACHE, PU_CACHE);
-            block = (memblock_t *)(malloc(size + header_size));
+            block->next = NULL;
+            block->prev = NULL;
         }
     }
-
-    if(!block)
-        I_Error("Z_Malloc: failed on allocation of %u bytes", (unsigned int)size);
+    else
+    {
+        block = Z_systemAlloc(size + header_size);
+        block->arena = false;
+        Z_linkBlock(block, &blockbytag[tag]);
+    }
 
     block->size = size;
-
-    if((block->next = blockbytag[tag]))
-        block->next->prev = &block->next;
-    blockbytag[tag] = block;
-    block->prev = &blockbytag[tag];
-
     block->id   = ZONEID;
     block->tag  = tag;
     block->user = user;
 
+    Z_account(tag, size, 1);
+
     ret = ((byte *)block + header_size);
     if(user)
         *user = ret;
@@ -149,6 +525,27 @@ void *Z_Calloc(int n1, int n2, int tag, void **user)
     return memset(Z_Malloc(size, tag, user), 0, size);
 }
 
+//
+// Z_reallocArena
+//
+// [SVE] Arena blocks can't be grown in place, so a reallocation that
+// starts or ends in the arena makes a new block and copies.
+//
+static void *Z_reallocArena(void *ptr, int size, int tag, void **user)
+{
+    memblock_t *block = (memblock_t *)((byte *)ptr - header_size);
+    void *p;
+
+    Z_dropUser(block);
+
+    p = Z_Calloc(1, size, tag, user);
+    memcpy(p, ptr, MIN(block->size, (size_t)size));
+
+    Z_Free(ptr);
+
+    return p;
+}
+
 //
 // Z_Realloc
 //
@@ -176,6 +573,10 @@ void *Z_Realloc(void *ptr, int size, int tag, void **user)
     if(block->id != ZONEID)
         I_Error("Z_Realloc: reallocated a block without ZONEID");
 
+    // [SVE]
+    if(block->arena || (arenamode && Z_ArenaTag(tag)))
+        return Z_reallocArena(ptr, size, tag, user);
+
     origsize = block->size;
 
     // nullify current user, if any
@@ -183,12 +584,15 @@ void *Z_Realloc(void *ptr, int size, int tag, void **user)
         *(block->user) = NULL;
 
     // detach from list before reallocation
-    if((*block->prev = block->next))
-        block->next->prev = block->prev;
+    Z_unlinkBlock(block);
+    Z_account(block->tag, block->size, -1);
 
     block->next = NULL;
     block->prev = NULL;
 
+    if(tag == PU_CACHE)
+        Z_trimCache(size);
+
     if(!(newblock = (memblock_t *)(realloc(block, size + header_size))))
     {
         if(blockbytag[PU_CACHE])
@@ -224,20 +628,44 @@ void *Z_Realloc(void *ptr, int size, int tag, void **user)
         *user = p;
 
     // reattach to list at possibly new address, new tag
-    if((block->next = blockbytag[tag]))
-        block->next->prev = &block->next;
-    blockbytag[tag] = block;
-    block->prev = &blockbytag[tag];
+    Z_linkBlock(block, &blockbytag[tag]);
+    Z_account(tag, size, 1);
 
     return p;
 }
 
+//
+// Z_poolsFreed
+//
+// [SVE] The slabs of any pool with a tag in the range are about to be
+// freed along with the rest of the blocks, so the pools start over.
+//
+static void Z_poolsFreed(int lowtag, int hightag)
+{
+    zpool_t *pool;
+
+    for(pool = zonepools; pool; pool = pool->nextpool)
+    {
+        if(pool->tag < lowtag || pool->tag > hightag)
+            continue;
+
+        pool->slabs     = NULL;
+        pool->rover     = NULL;
+        pool->left      = 0;
+        pool->freelist  = NULL;
+        pool->numslabs  = 0;
+        pool->live      = 0;
+        pool->highwater = 0;
+    }
+}
+
 //
 // Z_FreeTags
 //
 void Z_FreeTags(int lowtag, int	hightag)
 {
     memblock_t *block;
+    int         tag;
 
     if(lowtag <= PU_FREE)
         lowtag = PU_FREE + 1;
@@ -245,9 +673,11 @@ void Z_FreeTags(int lowtag, int	hightag)
     if(hightag > PU_CACHE)
         hightag = PU_CACHE;
 
-    for(; lowtag <= hightag; lowtag++)
+    Z_poolsFreed(lowtag, hightag);
+
+    for(tag = lowtag; tag <= hightag; tag++)
     {
-        for(block = blockbytag[lowtag], blockbytag[lowtag] = NULL; block; )
+        for(block = blockbytag[tag], blockbytag[tag] = NULL; block; )
         {
             memblock_t *next = block->next;
 
@@ -258,6 +688,10 @@ void Z_FreeTags(int lowtag, int	hightag)
             block = next;
         }
     }
+
+    // [SVE]
+    if(arenamode)
+        Z_releaseArena(lowtag, hightag);
 }
 
 //
@@ -276,6 +710,13 @@ void Z_CheckHeap(void)
                 I_Error("Z_CheckHeap: block found without ZONEID");
         }
     }
+
+    // [SVE]
+    for(block = arenaowned; block; block = block->next)
+    {
+        if(block->id != ZONEID)
+            I_Error("Z_CheckHeap: arena block found without ZONEID");
+    }
 }
 
 //
@@ -296,16 +737,187 @@ void Z_ChangeTag2(void *ptr, int tag, char *file, int line)
     if(tag >= PU_PURGELEVEL && !block->user)
         I_Error("Z_ChangeTag: an owner is required for purgable blocks");
 
-    if((*block->prev = block->next))
-        block->next->prev = block->prev;
-    if((block->next = blockbytag[tag]))
-        block->next->prev = &block->next;
-    block->prev = &blockbytag[tag];
-    blockbytag[tag] = block;
+    // [SVE] arena blocks can move between the level tags, but have to be
+    // moved to the heap to outlive the level. Only the owner learns of
+    // the new address, so there has to be one.
+    if(block->arena)
+    {
+        void **user = block->user;
+        void *p;
+
+        if(Z_ArenaTag(tag))
+        {
+            Z_account(block->tag, block->size, -1);
+            Z_account(tag, block->size, 1);
+            block->tag = tag;
+            return;
+        }
+
+        if(!user)
+        {
+            I_Error("Z_ChangeTag: an owner is required to take a level block "
+                    "out of the arena at %s:%d", file, line);
+        }
+
+        Z_dropUser(block);
+        p = Z_Malloc(block->size, tag, user);
+        memcpy(p, ptr, block->size);
+        Z_Free(ptr);
+        return;
+    }
+
+    Z_unlinkBlock(block);
+    Z_account(block->tag, block->size, -1);
+
+    if(tag == PU_CACHE)
+        Z_trimCache(block->size);
+
+    Z_linkBlock(block, &blockbytag[tag]);
+    Z_account(tag, block->size, 1);
 
     block->tag = tag;
 }
 
+//
+// Z_PoolInit
+//
+// [SVE] Sets up an empty pool of objects of the given size, which will
+// be allocated perslab at a time in blocks with the given tag. Purgable
+// tags can't be used, since nothing would be told about the purge.
+//
+void Z_PoolInit(zpool_t *pool, const char *name, size_t size, int perslab, int tag)
+{
+    if(tag >= PU_PURGELEVEL)
+        I_Error("Z_PoolInit: pool %s can't have a purgable tag", name);
+
+    memset(pool, 0, sizeof(*pool));
+
+    pool->name    = name;
+    pool->size    = POOL_ALIGN(size < sizeof(void *) ? sizeof(void *) : size);
+    pool->perslab = perslab;
+    pool->tag     = tag;
+
+    pool->nextpool = zonepools;
+    zonepools = pool;
+}
+
+//
+// Z_PoolAlloc
+//
+// [SVE] Returns an object from the pool. Its contents are undefined.
+//
+void *Z_PoolAlloc(zpool_t *pool)
+{
+    void *ptr;
+
+    if(pool->freelist)
+    {
+        ptr = pool->freelist;
+        pool->freelist = *(void **)ptr;
+    }
+    else
+    {
+        if(!pool->left)
+        {
+            zpoolslab_t *slab;
+
+            slab = Z_Malloc(POOL_ALIGN(sizeof(zpoolslab_t)) +
+                            pool->size * pool->perslab, pool->tag, NULL);
+            slab->next  = pool->slabs;
+            pool->slabs = slab;
+            pool->rover = (byte *)slab + POOL_ALIGN(sizeof(zpoolslab_t));
+            pool->left  = pool->perslab;
+            pool->numslabs++;
+        }
+
+        ptr = pool->rover;
+        pool->rover += pool->size;
+        pool->left--;
+    }
+
+    if(++pool->live > pool->highwater)
+        pool->highwater = pool->live;
+
+    return ptr;
+}
+
+//
+// Z_PoolFree
+//
+// [SVE] Puts an object from Z_PoolAlloc on the pool's free list.
+//
+void Z_PoolFree(zpool_t *pool, void *ptr)
+{
+    if(!ptr)
+        I_Error("Z_PoolFree: freed a NULL pointer to pool %s", pool->name);
+
+    *(void **)ptr = pool->freelist;
+    pool->freelist = ptr;
+    pool->live--;
+}
+
+//
+// Z_PrintPoolStats
+//
+// [SVE] Prints how full each pool is and has been since its tag
+// was last freed.
+//
+void Z_PrintPoolStats(void)
+{
+    zpool_t *pool;
+
+    for(pool = zonepools; pool; pool = pool->nextpool)
+    {
+        printf("    pool %-12s %6i live %6i high water %4i slabs (%u KB)\n",
+               pool->name, pool->live, pool->highwater, pool->numslabs,
+               (unsigned int)(pool->numslabs * pool->perslab * pool->size / 1024));
+    }
+}
+
+//
+// Z_DumpStats
+//
+// [SVE] Prints the blocks and bytes held under each tag, with the most
+// bytes each has held, followed by the arena, cache and pool figures.
+//
+void Z_DumpStats(void)
+{
+    zchunk_t *chunk;
+    size_t    spare = 0;
+    int       tag;
+
+    printf("Z_DumpStats:\n");
+    printf("    %-12s %8s %10s %10s\n", "tag", "blocks", "KB", "peak KB");
+
+    for(tag = PU_STATIC; tag < PU_NUM_TAGS; tag++)
+    {
+        if(tag == PU_FREE)
+            continue;
+
+        printf("    %-12s %8i %10u %10u\n", tagnames[tag], tagblocks[tag],
+               (unsigned int)(tagbytes[tag] / 1024),
+               (unsigned int)(tagpeak[tag] / 1024));
+    }
+
+    if(arenamode)
+    {
+        for(chunk = sparechunks; chunk; chunk = chunk->next)
+            spare += chunk->size;
+
+        printf("    level arena %u KB in use, %u KB spare, %u KB peak\n",
+               (unsigned int)(arenasize / 1024), (unsigned int)(spare / 1024),
+               (unsigned int)(arenapeak / 1024));
+    }
+
+    if(cachebudget)
+    {
+        printf("    cache budget %u KB, %i blocks purged\n",
+               (unsigned int)(cachebudget / 1024), cachepurges);
+    }
+
+    Z_PrintPoolStats();
+}
+
 // EOF
 
 
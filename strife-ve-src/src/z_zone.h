@@ -62,6 +62,44 @@ void    Z_ChangeTag2 (void *ptr, int tag, char *file, int line);
 void *Z_Calloc(int n1, int n2, int tag, void **user);
 void *Z_Realloc(void *ptr, int size, int tag, void **user);
 
+// [SVE] cache budget and accounting
+void    Z_LockCache (void);
+void    Z_UnlockCache (void);
+void    Z_DumpStats (void);
+
+//
+// [SVE] Pools of fixed size objects
+//
+// Objects are carved out of large zone blocks with the pool's tag
+// and recycled through a free list. The blocks are ordinary zone
+// memory, so Z_FreeTags releases them with everything else of that
+// tag and empties the pool. Objects from a pool must be given back
+// with Z_PoolFree, never Z_Free.
+//
+
+typedef struct zpoolslab_s zpoolslab_t;
+
+typedef struct zpool_s
+{
+    const char      *name;
+    size_t           size;      // per object, rounded up for alignment
+    int              perslab;
+    int              tag;
+    zpoolslab_t     *slabs;
+    unsigned char   *rover;     // next unused object in the newest slab
+    int              left;      // unused objects after the rover
+    void            *freelist;
+    int              numslabs;
+    int              live;      // objects handed out and not yet freed
+    int              highwater; // most objects live at once
+    struct zpool_s  *nextpool;
+} zpool_t;
+
+void    Z_PoolInit (zpool_t *pool, const char *name, size_t size, int perslab, int tag);
+void*   Z_PoolAlloc (zpool_t *pool);
+void    Z_PoolFree (zpool_t *pool, void *ptr);
+void    Z_PrintPoolStats (void);
+
 //
 // This is used to get the local FILE:LINE info from CPP
 // prior to really call the function in question.